@@ -0,0 +1,134 @@
+/*
+	Bus schedule planner. Runs a control loop workload on the link simulator and reports whether it fits the cycle,
+	in virtual time, so a schedule can be sized before the hardware exists.
+
+	Every cycle, for each motor on the bus:
+		dartt_sync         command block (setpoints, gains), one setpoint changed per cycle
+		dartt_read_multi   status block (position, velocity, current, temperature, faults)
+	on an RS485 style half duplex UART with COBS framing (dartt_serial_linux).
+
+	usage: bench_linksim [motors] [cycle_us] [baud]
+		Without a baud rate, common rates are swept.
+*/
+#include "dartt.h"
+#include "dartt_sync.h"
+#include "dartt_linksim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_MOTORS	DARTT_LINKSIM_MAX_PERIPHS
+#define CYCLES		1000
+
+typedef struct motor_regs_t
+{
+	int32_t setpoint[4];
+	int32_t gain[4];
+	int32_t position[4];
+	int32_t velocity[4];
+	int32_t current[4];
+	int32_t temperature;
+	uint32_t faults;
+}motor_regs_t;
+
+typedef struct motor_t
+{
+	motor_regs_t ctl;
+	motor_regs_t shadow;
+	motor_regs_t periph;
+	dartt_sync_t ds;
+	unsigned char tx_mem[64];
+	unsigned char rx_mem[64];
+}motor_t;
+
+static motor_t motors[MAX_MOTORS];
+
+static const dartt_linksim_params_t rs485 =
+{
+	.baud = 1000000,
+	.bits_per_byte = 10,		//8N1
+	.cobs = 1,
+	.full_duplex = 0,
+	.frame_overhead_bits = 0,
+	.turnaround_ns = 5000,		//transceiver enable and line settling
+	.propagation_ns = 20000,	//USB adapter latency on the controller side dominates
+	.periph_fixed_ns = 10000,	//parse and reply on a small MCU
+	.periph_per_byte_ns = 50
+};
+
+/*
+	Run the workload at one baud rate. Returns nonzero if every cycle fit
+*/
+static int plan(uint32_t baud, int num_motors, uint64_t cycle_ns)
+{
+	static dartt_linksim_t sim;
+	dartt_linksim_params_t params = rs485;
+	params.baud = baud;
+	dartt_linksim_init(&sim, &params, TYPE_SERIAL_MESSAGE, cycle_ns);
+	for(int m = 0; m < num_motors; m++)
+	{
+		motor_t * mt = &motors[m];
+		memset(mt, 0, sizeof(motor_t));
+		unsigned char address = (unsigned char)(m + 1);
+		dartt_linksim_add(&sim, dartt_get_complementary_address(address), (dartt_mem_t){.buf = (unsigned char *)&mt->periph, .size = sizeof(motor_regs_t)});
+		mt->ds.address = address;
+		mt->ds.ctl_base = (dartt_mem_t){.buf = (unsigned char *)&mt->ctl, .size = sizeof(motor_regs_t)};
+		mt->ds.periph_base = (dartt_mem_t){.buf = (unsigned char *)&mt->shadow, .size = sizeof(motor_regs_t)};
+		mt->ds.msg_type = TYPE_SERIAL_MESSAGE;
+		mt->ds.tx_buf = (dartt_buffer_t){.buf = mt->tx_mem, .size = sizeof(mt->tx_mem), .len = 0};
+		mt->ds.rx_buf = (dartt_buffer_t){.buf = mt->rx_mem, .size = sizeof(mt->rx_mem), .len = 0};
+		mt->ds.blocking_tx_callback = &dartt_linksim_tx;
+		mt->ds.blocking_rx_callback = &dartt_linksim_rx;
+		mt->ds.user_context_tx = &sim;
+		mt->ds.user_context_rx = &sim;
+		mt->ds.timeout_ms = 5;
+	}
+
+	for(int c = 0; c < CYCLES; c++)
+	{
+		dartt_linksim_begin_cycle(&sim);
+		for(int m = 0; m < num_motors; m++)
+		{
+			motor_t * mt = &motors[m];
+			mt->ctl.setpoint[c % 4] = c;
+			mt->periph.position[0] = c;		//the peripheral moves on its own
+			dartt_mem_t command = {.buf = (unsigned char *)&mt->ctl.setpoint, .size = sizeof(mt->ctl.setpoint) + sizeof(mt->ctl.gain)};
+			dartt_mem_t status = {.buf = (unsigned char *)&mt->ctl.position, .size = sizeof(motor_regs_t) - offsetof(motor_regs_t, position)};
+			if(dartt_sync(&command, &mt->ds) != DARTT_PROTOCOL_SUCCESS || dartt_read_multi(&status, &mt->ds) != DARTT_PROTOCOL_SUCCESS)
+			{
+				fprintf(stderr, "motor %d failed in cycle %d\n", m, c);
+				exit(1);
+			}
+		}
+		dartt_linksim_end_cycle(&sim);
+	}
+
+	const dartt_linksim_stats_t * st = &sim.stats;
+	printf("%9u %6d %10.1f %10.1f %9.1f %9.1f %8u\n", baud, num_motors,
+		st->max_duration_ns*1e-3, st->max_latency_ns*1e-3,
+		100.0*st->max_busy_ns/cycle_ns, 100.0*st->total_busy_ns/((double)cycle_ns*st->cycles), st->overruns);
+	return st->overruns == 0;
+}
+
+int main(int argc, char ** argv)
+{
+	int num_motors = (argc > 1) ? atoi(argv[1]) : 6;
+	uint64_t cycle_ns = (argc > 2) ? (uint64_t)atoi(argv[2])*1000u : 1000000u;
+	if(num_motors < 1 || num_motors > MAX_MOTORS || cycle_ns == 0)
+	{
+		fprintf(stderr, "usage: bench_linksim [motors (1-%d)] [cycle_us] [baud]\n", MAX_MOTORS);
+		return 1;
+	}
+	printf("# %d cycles of %.0f us, virtual time\n", CYCLES, cycle_ns*1e-3);
+	printf("#    baud motors max_cyc_us max_lat_us  max_util mean_util overruns\n");
+	if(argc > 3)
+	{
+		return plan((uint32_t)atoi(argv[3]), num_motors, cycle_ns) ? 0 : 2;
+	}
+	static const uint32_t bauds[] = {115200, 460800, 921600, 1000000, 2000000, 3000000, 4000000, 6000000, 12000000};
+	for(size_t i = 0; i < sizeof(bauds)/sizeof(bauds[0]); i++)
+	{
+		plan(bauds[i], num_motors, cycle_ns);
+	}
+	return 0;
+}
@@ -0,0 +1,120 @@
+/*
+	Shared memory benchmark. Reads one 32 bit register from a simulated peripheral over a dartt_shm_linux link and
+	reports transactions per second for:
+		pump     peripheral served from the rx callback of the controller, on one thread
+		thread   peripheral served by dartt_shm_linux_serve on a second thread
+
+	usage: bench_shm [transactions]
+*/
+#define _GNU_SOURCE
+#include "dartt.h"
+#include "dartt_sync.h"
+#include "dartt_shm_linux.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define REG_COUNT	64
+
+typedef struct server_t
+{
+	dartt_shm_linux_t link;
+	uint32_t regs[REG_COUNT];
+	dartt_mem_t mem_base;
+	volatile int stop;
+}server_t;
+
+static void * server_thread(void * arg)
+{
+	server_t * srv = (server_t *)arg;
+	while(!srv->stop)
+	{
+		dartt_shm_linux_serve(&srv->link, &srv->mem_base, TYPE_ADDR_CRC_MESSAGE, 10);
+	}
+	return NULL;
+}
+
+static int server_pump(void * context)
+{
+	server_t * srv = (server_t *)context;
+	return dartt_shm_linux_serve(&srv->link, &srv->mem_base, TYPE_ADDR_CRC_MESSAGE, 0) != DARTT_ERROR_TIMEOUT;
+}
+
+static double now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static uint32_t ctl_regs[REG_COUNT];
+static uint32_t shadow_regs[REG_COUNT];
+
+static double run(const char * name, dartt_sync_t * ds, server_t * srv, int transactions)
+{
+	dartt_mem_t reg = {.buf = (unsigned char *)&ctl_regs[5], .size = sizeof(uint32_t)};
+	double t0 = now_s();
+	for(int i = 0; i < transactions; i++)
+	{
+		srv->regs[5] = (uint32_t)i;
+		int rc = dartt_ctl_read(&reg, ds);
+		if(rc != DARTT_PROTOCOL_SUCCESS || shadow_regs[5] != (uint32_t)i)
+		{
+			fprintf(stderr, "%s: read %d failed with %d\n", name, i, rc);
+			exit(1);
+		}
+	}
+	double tps = transactions/(now_s() - t0);
+	printf("%-10s %12.0f transactions/s\n", name, tps);
+	return tps;
+}
+
+int main(int argc, char ** argv)
+{
+	int transactions = (argc > 1) ? atoi(argv[1]) : 1000000;
+
+	static dartt_shm_linux_t link;
+	static server_t srv;
+	if(dartt_shm_linux_create(&link) != DARTT_PROTOCOL_SUCCESS || dartt_shm_linux_attach(&srv.link, link.fd, 1) != DARTT_PROTOCOL_SUCCESS)
+	{
+		perror("dartt_shm_linux");
+		return 1;
+	}
+	srv.mem_base = (dartt_mem_t){.buf = (unsigned char *)srv.regs, .size = sizeof(srv.regs)};
+
+	unsigned char tx_mem[64];
+	unsigned char rx_mem[64];
+	dartt_sync_t ds = {};
+	ds.address = 3;
+	ds.ctl_base.buf = (unsigned char *)ctl_regs;
+	ds.ctl_base.size = sizeof(ctl_regs);
+	ds.periph_base.buf = (unsigned char *)shadow_regs;
+	ds.periph_base.size = sizeof(shadow_regs);
+	ds.msg_type = TYPE_ADDR_CRC_MESSAGE;
+	ds.tx_buf = (dartt_buffer_t){.buf = tx_mem, .size = sizeof(tx_mem), .len = 0};
+	ds.rx_buf = (dartt_buffer_t){.buf = rx_mem, .size = sizeof(rx_mem), .len = 0};
+	ds.blocking_tx_callback = &dartt_shm_linux_tx;
+	ds.blocking_rx_callback = &dartt_shm_linux_rx;
+	ds.user_context_tx = &link;
+	ds.user_context_rx = &link;
+	ds.timeout_ms = 100;
+	printf("%d reads of one register, spin %u\n", transactions, link.spin);
+
+	link.pump_callback = &server_pump;
+	link.pump_context = &srv;
+	run("pump", &ds, &srv, transactions);
+	link.pump_callback = NULL;
+	link.pump_context = NULL;
+
+	pthread_t thread;
+	pthread_create(&thread, NULL, &server_thread, &srv);
+	run("thread", &ds, &srv, transactions/10);	//two context switches per transaction on a single core
+	srv.stop = 1;
+	pthread_join(thread, NULL);
+
+	dartt_shm_linux_close(&srv.link);
+	dartt_shm_linux_close(&link);
+	return 0;
+}
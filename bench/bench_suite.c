@@ -0,0 +1,496 @@
+/*
+	Protocol benchmark suite. Times the frame codec, the peripheral parser, the CRCs, and the dartt_sync_t
+	operations against an in-process peripheral (loopback callbacks, no transport), for all three message types and
+	a range of payload sizes.
+
+	Output is CSV on stdout, one row per case, so runs can be diffed or collected over time:
+		benchmark,msg_type,bytes,iterations,ns_per_op,mbytes_per_s
+	bytes is the payload of one frame. mbytes_per_s counts the payload moved per operation: bytes for the codec and
+	CRC cases, the changed words for dartt_sync, the whole region for dartt_read_multi. Lines starting with # are
+	comments.
+
+	usage: bench_suite [min_ms_per_case] [filter]
+		min_ms_per_case  time spent on each case, after calibration. Default 100
+		filter           only run benchmarks whose name contains this string
+
+	Cortex-M (M3 and up): build this file and the protocol sources with your startup code and a printf retargeted to
+	a UART or semihosting, and define BENCH_CPU_HZ to the core clock. Time is then taken from the DWT cycle counter.
+*/
+#ifndef BENCH_CPU_HZ
+#define _GNU_SOURCE
+#endif
+#include "dartt.h"
+#include "dartt_sync.h"
+#include "dartt_crc.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef BENCH_CPU_HZ
+#include <time.h>
+#endif
+
+#define REGION_SIZE		1024	//peripheral memory for the dartt_sync_t cases
+#define MAX_PAYLOAD		256
+#define FRAME_SIZE		(MAX_PAYLOAD + 16)	//payload plus the largest framing overhead
+
+static const size_t payload_sizes[] = {4, 16, 64, 256};
+static const serial_message_type_t msg_types[] = {TYPE_SERIAL_MESSAGE, TYPE_ADDR_MESSAGE, TYPE_ADDR_CRC_MESSAGE};
+static const char * const msg_type_names[] = {"serial", "addr", "addr_crc"};
+
+static uint32_t min_ns = 100000000;
+static const char * filter = NULL;
+static volatile uint32_t sink;	//results are folded in here so the compiler keeps the work
+
+/*
+	Loopback link: the tx callback runs the peripheral on the frame at once, and queues its reply for the rx callback
+*/
+typedef struct loopback_t
+{
+	serial_message_type_t type;
+	dartt_mem_t periph_mem;
+	unsigned char reply_mem[FRAME_SIZE];
+	dartt_buffer_t reply;
+}loopback_t;
+
+static int loopback_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	(void)address;
+	(void)timeout;
+	loopback_t * lb = (loopback_t *)user_context;
+	payload_layer_msg_t pld = {};
+	int rc = dartt_frame_to_payload(tx, lb->type, PAYLOAD_ALIAS, &pld);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	lb->reply = (dartt_buffer_t){.buf = lb->reply_mem, .size = sizeof(lb->reply_mem), .len = 0};
+	return dartt_parse_general_message(&pld, lb->type, &lb->periph_mem, &lb->reply);
+}
+
+static int loopback_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout)
+{
+	(void)timeout;
+	loopback_t * lb = (loopback_t *)user_context;
+	if(lb->reply.len == 0 || lb->reply.len > rx->size)
+	{
+		rx->len = 0;
+		return DARTT_ERROR_TIMEOUT;
+	}
+	memcpy(rx->buf, lb->reply.buf, lb->reply.len);
+	rx->len = lb->reply.len;
+	lb->reply.len = 0;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+static const char * type_name(serial_message_type_t type)
+{
+	return ((size_t)type < sizeof(msg_type_names)/sizeof(msg_type_names[0])) ? msg_type_names[type] : "-";
+}
+
+#ifdef BENCH_CPU_HZ
+#define DEMCR		(*(volatile uint32_t *)0xE000EDFCu)
+#define DWT_CTRL	(*(volatile uint32_t *)0xE0001000u)
+#define DWT_CYCCNT	(*(volatile uint32_t *)0xE0001004u)
+
+/*
+	DWT cycle counter, extended to 64 bits. Called at least once per batch, so well within the 32 bit wrap
+*/
+static uint64_t now_ns(void)
+{
+	static uint32_t last;
+	static uint64_t cycles;
+	if((DWT_CTRL & 1u) == 0)
+	{
+		DEMCR |= (1u << 24);	//TRCENA
+		DWT_CYCCNT = 0;
+		DWT_CTRL |= 1u;			//CYCCNTENA
+		last = 0;
+	}
+	uint32_t now = DWT_CYCCNT;
+	cycles += (uint32_t)(now - last);
+	last = now;
+	return cycles*1000000000u/BENCH_CPU_HZ;
+}
+#else
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+/*
+	One benchmark case. setup runs untimed before every batch, op is the operation timed
+*/
+typedef struct bench_case_t
+{
+	const char * name;
+	serial_message_type_t type;
+	size_t bytes;			// Frame payload
+	size_t moved;			// Payload moved per operation
+	void (*setup)(struct bench_case_t * bc);
+	int (*op)(struct bench_case_t * bc);
+	loopback_t lb;
+	dartt_sync_t ds;
+	unsigned char frame_mem[FRAME_SIZE];
+	dartt_buffer_t frame;
+	unsigned char reply_mem[FRAME_SIZE];
+	unsigned char payload_mem[MAX_PAYLOAD];
+	unsigned char ctl_mem[REGION_SIZE];
+	unsigned char shadow_mem[REGION_SIZE];
+	unsigned char periph_mem[REGION_SIZE];
+	uint32_t counter;
+}bench_case_t;
+
+static int run_batch(bench_case_t * bc, uint64_t iterations, uint64_t * ns)
+{
+	if(bc->setup != NULL)
+	{
+		bc->setup(bc);
+	}
+	uint64_t t0 = now_ns();
+	for(uint64_t i = 0; i < iterations; i++)
+	{
+		int rc = bc->op(bc);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
+	}
+	*ns = now_ns() - t0;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/*
+	Grow the batch until it takes a tenth of the case time, then time enough batches to fill it and report the best
+	one, which is the least disturbed by the rest of the system
+*/
+static void run_case(bench_case_t * bc)
+{
+	if(filter != NULL && strstr(bc->name, filter) == NULL)
+	{
+		return;
+	}
+	uint64_t iterations = 1;
+	uint64_t ns = 0;
+	for(;;)
+	{
+		int rc = run_batch(bc, iterations, &ns);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			fprintf(stderr, "%s/%s/%zu failed with %d\n", bc->name, type_name(bc->type), bc->bytes, rc);
+			exit(1);
+		}
+		if(ns >= min_ns/10 || iterations >= (UINT64_C(1) << 40))
+		{
+			break;
+		}
+		iterations *= (ns < min_ns/1000) ? 10 : 2;
+	}
+	double best = (double)ns/iterations;
+	uint64_t total = ns;
+	while(total < min_ns)
+	{
+		run_batch(bc, iterations, &ns);
+		total += ns;
+		if((double)ns/iterations < best)
+		{
+			best = (double)ns/iterations;
+		}
+	}
+	printf("%s,%s,%zu,%llu,%.2f,%.2f\n", bc->name, type_name(bc->type), bc->bytes, (unsigned long long)iterations, best, bc->moved*1e3/best);
+}
+
+static void setup_write_frame(bench_case_t * bc)
+{
+	misc_write_message_t msg = {.address = 3, .index = 4, .payload = {.buf = bc->payload_mem, .size = sizeof(bc->payload_mem), .len = bc->bytes}};
+	bc->frame = (dartt_buffer_t){.buf = bc->frame_mem, .size = sizeof(bc->frame_mem), .len = 0};
+	dartt_create_write_frame(&msg, bc->type, &bc->frame);
+}
+
+static void setup_read_frame(bench_case_t * bc)
+{
+	misc_read_message_t msg = {.address = 3, .index = 4, .num_bytes = (uint16_t)bc->bytes, .tag = DARTT_TAG_NONE};
+	bc->frame = (dartt_buffer_t){.buf = bc->frame_mem, .size = sizeof(bc->frame_mem), .len = 0};
+	dartt_create_read_frame(&msg, bc->type, &bc->frame);
+}
+
+static int op_create_write_frame(bench_case_t * bc)
+{
+	bc->payload_mem[0] = (unsigned char)bc->counter++;
+	misc_write_message_t msg = {.address = 3, .index = 4, .payload = {.buf = bc->payload_mem, .size = sizeof(bc->payload_mem), .len = bc->bytes}};
+	dartt_buffer_t out = {.buf = bc->frame_mem, .size = sizeof(bc->frame_mem), .len = 0};
+	int rc = dartt_create_write_frame(&msg, bc->type, &out);
+	sink += out.buf[out.len - 1];
+	return rc;
+}
+
+static int op_frame_to_payload(bench_case_t * bc)
+{
+	payload_layer_msg_t pld = {};
+	int rc = dartt_frame_to_payload(&bc->frame, bc->type, PAYLOAD_ALIAS, &pld);
+	sink += pld.index_arg + pld.msg.len;
+	return rc;
+}
+
+/*
+	Full peripheral path for one request: frame to payload, then parse (and build the reply of a read)
+*/
+static int op_parse_message(bench_case_t * bc)
+{
+	payload_layer_msg_t pld = {};
+	int rc = dartt_frame_to_payload(&bc->frame, bc->type, PAYLOAD_ALIAS, &pld);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	dartt_mem_t mem = {.buf = bc->periph_mem, .size = sizeof(bc->periph_mem)};
+	dartt_buffer_t reply = {.buf = bc->reply_mem, .size = sizeof(bc->reply_mem), .len = 0};
+	rc = dartt_parse_general_message(&pld, bc->type, &mem, &reply);
+	sink += reply.len;
+	return rc;
+}
+
+static int op_frame_to_payload_copy(bench_case_t * bc)
+{
+	payload_layer_msg_t pld = {.msg = {.buf = bc->payload_mem, .size = sizeof(bc->payload_mem), .len = 0}};
+	int rc = dartt_frame_to_payload(&bc->frame, bc->type, PAYLOAD_COPY, &pld);
+	sink += pld.index_arg + pld.msg.buf[pld.msg.len - 1];
+	return rc;
+}
+
+/*
+	Controller side of a read reply: copy bc->bytes into the shadow copy
+*/
+static int op_parse_read_reply(bench_case_t * bc)
+{
+	misc_read_message_t request = {.address = 3, .index = 4, .num_bytes = (uint16_t)bc->bytes, .tag = DARTT_TAG_NONE};
+	payload_layer_msg_t reply = {.index_arg = 4, .msg = {.buf = bc->payload_mem, .size = sizeof(bc->payload_mem), .len = bc->bytes}};
+	dartt_mem_t shadow = {.buf = bc->shadow_mem, .size = sizeof(bc->shadow_mem)};
+	int rc = dartt_parse_read_reply(&reply, &request, &shadow);
+	sink += bc->shadow_mem[16];
+	return rc;
+}
+
+static int op_copy_buf_full(bench_case_t * bc)
+{
+	dartt_buffer_t in = {.buf = bc->periph_mem, .size = bc->bytes, .len = bc->bytes};
+	dartt_buffer_t out = {.buf = bc->shadow_mem, .size = bc->bytes, .len = 0};
+	int rc = copy_buf_full(&in, &out);
+	sink += out.buf[bc->bytes - 1];
+	return rc;
+}
+
+static int op_crc16(bench_case_t * bc)
+{
+	bc->payload_mem[0] = (unsigned char)bc->counter++;
+	sink += dartt_crc16(bc->payload_mem, bc->bytes);
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+static int op_crc32(bench_case_t * bc)
+{
+	bc->payload_mem[0] = (unsigned char)bc->counter++;
+	sink += dartt_crc32(bc->payload_mem, bc->bytes);
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/*
+	dartt_sync_t against the loopback peripheral, with tx and rx buffers holding bc->bytes of payload per frame
+*/
+static void setup_sync(bench_case_t * bc)
+{
+	memset(bc->ctl_mem, 0, sizeof(bc->ctl_mem));
+	memset(bc->shadow_mem, 0, sizeof(bc->shadow_mem));
+	memset(bc->periph_mem, 0, sizeof(bc->periph_mem));
+	bc->lb.type = bc->type;
+	bc->lb.periph_mem = (dartt_mem_t){.buf = bc->periph_mem, .size = sizeof(bc->periph_mem)};
+	bc->lb.reply.len = 0;
+	memset(&bc->ds, 0, sizeof(bc->ds));
+	bc->ds.address = 3;
+	bc->ds.ctl_base = (dartt_mem_t){.buf = bc->ctl_mem, .size = sizeof(bc->ctl_mem)};
+	bc->ds.periph_base = (dartt_mem_t){.buf = bc->shadow_mem, .size = sizeof(bc->shadow_mem)};
+	bc->ds.msg_type = bc->type;
+	size_t frame_size = bc->bytes + dartt_rw_overhead(bc->type) + NUM_BYTES_READ_REPLY_OVERHEAD_PLD;
+	bc->ds.tx_buf = (dartt_buffer_t){.buf = bc->frame_mem, .size = frame_size, .len = 0};
+	bc->ds.rx_buf = (dartt_buffer_t){.buf = bc->reply_mem, .size = frame_size, .len = 0};
+	bc->ds.blocking_tx_callback = &loopback_tx;
+	bc->ds.blocking_rx_callback = &loopback_rx;
+	bc->ds.user_context_tx = &bc->lb;
+	bc->ds.user_context_rx = &bc->lb;
+	bc->ds.timeout_ms = 0;
+}
+
+/*
+	As setup_sync, with the configuration checked once up front by dartt_sync_prepare
+*/
+static void setup_sync_prepared(bench_case_t * bc)
+{
+	setup_sync(bc);
+	dartt_sync_prepare(&bc->ds);
+}
+
+static int op_sync_clean(bench_case_t * bc)
+{
+	dartt_mem_t ctl = {.buf = bc->ctl_mem, .size = sizeof(bc->ctl_mem)};
+	return dartt_sync(&ctl, &bc->ds);
+}
+
+/*
+	One word changed per call, at a different place each time
+*/
+static int op_sync_sparse(bench_case_t * bc)
+{
+	uint32_t value = ++bc->counter;
+	memcpy(&bc->ctl_mem[((value*7) % (REGION_SIZE/sizeof(uint32_t)))*sizeof(uint32_t)], &value, sizeof(value));
+	dartt_mem_t ctl = {.buf = bc->ctl_mem, .size = sizeof(bc->ctl_mem)};
+	return dartt_sync(&ctl, &bc->ds);
+}
+
+/*
+	Every word changed per call
+*/
+static int op_sync_full(bench_case_t * bc)
+{
+	uint32_t value = ++bc->counter;
+	for(size_t i = 0; i < REGION_SIZE; i += sizeof(uint32_t))
+	{
+		memcpy(&bc->ctl_mem[i], &value, sizeof(value));
+	}
+	dartt_mem_t ctl = {.buf = bc->ctl_mem, .size = sizeof(bc->ctl_mem)};
+	return dartt_sync(&ctl, &bc->ds);
+}
+
+/*
+	Every word changed per call, written with dartt_bulk_write: one CRC32 query per window instead of a read-back
+*/
+static int op_bulk_write_full(bench_case_t * bc)
+{
+	uint32_t value = ++bc->counter;
+	for(size_t i = 0; i < REGION_SIZE; i += sizeof(uint32_t))
+	{
+		memcpy(&bc->ctl_mem[i], &value, sizeof(value));
+	}
+	dartt_mem_t ctl = {.buf = bc->ctl_mem, .size = sizeof(bc->ctl_mem)};
+	return dartt_bulk_write(&ctl, &bc->ds);
+}
+
+static int op_read_multi(bench_case_t * bc)
+{
+	bc->periph_mem[bc->counter++ % REGION_SIZE]++;
+	dartt_mem_t ctl = {.buf = bc->ctl_mem, .size = sizeof(bc->ctl_mem)};
+	return dartt_read_multi(&ctl, &bc->ds);
+}
+
+static int op_update_controller(bench_case_t * bc)
+{
+	dartt_mem_t ctl = {.buf = bc->ctl_mem, .size = sizeof(bc->ctl_mem)};
+	int rc = dartt_update_controller(&ctl, &bc->ds);
+	sink += bc->ctl_mem[REGION_SIZE - 1];
+	return rc;
+}
+
+int main(int argc, char ** argv)
+{
+	if(argc > 1)
+	{
+		min_ns = (uint32_t)atoi(argv[1])*1000000u;
+	}
+	if(argc > 2)
+	{
+		filter = argv[2];
+	}
+	printf("# dartt bench_suite, %u ms per case, region %d bytes\n", min_ns/1000000, REGION_SIZE);
+	printf("benchmark,msg_type,bytes,iterations,ns_per_op,mbytes_per_s\n");
+
+	static bench_case_t bc;
+	for(size_t s = 0; s < sizeof(payload_sizes)/sizeof(payload_sizes[0]); s++)
+	{
+		memset(&bc, 0, sizeof(bc));
+		bc.type = (serial_message_type_t)-1;	//not framed
+		bc.bytes = payload_sizes[s];
+		bc.moved = bc.bytes;
+		bc.name = "crc16";
+		bc.op = &op_crc16;
+		run_case(&bc);
+		bc.name = "crc32";
+		bc.op = &op_crc32;
+		run_case(&bc);
+		bc.name = "copy_buf_full";
+		bc.op = &op_copy_buf_full;
+		run_case(&bc);
+		bc.name = "parse_read_reply";
+		bc.op = &op_parse_read_reply;
+		run_case(&bc);
+	}
+
+	for(size_t t = 0; t < sizeof(msg_types)/sizeof(msg_types[0]); t++)
+	{
+		for(size_t s = 0; s < sizeof(payload_sizes)/sizeof(payload_sizes[0]); s++)
+		{
+			memset(&bc, 0, sizeof(bc));
+			bc.type = msg_types[t];
+			bc.bytes = payload_sizes[s];
+			bc.moved = bc.bytes;
+
+			bc.name = "create_write_frame";
+			bc.setup = NULL;
+			bc.op = &op_create_write_frame;
+			run_case(&bc);
+
+			bc.name = "frame_to_payload";
+			bc.setup = &setup_write_frame;
+			bc.op = &op_frame_to_payload;
+			run_case(&bc);
+
+			bc.name = "frame_to_payload_copy";
+			bc.setup = &setup_write_frame;
+			bc.op = &op_frame_to_payload_copy;
+			run_case(&bc);
+
+			bc.name = "parse_write";
+			bc.setup = &setup_write_frame;
+			bc.op = &op_parse_message;
+			run_case(&bc);
+
+			bc.name = "parse_read";
+			bc.setup = &setup_read_frame;
+			bc.op = &op_parse_message;
+			run_case(&bc);
+
+			//every operation below covers the whole REGION_SIZE region
+			bc.setup = &setup_sync;
+			bc.name = "sync_clean";
+			bc.moved = 0;
+			bc.op = &op_sync_clean;
+			run_case(&bc);
+			bc.name = "sync_sparse";
+			bc.moved = sizeof(uint32_t);
+			bc.op = &op_sync_sparse;
+			run_case(&bc);
+			bc.name = "sync_full";
+			bc.moved = REGION_SIZE;
+			bc.op = &op_sync_full;
+			run_case(&bc);
+			if(bc.bytes >= NUM_BYTES_CRC32_QUERY)	//the tx buffer must also hold a CRC32 query
+			{
+				bc.name = "bulk_write_full";
+				bc.op = &op_bulk_write_full;
+				run_case(&bc);
+			}
+			bc.name = "read_multi";
+			bc.op = &op_read_multi;
+			run_case(&bc);
+			bc.name = "read_multi_prepared";
+			bc.setup = &setup_sync_prepared;
+			run_case(&bc);
+			bc.name = "update_controller";
+			bc.setup = &setup_sync;
+			bc.op = &op_update_controller;
+			run_case(&bc);
+		}
+	}
+	return (int)(sink & 0);
+}
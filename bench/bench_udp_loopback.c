@@ -0,0 +1,247 @@
+/*
+	UDP loopback benchmark. Reads a 4 KiB block from a simulated peripheral over 127.0.0.1 and reports read frames per
+	second for:
+		naive      one sendto and one recvfrom per frame, dartt_read_multi
+		batched    dartt_udp_linux transport, dartt_read_multi
+		pipelined  dartt_udp_linux transport, dartt_read_multi_pipelined
+
+	usage: bench_udp_loopback [iterations] [rx_buf_size]
+*/
+#define _GNU_SOURCE
+#include "dartt.h"
+#include "dartt_sync.h"
+#include "dartt_periph.h"
+#include "dartt_udp_linux.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define BLOCK_SIZE	4096
+#define SERVER_BATCH	32
+
+typedef struct server_t
+{
+	int fd;
+	dartt_periph_t periph;
+	unsigned char mem[BLOCK_SIZE];
+	volatile int stop;
+}server_t;
+
+/*
+	Peripheral. Batched on both sides so the server is never the bottleneck of the measurement
+*/
+static void * server_thread(void * arg)
+{
+	server_t * srv = (server_t *)arg;
+	static unsigned char rx_mem[SERVER_BATCH][DARTT_UDP_LINUX_MAX_FRAME];
+	static unsigned char tx_mem[SERVER_BATCH][DARTT_UDP_LINUX_MAX_FRAME];
+	struct sockaddr_storage from[SERVER_BATCH];
+	struct mmsghdr rx_msgs[SERVER_BATCH];
+	struct mmsghdr tx_msgs[SERVER_BATCH];
+	struct iovec rx_iov[SERVER_BATCH];
+	struct iovec tx_iov[SERVER_BATCH];
+	while(!srv->stop)
+	{
+		struct pollfd pfd = {.fd = srv->fd, .events = POLLIN};
+		if(poll(&pfd, 1, 10) <= 0)
+		{
+			continue;
+		}
+		memset(rx_msgs, 0, sizeof(rx_msgs));
+		for(int i = 0; i < SERVER_BATCH; i++)
+		{
+			rx_iov[i].iov_base = rx_mem[i];
+			rx_iov[i].iov_len = DARTT_UDP_LINUX_MAX_FRAME;
+			rx_msgs[i].msg_hdr.msg_iov = &rx_iov[i];
+			rx_msgs[i].msg_hdr.msg_iovlen = 1;
+			rx_msgs[i].msg_hdr.msg_name = &from[i];
+			rx_msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+		}
+		int n = recvmmsg(srv->fd, rx_msgs, SERVER_BATCH, MSG_DONTWAIT, NULL);
+		int nreply = 0;
+		for(int i = 0; i < n; i++)
+		{
+			dartt_buffer_t rx = {.buf = rx_mem[i], .size = DARTT_UDP_LINUX_MAX_FRAME, .len = rx_msgs[i].msg_len};
+			payload_layer_msg_t pld = {};
+			if(dartt_frame_to_payload(&rx, TYPE_ADDR_CRC_MESSAGE, PAYLOAD_ALIAS, &pld) != DARTT_PROTOCOL_SUCCESS)
+			{
+				continue;
+			}
+			dartt_buffer_t reply = {.buf = tx_mem[nreply], .size = DARTT_UDP_LINUX_MAX_FRAME, .len = 0};
+			dartt_periph_parse(&srv->periph, &pld, TYPE_ADDR_CRC_MESSAGE, &reply);
+			if(reply.len == 0)
+			{
+				continue;
+			}
+			memset(&tx_msgs[nreply], 0, sizeof(tx_msgs[nreply]));
+			tx_iov[nreply].iov_base = reply.buf;
+			tx_iov[nreply].iov_len = reply.len;
+			tx_msgs[nreply].msg_hdr.msg_iov = &tx_iov[nreply];
+			tx_msgs[nreply].msg_hdr.msg_iovlen = 1;
+			tx_msgs[nreply].msg_hdr.msg_name = &from[i];
+			tx_msgs[nreply].msg_hdr.msg_namelen = rx_msgs[i].msg_hdr.msg_namelen;
+			nreply++;
+		}
+		if(nreply != 0)
+		{
+			sendmmsg(srv->fd, tx_msgs, (unsigned int)nreply, 0);
+		}
+	}
+	return NULL;
+}
+
+/*
+	Naive callbacks - one syscall per frame in each direction
+*/
+static int naive_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	(void)address;
+	(void)timeout;
+	int fd = *(int *)user_context;
+	return (send(fd, tx->buf, tx->len, 0) == (ssize_t)tx->len) ? DARTT_PROTOCOL_SUCCESS : DARTT_ERROR_INVALID_ARGUMENT;
+}
+
+static int naive_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout)
+{
+	(void)timeout;	//SO_RCVTIMEO is set once at startup
+	int fd = *(int *)user_context;
+	ssize_t n = recv(fd, rx->buf, rx->size, 0);
+	if(n < 0)
+	{
+		rx->len = 0;
+		return DARTT_ERROR_TIMEOUT;
+	}
+	rx->len = (size_t)n;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+static double now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/*
+	Number of read frames needed for the block, with the same chunking as dartt_read_multi(_pipelined)
+*/
+static size_t frames_per_block(size_t rx_size, size_t tag_bytes)
+{
+	size_t chunk = rx_size - dartt_rw_overhead(TYPE_ADDR_CRC_MESSAGE) - tag_bytes;
+	chunk -= chunk % sizeof(uint32_t);
+	return (BLOCK_SIZE + chunk - 1)/chunk;
+}
+
+static unsigned char ctl_mem[BLOCK_SIZE];
+static unsigned char shadow_mem[BLOCK_SIZE];
+
+static double run(const char * name, dartt_sync_t * ds, int pipelined, int iterations, size_t frames_per_read)
+{
+	dartt_mem_t block = {.buf = ctl_mem, .size = BLOCK_SIZE};
+	double t0 = now_s();
+	for(int i = 0; i < iterations; i++)
+	{
+		int rc = pipelined ? dartt_read_multi_pipelined(&block, ds) : dartt_read_multi(&block, ds);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			fprintf(stderr, "%s: read failed with %d\n", name, rc);
+			exit(1);
+		}
+	}
+	double fps = (double)iterations*frames_per_read/(now_s() - t0);
+	printf("%-10s %12.0f frames/s\n", name, fps);
+	return fps;
+}
+
+int main(int argc, char ** argv)
+{
+	int iterations = (argc > 1) ? atoi(argv[1]) : 200;
+	size_t rx_size = (argc > 2) ? (size_t)atoi(argv[2]) : 64;
+
+	static server_t srv;
+	srv.periph.mem_base.buf = srv.mem;
+	srv.periph.mem_base.size = BLOCK_SIZE;
+	for(int i = 0; i < BLOCK_SIZE; i++)
+	{
+		srv.mem[i] = (unsigned char)i;
+	}
+	srv.fd = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = 0, .sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)}};
+	socklen_t len = sizeof(addr);
+	if(srv.fd < 0 || bind(srv.fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || getsockname(srv.fd, (struct sockaddr *)&addr, &len) != 0)
+	{
+		perror("server socket");
+		return 1;
+	}
+	pthread_t thread;
+	pthread_create(&thread, NULL, &server_thread, &srv);
+
+	unsigned char tx_mem[DARTT_UDP_LINUX_MAX_FRAME];
+	unsigned char rx_mem[DARTT_UDP_LINUX_MAX_FRAME];
+	if(rx_size > sizeof(rx_mem))
+	{
+		rx_size = sizeof(rx_mem);
+	}
+	dartt_sync_t ds = {};
+	ds.address = 3;
+	ds.ctl_base.buf = ctl_mem;
+	ds.ctl_base.size = BLOCK_SIZE;
+	ds.periph_base.buf = shadow_mem;
+	ds.periph_base.size = BLOCK_SIZE;
+	ds.msg_type = TYPE_ADDR_CRC_MESSAGE;
+	ds.tx_buf = (dartt_buffer_t){.buf = tx_mem, .size = sizeof(tx_mem), .len = 0};
+	ds.rx_buf = (dartt_buffer_t){.buf = rx_mem, .size = rx_size, .len = 0};
+	ds.timeout_ms = 100;
+	size_t frames_per_read = frames_per_block(rx_size, 0);
+	printf("%d reads of %d bytes, %zu byte rx buffer, %zu frames per read\n", iterations, BLOCK_SIZE, rx_size, frames_per_read);
+
+	//naive
+	int naive_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	struct timeval tv = {.tv_sec = 0, .tv_usec = 100000};
+	setsockopt(naive_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	if(connect(naive_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		perror("connect");
+		return 1;
+	}
+	ds.blocking_tx_callback = &naive_tx;
+	ds.blocking_rx_callback = &naive_rx;
+	ds.user_context_tx = &naive_fd;
+	ds.user_context_rx = &naive_fd;
+	double naive = run("naive", &ds, 0, iterations, frames_per_read);
+	close(naive_fd);
+
+	//batched transport
+	static dartt_udp_linux_t port;
+	if(dartt_udp_linux_open(&port, "127.0.0.1", ntohs(addr.sin_port), 0) != DARTT_PROTOCOL_SUCCESS)
+	{
+		perror("dartt_udp_linux_open");
+		return 1;
+	}
+	ds.blocking_tx_callback = &dartt_udp_linux_tx;
+	ds.blocking_rx_callback = &dartt_udp_linux_rx;
+	ds.flush_tx_callback = &dartt_udp_linux_flush;
+	ds.user_context_tx = &port;
+	ds.user_context_rx = &port;
+	run("batched", &ds, 0, iterations, frames_per_read);
+	double pipelined = run("pipelined", &ds, 1, iterations, frames_per_block(rx_size, NUM_BYTES_TAG));
+	printf("pipelined/naive: %.2fx\n", pipelined/naive);
+	if(memcmp(shadow_mem, srv.mem, BLOCK_SIZE) != 0)
+	{
+		fprintf(stderr, "shadow copy mismatch\n");
+		return 1;
+	}
+
+	dartt_udp_linux_close(&port);
+	srv.stop = 1;
+	pthread_join(thread, NULL);
+	close(srv.fd);
+	return 0;
+}
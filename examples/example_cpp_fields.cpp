@@ -0,0 +1,101 @@
+/*
+    DARTT C++ field handles
+
+    Drives an in-process peripheral through dartt_sync_t using dartt.hpp: compile-time field handles, typed
+    access to the controller and shadow copies, and sync/read over several fields merged into contiguous spans.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include "dartt.hpp"
+
+struct motor_t
+{
+    float kp;               // Word 0
+    float ki;               // Word 1
+    float kd;               // Word 2
+    int32_t target[3];      // Words 3-5
+    uint16_t mode;          // Word 6
+    uint32_t status;        // Word 7
+    float temperature;      // Word 8
+};
+
+using kp = DARTT_FIELD(motor_t, kp);
+using ki = DARTT_FIELD(motor_t, ki);
+using kd = DARTT_FIELD(motor_t, kd);
+using target_z = DARTT_FIELD(motor_t, target[2]);
+using mode = DARTT_FIELD(motor_t, mode);
+using status = DARTT_FIELD(motor_t, status);
+using temperature = DARTT_FIELD(motor_t, temperature);
+
+// Everything below is resolved by the compiler
+static_assert(target_z::index == 5 && target_z::nbytes == 4, "");
+static_assert(dartt::num_spans<kd, kp, ki>() == 1, "adjacent fields are merged, in any order");
+static_assert(dartt::span<kd, kp, ki>(0).offset == 0 && dartt::span<kd, kp, ki>(0).nbytes == 12, "");
+static_assert(dartt::num_spans<mode, status>() == 1, "mode is padded to the next word and merged with status");
+static_assert(dartt::num_spans<kp, status, temperature>() == 2, "");
+
+static motor_t motor = {0.1f, 0.0f, 0.0f, {0, 0, 0}, 1, 0x5A, 31.5f};  // peripheral memory
+static unsigned char reply_mem[64];
+static dartt_buffer_t reply = dartt::buffer(reply_mem);
+
+// The peripheral serves each request as soon as it is sent
+static int loopback_tx(unsigned char, dartt_buffer_t * tx, void *, uint32_t)
+{
+    payload_layer_msg_t pld = {};
+    int rc = dartt_frame_to_payload(tx, TYPE_SERIAL_MESSAGE, PAYLOAD_ALIAS, &pld);
+    if(rc != DARTT_PROTOCOL_SUCCESS)
+    {
+        return rc;
+    }
+    dartt_mem_t periph = dartt::mem_of(motor);
+    reply.len = 0;
+    return dartt_parse_general_message(&pld, TYPE_SERIAL_MESSAGE, &periph, &reply);
+}
+
+static int loopback_rx(dartt_buffer_t * rx, void *, uint32_t)
+{
+    std::memcpy(rx->buf, reply.buf, reply.len);
+    rx->len = reply.len;
+    return DARTT_PROTOCOL_SUCCESS;
+}
+
+int main()
+{
+    motor_t ctl = {};
+    motor_t shadow = {};
+    static unsigned char tx_mem[64];
+    static unsigned char rx_mem[64];
+
+    dartt_sync_t ds = {};
+    ds.address = 3;
+    ds.ctl_base = dartt::mem_of(ctl);
+    ds.periph_base = dartt::mem_of(shadow);
+    ds.msg_type = TYPE_SERIAL_MESSAGE;
+    ds.tx_buf = dartt::buffer(tx_mem);
+    ds.rx_buf = dartt::buffer(rx_mem);
+    ds.blocking_tx_callback = &loopback_tx;
+    ds.blocking_rx_callback = &loopback_rx;
+    ds.timeout_ms = 10;
+
+    // Read the gains and the telemetry: two spans, two dartt_read_multi calls
+    int rc = dartt::read<kp, ki, kd, status, temperature>(ds);
+    std::printf("read: rc=%d kp=%.2f status=0x%X temperature=%.1f\n", rc,
+        dartt::periph<kp>(ds), (unsigned)dartt::periph<status>(ds), dartt::periph<temperature>(ds));
+    ctl = shadow;
+
+    // Change two gains and a target, then write and verify them
+    dartt::ctl<ki>(ds) = 0.01f;
+    dartt::ctl<kd>(ds) = 0.002f;
+    dartt::ctl<target_z>(ds) = -1200;
+    rc = dartt::sync<kp, ki, kd, target_z>(ds);
+    std::printf("sync: rc=%d peripheral ki=%.3f kd=%.3f target[2]=%d\n", rc, motor.ki, motor.kd, (int)motor.target[2]);
+
+    // Frames with constant indices, without a dartt_sync_t
+    unsigned char frame_mem[16];
+    dartt_buffer_t frame = dartt::buffer(frame_mem);
+    rc = dartt::write_frame<kp>(dartt_get_complementary_address(3), 0.2f, TYPE_SERIAL_MESSAGE, frame);
+    std::printf("kp write frame: rc=%d, %zu bytes, index %u\n", rc, frame.len, (unsigned)kp::index);
+
+    return (motor.ki == 0.01f && motor.target[2] == -1200) ? 0 : 1;
+}
@@ -2,7 +2,23 @@
 #include <dartt_crc.h>
 #include "dartt.h"
 #include "dartt_check_buffer.h"
+#include "dartt_copy.h"
 #include "dartt_assert.h"
+#include "dartt_inline.h"
+
+/*
+	Build-time message type. Define DARTT_FIXED_MSG_TYPE to one of the serial_message_type_t values to compile the
+	frame builders and parsers for that type only: the branches for the other types are dropped and the overheads
+	are constants, in this file and in everything that calls it (dartt_sync.c, dartt_periph.c). Calls with any other
+	type fail with DARTT_ERROR_INVALID_ARGUMENT (dartt_rw_overhead() returns 0).
+*/
+#ifdef DARTT_FIXED_MSG_TYPE
+#define FIXED_TYPE(type)		((serial_message_type_t)(DARTT_FIXED_MSG_TYPE))
+#define IS_FIXED_TYPE(type)		((type) == (DARTT_FIXED_MSG_TYPE))
+#else
+#define FIXED_TYPE(type)		(type)
+#define IS_FIXED_TYPE(type)		1
+#endif
 
 /**
  * @brief Calculate the 32-bit word index of a field within a memory structure.
@@ -88,9 +104,112 @@ int copy_buf_full(dartt_buffer_t * in, dartt_buffer_t * out)
 	{
 		return DARTT_ERROR_MEMORY_OVERRUN;
 	}
-	for(size_t i = 0; i < in->size; i++)
+	dartt_copy(out->buf, in->buf, in->size);
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/*
+	Headroom and tailroom. A frame can be built in a view into a larger buffer (typically a DMA buffer), leaving room
+	in front for a transport header and behind for a trailer. Builders and the peripheral reply path write the view
+	from its first byte as usual, then the transport grows the view over the reserved room with dartt_buffer_push
+	and dartt_buffer_put and sends it without copying the frame again:
+
+		unsigned char dma_mem[64];
+		dartt_buffer_t dma = {.buf = dma_mem, .size = sizeof(dma_mem), .len = 0};
+		dartt_buffer_t frame;
+		dartt_buffer_reserve(&dma, 4, 1, &frame);			// 4 byte header, 1 byte trailer
+		dartt_create_write_frame(&msg, type, &frame);		// frame.buf = dma_mem + 4
+		dartt_buffer_push(&dma, &frame, 4);					// frame.buf = dma_mem, write the header at frame.buf[0..3]
+		dartt_buffer_put(&dma, &frame, 1);					// write the trailer at frame.buf[frame.len - 1]
+*/
+
+/**
+ * @brief Set up a view into dma with headroom bytes reserved in front and tailroom bytes behind.
+ *
+ * @param dma Buffer holding the frame and the room around it
+ * @param headroom Bytes left free in front of the view
+ * @param tailroom Bytes left free behind the view
+ * @param frame Loaded with the view, empty
+ * @return DARTT_PROTOCOL_SUCCESS, DARTT_ERROR_MEMORY_OVERRUN if the room leaves no space for a frame,
+ * DARTT_ERROR_INVALID_ARGUMENT for an invalid dma buffer
+ */
+int dartt_buffer_reserve(const dartt_buffer_t * dma, size_t headroom, size_t tailroom, dartt_buffer_t * frame)
+{
+	int cb = check_buffer(dma);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
 	{
-		out->buf[i] = in->buf[i];
+		return cb;
+	}
+	if(frame == NULL)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	if(headroom >= dma->size || tailroom >= dma->size - headroom)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	frame->buf = dma->buf + headroom;
+	frame->size = dma->size - headroom - tailroom;
+	frame->len = 0;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Bytes free in front of a view into dma.
+ */
+size_t dartt_buffer_headroom(const dartt_buffer_t * dma, const dartt_buffer_t * frame)
+{
+	DARTT_ASSERT(dma != NULL && frame != NULL);
+	if(frame->buf < dma->buf || frame->buf > dma->buf + dma->size)
+	{
+		return 0;
+	}
+	return (size_t)(frame->buf - dma->buf);
+}
+
+/**
+ * @brief Grow a view into dma by nbytes at the front, for a transport header.
+ *
+ * @param dma Buffer the view was reserved in
+ * @param frame View. On success its buf moves back by nbytes, and its len and size grow by nbytes. The header goes
+ * in frame->buf[0] to frame->buf[nbytes - 1]
+ * @param nbytes Header length
+ * @return DARTT_PROTOCOL_SUCCESS, DARTT_ERROR_MEMORY_OVERRUN if less than nbytes of headroom are left
+ */
+int dartt_buffer_push(const dartt_buffer_t * dma, dartt_buffer_t * frame, size_t nbytes)
+{
+	DARTT_ASSERT(dma != NULL && frame != NULL);
+	if(nbytes > dartt_buffer_headroom(dma, frame))
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	frame->buf -= nbytes;
+	frame->size += nbytes;
+	frame->len += nbytes;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Grow a view into dma by nbytes at the back, for a transport trailer.
+ *
+ * @param dma Buffer the view was reserved in
+ * @param frame View. On success its len grows by nbytes (and its size with it, if needed). The trailer goes in the
+ * last nbytes of the view
+ * @param nbytes Trailer length
+ * @return DARTT_PROTOCOL_SUCCESS, DARTT_ERROR_MEMORY_OVERRUN if the trailer would run past the end of dma
+ */
+int dartt_buffer_put(const dartt_buffer_t * dma, dartt_buffer_t * frame, size_t nbytes)
+{
+	DARTT_ASSERT(dma != NULL && frame != NULL);
+	size_t head = dartt_buffer_headroom(dma, frame);
+	if(frame->buf != dma->buf + head || head + frame->len + nbytes > dma->size)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	frame->len += nbytes;
+	if(frame->len > frame->size)
+	{
+		frame->size = frame->len;
 	}
 	return DARTT_PROTOCOL_SUCCESS;
 }
@@ -171,23 +290,24 @@ int check_write_lengths(misc_write_message_t * msg, serial_message_type_t type,
     {
         return DARTT_ERROR_INVALID_ARGUMENT;
     }
+    size_t nb_index_ext = DARTT_INDEX_NUM_BYTES(msg->index) - NUM_BYTES_INDEX;
     if(type == TYPE_SERIAL_MESSAGE)
     {
-        if( (msg->payload.len + (NUM_BYTES_ADDRESS + NUM_BYTES_INDEX + NUM_BYTES_CHECKSUM) ) > output->size)
+        if( (msg->payload.len + nb_index_ext + (NUM_BYTES_ADDRESS + NUM_BYTES_INDEX + NUM_BYTES_CHECKSUM) ) > output->size)
         {
             return DARTT_ERROR_MEMORY_OVERRUN;
         }
     }
     else if(type == TYPE_ADDR_MESSAGE)
     {
-        if(msg->payload.len + (NUM_BYTES_INDEX + NUM_BYTES_CHECKSUM) > output->size)
+        if(msg->payload.len + nb_index_ext + (NUM_BYTES_INDEX + NUM_BYTES_CHECKSUM) > output->size)
         {
             return DARTT_ERROR_MEMORY_OVERRUN;
         }
     }
     else if (type == TYPE_ADDR_CRC_MESSAGE)
     {
-        if( (msg->payload.len + NUM_BYTES_INDEX) > output->size)
+        if( (msg->payload.len + nb_index_ext + NUM_BYTES_INDEX) > output->size)
         {
             return DARTT_ERROR_MEMORY_OVERRUN;
         }
@@ -220,41 +340,17 @@ int check_write_lengths(misc_write_message_t * msg, serial_message_type_t type,
  *       - TYPE_ADDR_MESSAGE: [idx_lo][idx_hi][payload...][crc_lo][crc_hi]
  *       - TYPE_ADDR_CRC_MESSAGE: [idx_lo][idx_hi][payload...]
  * @note The MSB of the index is cleared to indicate write operation.
+ * @note If msg->index has DARTT_INDEX_EXTENDED_BIT set, [idx_lo][idx_hi] is DARTT_INDEX_EXTENDED and is followed by
+ *       the 32 bit word index [w0][w1][w2][w3]. Returns DARTT_ERROR_INVALID_ARGUMENT for an index above 0x7FFF
+ *       without the bit.
  */
 int dartt_create_write_frame(misc_write_message_t * msg, serial_message_type_t type, dartt_buffer_t * output)
 {
-    DARTT_ASSERT(check_write_args(msg,type,output) == DARTT_PROTOCOL_SUCCESS);  //assert to save on runtime execution
-    int cb = check_buffer(output);
-    if(cb != DARTT_PROTOCOL_SUCCESS)
-    {
-        return cb;
-    }
-    int rc = check_write_lengths(msg,type,output);
-    if(rc != DARTT_PROTOCOL_SUCCESS)
-    {
-        return rc;  //memory overrun guards. likelihood of this being a runtime error is high, especially since length is not constant, so failure to pass these checks should return nicely rather than throw an error or risk memory overrun in a release build
-    }
-
-    //prepare the serial buffer
-    output->len = 0;
-    if(type == TYPE_SERIAL_MESSAGE)
-    {
-        output->buf[output->len++] = msg->address;        
-    }
-    uint16_t rw_index = (msg->index & (~READ_WRITE_BITMASK));   //MSB = 0 for write, low 15 for index
-    output->buf[output->len++] = (unsigned char)(rw_index & 0x00FF);
-    output->buf[output->len++] = (unsigned char)((rw_index & 0xFF00) >> 8);
-    for(size_t i = 0; i < msg->payload.len; i++)
-    {
-        output->buf[output->len++] = msg->payload.buf[i];
-    }
-    if(type == TYPE_SERIAL_MESSAGE || type == TYPE_ADDR_MESSAGE)
-    {
-        uint16_t crc = dartt_crc16(output->buf, output->len);
-        output->buf[output->len++] = (unsigned char)(crc & 0x00FF);
-        output->buf[output->len++] = (unsigned char)((crc & 0xFF00) >> 8);
-    }
-    return DARTT_PROTOCOL_SUCCESS;
+	if(!IS_FIXED_TYPE(type))
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	return dartt_create_write_frame_inline(msg, FIXED_TYPE(type), output);
 }
 
 /**
@@ -291,23 +387,25 @@ int check_read_args(misc_read_message_t * msg, serial_message_type_t type, dartt
     }
 
     //pre-check lengths for overrun
+    size_t nb_tag = (msg->tag != DARTT_TAG_NONE) ? NUM_BYTES_TAG : 0;
+    nb_tag += DARTT_INDEX_NUM_BYTES(msg->index) - NUM_BYTES_INDEX;    //the word index of extended frames
     if(type == TYPE_SERIAL_MESSAGE)
     {
-        if( ( (NUM_BYTES_ADDRESS + NUM_BYTES_INDEX + NUM_BYTES_NUMWORDS_READREQUEST + NUM_BYTES_CHECKSUM) ) > output->size)
+        if( ( (NUM_BYTES_ADDRESS + NUM_BYTES_INDEX + NUM_BYTES_NUMWORDS_READREQUEST + nb_tag + NUM_BYTES_CHECKSUM) ) > output->size)
         {
             return DARTT_ERROR_MEMORY_OVERRUN;
         }
     }
     else if(type == TYPE_ADDR_MESSAGE)
     {
-        if( (NUM_BYTES_INDEX + NUM_BYTES_NUMWORDS_READREQUEST + NUM_BYTES_CHECKSUM) > output->size)
+        if( (NUM_BYTES_INDEX + NUM_BYTES_NUMWORDS_READREQUEST + nb_tag + NUM_BYTES_CHECKSUM) > output->size)
         {
             return DARTT_ERROR_MEMORY_OVERRUN;
         }
     }
     else if (type == TYPE_ADDR_CRC_MESSAGE)
     {
-        if( (NUM_BYTES_INDEX + NUM_BYTES_NUMWORDS_READREQUEST) > output->size)
+        if( (NUM_BYTES_INDEX + NUM_BYTES_NUMWORDS_READREQUEST + nb_tag) > output->size)
         {
             return DARTT_ERROR_MEMORY_OVERRUN;
         }
@@ -326,20 +424,42 @@ int check_read_args(misc_read_message_t * msg, serial_message_type_t type, dartt
  */
 size_t dartt_rw_overhead(serial_message_type_t type)
 {
-	size_t overhead = NUM_BYTES_INDEX;
-	if(type == TYPE_SERIAL_MESSAGE)
+	if(!IS_FIXED_TYPE(type))
+	{
+		return 0;
+	}
+	return dartt_rw_overhead_inline(FIXED_TYPE(type));
+}
+
+/**
+ * @brief Returns the CAN-FD data length needed to carry a frame, i.e. the smallest legal DLC length that fits it
+ * @param len Frame length in bytes
+ * @returns len rounded up to the next of 0-8, 12, 16, 20, 24, 32, 48 or 64. 0 if len is larger than DARTT_CANFD_MAX_LEN
+ * @note Usable directly as dartt_sync_t frame_len_callback for CAN-FD links
+ */
+size_t dartt_canfd_len(size_t len)
+{
+	if(len <= 8)
 	{
-		overhead += NUM_BYTES_ADDRESS + NUM_BYTES_CHECKSUM;
+		return len;
 	}
-	else if(type == TYPE_ADDR_MESSAGE)
+	if(len <= 24)
 	{
-		overhead += NUM_BYTES_CHECKSUM;
+		return (len + 3) & ~(size_t)3;	//12, 16, 20, 24
 	}
-	else if (type != TYPE_ADDR_CRC_MESSAGE)
+	if(len <= 32)
 	{
-		overhead = 0;
+		return 32;
 	}
-	return overhead;
+	if(len <= 48)
+	{
+		return 48;
+	}
+	if(len <= DARTT_CANFD_MAX_LEN)
+	{
+		return DARTT_CANFD_MAX_LEN;
+	}
+	return 0;
 }
 
 /**
@@ -363,37 +483,308 @@ size_t dartt_rw_overhead(serial_message_type_t type)
  *       - TYPE_ADDR_MESSAGE: [idx_lo|0x80][idx_hi][bytes_lo][bytes_hi][crc_lo][crc_hi]
  *       - TYPE_ADDR_CRC_MESSAGE: [idx_lo|0x80][idx_hi][bytes_lo][bytes_hi]
  * @note The MSB of the index is set to indicate read operation.
+ * @note Extended frames as in dartt_create_write_frame().
  */
 int dartt_create_read_frame(misc_read_message_t * msg, serial_message_type_t type, dartt_buffer_t * output)
 {
-    DARTT_ASSERT(check_read_args(msg,type,output) == DARTT_PROTOCOL_SUCCESS);
-	int rc = check_buffer(output);
-	if(rc != DARTT_PROTOCOL_SUCCESS)
-	{
-		return rc;
-	}
-	
-	if(output->size < dartt_rw_overhead(type) + NUM_BYTES_NUMWORDS_READREQUEST)
+	if(!IS_FIXED_TYPE(type))
 	{
-		return DARTT_ERROR_MEMORY_OVERRUN;
+		return DARTT_ERROR_INVALID_ARGUMENT;
 	}
+	return dartt_create_read_frame_inline(msg, FIXED_TYPE(type), output);
+}
+
+/*
+	Little endian 32 bit fields of CRC32 queries and replies
+*/
+static void load_u32(unsigned char * buf, uint32_t value)
+{
+    buf[0] = (unsigned char)(value & 0xFF);
+    buf[1] = (unsigned char)((value >> 8) & 0xFF);
+    buf[2] = (unsigned char)((value >> 16) & 0xFF);
+    buf[3] = (unsigned char)((value >> 24) & 0xFF);
+}
+
+static uint32_t get_u32(const unsigned char * buf)
+{
+    return ((uint32_t)buf[0]) | (((uint32_t)buf[1]) << 8) | (((uint32_t)buf[2]) << 16) | (((uint32_t)buf[3]) << 24);
+}
+
+/*
+	Length of the payload of a read request before its optional tag: the num bytes field, or the span of a CRC32 query
+*/
+static size_t read_request_len(const payload_layer_msg_t * request)
+{
+    return (request->index_arg == DARTT_INDEX_CRC32) ? NUM_BYTES_CRC32_QUERY : NUM_BYTES_NUMWORDS_READREQUEST;
+}
+
+/**
+ * @brief Remove the tag from a reply to a tagged read request (controller-side).
+ *
+ * Replies to tagged read requests (misc_read_message_t.tag != DARTT_TAG_NONE) carry the tag as their last byte,
+ * after the data or error code. Call this after dartt_frame_to_payload() and before any other reply parsing.
+ *
+ * @param payload Payload layer message extracted from the reply frame. msg.len is reduced by the tag
+ * @param tag Receives the tag
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_MALFORMED_MESSAGE if the reply is too short to carry a tag
+ */
+int dartt_strip_reply_tag(payload_layer_msg_t * payload, uint8_t * tag)
+{
+    DARTT_ASSERT(payload != NULL && tag != NULL);
+    if(payload->msg.len < NUM_BYTES_TAG || payload->msg.buf == NULL)
+    {
+        return DARTT_ERROR_MALFORMED_MESSAGE;
+    }
+    payload->msg.len -= NUM_BYTES_TAG;
+    *tag = payload->msg.buf[payload->msg.len];
+    return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Load an error reply into a base (unframed) reply buffer.
+ *
+ * Error reply format: [idx_lo][idx_hi|0x80][error]. The read/write bit, which is never set in a read reply,
+ * marks the frame as an error reply. The single payload byte is the (negative) error code as an int8.
+ * Errors to extended requests echo the extended index: [idx_lo][idx_hi|0x80][w0][w1][w2][w3][error].
+ *
+ * @param request The rejected request. If it is a tagged read request, the tag is echoed after the error code
+ * @param error Error code to report. Must be negative
+ * @param reply_base Buffer to receive the error reply. Left empty if too small
+ * @return error, so callers can return the result directly
+ */
+int dartt_load_error_reply(const payload_layer_msg_t * request, int error, dartt_buffer_t * reply_base)
+{
+    DARTT_ASSERT(request != NULL);
+    DARTT_ASSERT(error < 0);
+    reply_base->len = 0;
+    size_t nb_request = read_request_len(request);
+    size_t nb_tag = (request->msg.len == nb_request + NUM_BYTES_TAG) ? NUM_BYTES_TAG : 0;
+    size_t nb_index_ext = DARTT_INDEX_NUM_BYTES(request->index_arg) - NUM_BYTES_INDEX;
+    if(reply_base->size < NUM_BYTES_ERROR_REPLY_PLD + nb_index_ext + nb_tag)
+    {
+        return error;   //no room to report it. The controller will time out instead
+    }
+    reply_base->len += dartt_load_index_inline(reply_base->buf, request->index_arg, READ_WRITE_BITMASK);
+    reply_base->buf[reply_base->len++] = (unsigned char)((int8_t)error);
+    if(nb_tag != 0)
+    {
+        reply_base->buf[reply_base->len++] = request->msg.buf[nb_request];
+    }
+    return error;
+}
+
+/**
+ * @brief Create a complete error reply frame for a rejected read request (peripheral-side).
+ *
+ * For peripherals that reject a read request before it reaches dartt_parse_general_message (for instance on an
+ * access control check). Framing matches the read reply of the same type.
+ *
+ * @param request The rejected request
+ * @param error Error code to report. Must be negative
+ * @param type Original frame type (determines reply frame format)
+ * @param reply Buffer to receive the error reply frame. Left empty if too small
+ * @return error, so callers can return the result directly
+ */
+int dartt_create_error_reply(const payload_layer_msg_t * request, int error, serial_message_type_t type, dartt_buffer_t * reply)
+{
+    DARTT_ASSERT(reply != NULL && reply->buf != NULL);
+    reply->len = 0;
+    size_t head = (type == TYPE_SERIAL_MESSAGE) ? NUM_BYTES_ADDRESS : 0;
+    size_t tail = (type == TYPE_ADDR_CRC_MESSAGE) ? 0 : NUM_BYTES_CHECKSUM;
+    if(reply->size < head + tail)
+    {
+        return error;
+    }
+    dartt_buffer_t reply_base = {
+        .buf = reply->buf + head,
+        .size = reply->size - (head + tail),
+        .len = 0
+    };
+    dartt_load_error_reply(request, error, &reply_base);
+    if(reply_base.len == 0)
+    {
+        return error;
+    }
+    if(head != 0)
+    {
+        reply->buf[0] = MASTER_MISC_ADDRESS;
+    }
+    reply->len = head + reply_base.len;
+    if(tail != 0 && append_crc(reply) != DARTT_PROTOCOL_SUCCESS)
+    {
+        reply->len = 0;
+    }
+    return error;
+}
+
+/**
+ * @brief Check whether a received reply is an error reply (controller-side).
+ *
+ * @param payload Payload layer message extracted from a reply frame with dartt_frame_to_payload()
+ * @return DARTT_PROTOCOL_SUCCESS if the reply is a regular read reply, the peripheral's error code if it is an
+ *         error reply, DARTT_ERROR_MALFORMED_MESSAGE if it is an error reply without a valid error code
+ */
+int dartt_check_error_reply(const payload_layer_msg_t * payload)
+{
+    DARTT_ASSERT(payload != NULL);
+    if(payload->rw_bit == 0)
+    {
+        return DARTT_PROTOCOL_SUCCESS;
+    }
+    if(payload->msg.len < NUM_BYTES_ERROR_REPLY_PLD - NUM_BYTES_INDEX)
+    {
+        return DARTT_ERROR_MALFORMED_MESSAGE;
+    }
+    int error = (int)((int8_t)payload->msg.buf[0]);
+    if(error >= 0)
+    {
+        return DARTT_ERROR_MALFORMED_MESSAGE;
+    }
+    return error;
+}
+
+/**
+ * @brief Create a CRC32 query frame (controller-side).
+ *
+ * A CRC32 query is a read request to the reserved index DARTT_INDEX_CRC32 whose num bytes field is replaced by the
+ * span to check. The peripheral replies with the dartt_crc32() of the span instead of its content, so a large
+ * region can be verified with a single short reply.
+ *
+ * Frame format: [addr][0xFD][0xFF][w0][w1][w2][w3][n0][n1][n2][n3][tag][crc_lo][crc_hi], with the address, tag and
+ * CRC present as in a read request of the same type.
+ *
+ * @param msg Query: address, first word index and length of the span, optional tag
+ * @param type Frame type determining structure (address and CRC inclusion)
+ * @param output Buffer to receive the generated frame (len will be updated)
+ * @return DARTT_PROTOCOL_SUCCESS, DARTT_ERROR_INVALID_ARGUMENT for an invalid argument or type,
+ *         DARTT_ERROR_MEMORY_OVERRUN if the frame does not fit in output
+ * @note The word index is absolute, like the index of any other frame. It is not limited to the standard index range.
+ */
+int dartt_create_crc32_query(misc_crc32_query_t * msg, serial_message_type_t type, dartt_buffer_t * output)
+{
+    if(msg == NULL || !IS_FIXED_TYPE(type))
+    {
+        return DARTT_ERROR_INVALID_ARGUMENT;
+    }
+    type = FIXED_TYPE(type);
+    int cb = check_buffer(output);
+    if(cb != DARTT_PROTOCOL_SUCCESS)
+    {
+        return cb;
+    }
+    size_t overhead = dartt_rw_overhead_inline(type);
+    if(overhead == 0)
+    {
+        return DARTT_ERROR_INVALID_ARGUMENT;
+    }
+    size_t nb_tag = (msg->tag != DARTT_TAG_NONE) ? NUM_BYTES_TAG : 0;
+    if(output->size < overhead + NUM_BYTES_CRC32_QUERY + nb_tag)
+    {
+        return DARTT_ERROR_MEMORY_OVERRUN;
+    }
 
     output->len = 0;
     if(type == TYPE_SERIAL_MESSAGE)
     {
         output->buf[output->len++] = msg->address;
     }
-    uint16_t rw_index = msg->index | READ_WRITE_BITMASK;
-    output->buf[output->len++] = (unsigned char)(rw_index & 0x00FF);
-    output->buf[output->len++] = (unsigned char)((rw_index & 0xFF00) >> 8);
-    output->buf[output->len++] = (unsigned char)(msg->num_bytes & 0x00FF);
-    output->buf[output->len++] = (unsigned char)((msg->num_bytes & 0xFF00) >> 8);
+    output->len += dartt_load_index_inline(output->buf + output->len, DARTT_INDEX_CRC32, READ_WRITE_BITMASK);
+    load_u32(output->buf + output->len, msg->word);
+    load_u32(output->buf + output->len + sizeof(uint32_t), msg->num_bytes);
+    output->len += NUM_BYTES_CRC32_QUERY;
+    if(nb_tag != 0)
+    {
+        output->buf[output->len++] = msg->tag;
+    }
     if(type == TYPE_SERIAL_MESSAGE || type == TYPE_ADDR_MESSAGE)
     {
-        uint16_t crc = dartt_crc16(output->buf, output->len);
-        output->buf[output->len++] = (unsigned char)(crc & 0x00FF);
-        output->buf[output->len++] = (unsigned char)((crc & 0xFF00) >> 8);
-    }    
+        return append_crc(output);
+    }
+    return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Extract the span of a CRC32 query (peripheral-side).
+ *
+ * @param request Payload layer message of the query, as returned by dartt_frame_to_payload()
+ * @param word Receives the word index of the first word of the span
+ * @param num_bytes Receives the length of the span in bytes
+ * @return DARTT_PROTOCOL_SUCCESS, DARTT_ERROR_INVALID_ARGUMENT if the message is not a CRC32 query,
+ *         DARTT_ERROR_MALFORMED_MESSAGE if its payload has the wrong length
+ */
+int dartt_parse_crc32_query(const payload_layer_msg_t * request, uint32_t * word, uint32_t * num_bytes)
+{
+    DARTT_ASSERT(request != NULL && word != NULL && num_bytes != NULL);
+    if(request->rw_bit == 0 || request->index_arg != DARTT_INDEX_CRC32)
+    {
+        return DARTT_ERROR_INVALID_ARGUMENT;
+    }
+    if(request->msg.buf == NULL || (request->msg.len != NUM_BYTES_CRC32_QUERY && request->msg.len != NUM_BYTES_CRC32_QUERY + NUM_BYTES_TAG))
+    {
+        return DARTT_ERROR_MALFORMED_MESSAGE;
+    }
+    *word = get_u32(request->msg.buf);
+    *num_bytes = get_u32(request->msg.buf + sizeof(uint32_t));
+    return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Extract the CRC32 from the reply to a CRC32 query (controller-side).
+ *
+ * @param payload Payload layer message extracted from the reply frame. Strip the tag first for tagged queries
+ * @param crc Receives the CRC32 of the span computed by the peripheral
+ * @return DARTT_PROTOCOL_SUCCESS, the peripheral's error code for an error reply, DARTT_ERROR_MALFORMED_MESSAGE if
+ *         the reply is not a CRC32 reply, DARTT_ERROR_CTL_READ_LEN_MISMATCH if its payload has the wrong length
+ */
+int dartt_parse_crc32_reply(const payload_layer_msg_t * payload, uint32_t * crc)
+{
+    DARTT_ASSERT(payload != NULL && crc != NULL);
+    int rc = dartt_check_error_reply(payload);
+    if(rc != DARTT_PROTOCOL_SUCCESS)
+    {
+        return rc;
+    }
+    if(payload->index_arg != DARTT_INDEX_CRC32 || payload->msg.buf == NULL)
+    {
+        return DARTT_ERROR_MALFORMED_MESSAGE;
+    }
+    if(payload->msg.len != NUM_BYTES_CRC32)
+    {
+        return DARTT_ERROR_CTL_READ_LEN_MISMATCH;
+    }
+    *crc = get_u32(payload->msg.buf);
+    return DARTT_PROTOCOL_SUCCESS;
+}
+
+/*
+	Answer a CRC32 query with [0xFD][0x7F][crc0][crc1][crc2][crc3](+tag), or with an error reply
+*/
+static int load_crc32_reply(payload_layer_msg_t * pld_msg, const dartt_mem_t * mem_base, dartt_buffer_t * reply_base)
+{
+    uint32_t word = 0;
+    uint32_t num_bytes = 0;
+    int rc = dartt_parse_crc32_query(pld_msg, &word, &num_bytes);
+    if(rc != DARTT_PROTOCOL_SUCCESS)
+    {
+        return dartt_load_error_reply(pld_msg, rc, reply_base);
+    }
+    if(word > mem_base->size / sizeof(uint32_t) || num_bytes > mem_base->size - word*sizeof(uint32_t))
+    {
+        return dartt_load_error_reply(pld_msg, DARTT_ERROR_MEMORY_OVERRUN, reply_base);
+    }
+    size_t nb_tag = (pld_msg->msg.len == NUM_BYTES_CRC32_QUERY + NUM_BYTES_TAG) ? NUM_BYTES_TAG : 0;
+    if(NUM_BYTES_INDEX + NUM_BYTES_CRC32 + nb_tag > reply_base->size)
+    {
+        return dartt_load_error_reply(pld_msg, DARTT_ERROR_MEMORY_OVERRUN, reply_base);
+    }
+    uint32_t crc = dartt_crc32(mem_base->buf + word*sizeof(uint32_t), num_bytes);
+    reply_base->len = dartt_load_index_inline(reply_base->buf, DARTT_INDEX_CRC32, 0);
+    load_u32(reply_base->buf + reply_base->len, crc);
+    reply_base->len += NUM_BYTES_CRC32;
+    if(nb_tag != 0)
+    {
+        reply_base->buf[reply_base->len++] = pld_msg->msg.buf[NUM_BYTES_CRC32_QUERY];
+    }
     return DARTT_PROTOCOL_SUCCESS;
 }
 
@@ -417,8 +808,18 @@ int dartt_create_read_frame(misc_read_message_t * msg, serial_message_type_t typ
  * 
  * @note Input message format: [idx_lo][idx_hi][payload...] for writes
  *                             [idx_lo|0x80][idx_hi][num_bytes_lo][num_bytes_hi] for reads
+ *                             [idx_lo|0x80][idx_hi][num_bytes_lo][num_bytes_hi][tag] for tagged reads. The reply ends with the tag
+ *       (index bytes as extracted by dartt_frame_to_payload). Replies to extended requests carry the extended index.
  * @note For read operations, reply_base will contain the requested data
  * @note For write operations, reply_base->len is set to 0 (no reply)
+ * @note Read requests to DARTT_INDEX_CRC32 are CRC32 queries (see dartt_create_crc32_query()). The reply carries the
+ *       CRC32 of the span, [0xFD][0x7F][crc0][crc1][crc2][crc3], computed over mem_base. Its cost grows with the span.
+ * @note Other standard indices at or above DARTT_INDEX_RESERVED_BASE never address memory, even in maps larger than
+ *       the standard index range: reads get a DARTT_ERROR_INVALID_ARGUMENT error reply, writes to DARTT_INDEX_COMMIT
+ *       are ignored and other writes are rejected with DARTT_ERROR_INVALID_ARGUMENT.
+ * @note Rejected read requests load an error reply [idx_lo][idx_hi|0x80][error] into reply_base AND return the error
+ *       code, so the controller fails immediately instead of waiting for its rx timeout. Send the reply whenever
+ *       reply_base->len is nonzero, regardless of the return value. Rejected writes are never replied to.
  * @note Caller should reserve space for address framing using pointer arithmetic
  * @note This function is message-type agnostic - framing is handled upstream
  */
@@ -437,25 +838,61 @@ int dartt_parse_base_serial_message(payload_layer_msg_t* pld_msg, const dartt_me
     {
         return cb;
     }
+    reply_base->len = 0;
     
     //critical check - keep as runtime since this is data-dependent
     if(pld_msg->msg.len == 0)   //if write, it must contain at least one byte of payload. If read, it must contain exactly two additional bytes of read size
     {
+        if(pld_msg->rw_bit != 0)
+        {
+            return dartt_load_error_reply(pld_msg, DARTT_ERROR_MALFORMED_MESSAGE, reply_base);
+        }
         return DARTT_ERROR_MALFORMED_MESSAGE;
     }
+    if(pld_msg->rw_bit != 0 && pld_msg->index_arg == DARTT_INDEX_CRC32)
+    {
+        return load_crc32_reply(pld_msg, mem_base, reply_base);
+    }
+    if(!DARTT_INDEX_IS_EXTENDED(pld_msg->index_arg) && pld_msg->index_arg >= DARTT_INDEX_RESERVED_BASE)   //reserved indices never address memory, however large the map
+    {
+        if(pld_msg->rw_bit != 0)
+        {
+            return dartt_load_error_reply(pld_msg, DARTT_ERROR_INVALID_ARGUMENT, reply_base);
+        }
+        if(pld_msg->index_arg == DARTT_INDEX_COMMIT)
+        {
+            return DARTT_PROTOCOL_SUCCESS;  //nothing is staged without a staging block: the commit is ignored
+        }
+        return DARTT_ERROR_INVALID_ARGUMENT;
+    }
 
     size_t bidx = 0;
-    size_t word_offset = ((size_t)(pld_msg->index_arg))*sizeof(uint32_t); 
+    size_t word = DARTT_INDEX_WORD(pld_msg->index_arg);
+    if(word > mem_base->size / sizeof(uint32_t))    //guards the multiplication below against wrapping on 32 bit targets
+    {
+        if(pld_msg->rw_bit != 0)
+        {
+            return dartt_load_error_reply(pld_msg, DARTT_ERROR_MEMORY_OVERRUN, reply_base);
+        }
+        return DARTT_ERROR_MEMORY_OVERRUN;
+    }
+    size_t word_offset = word*sizeof(uint32_t);
+    size_t nb_index = DARTT_INDEX_NUM_BYTES(pld_msg->index_arg);
     if(pld_msg->rw_bit != 0) //read
     {
-        if(pld_msg->msg.len != NUM_BYTES_NUMWORDS_READREQUEST)  //read messages must have precisely this content (once addr and crc are removed, if relevant)
+        size_t nb_tag = 0;
+        if(pld_msg->msg.len == NUM_BYTES_NUMWORDS_READREQUEST + NUM_BYTES_TAG)
+        {
+            nb_tag = NUM_BYTES_TAG; //tagged request. Echo the tag at the end of the reply
+        }
+        else if(pld_msg->msg.len != NUM_BYTES_NUMWORDS_READREQUEST)  //read messages must have precisely this content (once addr and crc are removed, if relevant)
         {
-            return DARTT_ERROR_MALFORMED_MESSAGE;
+            return dartt_load_error_reply(pld_msg, DARTT_ERROR_MALFORMED_MESSAGE, reply_base);
         }
         uint16_t num_bytes = 0;
         num_bytes |= (uint16_t)(pld_msg->msg.buf[bidx++]);
         num_bytes |= (((uint16_t)(pld_msg->msg.buf[bidx++])) << 8);
-        if(num_bytes + NUM_BYTES_READ_REPLY_OVERHEAD_PLD > reply_base->size)    //ensure there is room for the memory block and the word_offset
+        if(num_bytes + nb_index + nb_tag > reply_base->size)    //ensure there is room for the memory block, the word_offset and the tag
         {
             /*
             TODO (NEXT STEPS/GOOD FEATURES): now that the reply frame structure mirrors the write frame structure, we can service this request
@@ -463,26 +900,23 @@ int dartt_parse_base_serial_message(payload_layer_msg_t* pld_msg, const dartt_me
 
             I.e. we implement the same logic as in 'read_multi', where we send out multiple reply frames in response to a request that 
             we can't cover with a single reply.
-
-            ERROR CODE RETURN: We can also implement logic where other out of bounds errors trigger the loading of a reply frame consisting of only the 
-            index, rather than being silent. This requires more unit testing and refactoring but it's an elegant solution to some of the problems I had with the first pass of the protocol.
             */
-            return DARTT_ERROR_MEMORY_OVERRUN;
+            return dartt_load_error_reply(pld_msg, DARTT_ERROR_MEMORY_OVERRUN, reply_base);
         }
 
         
         unsigned char * cpy_ptr = mem_base->buf + word_offset;
         if(word_offset + num_bytes > mem_base->size)
         {
-            return DARTT_ERROR_MEMORY_OVERRUN;
+            return dartt_load_error_reply(pld_msg, DARTT_ERROR_MEMORY_OVERRUN, reply_base);
         }
 
-        reply_base->len = 0;
-        reply_base->buf[reply_base->len++] = (unsigned char)(pld_msg->index_arg & 0x00FF);     //prepend the word offset
-        reply_base->buf[reply_base->len++] = (unsigned char)((pld_msg->index_arg & 0xFF00) >> 8);  //prepend the word offset
-        for(uint16_t i = 0; i < num_bytes; i++)
+        reply_base->len = dartt_load_index_inline(reply_base->buf, pld_msg->index_arg, 0);     //prepend the word offset, in the form of the request
+        dartt_copy(reply_base->buf + reply_base->len, cpy_ptr, num_bytes);
+        reply_base->len += num_bytes;
+        if(nb_tag != 0)
         {
-            reply_base->buf[reply_base->len++] = cpy_ptr[i];
+            reply_base->buf[reply_base->len++] = pld_msg->msg.buf[NUM_BYTES_NUMWORDS_READREQUEST];
         }
         return DARTT_PROTOCOL_SUCCESS; //caller needs to finish the reply formatting
     }
@@ -493,10 +927,7 @@ int dartt_parse_base_serial_message(payload_layer_msg_t* pld_msg, const dartt_me
             return DARTT_ERROR_MEMORY_OVERRUN;
         }
         unsigned char * mem_ptr = mem_base->buf + word_offset;
-        for(size_t i = 0; i < pld_msg->msg.len; i++)
-        {
-            mem_ptr[i] = pld_msg->msg.buf[i];  //perform the copy
-        }
+        dartt_copy(mem_ptr, pld_msg->msg.buf, pld_msg->msg.len);  //perform the copy
         reply_base->len = 0;    //erase the reply. Success and nonzero reply len should trigger transmission of a reply frame, and we don't reply to write messages!
         return DARTT_PROTOCOL_SUCCESS; //no reply, so caller doesn't need to do anything else
     }
@@ -533,7 +964,7 @@ int validate_crc(const dartt_buffer_t * input)
     {
         return DARTT_ERROR_INVALID_ARGUMENT;
     }
-    uint16_t crc = dartt_crc16(input->buf, input->len - NUM_BYTES_CHECKSUM);
+    uint16_t crc = dartt_frame_crc16(input->buf, input->len - NUM_BYTES_CHECKSUM);
     uint16_t m_crc = 0;
     unsigned char * pchecksum = input->buf + (input->len - NUM_BYTES_CHECKSUM);
     m_crc |= (uint16_t)pchecksum[0];
@@ -579,7 +1010,7 @@ int append_crc(dartt_buffer_t * input)
     {
         return DARTT_ERROR_MEMORY_OVERRUN;
     }
-    uint16_t crc = dartt_crc16(input->buf, input->len);
+    uint16_t crc = dartt_frame_crc16(input->buf, input->len);
     input->buf[input->len++] = (unsigned char)(crc & 0x00FF);
     input->buf[input->len++] = (unsigned char)((crc & 0xFF00) >> 8);
 
@@ -602,8 +1033,9 @@ int append_crc(dartt_buffer_t * input)
  * @return DARTT_PROTOCOL_SUCCESS on successful parsing, or error code:
  *         - DARTT_ERROR_MEMORY_OVERRUN if calculated offset exceeds destination bounds
  *         - DARTT_ERROR_MALFORMED_MESSAGE if reply length doesn't match requested length
+ *         - the peripheral's error code if the reply is an error reply (see dartt_check_error_reply())
  * 
- * @note The destination offset is calculated as: original_msg->index * sizeof(uint32_t)
+ * @note The destination offset is calculated as: DARTT_INDEX_WORD(payload->index_arg) * sizeof(uint32_t)
  * @note Reply length must exactly match original_msg->num_bytes
  * @note This function is called after dartt_frame_to_payload() has extracted the raw payload
  * @note Used by master devices to reconstruct remote memory after read operations
@@ -624,13 +1056,23 @@ int dartt_parse_read_reply(payload_layer_msg_t * payload, misc_read_message_t *
     {
         return cb;
     }
+    cb = dartt_check_error_reply(payload);
+    if(cb != DARTT_PROTOCOL_SUCCESS)
+    {
+        return cb;  //the peripheral rejected the request
+    }
     
     if(payload->msg.len != original_msg->num_bytes)
     {
         return DARTT_ERROR_CTL_READ_LEN_MISMATCH;
     }
 
-    size_t byte_offset = ((size_t)payload->index_arg)*sizeof(uint32_t);
+    size_t word = DARTT_INDEX_WORD(payload->index_arg);
+    if(word > dest->size / sizeof(uint32_t))
+    {
+        return DARTT_ERROR_MEMORY_OVERRUN;
+    }
+    size_t byte_offset = word*sizeof(uint32_t);
 
     // Validate that the offset and data length don't exceed destination buffer bounds
     if(byte_offset + payload->msg.len > dest->size)
@@ -640,10 +1082,7 @@ int dartt_parse_read_reply(payload_layer_msg_t * payload, misc_read_message_t *
         
     // Copy the reply data to the correct offset in the destination buffer
     unsigned char * dest_ptr = dest->buf + byte_offset;
-    for(size_t i = 0; i < payload->msg.len; i++)
-    {
-        dest_ptr[i] = payload->msg.buf[i];
-    }
+    dartt_copy(dest_ptr, payload->msg.buf, payload->msg.len);
     
     return DARTT_PROTOCOL_SUCCESS;
 }
@@ -675,103 +1114,19 @@ int dartt_parse_read_reply(payload_layer_msg_t * payload, misc_read_message_t *
  *       - TYPE_SERIAL_MESSAGE: Validates CRC, extracts address, removes both from payload
  *       - TYPE_ADDR_MESSAGE: Validates CRC, removes CRC from payload (no address)
  *       - TYPE_ADDR_CRC_MESSAGE: No validation, payload = entire frame
+ * @note The index word is removed from the payload. For extended frames (index word DARTT_INDEX_EXTENDED) the 32 bit
+ *       word index that follows is removed too, and pld->index_arg is the word index with DARTT_INDEX_EXTENDED_BIT set.
  * @note PAYLOAD_ALIAS mode uses pointer arithmetic (zero-copy, but payload tied to frame)
  * @note PAYLOAD_COPY mode copies payload data (safe for frame buffer reuse)
  * @note This function only handles framing - payload structure is decoded downstream
  */
 int dartt_frame_to_payload(dartt_buffer_t * ser_msg, serial_message_type_t type, payload_mode_t pld_mode, payload_layer_msg_t * pld)
 {
-    DARTT_ASSERT(pld != NULL);
-	
-	//check for payload argument validity
-	if(pld_mode != PAYLOAD_ALIAS)
-	{
-		int cb = check_buffer(&pld->msg);
-		if(cb != DARTT_PROTOCOL_SUCCESS)
-		{
-			return cb;
-		}
-	}
-
-	int cb = check_buffer(ser_msg);
-	if(cb != DARTT_PROTOCOL_SUCCESS)
-	{
-		return cb;
-	}
-
-	//pre-flight length check
-	if(ser_msg->len <= dartt_rw_overhead(type))
-	{
-		return DARTT_ERROR_MALFORMED_MESSAGE;	
-	}
-
-	size_t head = 0;
-	size_t tail = 0;
-	if(type == TYPE_SERIAL_MESSAGE)
-	{
-		int rc = validate_crc(ser_msg);
-		if(rc != DARTT_PROTOCOL_SUCCESS)
-		{
-			return rc;	//checksum must match
-		}
-
-		//extract address
-		pld->address = ser_msg->buf[head++];
-		tail = NUM_BYTES_CHECKSUM;
-	}
-	else if(type == TYPE_ADDR_MESSAGE)
-	{
-		int rc = validate_crc(ser_msg);
-		if(rc != DARTT_PROTOCOL_SUCCESS)
-		{
-			return rc;	//checksum must match
-		}
-		tail = NUM_BYTES_CHECKSUM;
-	}
-	else if (type != TYPE_ADDR_CRC_MESSAGE)
-	{
-		return DARTT_ERROR_INVALID_ARGUMENT;
-	}
-
-	//extract rw_bit and index_arg, and advance head to truncate the rw_index header off the message
-	uint16_t rw_index = 0;
-    rw_index |= (uint16_t)(ser_msg->buf[head++]);
-    rw_index |= (((uint16_t)(ser_msg->buf[head++])) << 8);
-    pld->rw_bit = rw_index & READ_WRITE_BITMASK;  //omit the shift and perform zero comparison for speed
-    pld->index_arg = rw_index & (~READ_WRITE_BITMASK);
-
-	if(pld_mode == PAYLOAD_ALIAS)	//Use pointer arithmetic
-	{
-		//truncate off checksum, address and rw_index
-		pld->msg.buf = &ser_msg->buf[head];
-		pld->msg.len = ser_msg->len - (head + tail);
-		pld->msg.size = ser_msg->size - (head + tail);						
-	}
-	else if(pld_mode == PAYLOAD_COPY)	//
-	{
-		if(pld->msg.buf == NULL)
-		{
-			return DARTT_ERROR_INVALID_ARGUMENT;
-		}
-		size_t newlen  = ser_msg->len - (head + tail);
-		if(newlen > pld->msg.size)
-		{
-			return DARTT_ERROR_MEMORY_OVERRUN;
-		}
-		unsigned char * sm_start = ser_msg->buf + head; //skip address and rw_index
-		
-		for(size_t i = 0; i < newlen; i++)
-		{
-			pld->msg.buf[i] = sm_start[i];
-		}
-		pld->msg.len = newlen;
-	}
-	else
+	if(!IS_FIXED_TYPE(type))
 	{
 		return DARTT_ERROR_INVALID_ARGUMENT;
 	}
-	return DARTT_PROTOCOL_SUCCESS;
-
+	return dartt_frame_to_payload_inline(ser_msg, FIXED_TYPE(type), pld_mode, pld);
 }
 
 /**
@@ -798,76 +1153,17 @@ int dartt_frame_to_payload(dartt_buffer_t * ser_msg, serial_message_type_t type,
  *       - TYPE_ADDR_CRC_MESSAGE: [payload] (if read reply exists)
  * @note Write operations produce no reply (reply->len = 0)
  * @note Read operations generate reply data formatted according to frame type
+ * @note Rejected read requests generate an error reply formatted the same way, and the error code is returned.
+ *       Transmit the reply whenever reply->len is nonzero, regardless of the return value.
  * @note This function coordinates payload processing with frame formatting
  * @note Typically called after dartt_frame_to_payload() and address range validation
  */
 int dartt_parse_general_message(payload_layer_msg_t * pld_msg, serial_message_type_t type, const dartt_mem_t * mem_base, dartt_buffer_t * reply)
 {
-    DARTT_ASSERT(pld_msg != NULL);
-    DARTT_ASSERT(pld_msg->msg.buf != NULL);
-    DARTT_ASSERT(pld_msg->msg.size != 0);
-    DARTT_ASSERT(pld_msg->msg.len <= pld_msg->msg.size);
-    int cb = check_mem_base(mem_base);
-    if(cb != DARTT_PROTOCOL_SUCCESS)
-    {
-        return cb;
-    }
-	cb = check_buffer(reply);
-	if(cb != DARTT_PROTOCOL_SUCCESS)
+	if(!IS_FIXED_TYPE(type))
 	{
-		return cb;
+		return DARTT_ERROR_INVALID_ARGUMENT;
 	}
-	
-    if(type == TYPE_SERIAL_MESSAGE)
-    {
-        dartt_buffer_t reply_cpy = {
-            .buf = reply->buf + NUM_BYTES_ADDRESS,     //make room for the address, which we will load after if necessary
-            .size = reply->size - 1,
-            .len = 0
-        };
-        int rc = dartt_parse_base_serial_message(pld_msg, mem_base, &reply_cpy);    //will copy from 1 to len. the original reply buffer is now ready for address and crc loading
-        if(rc == DARTT_PROTOCOL_SUCCESS)
-        {
-			if(reply_cpy.len != 0)
-			{
-				//append address
-				reply->buf[0] = MASTER_MISC_ADDRESS;
-				reply->len = reply_cpy.len + NUM_BYTES_ADDRESS; //update len now that we have the address in the base message
-				return append_crc(reply);   //the checks in this function also check for address length increase/overrun
-			}
-			else
-			{
-				reply->len = reply_cpy.len;
-			}
-        }
-        else if(rc != DARTT_PROTOCOL_SUCCESS)
-        {
-            return rc;
-        }
-        return DARTT_PROTOCOL_SUCCESS;
-    }
-    else if (type == TYPE_ADDR_MESSAGE)
-    {
-        reply->len = 0;
-        int rc = dartt_parse_base_serial_message(pld_msg, mem_base, reply);
-        if(rc == DARTT_PROTOCOL_SUCCESS && reply->len != 0)
-        {
-            return append_crc(reply);
-        }
-        else if (rc != DARTT_PROTOCOL_SUCCESS)
-        {
-            return rc;
-        }
-        return DARTT_PROTOCOL_SUCCESS;
-
-    }
-    else if (type == TYPE_ADDR_CRC_MESSAGE)
-    {
-        return dartt_parse_base_serial_message(pld_msg, mem_base, reply);   //type 3 carries the base protocol with no additional payload dressings
-    }
-    else
-    {
-        return DARTT_ERROR_INVALID_ARGUMENT;  //should never end up here - assert should catch this. Can only happen in release builds untested in debug
-    }
+	return dartt_parse_general_message_inline(pld_msg, FIXED_TYPE(type), mem_base, reply);
 }
 
@@ -9,12 +9,18 @@ extern "C" {
 
 #define NUM_BYTES_ADDRESS sizeof(unsigned char)
 #define NUM_BYTES_INDEX sizeof(uint16_t)
+#define NUM_BYTES_INDEX_EXTENDED sizeof(uint32_t)	//word index following the index word of extended frames (DARTT_INDEX_EXTENDED)
 #define NUM_BYTES_NUMWORDS_READREQUEST	sizeof(uint16_t)	//for a read struct request, we send a fixed 16bit integer argument in the payload section for the readsize request
 #define NUM_BYTES_CHECKSUM sizeof(uint16_t)
 #define NUM_BYTES_NON_PAYLOAD (NUM_BYTES_ADDRESS + NUM_BYTES_INDEX + NUM_BYTES_CHECKSUM)
 #define MINIMUM_MESSAGE_LENGTH NUM_BYTES_NON_PAYLOAD
 //
 #define NUM_BYTES_READ_REPLY_OVERHEAD_PLD NUM_BYTES_INDEX	//non frame layer overhead in read replies. 
+#define NUM_BYTES_ERROR_REPLY_PLD (NUM_BYTES_INDEX + sizeof(int8_t))	//error replies carry the index (with the read/write bit set) and a single error code byte
+#define NUM_BYTES_TAG sizeof(uint8_t)	//OPTIONAL request tag, appended to read requests and echoed as the last byte of the reply
+#define DARTT_TAG_NONE	0	//tag value for untagged read requests
+#define NUM_BYTES_CRC32_QUERY	(2*sizeof(uint32_t))	//CRC32 query payload, in place of the num bytes of a read request: [word index][num bytes], 32 bits each
+#define NUM_BYTES_CRC32			sizeof(uint32_t)	//CRC32 query reply payload
 
 //This is a fixed address that always corresponds
 #define MASTER_MOTOR_ADDRESS	0x7F
@@ -22,7 +28,27 @@ extern "C" {
 
 #define READ_WRITE_BITMASK	0x8000	//msg is the read write bit. 1 for read, 0 for write.
 
-enum {DARTT_ERROR_CTL_READ_LEN_MISMATCH = -7, DARTT_ERROR_SYNC_MISMATCH = -6, DARTT_ERROR_MEMORY_OVERRUN = -5, DARTT_ERROR_INVALID_ARGUMENT = -4, DARTT_ERROR_CHECKSUM_MISMATCH = -3, DARTT_ERROR_MALFORMED_MESSAGE = -2, DARTT_ADDRESS_FILTERED = -1, DARTT_PROTOCOL_SUCCESS = 0};
+//Reserved indices. Index arguments at or above DARTT_INDEX_RESERVED_BASE do not address memory - they carry protocol commands
+#define DARTT_INDEX_RESERVED_BASE	0x7FF0
+#define DARTT_INDEX_CRC32			0x7FFD	//read only: CRC32 (dartt_crc32) of a span of peripheral memory, see dartt_create_crc32_query
+#define DARTT_INDEX_EXTENDED		0x7FFE	//extended frame: the index word is followed by a 32 bit word index, for memory maps beyond the standard index range
+#define DARTT_INDEX_COMMIT			0x7FFF	//a write to this index commits staged writes on peripherals with a staging buffer. Payload content is ignored
+
+/*
+	Message indices (misc_write_message_t.index, misc_read_message_t.index, payload_layer_msg_t.index_arg) are 32 bits.
+	Values below 0x8000 are sent in standard frames: word indices below DARTT_INDEX_RESERVED_BASE, or reserved indices.
+	Words at or above DARTT_INDEX_RESERVED_BASE are addressed with DARTT_INDEX_EXTENDED_BIT set, and are sent in
+	extended frames. DARTT_INDEX_OF_WORD picks the right form for a word index.
+*/
+#define DARTT_INDEX_EXTENDED_BIT	((uint32_t)0x80000000)
+#define DARTT_INDEX_OF_WORD(word)	((word) < DARTT_INDEX_RESERVED_BASE ? (uint32_t)(word) : ((uint32_t)(word) | DARTT_INDEX_EXTENDED_BIT))
+#define DARTT_INDEX_WORD(index)		((uint32_t)(index) & ~DARTT_INDEX_EXTENDED_BIT)	//word index addressed by a message index
+#define DARTT_INDEX_IS_EXTENDED(index)	(((uint32_t)(index) & DARTT_INDEX_EXTENDED_BIT) != 0)
+#define DARTT_INDEX_NUM_BYTES(index)	(DARTT_INDEX_IS_EXTENDED(index) ? (NUM_BYTES_INDEX + NUM_BYTES_INDEX_EXTENDED) : NUM_BYTES_INDEX)	//bytes of index in a frame
+
+#define DARTT_CANFD_MAX_LEN		64	//largest CAN-FD data field. Lengths above 8 must be one of 12, 16, 20, 24, 32, 48, 64
+
+enum {DARTT_ERROR_TIMEOUT = -10, DARTT_ERROR_TAG_MISMATCH = -9, DARTT_ERROR_ACCESS_DENIED = -8, DARTT_ERROR_CTL_READ_LEN_MISMATCH = -7, DARTT_ERROR_SYNC_MISMATCH = -6, DARTT_ERROR_MEMORY_OVERRUN = -5, DARTT_ERROR_INVALID_ARGUMENT = -4, DARTT_ERROR_CHECKSUM_MISMATCH = -3, DARTT_ERROR_MALFORMED_MESSAGE = -2, DARTT_ADDRESS_FILTERED = -1, DARTT_PROTOCOL_SUCCESS = 0};
 
 /*
  * Flags to capture byte field definitions for different physical and link layer protocols,
@@ -84,7 +110,7 @@ typedef struct payload_layer_msg_t
 {
 	unsigned char address;
 	uint16_t rw_bit;
-	uint16_t index_arg;
+	uint32_t index_arg;	//message index. DARTT_INDEX_EXTENDED_BIT is set if the frame was an extended frame
 	dartt_buffer_t msg;
 } payload_layer_msg_t;
 
@@ -94,7 +120,7 @@ Master write message/write request
 typedef struct misc_write_message_t
 {
 	unsigned char address;		//slave destination address
-	uint16_t index;		//32bit-aligned index offset, where we want the payload to start writing to
+	uint32_t index;		//32bit-aligned index offset, where we want the payload to start writing to. See DARTT_INDEX_OF_WORD
 	dartt_buffer_t payload;	//the content of the message, bytewise, which we will be writing
 	//the checksum is computed in the message loader function, iff the hardware doesn't support it inherently. Therefore it is considered 'user alterable' data and not part of the message structure.
 }misc_write_message_t;
@@ -105,14 +131,31 @@ Master read message/read request
 typedef struct misc_read_message_t
 {
 	unsigned char address;		//slave destination address
-	uint16_t index;		//32bit-aligned index offset, where we want the payload to start reading from
+	uint32_t index;		//32bit-aligned index offset, where we want the payload to start reading from. See DARTT_INDEX_OF_WORD
 	uint16_t num_bytes;	//2^16 byte read requests at a time maximum. Not recommended to use buffers this large. 
+	uint8_t tag;		//OPTIONAL request tag (1-255), echoed in the reply so out of order replies can be matched to requests. DARTT_TAG_NONE for untagged
 }misc_read_message_t;
 
+/*
+Master CRC32 query. A read request to DARTT_INDEX_CRC32, answered with the CRC32 of the span instead of its content
+ */
+typedef struct misc_crc32_query_t
+{
+	unsigned char address;		//slave destination address
+	uint32_t word;		//word index of the first word of the span
+	uint32_t num_bytes;	//length of the span in bytes
+	uint8_t tag;		//OPTIONAL request tag (1-255), echoed in the reply. DARTT_TAG_NONE for untagged
+}misc_crc32_query_t;
+
 int index_of_field(void * p_field, void * mem, size_t mem_size);
 int copy_buf_full(dartt_buffer_t * in, dartt_buffer_t * out);
+int dartt_buffer_reserve(const dartt_buffer_t * dma, size_t headroom, size_t tailroom, dartt_buffer_t * frame);
+size_t dartt_buffer_headroom(const dartt_buffer_t * dma, const dartt_buffer_t * frame);
+int dartt_buffer_push(const dartt_buffer_t * dma, dartt_buffer_t * frame, size_t nbytes);
+int dartt_buffer_put(const dartt_buffer_t * dma, dartt_buffer_t * frame, size_t nbytes);
 unsigned char dartt_get_complementary_address(unsigned char address);
 size_t dartt_rw_overhead(serial_message_type_t type);
+size_t dartt_canfd_len(size_t len);
 int dartt_create_write_frame(misc_write_message_t * msg, serial_message_type_t type, dartt_buffer_t * output);
 int dartt_create_read_frame(misc_read_message_t * msg, serial_message_type_t type, dartt_buffer_t * output);
 int dartt_frame_to_payload(dartt_buffer_t * ser_msg, serial_message_type_t type, payload_mode_t pld_mode, payload_layer_msg_t * pld);
@@ -121,6 +164,13 @@ int dartt_parse_general_message(payload_layer_msg_t * pld_msg, serial_message_ty
 int append_crc(dartt_buffer_t * input);
 int validate_crc(const dartt_buffer_t * input);
 int dartt_parse_read_reply(payload_layer_msg_t * payload, misc_read_message_t * original_msg, const dartt_mem_t * dest);
+int dartt_load_error_reply(const payload_layer_msg_t * request, int error, dartt_buffer_t * reply_base);
+int dartt_create_error_reply(const payload_layer_msg_t * request, int error, serial_message_type_t type, dartt_buffer_t * reply);
+int dartt_strip_reply_tag(payload_layer_msg_t * payload, uint8_t * tag);
+int dartt_check_error_reply(const payload_layer_msg_t * payload);
+int dartt_create_crc32_query(misc_crc32_query_t * msg, serial_message_type_t type, dartt_buffer_t * output);
+int dartt_parse_crc32_query(const payload_layer_msg_t * request, uint32_t * word, uint32_t * num_bytes);
+int dartt_parse_crc32_reply(const payload_layer_msg_t * payload, uint32_t * crc);
 
 #ifdef __cplusplus
 }
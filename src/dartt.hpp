@@ -0,0 +1,295 @@
+#ifndef DARTT_HPP
+#define DARTT_HPP
+/*
+	Header-only C++17 layer over dartt.h and dartt_sync.h.
+
+	Fields of a DARTT region are named at compile time with DARTT_FIELD(Struct, member). A field handle carries the
+	byte offset, word index, size and type of the member, so frames are built with constant indices and misaligned
+	or out of range fields fail to compile. sync/read/write take a list of fields, sort and merge them into
+	contiguous spans at compile time, and run one dartt_sync_t operation per span.
+
+		struct motor_t { float kp; float ki; int32_t pos[4]; uint32_t status; };
+		using kp = DARTT_FIELD(motor_t, kp);
+		using ki = DARTT_FIELD(motor_t, ki);
+		using status = DARTT_FIELD(motor_t, status);
+
+		dartt::ctl<kp>(ds) = 1.5f;
+		dartt::sync<kp, ki>(ds);			// one span, words 0-1
+		dartt::read<status>(ds);
+		uint32_t s = dartt::periph<status>(ds);
+*/
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#endif
+#include "dartt.h"
+#include "dartt_sync.h"
+
+namespace dartt {
+
+#if defined(__cpp_lib_span)
+using byte_span = std::span<unsigned char>;
+#else
+/*
+	Stand-in for std::span<unsigned char> before C++20
+*/
+class byte_span
+{
+public:
+	constexpr byte_span() noexcept : ptr_(nullptr), size_(0) {}
+	constexpr byte_span(unsigned char * ptr, std::size_t size) noexcept : ptr_(ptr), size_(size) {}
+	template<std::size_t N>
+	constexpr byte_span(unsigned char (&arr)[N]) noexcept : ptr_(arr), size_(N) {}
+	template<std::size_t N>
+	constexpr byte_span(std::array<unsigned char, N> & arr) noexcept : ptr_(arr.data()), size_(N) {}
+
+	constexpr unsigned char * data() const noexcept { return ptr_; }
+	constexpr std::size_t size() const noexcept { return size_; }
+	constexpr unsigned char * begin() const noexcept { return ptr_; }
+	constexpr unsigned char * end() const noexcept { return ptr_ + size_; }
+	constexpr unsigned char & operator[](std::size_t i) const noexcept { return ptr_[i]; }
+	constexpr byte_span subspan(std::size_t offset, std::size_t count) const noexcept { return byte_span(ptr_ + offset, count); }
+
+private:
+	unsigned char * ptr_;
+	std::size_t size_;
+};
+#endif
+
+/**
+ * @brief Buffer over a span, e.g. a tx or rx buffer for dartt_sync_t.
+ */
+inline dartt_buffer_t buffer(byte_span s, std::size_t len = 0) noexcept
+{
+	return dartt_buffer_t{s.data(), s.size(), len};
+}
+
+/**
+ * @brief Region over a span.
+ */
+inline dartt_mem_t mem(byte_span s) noexcept
+{
+	return dartt_mem_t{s.data(), s.size()};
+}
+
+/**
+ * @brief Region over a struct, e.g. the ctl or periph copy of a dartt_sync_t.
+ */
+template<class S>
+inline dartt_mem_t mem_of(S & obj) noexcept
+{
+	static_assert(std::is_trivially_copyable<S>::value, "DARTT regions are copied bytewise");
+	return dartt_mem_t{reinterpret_cast<unsigned char *>(&obj), sizeof(S)};
+}
+
+/*
+	Compile-time handle to a member of a DARTT region. Use DARTT_FIELD(Struct, member), which also accepts nested
+	members such as DARTT_FIELD(motor_t, pos[2]) or DARTT_FIELD(motor_t, gains.kp).
+*/
+template<class S, std::size_t Offset, class T>
+struct field
+{
+	static_assert(std::is_trivially_copyable<S>::value, "DARTT regions are copied bytewise");
+	static_assert(Offset % sizeof(uint32_t) == 0, "DARTT fields must be 32 bit aligned");
+	static_assert(Offset / sizeof(uint32_t) < DARTT_INDEX_EXTENDED_BIT, "field index is beyond the extended index range");
+
+	using struct_type = S;
+	using value_type = T;
+	static constexpr std::size_t offset = Offset;
+	static constexpr std::size_t nbytes = sizeof(T);
+	static constexpr uint32_t index = DARTT_INDEX_OF_WORD(Offset / sizeof(uint32_t));	// message index, extended beyond the standard range
+
+	static T & get(S & s) noexcept { return *reinterpret_cast<T *>(reinterpret_cast<unsigned char *>(&s) + Offset); }
+	static const T & get(const S & s) noexcept { return *reinterpret_cast<const T *>(reinterpret_cast<const unsigned char *>(&s) + Offset); }
+};
+
+#define DARTT_FIELD(S, member)	::dartt::field<S, offsetof(S, member), std::remove_cv_t<std::remove_reference_t<decltype(std::declval<S &>().member)>>>
+
+/*
+	Byte range of a region, [offset, offset + nbytes)
+*/
+struct span_t
+{
+	std::size_t offset;
+	std::size_t nbytes;
+};
+
+namespace detail {
+
+template<class F, class... Rest>
+struct first_field { using type = F; };
+
+/*
+	Sort the fields by offset and merge the ones that overlap or touch. A field that ends short of a word boundary
+	is merged with a field starting at the next boundary: the padding in between is transferred along with it.
+*/
+template<std::size_t N>
+struct merged_spans
+{
+	std::array<span_t, N> spans;
+	std::size_t count;
+};
+
+template<std::size_t N>
+constexpr merged_spans<N> merge_spans(std::array<span_t, N> in)
+{
+	for(std::size_t i = 1; i < N; i++)
+	{
+		for(std::size_t j = i; j > 0 && in[j].offset < in[j - 1].offset; j--)
+		{
+			span_t tmp = in[j];
+			in[j] = in[j - 1];
+			in[j - 1] = tmp;
+		}
+	}
+	merged_spans<N> out{};
+	for(std::size_t i = 0; i < N; i++)
+	{
+		if(out.count != 0)
+		{
+			span_t & last = out.spans[out.count - 1];
+			std::size_t last_end = last.offset + last.nbytes;
+			std::size_t last_end_word = (last_end + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+			if(in[i].offset <= last_end_word)
+			{
+				std::size_t end = in[i].offset + in[i].nbytes;
+				if(end > last_end)
+				{
+					last.nbytes = end - last.offset;
+				}
+				continue;
+			}
+		}
+		out.spans[out.count++] = in[i];
+	}
+	return out;
+}
+
+template<class... F>
+struct region
+{
+	static_assert(sizeof...(F) > 0, "at least one field is required");
+	using struct_type = typename first_field<F...>::type::struct_type;
+	static_assert((std::is_same<typename F::struct_type, struct_type>::value && ...), "all fields must belong to the same struct");
+	static constexpr merged_spans<sizeof...(F)> merged = merge_spans(std::array<span_t, sizeof...(F)>{span_t{F::offset, F::nbytes}...});
+};
+
+template<class S>
+inline bool fits(const dartt_sync_t & ds) noexcept
+{
+	return ds.ctl_base.buf != nullptr && ds.ctl_base.size >= sizeof(S) && ds.periph_base.buf != nullptr && ds.periph_base.size >= sizeof(S);
+}
+
+template<class R>
+inline int for_each_span(dartt_sync_t & ds, int (*op)(dartt_mem_t *, dartt_sync_t *)) noexcept
+{
+	if(!fits<typename R::struct_type>(ds))
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	for(std::size_t i = 0; i < R::merged.count; i++)
+	{
+		dartt_mem_t ctl = {ds.ctl_base.buf + R::merged.spans[i].offset, R::merged.spans[i].nbytes};
+		int rc = op(&ctl, &ds);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+} // namespace detail
+
+/**
+ * @brief Contiguous spans covering a list of fields, sorted by offset. Computed at compile time.
+ */
+template<class... F>
+constexpr std::size_t num_spans() noexcept
+{
+	return detail::region<F...>::merged.count;
+}
+
+template<class... F>
+constexpr span_t span(std::size_t i) noexcept
+{
+	return detail::region<F...>::merged.spans[i];
+}
+
+/**
+ * @brief The controller copy of a field.
+ */
+template<class F>
+inline typename F::value_type & ctl(dartt_sync_t & ds) noexcept
+{
+	return F::get(*reinterpret_cast<typename F::struct_type *>(ds.ctl_base.buf));
+}
+
+/**
+ * @brief The shadow copy of a field: the last value read from, or written to and verified on, the peripheral.
+ */
+template<class F>
+inline const typename F::value_type & periph(const dartt_sync_t & ds) noexcept
+{
+	return F::get(*reinterpret_cast<const typename F::struct_type *>(ds.periph_base.buf));
+}
+
+/**
+ * @brief dartt_sync() over the spans covering the fields: write what differs from the shadow copy, then verify.
+ *
+ * @param ds Controller, with ctl_base and periph_base covering the struct of the fields
+ * @return DARTT_PROTOCOL_SUCCESS, DARTT_ERROR_INVALID_ARGUMENT if a region is smaller than the struct, or the first
+ * error of dartt_sync()
+ */
+template<class... F>
+inline int sync(dartt_sync_t & ds) noexcept
+{
+	return detail::for_each_span<detail::region<F...>>(ds, &dartt_sync);
+}
+
+/**
+ * @brief dartt_read_multi() over the spans covering the fields, into the shadow copy.
+ */
+template<class... F>
+inline int read(dartt_sync_t & ds) noexcept
+{
+	return detail::for_each_span<detail::region<F...>>(ds, &dartt_read_multi);
+}
+
+/**
+ * @brief dartt_write_multi() of the controller copy over the spans covering the fields, without verification.
+ */
+template<class... F>
+inline int write(dartt_sync_t & ds) noexcept
+{
+	return detail::for_each_span<detail::region<F...>>(ds, &dartt_write_multi);
+}
+
+/**
+ * @brief Build a write frame for one field with a constant index.
+ */
+template<class F>
+inline int write_frame(unsigned char address, const typename F::value_type & value, serial_message_type_t type, dartt_buffer_t & output) noexcept
+{
+	misc_write_message_t msg = {address, F::index, {const_cast<unsigned char *>(reinterpret_cast<const unsigned char *>(&value)), F::nbytes, F::nbytes}};
+	return dartt_create_write_frame(&msg, type, &output);
+}
+
+/**
+ * @brief Build a read frame for one field with a constant index.
+ */
+template<class F>
+inline int read_frame(unsigned char address, serial_message_type_t type, dartt_buffer_t & output, uint8_t tag = DARTT_TAG_NONE) noexcept
+{
+	static_assert(F::nbytes <= UINT16_MAX, "field too large for one read request");
+	misc_read_message_t msg = {address, F::index, static_cast<uint16_t>(F::nbytes), tag};
+	return dartt_create_read_frame(&msg, type, &output);
+}
+
+} // namespace dartt
+
+#endif
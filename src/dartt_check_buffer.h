@@ -1,3 +1,5 @@
+#ifndef DARTT_CHECK_BUFFER_H
+#define DARTT_CHECK_BUFFER_H
 #include "dartt.h"
 
 
@@ -46,3 +48,5 @@ static inline int check_mem_base(const dartt_mem_t * m)
 	}
 	return DARTT_PROTOCOL_SUCCESS;
 }
+
+#endif
@@ -0,0 +1,174 @@
+
+#include "dartt_cobs.h"
+#include "dartt_check_buffer.h"
+#include "dartt_assert.h"
+
+
+/*
+	Encoder body. in may overlap out, as long as it starts at least DARTT_COBS_HEADROOM(len) bytes after out->buf:
+	the output never runs ahead of the input
+*/
+static int cobs_encode(const unsigned char * in, size_t len, dartt_buffer_t * out)
+{
+	out->len = 0;
+
+	size_t code_idx = 0;	//position of the code byte of the current block
+	size_t o = 1;
+	uint8_t code = 1;
+	for(size_t i = 0; i < len; i++)
+	{
+		if(o >= out->size)
+		{
+			return DARTT_ERROR_MEMORY_OVERRUN;
+		}
+		if(in[i] != 0)
+		{
+			out->buf[o++] = in[i];
+			code++;
+		}
+		if(in[i] == 0 || (code == 0xFF && i + 1 < len))
+		{
+			out->buf[code_idx] = code;	//close the block. A full block at the end of the frame is closed below
+			code_idx = o++;
+			code = 1;
+		}
+	}
+	if(o >= out->size)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	out->buf[code_idx] = code;
+	out->buf[o++] = DARTT_COBS_DELIMITER;
+	out->len = o;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+
+/**
+ * @brief COBS encode a frame and append the frame delimiter.
+ *
+ * @param in Frame to encode. in->len bytes are encoded, and may contain zeros
+ * @param out Buffer to receive the encoded frame. out->len is set to the encoded length including the trailing
+ * DARTT_COBS_DELIMITER. out->size must be at least DARTT_COBS_MAX_FRAME_LEN(in->len) to be sure the frame fits
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_MEMORY_OVERRUN if the encoded frame does not fit in out,
+ * DARTT_ERROR_INVALID_ARGUMENT for invalid buffers
+ */
+int dartt_cobs_encode(const dartt_buffer_t * in, dartt_buffer_t * out)
+{
+	DARTT_ASSERT(in != NULL && out != NULL);
+	DARTT_ASSERT(in->buf != out->buf);	//in place encoding needs headroom, see dartt_cobs_encode_in_place
+	int cb = check_buffer(in);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	cb = check_buffer(out);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	return cobs_encode(in->buf, in->len, out);
+}
+
+/**
+ * @brief COBS encode a frame in place and append the frame delimiter.
+ *
+ * The frame must be a view into dma with at least DARTT_COBS_HEADROOM(frame->len) bytes of headroom, e.g. reserved
+ * with dartt_buffer_reserve(dma, DARTT_COBS_HEADROOM(max_len), DARTT_COBS_TAILROOM, frame). The encoded frame is
+ * written over the headroom and the frame: every byte is written at or before the position it is read from.
+ *
+ * @param dma Buffer the frame was reserved in
+ * @param frame Frame to encode. On success it covers the encoded frame including the trailing DARTT_COBS_DELIMITER
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_MEMORY_OVERRUN if the headroom is short or the encoded frame
+ * runs past the end of dma, DARTT_ERROR_INVALID_ARGUMENT for invalid buffers
+ */
+int dartt_cobs_encode_in_place(const dartt_buffer_t * dma, dartt_buffer_t * frame)
+{
+	DARTT_ASSERT(dma != NULL && frame != NULL);
+	int cb = check_buffer(dma);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	cb = check_buffer(frame);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	size_t head = dartt_buffer_headroom(dma, frame);
+	if(frame->buf != dma->buf + head || head < DARTT_COBS_HEADROOM(frame->len))
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	size_t start = head - DARTT_COBS_HEADROOM(frame->len);
+	dartt_buffer_t out = {.buf = dma->buf + start, .size = dma->size - start, .len = 0};
+	int rc = cobs_encode(frame->buf, frame->len, &out);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	*frame = out;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Decode a COBS encoded frame.
+ *
+ * @param in Encoded frame. Decoding stops at the first DARTT_COBS_DELIMITER or at in->len, so the trailing
+ * delimiter is optional
+ * @param out Buffer to receive the decoded frame. out->len is set to the decoded length. The decoded frame is
+ * never longer than the encoded frame
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_MALFORMED_MESSAGE if a block is truncated by the end of
+ * the frame, DARTT_ERROR_MEMORY_OVERRUN if the decoded frame does not fit in out,
+ * DARTT_ERROR_INVALID_ARGUMENT for invalid buffers
+ */
+int dartt_cobs_decode(const dartt_buffer_t * in, dartt_buffer_t * out)
+{
+	DARTT_ASSERT(in != NULL && out != NULL);
+	int cb = check_buffer(in);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	cb = check_buffer(out);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	out->len = 0;
+
+	size_t end = 0;
+	while(end < in->len && in->buf[end] != DARTT_COBS_DELIMITER)
+	{
+		end++;
+	}
+
+	size_t i = 0;
+	size_t o = 0;
+	while(i < end)
+	{
+		uint8_t code = in->buf[i++];
+		if(i + code - 1 > end)
+		{
+			return DARTT_ERROR_MALFORMED_MESSAGE;	//block runs past the delimiter
+		}
+		for(uint8_t j = 1; j < code; j++)
+		{
+			if(o >= out->size)
+			{
+				return DARTT_ERROR_MEMORY_OVERRUN;
+			}
+			out->buf[o++] = in->buf[i++];
+		}
+		if(code != 0xFF && i < end)
+		{
+			if(o >= out->size)
+			{
+				return DARTT_ERROR_MEMORY_OVERRUN;
+			}
+			out->buf[o++] = 0;	//every block except full blocks and the last one ends in an implicit zero
+		}
+	}
+	out->len = o;
+	return DARTT_PROTOCOL_SUCCESS;
+}
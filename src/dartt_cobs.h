@@ -0,0 +1,31 @@
+#ifndef DARTT_COBS_H
+#define DARTT_COBS_H
+#include <stdint.h>
+#include <stddef.h>
+#include "dartt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+	Consistent Overhead Byte Stuffing. Encoded frames contain no zero bytes, so a single 0x00 delimits frames on
+	byte streams (UART, RS485, ptys). Overhead is one byte per started 254 byte block, plus the delimiter.
+*/
+#define DARTT_COBS_DELIMITER				0x00
+#define DARTT_COBS_MAX_ENCODED_LEN(len)		((len) + (len)/254 + 1)	//worst case encoded length of len bytes, without the delimiter
+#define DARTT_COBS_MAX_FRAME_LEN(len)		(DARTT_COBS_MAX_ENCODED_LEN(len) + 1)	//worst case encoded length of len bytes, with the delimiter
+#define DARTT_COBS_HEADROOM(len)			((len)/254 + 1)	//headroom in front of a frame of len bytes for dartt_cobs_encode_in_place
+#define DARTT_COBS_TAILROOM					1	//room behind the frame for the delimiter
+
+int dartt_cobs_encode(const dartt_buffer_t * in, dartt_buffer_t * out);
+int dartt_cobs_encode_in_place(const dartt_buffer_t * dma, dartt_buffer_t * frame);
+int dartt_cobs_decode(const dartt_buffer_t * in, dartt_buffer_t * out);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
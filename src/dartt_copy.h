@@ -0,0 +1,58 @@
+#ifndef DARTT_COPY_H
+#define DARTT_COPY_H
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+	Copy primitive for payloads, read replies and regions. Source and destination must not overlap.
+
+	By default this is memcpy, which hosted C libraries implement with wide aligned moves. Define DARTT_COPY_WORDS
+	for toolchains whose memcpy goes byte by byte (e.g. newlib-nano, which is built for size): the copy then moves
+	32 bit words and finishes the tail byte by byte. On cores with unaligned word access (Cortex-M3 and up, x86)
+	every copy goes by words, including payloads at the odd offsets of serial frames. Elsewhere (Cortex-M0) only
+	copies with both ends word aligned do, which covers regions and read replies since DARTT offsets are word
+	aligned. Loop distribution is disabled for it, or GCC turns the loops back into memcpy calls.
+*/
+#if defined(DARTT_COPY_WORDS) && defined(__GNUC__)
+#if defined(__ARM_FEATURE_UNALIGNED) || defined(__x86_64__) || defined(__i386__)
+#define DARTT_COPY_UNALIGNED
+typedef uint32_t __attribute__((__may_alias__, __aligned__(1))) dartt_copy_word_t;
+#else
+typedef uint32_t __attribute__((__may_alias__)) dartt_copy_word_t;
+#endif
+
+#if !defined(__clang__)
+__attribute__((optimize("no-tree-loop-distribute-patterns")))
+#endif
+static inline void dartt_copy(unsigned char * dst, const unsigned char * src, size_t n)
+{
+#ifndef DARTT_COPY_UNALIGNED
+	if((((uintptr_t)dst | (uintptr_t)src) & (sizeof(uint32_t) - 1)) == 0)
+#endif
+	{
+		dartt_copy_word_t * wdst = (dartt_copy_word_t *)dst;
+		const dartt_copy_word_t * wsrc = (const dartt_copy_word_t *)src;
+		for(; n >= sizeof(uint32_t); n -= sizeof(uint32_t))
+		{
+			*wdst++ = *wsrc++;
+		}
+		dst = (unsigned char *)wdst;
+		src = (const unsigned char *)wsrc;
+	}
+	for(size_t i = 0; i < n; i++)
+	{
+		dst[i] = src[i];
+	}
+}
+#else
+static inline void dartt_copy(unsigned char * dst, const unsigned char * src, size_t n)
+{
+	if(n != 0)
+	{
+		memcpy(dst, src, n);
+	}
+}
+#endif
+
+#endif
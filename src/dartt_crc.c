@@ -1,15 +1,15 @@
 #include <stdint.h>
 #include <string.h>
+#include "dartt_crc.h"
 
 
 #ifdef NON_LUT_CRC      //define if memory is highly constrained
 /*
-    Calculate the CRC16 checksum of a message using bit-by-bit method.
+    Continue a CRC16 checksum over size more bytes using bit-by-bit method.
     Uses CRC-16-ANSI polynomial 0x8005 (reversed 0xA001).
  */
-uint16_t dartt_crc16(const unsigned char * arr, size_t size)
+uint16_t dartt_crc16_update(uint16_t crc, const unsigned char * arr, size_t size)
 {
-    uint16_t crc = 0xFFFF;
     for(int i = 0; i < size; i++)
     {
         crc ^= ((uint16_t)arr[i]);
@@ -70,13 +70,12 @@ static const uint16_t crc16_table[256] =
 };
 
 /*
-    Calculate the CRC16 checksum of a message using lookup table.
+    Continue a CRC16 checksum over size more bytes using lookup table.
     Much faster than bit-by-bit method for large data.
     Uses CRC-16-ANSI polynomial 0x8005 (reversed 0xA001).
  */
-uint16_t dartt_crc16(const unsigned char * arr, size_t size)
+uint16_t dartt_crc16_update(uint16_t crc, const unsigned char * arr, size_t size)
 {
-    uint16_t crc = 0xFFFF;
     for(int i = 0; i < size; i++)
     {
         uint8_t tbl_idx = (crc ^ arr[i]) & 0xFF;
@@ -88,18 +87,67 @@ uint16_t dartt_crc16(const unsigned char * arr, size_t size)
 
 #endif
 
+/*
+    Calculate the CRC16 checksum of a message in software, regardless of the installed backend
+ */
+uint16_t dartt_crc16(const unsigned char * arr, size_t size)
+{
+    return dartt_crc16_update(DARTT_CRC16_INIT, arr, size);
+}
+
+static const dartt_crc16_backend_t * crc16_backend = NULL;
+
+/**
+ * @brief Install the CRC-16 backend used for frame checksums.
+ *
+ * @param backend Backend with all three callbacks set, or NULL to go back to the software dartt_crc16. Must stay valid
+ *                while installed
+ * @note Not synchronized: install the backend at startup, before any frame is built or parsed.
+ */
+void dartt_crc16_set_backend(const dartt_crc16_backend_t * backend)
+{
+    crc16_backend = backend;
+}
+
+/**
+ * @brief CRC-16 of a frame, through the installed backend or dartt_crc16 if there is none.
+ */
+uint16_t dartt_frame_crc16(const unsigned char * arr, size_t size)
+{
+    const dartt_crc16_backend_t * backend = crc16_backend;
+    if(backend == NULL)
+    {
+        return dartt_crc16(arr, size);
+    }
+    (*(backend->init))(backend->context);
+    (*(backend->update))(backend->context, arr, size);
+    return (*(backend->final))(backend->context);
+}
+
 /*
 As-is crc32 algo
 CRC-32/ISO-HDLC, no LUT
 */
 uint32_t dartt_crc32(const unsigned char *message, size_t len)
+{
+   return dartt_crc32_update(0, message, len);
+}
+
+/**
+ * @brief Continue a CRC32 over more data.
+ *
+ * @param crc CRC32 of the data so far, 0 for none. The result of dartt_crc32 or of a previous call
+ * @return CRC32 of the data so far followed by message, so that
+ *         dartt_crc32_update(dartt_crc32(a, n), b, m) equals dartt_crc32 of a and b back to back
+ */
+uint32_t dartt_crc32_update(uint32_t crc, const unsigned char *message, size_t len)
 {
    size_t i;
    int j;
-   uint32_t byte, crc, mask;
+   uint32_t byte, mask;
 
    i = 0;
-   crc = 0xFFFFFFFF;
+   crc = ~crc;
    while (i < len)
    {
 		byte = (uint32_t)message[i];            // Get next byte.
@@ -8,13 +8,32 @@
 extern "C" {
 #endif
 
+#define DARTT_CRC16_INIT	0xFFFF	//initial value of the frame CRC. CRC-16/MODBUS: polynomial 0x8005 reflected (0xA001), no final xor
+
+/*
+	Pluggable CRC-16 backend for the frame layer. append_crc and validate_crc (and through them every frame
+	builder and parser) compute the frame CRC through the installed backend, so firmware can route it through a CRC
+	peripheral or DMA. The backend must compute the same CRC as dartt_crc16: on STM32, CRC unit with polynomial
+	0x8005, 16 bit polynomial size, initial value 0xFFFF, input reversed by byte, output reversed.
+*/
+typedef struct dartt_crc16_backend_t
+{
+		void (*init)(void * context);		// Start a new CRC at DARTT_CRC16_INIT
+		void (*update)(void * context, const unsigned char * buf, size_t size);	// Feed size bytes. Called once per frame
+		uint16_t (*final)(void * context);	// Return the CRC of the bytes fed since init
+		void * context;		//OPTIONAL handle passed to the callbacks - i.e. CRC peripheral handle. Set to NULL if not needed
+}dartt_crc16_backend_t;
 
 uint16_t dartt_crc16(const unsigned char * arr, size_t size);
+uint16_t dartt_crc16_update(uint16_t crc, const unsigned char * arr, size_t size);
 uint32_t dartt_crc32(const unsigned char * message, size_t len);
+uint32_t dartt_crc32_update(uint32_t crc, const unsigned char * message, size_t len);
+
+void dartt_crc16_set_backend(const dartt_crc16_backend_t * backend);
+uint16_t dartt_frame_crc16(const unsigned char * arr, size_t size);
 
 #ifdef __cplusplus
 }
 #endif
 
 #endif
-
@@ -0,0 +1,282 @@
+#include "dartt_flash.h"
+#include "dartt_crc.h"
+#include "dartt_copy.h"
+#include "dartt_assert.h"
+#include <string.h>
+
+
+/**
+ * @brief Initialize a flash control block in the peripheral memory map.
+ *
+ * @param ctl Control block. The window_size bytes following it in the memory block are the window
+ * @param window_size Size of the window in bytes
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_INVALID_ARGUMENT if window_size is 0 or not a multiple of 4
+ *
+ * @note The control block must be word aligned within the memory block, and the memory block must hold the whole
+ * window after it. The status words should be read only for the controller (DARTT_ACCESS_RO).
+ * @note Serve the region with a dartt_periph_t without a staging block: the status words are read from the live
+ * block, and with staging the hook would update the staging copy instead.
+ */
+int dartt_flash_init(dartt_flash_ctl_t * ctl, size_t window_size)
+{
+	if(ctl == NULL || window_size == 0 || (window_size % sizeof(uint32_t)) != 0 || window_size > UINT32_MAX)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	memset(ctl, 0, sizeof(dartt_flash_ctl_t));
+	ctl->window_size = (uint32_t)window_size;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+static int flash_erase(dartt_flash_t * flash, dartt_flash_ctl_t * ctl)
+{
+	if(ctl->len > flash->capacity)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	ctl->written = 0;	//nothing valid is left from here on, even if the erase fails halfway
+	ctl->image_crc = 0;
+	return (*(flash->backend->erase))(flash->backend->context, 0, ctl->len);
+}
+
+/*
+	Windows are programmed in order, and each one only after its CRC32 matches: a window corrupted on the way, or
+	only partly written, never reaches the flash.
+*/
+static int flash_program(dartt_flash_t * flash, dartt_flash_ctl_t * ctl)
+{
+	const unsigned char * window = (const unsigned char *)(ctl + 1);
+	if(ctl->len == 0 || ctl->len > ctl->window_size || ctl->offset != ctl->written)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	if((size_t)ctl->offset + ctl->len > flash->capacity)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	if(dartt_crc32(window, ctl->len) != ctl->crc)
+	{
+		return DARTT_ERROR_SYNC_MISMATCH;
+	}
+	int rc = (*(flash->backend->program))(flash->backend->context, ctl->offset, window, ctl->len);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	ctl->written += ctl->len;
+	ctl->image_crc = dartt_crc32_update(ctl->image_crc, window, ctl->len);
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+static int flash_commit(dartt_flash_t * flash, dartt_flash_ctl_t * ctl)
+{
+	if(ctl->len != ctl->written)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	if(ctl->crc != ctl->image_crc)
+	{
+		return DARTT_ERROR_SYNC_MISMATCH;
+	}
+	int rc = (*(flash->backend->commit))(flash->backend->context, ctl->len, ctl->crc);
+	if(rc == DARTT_PROTOCOL_SUCCESS)
+	{
+		flash->commits++;
+	}
+	return rc;
+}
+
+/**
+ * @brief Run the command in a flash control block, if it has not run yet.
+ *
+ * Called by dartt_flash_hook when the command word is written. Firmware that must not block the communication
+ * context (e.g. for a long erase) can register its own hook that defers this call to the main loop; the controller
+ * polls the status words until the command is acknowledged.
+ *
+ * @param flash Flash context with the backend
+ * @param ctl Control block, followed by its window
+ * @return The result of the command, also stored in ctl->status. DARTT_PROTOCOL_SUCCESS if there was nothing to run
+ *
+ * @note A command runs once per seq: if seq equals ack, the command was already run and is ignored.
+ */
+int dartt_flash_run(dartt_flash_t * flash, dartt_flash_ctl_t * ctl)
+{
+	DARTT_ASSERT(flash != NULL && ctl != NULL);
+	if(ctl->command == DARTT_FLASH_CMD_NONE || ctl->seq == ctl->ack)
+	{
+		return DARTT_PROTOCOL_SUCCESS;
+	}
+	int rc;
+	if(flash->backend == NULL || flash->backend->erase == NULL || flash->backend->program == NULL || flash->backend->commit == NULL)
+	{
+		rc = DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	else if(ctl->command == DARTT_FLASH_CMD_ERASE)
+	{
+		rc = flash_erase(flash, ctl);
+	}
+	else if(ctl->command == DARTT_FLASH_CMD_PROGRAM)
+	{
+		rc = flash_program(flash, ctl);
+	}
+	else if(ctl->command == DARTT_FLASH_CMD_COMMIT)
+	{
+		rc = flash_commit(flash, ctl);
+	}
+	else
+	{
+		rc = DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	ctl->status = rc;
+	ctl->ack = ctl->seq;	//acknowledged last, so the controller never reads a stale status with a current ack
+	return rc;
+}
+
+/**
+ * @brief Write notification callback for the command word of a flash control block. Register it with DARTT_FLASH_HOOK.
+ *
+ * @param field Pointer to the command word, in the block the write landed in
+ * @param user_context The dartt_flash_t of the region
+ */
+void dartt_flash_hook(unsigned char * field, uint32_t index, size_t nbytes, void * user_context)
+{
+	(void)index;
+	if(nbytes != sizeof(uint32_t) || user_context == NULL)
+	{
+		return;	//the command word is only complete once all of it was written
+	}
+	dartt_flash_ctl_t * ctl = (dartt_flash_ctl_t *)(field - offsetof(dartt_flash_ctl_t, command));
+	dartt_flash_run((dartt_flash_t *)user_context, ctl);
+}
+
+/*
+	Controller side. The control block is copied in and out of the ctl and shadow copies with dartt_copy, since
+	ctl_base and periph_base need not be word aligned in host memory.
+*/
+static const unsigned char * shadow_of(const dartt_mem_t * region, const dartt_sync_t * psync)
+{
+	return psync->periph_base.buf + (region->buf - psync->ctl_base.buf);
+}
+
+static int read_status(dartt_mem_t * region, dartt_sync_t * psync, dartt_flash_ctl_t * status)
+{
+	dartt_mem_t span = {region->buf, DARTT_FLASH_STATUS_WORDS*sizeof(uint32_t)};
+	int rc = dartt_read_multi(&span, psync);
+	if(rc == DARTT_PROTOCOL_SUCCESS)
+	{
+		dartt_copy((unsigned char *)status, shadow_of(region, psync), sizeof(dartt_flash_ctl_t));
+	}
+	return rc;
+}
+
+/*
+	Write the command words in one span, command last, then read the status words until the command is acknowledged.
+	The command is written again before every read: the peripheral runs each seq once, so the repeats are harmless and
+	a lost command frame is recovered.
+*/
+static int run_command(dartt_mem_t * region, dartt_sync_t * psync, dartt_flash_ctl_t * status, uint32_t command, uint32_t offset, uint32_t len, uint32_t crc)
+{
+	dartt_flash_ctl_t ctl = *status;
+	ctl.offset = offset;
+	ctl.len = len;
+	ctl.crc = crc;
+	ctl.seq = status->ack + 1;
+	ctl.command = command;
+	size_t first = offsetof(dartt_flash_ctl_t, offset);
+	dartt_copy(region->buf + first, (const unsigned char *)&ctl + first, sizeof(dartt_flash_ctl_t) - first);
+	dartt_mem_t args = {region->buf + first, sizeof(dartt_flash_ctl_t) - first};
+	for(int poll = 0; poll < DARTT_FLASH_MAX_POLLS; poll++)
+	{
+		int rc = dartt_write_multi(&args, psync);
+		if(rc == DARTT_PROTOCOL_SUCCESS)
+		{
+			rc = read_status(region, psync, status);
+		}
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
+		if(status->ack == ctl.seq)
+		{
+			return status->status;
+		}
+	}
+	return DARTT_ERROR_TIMEOUT;
+}
+
+/**
+ * @brief Upload an image into the flash staging region of a peripheral, and commit it.
+ *
+ * Erases room for the image, then sends it one window at a time: each window is written with dartt_bulk_write
+ * (windowed frames, acknowledged and repaired with CRC32 queries), then programmed with a sequenced command that
+ * the peripheral checks against the CRC32 of the window. Finally the image is committed with its CRC32, which the
+ * peripheral compares with the CRC32 it streamed over every programmed window.
+ *
+ * @param region Region within ctl_base covering the control block and its window, as laid out on the peripheral.
+ *               Must start on a 32 bit boundary. Windows are limited to the smaller of the peripheral window_size
+ *               and the room left in region after the control block
+ * @param psync Sync structure, with ctl_base and periph_base covering region. Its retry policy applies to every frame
+ * @param image Image to upload
+ * @param len Image size in bytes. Must not be 0
+ * @return DARTT_PROTOCOL_SUCCESS once the image is committed. The error code reported by the peripheral for a
+ *         rejected command (e.g. DARTT_ERROR_MEMORY_OVERRUN if the image does not fit), DARTT_ERROR_TIMEOUT if a command
+ *         is not acknowledged after DARTT_FLASH_MAX_POLLS status reads, or the first transfer error otherwise
+ * @note An upload that fails part way leaves the previous committed image in place on backends that only replace it
+ * on commit. Start over from the erase to retry.
+ */
+int dartt_flash_upload(dartt_mem_t * region, dartt_sync_t * psync, const unsigned char * image, size_t len)
+{
+	DARTT_ASSERT(region != NULL && psync != NULL);
+	if(image == NULL || len == 0 || len > UINT32_MAX || region->buf == NULL || region->size <= sizeof(dartt_flash_ctl_t))
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	if(psync->ctl_base.buf == NULL || region->buf < psync->ctl_base.buf || region->buf + region->size > psync->ctl_base.buf + psync->ctl_base.size
+		|| psync->periph_base.buf == NULL || psync->periph_base.size != psync->ctl_base.size)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+
+	dartt_flash_ctl_t status;
+	int rc = read_status(region, psync, &status);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	size_t window = region->size - sizeof(dartt_flash_ctl_t);
+	if(status.window_size < window)
+	{
+		window = status.window_size;
+	}
+	if(window == 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+
+	rc = run_command(region, psync, &status, DARTT_FLASH_CMD_ERASE, 0, (uint32_t)len, 0);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	unsigned char * window_buf = region->buf + sizeof(dartt_flash_ctl_t);
+	uint32_t image_crc = 0;
+	for(size_t offset = 0; offset < len; offset += window)
+	{
+		size_t n = (len - offset < window) ? len - offset : window;
+		dartt_copy(window_buf, image + offset, n);
+		dartt_mem_t span = {window_buf, n};
+		rc = dartt_bulk_write(&span, psync);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
+		uint32_t window_crc = dartt_crc32(window_buf, n);
+		image_crc = dartt_crc32_update(image_crc, window_buf, n);
+		rc = run_command(region, psync, &status, DARTT_FLASH_CMD_PROGRAM, (uint32_t)offset, (uint32_t)n, window_crc);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
+	}
+	return run_command(region, psync, &status, DARTT_FLASH_CMD_COMMIT, 0, (uint32_t)len, image_crc);
+}
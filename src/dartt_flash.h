@@ -0,0 +1,87 @@
+#ifndef DARTT_FLASH_H
+#define DARTT_FLASH_H
+#include <stdint.h>
+#include <stddef.h>
+#include "dartt.h"
+#include "dartt_periph.h"
+#include "dartt_sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#ifndef DARTT_FLASH_MAX_POLLS
+#define DARTT_FLASH_MAX_POLLS	100	//status reads dartt_flash_upload makes before giving up on a command that was not acknowledged
+#endif
+
+/*
+	Flash staging region. A control block placed in the peripheral memory map, followed by a window of window_size
+	bytes. The controller writes a window of the image, then writes the command words in one go: command is the last
+	word, so it is only seen once offset, len, crc and seq are in place. A write hook on the command word
+	(DARTT_FLASH_HOOK) runs the command on the flash backend and reports the result in the status words.
+
+	Commands are sequenced: a command only runs if its seq differs from the last acknowledged one, so a command frame
+	received twice is not applied twice. Windows must be programmed in order, and each one is checked against its
+	CRC32 before it is programmed. image_crc is the CRC32 of everything programmed since the last erase, which commit
+	compares with the CRC32 of the whole image.
+*/
+#define DARTT_FLASH_CMD_NONE		0
+#define DARTT_FLASH_CMD_ERASE		1	//erase len bytes from offset 0, the size of the image to come
+#define DARTT_FLASH_CMD_PROGRAM		2	//program len bytes of the window at image offset, which must equal written. crc is the CRC32 of the window
+#define DARTT_FLASH_CMD_COMMIT		3	//mark the image of len bytes valid. crc is the CRC32 of the whole image
+
+typedef struct dartt_flash_ctl_t
+{
+		uint32_t window_size;		// Peripheral: bytes in the window following the control block
+		int32_t status;				// Peripheral: result of the last command, DARTT_PROTOCOL_SUCCESS or an error code
+		uint32_t ack;				// Peripheral: seq of the last command run
+		uint32_t written;			// Peripheral: image bytes programmed since the last erase
+		uint32_t image_crc;			// Peripheral: CRC32 of the image bytes programmed since the last erase
+		uint32_t offset;			// Controller: image byte offset of the window
+		uint32_t len;				// Controller: bytes to erase, program or commit
+		uint32_t crc;				// Controller: CRC32 of the window (program) or of the image (commit)
+		uint32_t seq;				// Controller: sequence number of the command, different from ack
+		uint32_t command;			// Controller: DARTT_FLASH_CMD_*. Written last
+}dartt_flash_ctl_t;
+
+#define DARTT_FLASH_STATUS_WORDS	5	//window_size to image_crc, read by the controller after each command
+#define DARTT_FLASH_COMMAND_WORD	(offsetof(dartt_flash_ctl_t, command)/sizeof(uint32_t))	//word of the command, relative to the control block
+
+/*
+	Flash backend. Offsets are relative to the start of the image slot. Each callback returns DARTT_PROTOCOL_SUCCESS,
+	or an error code that is reported to the controller in status.
+*/
+typedef struct dartt_flash_backend_t
+{
+		int (*erase)(void * context, uint32_t offset, size_t len);	// Erase at least [offset, offset + len)
+		int (*program)(void * context, uint32_t offset, const unsigned char * buf, size_t len);	// Program erased bytes
+		int (*commit)(void * context, size_t len, uint32_t crc);	// Mark the image valid, e.g. write its header or swap slots
+		void * context;		//OPTIONAL handle passed to the callbacks - i.e. flash driver or file. Set to NULL if not needed
+}dartt_flash_backend_t;
+
+typedef struct dartt_flash_t
+{
+		const dartt_flash_backend_t * backend;	// Flash backend. Must stay valid while the region is in use
+		size_t capacity;			// Size of the image slot in bytes. Larger images are rejected on erase
+		uint32_t commits;			// Number of images committed since initialization
+}dartt_flash_t;
+
+/*
+	Write notification entry for a control block at word first_word of the memory block. Add it to the hook table of
+	the dartt_periph_t serving the region.
+*/
+#define DARTT_FLASH_HOOK(first_word, flash)	{(uint32_t)((first_word) + DARTT_FLASH_COMMAND_WORD), (uint32_t)((first_word) + DARTT_FLASH_COMMAND_WORD + 1), &dartt_flash_hook, (flash)}
+
+int dartt_flash_init(dartt_flash_ctl_t * ctl, size_t window_size);
+int dartt_flash_run(dartt_flash_t * flash, dartt_flash_ctl_t * ctl);
+void dartt_flash_hook(unsigned char * field, uint32_t index, size_t nbytes, void * user_context);
+
+int dartt_flash_upload(dartt_mem_t * region, dartt_sync_t * psync, const unsigned char * image, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
@@ -0,0 +1,444 @@
+#ifndef DARTT_INLINE_H
+#define DARTT_INLINE_H
+#include <stdint.h>
+#include <stddef.h>
+#include "dartt.h"
+#include "dartt_crc.h"
+#include "dartt_check_buffer.h"
+#include "dartt_copy.h"
+#include "dartt_assert.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+	Inline frame builders and parsers.
+
+	The generic functions in dartt.c take the message type as an argument and branch on it on every call. Firmware
+	normally uses one message type for its whole life, so this header provides the same functions with the type
+	fixed in the name:
+
+		dartt_rw_overhead_<t>()
+		dartt_create_write_frame_<t>(msg, output)
+		dartt_create_read_frame_<t>(msg, output)
+		dartt_frame_to_payload_<t>(ser_msg, pld_mode, pld)
+		dartt_parse_general_message_<t>(pld_msg, mem_base, reply)
+
+	with <t> one of serial (TYPE_SERIAL_MESSAGE), addr (TYPE_ADDR_MESSAGE) or addr_crc (TYPE_ADDR_CRC_MESSAGE).
+	They are static inline wrappers around the *_inline bodies below with a constant type, so the compiler drops the
+	branches for the other types and folds the overheads. Behaviour and return codes match the generic functions.
+
+	To fix the type of the generic functions instead (including their use inside dartt_sync.c and dartt_periph.c),
+	build dartt.c with DARTT_FIXED_MSG_TYPE defined to the type. See dartt.c.
+*/
+
+int check_write_args(misc_write_message_t * msg, serial_message_type_t type, dartt_buffer_t * output);
+int check_read_args(misc_read_message_t * msg, serial_message_type_t type, dartt_buffer_t * output);
+
+/*
+	Write the index word of a frame at buf, followed by the word index for extended frames. rw_bit is
+	READ_WRITE_BITMASK or 0. Returns the number of bytes written, DARTT_INDEX_NUM_BYTES(index)
+*/
+static inline size_t dartt_load_index_inline(unsigned char * buf, uint32_t index, uint16_t rw_bit)
+{
+	uint16_t rw_index = DARTT_INDEX_IS_EXTENDED(index) ? DARTT_INDEX_EXTENDED : (uint16_t)(index & (~READ_WRITE_BITMASK));
+	rw_index |= rw_bit;
+	buf[0] = (unsigned char)(rw_index & 0x00FF);
+	buf[1] = (unsigned char)((rw_index & 0xFF00) >> 8);
+	if(!DARTT_INDEX_IS_EXTENDED(index))
+	{
+		return NUM_BYTES_INDEX;
+	}
+	uint32_t word = DARTT_INDEX_WORD(index);
+	buf[2] = (unsigned char)(word & 0xFF);
+	buf[3] = (unsigned char)((word >> 8) & 0xFF);
+	buf[4] = (unsigned char)((word >> 16) & 0xFF);
+	buf[5] = (unsigned char)((word >> 24) & 0xFF);
+	return NUM_BYTES_INDEX + NUM_BYTES_INDEX_EXTENDED;
+}
+
+/*
+	Message indices without DARTT_INDEX_EXTENDED_BIT must fit the 15 bits of a standard index word
+*/
+static inline int dartt_check_index_inline(uint32_t index)
+{
+	if(!DARTT_INDEX_IS_EXTENDED(index) && index > (uint32_t)(~READ_WRITE_BITMASK & 0xFFFF))
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Body of dartt_rw_overhead().
+ */
+static inline size_t dartt_rw_overhead_inline(serial_message_type_t type)
+{
+	size_t overhead = NUM_BYTES_INDEX;
+	if(type == TYPE_SERIAL_MESSAGE)
+	{
+		overhead += NUM_BYTES_ADDRESS + NUM_BYTES_CHECKSUM;
+	}
+	else if(type == TYPE_ADDR_MESSAGE)
+	{
+		overhead += NUM_BYTES_CHECKSUM;
+	}
+	else if (type != TYPE_ADDR_CRC_MESSAGE)
+	{
+		overhead = 0;
+	}
+	return overhead;
+}
+
+/**
+ * @brief Body of dartt_create_write_frame().
+ */
+static inline int dartt_create_write_frame_inline(misc_write_message_t * msg, serial_message_type_t type, dartt_buffer_t * output)
+{
+    DARTT_ASSERT(check_write_args(msg,type,output) == DARTT_PROTOCOL_SUCCESS);  //assert to save on runtime execution
+    int cb = check_buffer(output);
+    if(cb != DARTT_PROTOCOL_SUCCESS)
+    {
+        return cb;
+    }
+    //memory overrun guards, as in check_write_lengths(). The payload length is not constant, so these stay runtime checks
+    size_t overhead = dartt_rw_overhead_inline(type);
+    if(msg->payload.len == 0 || overhead == 0 || dartt_check_index_inline(msg->index) != DARTT_PROTOCOL_SUCCESS)
+    {
+        return DARTT_ERROR_INVALID_ARGUMENT;
+    }
+    overhead += DARTT_INDEX_NUM_BYTES(msg->index) - NUM_BYTES_INDEX;
+    if(msg->payload.len + overhead > output->size)
+    {
+        return DARTT_ERROR_MEMORY_OVERRUN;
+    }
+
+    //prepare the serial buffer
+    output->len = 0;
+    if(type == TYPE_SERIAL_MESSAGE)
+    {
+        output->buf[output->len++] = msg->address;
+    }
+    output->len += dartt_load_index_inline(output->buf + output->len, msg->index, 0);   //MSB = 0 for write, low 15 for index
+    dartt_copy(output->buf + output->len, msg->payload.buf, msg->payload.len);
+    output->len += msg->payload.len;
+    if(type == TYPE_SERIAL_MESSAGE || type == TYPE_ADDR_MESSAGE)
+    {
+        uint16_t crc = dartt_frame_crc16(output->buf, output->len);
+        output->buf[output->len++] = (unsigned char)(crc & 0x00FF);
+        output->buf[output->len++] = (unsigned char)((crc & 0xFF00) >> 8);
+    }
+    return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Body of dartt_create_read_frame().
+ */
+static inline int dartt_create_read_frame_inline(misc_read_message_t * msg, serial_message_type_t type, dartt_buffer_t * output)
+{
+    DARTT_ASSERT(check_read_args(msg,type,output) == DARTT_PROTOCOL_SUCCESS);
+	int rc = check_buffer(output);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+
+	rc = dartt_check_index_inline(msg->index);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	size_t nb_tag = (msg->tag != DARTT_TAG_NONE) ? NUM_BYTES_TAG : 0;
+	size_t nb_index_ext = DARTT_INDEX_NUM_BYTES(msg->index) - NUM_BYTES_INDEX;
+	if(output->size < dartt_rw_overhead_inline(type) + nb_index_ext + NUM_BYTES_NUMWORDS_READREQUEST + nb_tag)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+
+    output->len = 0;
+    if(type == TYPE_SERIAL_MESSAGE)
+    {
+        output->buf[output->len++] = msg->address;
+    }
+    output->len += dartt_load_index_inline(output->buf + output->len, msg->index, READ_WRITE_BITMASK);
+    output->buf[output->len++] = (unsigned char)(msg->num_bytes & 0x00FF);
+    output->buf[output->len++] = (unsigned char)((msg->num_bytes & 0xFF00) >> 8);
+    if(nb_tag != 0)
+    {
+        output->buf[output->len++] = msg->tag;
+    }
+    if(type == TYPE_SERIAL_MESSAGE || type == TYPE_ADDR_MESSAGE)
+    {
+        uint16_t crc = dartt_frame_crc16(output->buf, output->len);
+        output->buf[output->len++] = (unsigned char)(crc & 0x00FF);
+        output->buf[output->len++] = (unsigned char)((crc & 0xFF00) >> 8);
+    }
+    return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Body of dartt_frame_to_payload().
+ */
+static inline int dartt_frame_to_payload_inline(dartt_buffer_t * ser_msg, serial_message_type_t type, payload_mode_t pld_mode, payload_layer_msg_t * pld)
+{
+    DARTT_ASSERT(pld != NULL);
+
+	//check for payload argument validity
+	if(pld_mode != PAYLOAD_ALIAS)
+	{
+		int cb = check_buffer(&pld->msg);
+		if(cb != DARTT_PROTOCOL_SUCCESS)
+		{
+			return cb;
+		}
+	}
+
+	int cb = check_buffer(ser_msg);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+
+	//pre-flight length check
+	if(ser_msg->len <= dartt_rw_overhead_inline(type))
+	{
+		return DARTT_ERROR_MALFORMED_MESSAGE;
+	}
+
+	size_t head = 0;
+	size_t tail = 0;
+	if(type == TYPE_SERIAL_MESSAGE)
+	{
+		int rc = validate_crc(ser_msg);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;	//checksum must match
+		}
+
+		//extract address
+		pld->address = ser_msg->buf[head++];
+		tail = NUM_BYTES_CHECKSUM;
+	}
+	else if(type == TYPE_ADDR_MESSAGE)
+	{
+		int rc = validate_crc(ser_msg);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;	//checksum must match
+		}
+		tail = NUM_BYTES_CHECKSUM;
+	}
+	else if (type != TYPE_ADDR_CRC_MESSAGE)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+
+	//extract rw_bit and index_arg, and advance head to truncate the rw_index header off the message
+	uint16_t rw_index = 0;
+    rw_index |= (uint16_t)(ser_msg->buf[head++]);
+    rw_index |= (((uint16_t)(ser_msg->buf[head++])) << 8);
+    pld->rw_bit = rw_index & READ_WRITE_BITMASK;  //omit the shift and perform zero comparison for speed
+    pld->index_arg = rw_index & (~READ_WRITE_BITMASK);
+    if(pld->index_arg == DARTT_INDEX_EXTENDED)
+    {
+        if(ser_msg->len <= dartt_rw_overhead_inline(type) + NUM_BYTES_INDEX_EXTENDED)
+        {
+            return DARTT_ERROR_MALFORMED_MESSAGE;
+        }
+        uint32_t word = 0;
+        word |= (uint32_t)(ser_msg->buf[head++]);
+        word |= ((uint32_t)(ser_msg->buf[head++])) << 8;
+        word |= ((uint32_t)(ser_msg->buf[head++])) << 16;
+        word |= ((uint32_t)(ser_msg->buf[head++])) << 24;
+        pld->index_arg = DARTT_INDEX_WORD(word) | DARTT_INDEX_EXTENDED_BIT;
+    }
+
+	if(pld_mode == PAYLOAD_ALIAS)	//Use pointer arithmetic
+	{
+		//truncate off checksum, address and rw_index
+		pld->msg.buf = &ser_msg->buf[head];
+		pld->msg.len = ser_msg->len - (head + tail);
+		pld->msg.size = ser_msg->size - (head + tail);
+	}
+	else if(pld_mode == PAYLOAD_COPY)	//
+	{
+		if(pld->msg.buf == NULL)
+		{
+			return DARTT_ERROR_INVALID_ARGUMENT;
+		}
+		size_t newlen  = ser_msg->len - (head + tail);
+		if(newlen > pld->msg.size)
+		{
+			return DARTT_ERROR_MEMORY_OVERRUN;
+		}
+		unsigned char * sm_start = ser_msg->buf + head; //skip address and rw_index
+
+		dartt_copy(pld->msg.buf, sm_start, newlen);
+		pld->msg.len = newlen;
+	}
+	else
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Body of dartt_parse_general_message().
+ */
+static inline int dartt_parse_general_message_inline(payload_layer_msg_t * pld_msg, serial_message_type_t type, const dartt_mem_t * mem_base, dartt_buffer_t * reply)
+{
+    DARTT_ASSERT(pld_msg != NULL);
+    DARTT_ASSERT(pld_msg->msg.buf != NULL);
+    DARTT_ASSERT(pld_msg->msg.size != 0);
+    DARTT_ASSERT(pld_msg->msg.len <= pld_msg->msg.size);
+    int cb = check_mem_base(mem_base);
+    if(cb != DARTT_PROTOCOL_SUCCESS)
+    {
+        return cb;
+    }
+	cb = check_buffer(reply);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+
+    if(type == TYPE_SERIAL_MESSAGE)
+    {
+        dartt_buffer_t reply_cpy = {
+            reply->buf + NUM_BYTES_ADDRESS,     //make room for the address, which we will load after if necessary
+            reply->size - 1,
+            0
+        };  //positional, so the header also compiles as C++
+        int rc = dartt_parse_base_serial_message(pld_msg, mem_base, &reply_cpy);    //will copy from 1 to len. the original reply buffer is now ready for address and crc loading
+        reply->len = 0;
+        if(reply_cpy.len != 0)     //read reply, or error reply to a rejected read
+        {
+            //append address
+            reply->buf[0] = MASTER_MISC_ADDRESS;
+            reply->len = reply_cpy.len + NUM_BYTES_ADDRESS; //update len now that we have the address in the base message
+            int ac = append_crc(reply);   //the checks in this function also check for address length increase/overrun
+            if(ac != DARTT_PROTOCOL_SUCCESS)
+            {
+                reply->len = 0;
+                return ac;
+            }
+        }
+        return rc;
+    }
+    else if (type == TYPE_ADDR_MESSAGE)
+    {
+        reply->len = 0;
+        int rc = dartt_parse_base_serial_message(pld_msg, mem_base, reply);
+        if(reply->len != 0)
+        {
+            int ac = append_crc(reply);
+            if(ac != DARTT_PROTOCOL_SUCCESS)
+            {
+                reply->len = 0;
+                return ac;
+            }
+        }
+        return rc;
+
+    }
+    else if (type == TYPE_ADDR_CRC_MESSAGE)
+    {
+        return dartt_parse_base_serial_message(pld_msg, mem_base, reply);   //type 3 carries the base protocol with no additional payload dressings
+    }
+    else
+    {
+        return DARTT_ERROR_INVALID_ARGUMENT;  //should never end up here - assert should catch this. Can only happen in release builds untested in debug
+    }
+}
+
+/*
+	TYPE_SERIAL_MESSAGE: [address][index][payload][crc]
+*/
+static inline size_t dartt_rw_overhead_serial(void)
+{
+	return dartt_rw_overhead_inline(TYPE_SERIAL_MESSAGE);
+}
+
+static inline int dartt_create_write_frame_serial(misc_write_message_t * msg, dartt_buffer_t * output)
+{
+	return dartt_create_write_frame_inline(msg, TYPE_SERIAL_MESSAGE, output);
+}
+
+static inline int dartt_create_read_frame_serial(misc_read_message_t * msg, dartt_buffer_t * output)
+{
+	return dartt_create_read_frame_inline(msg, TYPE_SERIAL_MESSAGE, output);
+}
+
+static inline int dartt_frame_to_payload_serial(dartt_buffer_t * ser_msg, payload_mode_t pld_mode, payload_layer_msg_t * pld)
+{
+	return dartt_frame_to_payload_inline(ser_msg, TYPE_SERIAL_MESSAGE, pld_mode, pld);
+}
+
+static inline int dartt_parse_general_message_serial(payload_layer_msg_t * pld_msg, const dartt_mem_t * mem_base, dartt_buffer_t * reply)
+{
+	return dartt_parse_general_message_inline(pld_msg, TYPE_SERIAL_MESSAGE, mem_base, reply);
+}
+
+/*
+	TYPE_ADDR_MESSAGE: [index][payload][crc]
+*/
+static inline size_t dartt_rw_overhead_addr(void)
+{
+	return dartt_rw_overhead_inline(TYPE_ADDR_MESSAGE);
+}
+
+static inline int dartt_create_write_frame_addr(misc_write_message_t * msg, dartt_buffer_t * output)
+{
+	return dartt_create_write_frame_inline(msg, TYPE_ADDR_MESSAGE, output);
+}
+
+static inline int dartt_create_read_frame_addr(misc_read_message_t * msg, dartt_buffer_t * output)
+{
+	return dartt_create_read_frame_inline(msg, TYPE_ADDR_MESSAGE, output);
+}
+
+static inline int dartt_frame_to_payload_addr(dartt_buffer_t * ser_msg, payload_mode_t pld_mode, payload_layer_msg_t * pld)
+{
+	return dartt_frame_to_payload_inline(ser_msg, TYPE_ADDR_MESSAGE, pld_mode, pld);
+}
+
+static inline int dartt_parse_general_message_addr(payload_layer_msg_t * pld_msg, const dartt_mem_t * mem_base, dartt_buffer_t * reply)
+{
+	return dartt_parse_general_message_inline(pld_msg, TYPE_ADDR_MESSAGE, mem_base, reply);
+}
+
+/*
+	TYPE_ADDR_CRC_MESSAGE: [index][payload]
+*/
+static inline size_t dartt_rw_overhead_addr_crc(void)
+{
+	return dartt_rw_overhead_inline(TYPE_ADDR_CRC_MESSAGE);
+}
+
+static inline int dartt_create_write_frame_addr_crc(misc_write_message_t * msg, dartt_buffer_t * output)
+{
+	return dartt_create_write_frame_inline(msg, TYPE_ADDR_CRC_MESSAGE, output);
+}
+
+static inline int dartt_create_read_frame_addr_crc(misc_read_message_t * msg, dartt_buffer_t * output)
+{
+	return dartt_create_read_frame_inline(msg, TYPE_ADDR_CRC_MESSAGE, output);
+}
+
+static inline int dartt_frame_to_payload_addr_crc(dartt_buffer_t * ser_msg, payload_mode_t pld_mode, payload_layer_msg_t * pld)
+{
+	return dartt_frame_to_payload_inline(ser_msg, TYPE_ADDR_CRC_MESSAGE, pld_mode, pld);
+}
+
+static inline int dartt_parse_general_message_addr_crc(payload_layer_msg_t * pld_msg, const dartt_mem_t * mem_base, dartt_buffer_t * reply)
+{
+	return dartt_parse_general_message_inline(pld_msg, TYPE_ADDR_CRC_MESSAGE, mem_base, reply);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
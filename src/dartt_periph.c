@@ -0,0 +1,402 @@
+
+#include "dartt_periph.h"
+#include "dartt_check_buffer.h"
+#include "dartt_copy.h"
+#include "dartt_assert.h"
+
+
+/*
+	Add the byte range [start, end) to a dirty list, merging it with the ranges it overlaps or touches. A full list is
+	merged into a single range covering everything
+*/
+static void dirty_add(dartt_dirty_t * dirty, size_t start, size_t end)
+{
+	size_t i = 0;
+	while(i < dirty->num)
+	{
+		if(start <= dirty->end[i] && dirty->start[i] <= end)
+		{
+			start = (dirty->start[i] < start) ? dirty->start[i] : start;
+			end = (dirty->end[i] > end) ? dirty->end[i] : end;
+			dirty->num--;
+			dirty->start[i] = dirty->start[dirty->num];
+			dirty->end[i] = dirty->end[dirty->num];
+			i = 0;	//the grown range may now touch one already checked
+			continue;
+		}
+		i++;
+	}
+	if(dirty->num == DARTT_PERIPH_MAX_DIRTY)
+	{
+		for(i = 0; i < dirty->num; i++)
+		{
+			start = (dirty->start[i] < start) ? dirty->start[i] : start;
+			end = (dirty->end[i] > end) ? dirty->end[i] : end;
+		}
+		dirty->num = 0;
+	}
+	dirty->start[dirty->num] = start;
+	dirty->end[dirty->num] = end;
+	dirty->num++;
+}
+
+static void dirty_copy(unsigned char * dst, const unsigned char * src, const dartt_dirty_t * dirty)
+{
+	for(size_t i = 0; i < dirty->num; i++)
+	{
+		dartt_copy(dst + dirty->start[i], src + dirty->start[i], dirty->end[i] - dirty->start[i]);
+	}
+}
+
+static void copy_app_owned(const dartt_periph_t * periph, unsigned char * dst, const unsigned char * src)
+{
+	for(size_t i = 0; i < periph->num_app_owned; i++)
+	{
+		size_t start = ((size_t)periph->app_owned[i].start)*sizeof(uint32_t);
+		size_t end = ((size_t)periph->app_owned[i].end)*sizeof(uint32_t);
+		end = (end < periph->mem_base.size) ? end : periph->mem_base.size;
+		if(start < end)
+		{
+			dartt_copy(dst + start, src + start, end - start);
+		}
+	}
+}
+
+/**
+ * @brief Commit all staged writes to the live memory block.
+ *
+ * The live and staging blocks are swapped by exchanging pointers, so the application sees every staged
+ * write at once. Before the swap, the app_owned ranges are carried over from the live block, so fields written by the
+ * application survive the commit. After it, the ranges written since the last commit are copied into the next staging
+ * block, so later partial writes start from the committed state rather than reverting it. The cost is proportional
+ * to the bytes written and app_owned, not to the size of the block.
+ *
+ * Without a spare block, the previous live block becomes the staging block. A commit arriving while the control loop
+ * holds the live block (see dartt_periph_live) is deferred until the loop releases it: it is applied by the next
+ * dartt_periph_parse or dartt_periph_commit call, together with any writes staged in between.
+ *
+ * With a spare block, commits are never deferred: the next staging block is whichever of the previous live block and
+ * the spare block the control loop does not hold, so neither the copy nor later staged writes touch the block a
+ * running iteration is using.
+ *
+ * @param periph Peripheral context. If periph->staging.buf is NULL, writes are already live and this is a no-op.
+ * @return DARTT_PROTOCOL_SUCCESS on success, also when the commit is deferred, error code on failure
+ *
+ * @note Without a spare block, commits must run on the same core as the control loop: between iterations, or
+ * preempting it (e.g. from a receive interrupt). With a spare block, the control loop may also run on another core.
+ * @note Fields written by the application and not listed in app_owned are stale in the committed block until the
+ * application writes them again. With a spare block, app_owned values an iteration writes after a commit preempted it
+ * are not carried over either.
+ */
+int dartt_periph_commit(dartt_periph_t * periph)
+{
+	DARTT_ASSERT(periph != NULL);
+	int cm = check_mem_base(&periph->mem_base);
+	if(cm != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cm;
+	}
+	if(periph->staging.buf == NULL)
+	{
+		return DARTT_PROTOCOL_SUCCESS;	//no staging configured, writes are applied directly
+	}
+	if(periph->staging.size != periph->mem_base.size || (periph->spare.buf != NULL && periph->spare.size != periph->mem_base.size))
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+
+	unsigned char * staged = periph->staging.buf;
+	unsigned char * retired = DARTT_PERIPH_LOAD(&periph->mem_base.buf);
+	if(periph->spare.buf == NULL && DARTT_PERIPH_LOAD(&periph->held) == retired)
+	{
+		periph->commit_pending = 1;	//the control loop is using the block that would become the staging block
+		return DARTT_PROTOCOL_SUCCESS;
+	}
+	periph->commit_pending = 0;
+	copy_app_owned(periph, staged, retired);
+	DARTT_PERIPH_STORE(&periph->mem_base.buf, staged);	//the swap. From here on the application sees the staged content
+
+	unsigned char * next = retired;
+	const dartt_dirty_t * missing = &periph->staged;	//what next lacks of the committed state
+	if(periph->spare.buf != NULL)
+	{
+		for(size_t i = 0; i < periph->staged.num; i++)
+		{
+			dirty_add(&periph->spare_stale, periph->staged.start[i], periph->staged.end[i]);
+		}
+		if(DARTT_PERIPH_LOAD(&periph->held) == retired)
+		{
+			next = periph->spare.buf;	//the control loop may still be using the retired block. It becomes the spare
+			periph->spare.buf = retired;
+			dirty_copy(next, staged, &periph->spare_stale);
+			periph->spare_stale = periph->staged;	//the retired block was live, so it only lacks this commit
+			missing = NULL;
+		}
+	}
+	if(missing != NULL)
+	{
+		dirty_copy(next, staged, missing);
+	}
+	periph->staging.buf = next;
+	periph->staged.num = 0;
+	periph->commit_count++;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Validate a write notification table. Call once during initialization.
+ *
+ * @param hooks Table of write notification regions
+ * @param num_hooks Number of entries in the table
+ * @return DARTT_PROTOCOL_SUCCESS if every region is non-empty, has a callback, and the table is sorted by start
+ * with no overlapping regions. DARTT_ERROR_INVALID_ARGUMENT otherwise.
+ */
+int dartt_periph_check_hooks(const dartt_write_hook_t * hooks, size_t num_hooks)
+{
+	if(num_hooks == 0)
+	{
+		return DARTT_PROTOCOL_SUCCESS;
+	}
+	if(hooks == NULL)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	for(size_t i = 0; i < num_hooks; i++)
+	{
+		if(hooks[i].start >= hooks[i].end || hooks[i].callback == NULL)
+		{
+			return DARTT_ERROR_INVALID_ARGUMENT;
+		}
+		if(i > 0 && hooks[i].start < hooks[i-1].end)
+		{
+			return DARTT_ERROR_INVALID_ARGUMENT;	//unsorted or overlapping
+		}
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Check an access request against an access control map.
+ *
+ * Every map entry overlapping the request is masked to the touched words and tested against the deny bit of the
+ * requested operation in one operation, so the cost is O(words touched / 16) with no per-byte branches.
+ *
+ * @param access_map Access control map, 2 bits per 32-bit word (see DARTT_ACCESS_RW etc.)
+ * @param access_map_len Number of uint32_t entries in access_map
+ * @param index Word index of the first word accessed
+ * @param nbytes Number of bytes accessed
+ * @param rw WRITE_MESSAGE or READ_MESSAGE
+ * @return DARTT_PROTOCOL_SUCCESS if every touched word allows the operation, DARTT_ERROR_ACCESS_DENIED if any word
+ * denies it, DARTT_ERROR_MEMORY_OVERRUN if the request extends past the end of the map.
+ */
+int dartt_access_check(const uint32_t * access_map, size_t access_map_len, uint32_t index, size_t nbytes, read_write_type_t rw)
+{
+	if(access_map == NULL)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	if(nbytes == 0)
+	{
+		return DARTT_PROTOCOL_SUCCESS;
+	}
+	if(index / DARTT_ACCESS_WORDS_PER_ENTRY >= access_map_len)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;	//also guards the byte offset below against wrapping
+	}
+	size_t first_word = index;
+	size_t last_word = (((size_t)index)*sizeof(uint32_t) + nbytes - 1)/sizeof(uint32_t);	//inclusive
+	size_t first_entry = first_word/DARTT_ACCESS_WORDS_PER_ENTRY;
+	size_t last_entry = last_word/DARTT_ACCESS_WORDS_PER_ENTRY;
+	if(last_entry >= access_map_len)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+
+	const uint32_t deny = (rw == WRITE_MESSAGE) ? 0x55555555 : 0xAAAAAAAA;	//bit 0 of every word for writes, bit 1 for reads
+	uint32_t lo_mask = 0xFFFFFFFF << (2*(first_word % DARTT_ACCESS_WORDS_PER_ENTRY));	//clears the words before the request in the first entry
+	uint32_t hi_mask = 0xFFFFFFFF >> (2*(DARTT_ACCESS_WORDS_PER_ENTRY - 1 - (last_word % DARTT_ACCESS_WORDS_PER_ENTRY)));	//clears the words after the request in the last entry
+	uint32_t denied = 0;
+	for(size_t e = first_entry; e <= last_entry; e++)
+	{
+		uint32_t mask = deny;
+		if(e == first_entry)
+		{
+			mask &= lo_mask;
+		}
+		if(e == last_entry)
+		{
+			mask &= hi_mask;
+		}
+		denied |= access_map[e] & mask;
+	}
+	return (denied == 0) ? DARTT_PROTOCOL_SUCCESS : DARTT_ERROR_ACCESS_DENIED;
+}
+
+/*
+	Call the hooks of every region touched by a write of nbytes at word index, landing in block.
+	Binary search for the first region ending after the write start, then walk forward until the regions start past the
+	write end. Cost is O(log(num_hooks) + touched regions).
+*/
+static void dispatch_write_hooks(const dartt_periph_t * periph, const dartt_mem_t * block, uint32_t index, size_t nbytes)
+{
+	size_t write_start = ((size_t)index)*sizeof(uint32_t);
+	size_t write_end = write_start + nbytes;
+
+	size_t lo = 0;
+	size_t hi = periph->num_hooks;
+	while(lo < hi)
+	{
+		size_t mid = lo + (hi - lo)/2;
+		if(periph->hooks[mid].end <= index)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	for(size_t i = lo; i < periph->num_hooks; i++)
+	{
+		const dartt_write_hook_t * hook = &periph->hooks[i];
+		size_t region_start = ((size_t)hook->start)*sizeof(uint32_t);
+		if(region_start >= write_end)
+		{
+			break;
+		}
+		size_t region_end = ((size_t)hook->end)*sizeof(uint32_t);
+		size_t first = (region_start > write_start) ? region_start : write_start;
+		size_t last = (region_end < write_end) ? region_end : write_end;
+		(*(hook->callback))(block->buf + first, (uint32_t)(first/sizeof(uint32_t)), last - first, hook->user_context);
+	}
+}
+
+/*
+	CRC32 queries verify writes, so they are computed over the block writes land in: the staging block when staging is
+	used. The span is checked against the access map like a read.
+*/
+static int crc32_query(dartt_periph_t * periph, payload_layer_msg_t * pld_msg, serial_message_type_t type, dartt_buffer_t * reply)
+{
+	if(periph->access_map != NULL)
+	{
+		uint32_t word = 0;
+		uint32_t num_bytes = 0;
+		int rc = dartt_parse_crc32_query(pld_msg, &word, &num_bytes);
+		if(rc == DARTT_PROTOCOL_SUCCESS)
+		{
+			rc = dartt_access_check(periph->access_map, periph->access_map_len, word, num_bytes, READ_MESSAGE);
+		}
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return dartt_create_error_reply(pld_msg, rc, type, reply);
+		}
+	}
+	const dartt_mem_t * target = &periph->mem_base;
+	if(periph->staging.buf != NULL)
+	{
+		if(periph->staging.size != periph->mem_base.size)
+		{
+			return dartt_create_error_reply(pld_msg, DARTT_ERROR_MEMORY_OVERRUN, type, reply);
+		}
+		target = &periph->staging;
+	}
+	return dartt_parse_general_message(pld_msg, type, target, reply);
+}
+
+/**
+ * @brief Peripheral-side message handler with optional staged (double buffered) writes.
+ *
+ * Wrapper for dartt_parse_general_message. Reads are always serviced from the live block. When a staging
+ * block is configured, writes are applied to the staging block and only become visible to the application
+ * after a write to DARTT_INDEX_COMMIT (or a local call to dartt_periph_commit). A deferred commit (see
+ * dartt_periph_commit) is retried before the message is handled.
+ *
+ * @param periph Peripheral context containing the live block and optional staging block
+ * @param pld_msg Payload layer message (address and CRC already removed)
+ * @param type Original frame type (determines reply frame format)
+ * @param reply Buffer to receive the formatted reply frame
+ * @return DARTT_PROTOCOL_SUCCESS on success, error code on failure
+ *
+ * @note If an access control map is configured, every request is checked against it before any memory is touched.
+ * Requests touching a denied word are rejected as a whole with DARTT_ERROR_ACCESS_DENIED. Denied reads are answered
+ * with an error reply, denied writes are dropped silently.
+ * @note If a write notification table is configured, the hooks of every region touched by a successful write are called
+ * after the write is applied, with a pointer into the block the write landed in (the staging block when staging is used).
+ * Hooks run in the caller's context, and are not called again on commit. With staging, only the written words are
+ * carried into later staging blocks, so hooks should not modify the block outside them.
+ * @note CRC32 queries (DARTT_INDEX_CRC32) are answered from the staging block when staging is used, so staged writes
+ * can be verified before they are committed.
+ * @note Read-back verification of a staged write (dartt_sync) only matches after the commit. A typical controller
+ * sequence is dartt_write_multi, dartt_ctl_commit, then dartt_sync or dartt_read_multi to verify.
+ */
+int dartt_periph_parse(dartt_periph_t * periph, payload_layer_msg_t * pld_msg, serial_message_type_t type, dartt_buffer_t * reply)
+{
+	DARTT_ASSERT(periph != NULL);
+	DARTT_ASSERT(pld_msg != NULL);
+	int cb = check_buffer(reply);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+
+	if(periph->commit_pending)
+	{
+		dartt_periph_commit(periph);	//stays pending while the control loop holds the live block
+	}
+
+	if(pld_msg->rw_bit == 0 && pld_msg->index_arg == DARTT_INDEX_COMMIT)
+	{
+		reply->len = 0;	//commits are writes, and writes are not replied to
+		return dartt_periph_commit(periph);
+	}
+
+	if(pld_msg->rw_bit != 0 && pld_msg->index_arg == DARTT_INDEX_CRC32)
+	{
+		return crc32_query(periph, pld_msg, type, reply);
+	}
+
+	if(pld_msg->rw_bit != 0)
+	{
+		if(periph->access_map != NULL && pld_msg->msg.len >= NUM_BYTES_NUMWORDS_READREQUEST)
+		{
+			size_t num_bytes = ((size_t)pld_msg->msg.buf[0]) | (((size_t)pld_msg->msg.buf[1]) << 8);
+			int ac = dartt_access_check(periph->access_map, periph->access_map_len, DARTT_INDEX_WORD(pld_msg->index_arg), num_bytes, READ_MESSAGE);
+			if(ac != DARTT_PROTOCOL_SUCCESS)
+			{
+				return dartt_create_error_reply(pld_msg, ac, type, reply);	//rejected reads are answered with an error reply
+			}
+		}
+		return dartt_parse_general_message(pld_msg, type, &periph->mem_base, reply);
+	}
+
+	if(periph->access_map != NULL)
+	{
+		int ac = dartt_access_check(periph->access_map, periph->access_map_len, DARTT_INDEX_WORD(pld_msg->index_arg), pld_msg->msg.len, WRITE_MESSAGE);
+		if(ac != DARTT_PROTOCOL_SUCCESS)
+		{
+			reply->len = 0;
+			return ac;	//denied writes are dropped without touching memory or calling hooks
+		}
+	}
+
+	const dartt_mem_t * target = &periph->mem_base;
+	if(periph->staging.buf != NULL)
+	{
+		if(periph->staging.size != periph->mem_base.size)
+		{
+			return DARTT_ERROR_MEMORY_OVERRUN;
+		}
+		target = &periph->staging;
+	}
+	int rc = dartt_parse_general_message(pld_msg, type, target, reply);
+	if(rc == DARTT_PROTOCOL_SUCCESS && target == &periph->staging)
+	{
+		size_t start = ((size_t)DARTT_INDEX_WORD(pld_msg->index_arg))*sizeof(uint32_t);
+		dirty_add(&periph->staged, start, start + pld_msg->msg.len);	//in range: checked by the write
+	}
+	if(rc == DARTT_PROTOCOL_SUCCESS && periph->num_hooks != 0)
+	{
+		dispatch_write_hooks(periph, target, DARTT_INDEX_WORD(pld_msg->index_arg), pld_msg->msg.len);
+	}
+	return rc;
+}
@@ -0,0 +1,117 @@
+#ifndef DARTT_PERIPH_H
+#define DARTT_PERIPH_H
+#include <stdint.h>
+#include <stddef.h>
+#include "dartt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+	Access control map. 2 bits per 32-bit word of the memory block, packed 16 words per uint32_t entry,
+	word N in bits [2*(N%16), 2*(N%16)+1] of entry N/16. A zero map grants full access.
+*/
+#define DARTT_ACCESS_RW					0x0		//read and write allowed
+#define DARTT_ACCESS_RO					0x1		//write denied
+#define DARTT_ACCESS_WO					0x2		//read denied
+#define DARTT_ACCESS_NA					0x3		//read and write denied
+#define DARTT_ACCESS_WORDS_PER_ENTRY	16
+#define DARTT_ACCESS_MAP_LEN(nbytes)	((((nbytes) + sizeof(uint32_t) - 1)/sizeof(uint32_t) + DARTT_ACCESS_WORDS_PER_ENTRY - 1)/DARTT_ACCESS_WORDS_PER_ENTRY)	//number of entries needed to cover nbytes
+
+/*
+	Write notification region. Covers the word indices [start, end). When a write touches the region, callback is
+	called with a pointer to the first touched byte of the region, its word index and the number of bytes touched.
+*/
+typedef struct dartt_write_hook_t
+{
+		uint32_t start;			// First word index of the region
+		uint32_t end;			// One past the last word index of the region
+		void (*callback)(unsigned char * field, uint32_t index, size_t nbytes, void * user_context);
+		void * user_context;	//OPTIONAL resource passed to the callback. Set to NULL if not needed
+}dartt_write_hook_t;
+
+/*
+	Word range [start, end) of the memory block
+*/
+typedef struct dartt_word_range_t
+{
+		uint32_t start;			// First word index of the range
+		uint32_t end;			// One past the last word index of the range
+}dartt_word_range_t;
+
+#ifndef DARTT_PERIPH_MAX_DIRTY
+#define DARTT_PERIPH_MAX_DIRTY	4	//written byte ranges tracked per block. Past that they are merged into one range covering them all
+#endif
+
+/*
+	Byte ranges [start, end) written to a block since it was last brought up to date. Maintained by dartt_periph_parse
+	and dartt_periph_commit
+*/
+typedef struct dartt_dirty_t
+{
+		size_t num;								// Ranges in use
+		size_t start[DARTT_PERIPH_MAX_DIRTY];
+		size_t end[DARTT_PERIPH_MAX_DIRTY];
+}dartt_dirty_t;
+
+typedef struct dartt_periph_t
+{
+		dartt_mem_t mem_base;		// Live memory block. The application reads and writes through mem_base.buf, which is swapped on commit when staging is used
+		dartt_mem_t staging;		//OPTIONAL staging block, same size as mem_base and initialized as a copy of it. Writes land here until committed. Set .buf to NULL to write directly to mem_base
+		dartt_mem_t spare;			//OPTIONAL third block, same size as mem_base and initialized as a copy of it. Lets commits preempt the control loop (see dartt_periph_commit). Set .buf to NULL if not needed
+		const dartt_word_range_t * app_owned;	//OPTIONAL word ranges written by the application (status, sensor readings), carried into the new live block on commit. Set to NULL if not needed
+		size_t num_app_owned;		// Number of entries in app_owned
+		unsigned char * volatile held;	// Block the control loop holds, between dartt_periph_live and dartt_periph_release. Zero initialize
+		dartt_dirty_t staged;		// Ranges written to the staging block since the last commit. Zero initialize
+		dartt_dirty_t spare_stale;	// Ranges committed since the spare block was last up to date. Zero initialize
+		int commit_pending;			// Set while a commit waits for the control loop to release the live block. Zero initialize
+		uint32_t commit_count;		// Number of commits applied since initialization
+		const dartt_write_hook_t * hooks;	//OPTIONAL write notification table, sorted by start and non-overlapping. Set to NULL if not needed
+		size_t num_hooks;			// Number of entries in hooks
+		const uint32_t * access_map;	//OPTIONAL access control map (see DARTT_ACCESS_RW etc.). Set to NULL to allow all access
+		size_t access_map_len;		// Number of uint32_t entries in access_map. Must be at least DARTT_ACCESS_MAP_LEN(mem_base.size)
+}dartt_periph_t;
+
+
+int dartt_periph_parse(dartt_periph_t * periph, payload_layer_msg_t * pld_msg, serial_message_type_t type, dartt_buffer_t * reply);
+int dartt_periph_commit(dartt_periph_t * periph);
+int dartt_periph_check_hooks(const dartt_write_hook_t * hooks, size_t num_hooks);
+int dartt_access_check(const uint32_t * access_map, size_t access_map_len, uint32_t index, size_t nbytes, read_write_type_t rw);
+
+#define DARTT_PERIPH_LOAD(p)		__atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define DARTT_PERIPH_STORE(p, v)	__atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+
+/*
+	Returns the live memory block and records it as held by the control loop until dartt_periph_release. Control loops
+	call this once at the start of every iteration and use the result for the whole iteration: a commit is then never
+	observed half-applied, and never modifies the block in use. With a spare block the commit swaps the block pointer
+	before it checks held, and this checks the pointer again after setting held, so one of the two always sees the
+	other, also from another core.
+*/
+static inline unsigned char * dartt_periph_live(dartt_periph_t * periph)
+{
+	unsigned char * live;
+	do
+	{
+		live = DARTT_PERIPH_LOAD(&periph->mem_base.buf);
+		DARTT_PERIPH_STORE(&periph->held, live);
+	}while(live != DARTT_PERIPH_LOAD(&periph->mem_base.buf));	//a commit in between may have staged into live: pick up again
+	return live;
+}
+
+/*
+	Ends a control loop iteration started with dartt_periph_live
+*/
+static inline void dartt_periph_release(dartt_periph_t * periph)
+{
+	DARTT_PERIPH_STORE(&periph->held, (unsigned char *)NULL);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
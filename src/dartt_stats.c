@@ -0,0 +1,132 @@
+#include "dartt_stats.h"
+#include "dartt_assert.h"
+#include <string.h>
+
+
+/*
+	Index of the most significant set bit. value must be nonzero
+*/
+static uint32_t msb_index(uint32_t value)
+{
+#if defined(__GNUC__)
+	return 31u - (uint32_t)__builtin_clz(value);
+#else
+	uint32_t msb = 0;
+	while(value >>= 1)
+	{
+		msb++;
+	}
+	return msb;
+#endif
+}
+
+/**
+ * @brief Bucket of a dartt_histogram_t that a value is counted in.
+ *
+ * @param value Recorded value
+ * @return Bucket index, less than DARTT_STATS_NUM_BUCKETS
+ */
+size_t dartt_histogram_bucket(uint32_t value)
+{
+	if(value < DARTT_STATS_SUB_BUCKETS)
+	{
+		return value;
+	}
+	uint32_t msb = msb_index(value);
+	uint32_t shift = msb - DARTT_STATS_SUB_BUCKET_BITS;
+	return (size_t)(shift + 1u) * DARTT_STATS_SUB_BUCKETS + ((value >> shift) & (DARTT_STATS_SUB_BUCKETS - 1u));
+}
+
+/**
+ * @brief Smallest value counted in a bucket. The bucket holds the values from its floor up to the floor of the next
+ * bucket, excluded. The last bucket ends at UINT32_MAX.
+ *
+ * @param bucket Bucket index, less than DARTT_STATS_NUM_BUCKETS
+ * @return Smallest value of the bucket
+ */
+uint32_t dartt_histogram_bucket_floor(size_t bucket)
+{
+	DARTT_ASSERT(bucket < DARTT_STATS_NUM_BUCKETS);
+	if(bucket < DARTT_STATS_SUB_BUCKETS)
+	{
+		return (uint32_t)bucket;
+	}
+	uint32_t shift = (uint32_t)(bucket / DARTT_STATS_SUB_BUCKETS) - 1u;
+	uint32_t sub = (uint32_t)(bucket % DARTT_STATS_SUB_BUCKETS);
+	return (DARTT_STATS_SUB_BUCKETS + sub) << shift;
+}
+
+/**
+ * @brief Count a value.
+ *
+ * @param hist Histogram. Zero initialize, or clear with memset, before the first value
+ * @param value Value to count
+ */
+void dartt_histogram_record(dartt_histogram_t * hist, uint32_t value)
+{
+	DARTT_ASSERT(hist != NULL);
+	if(hist->count == 0 || value < hist->min)
+	{
+		hist->min = value;
+	}
+	if(value > hist->max)
+	{
+		hist->max = value;
+	}
+	hist->count++;
+	hist->total += value;
+	hist->buckets[dartt_histogram_bucket(value)]++;
+}
+
+/**
+ * @brief Value below which a given share of the recorded values fall.
+ *
+ * @param hist Histogram
+ * @param permille Share of the values, in thousandths. 500 for the median, 990 for p99, 999 for p99.9, 1000 for the
+ * maximum
+ * @return The largest value of the bucket holding the requested rank, capped to the recorded maximum. The value is
+ * therefore never under-reported, and over-reported by at most the bucket width. 0 if the histogram is empty
+ */
+uint32_t dartt_histogram_quantile(const dartt_histogram_t * hist, uint32_t permille)
+{
+	DARTT_ASSERT(hist != NULL);
+	if(hist->count == 0)
+	{
+		return 0;
+	}
+	if(permille > 1000)
+	{
+		permille = 1000;
+	}
+	uint64_t rank = ((uint64_t)hist->count * permille + 999u) / 1000u;	//1-based rank of the value, rounded up
+	if(rank == 0)
+	{
+		rank = 1;
+	}
+	uint64_t seen = 0;
+	for(size_t i = 0; i < DARTT_STATS_NUM_BUCKETS; i++)
+	{
+		seen += hist->buckets[i];
+		if(seen >= rank)
+		{
+			uint32_t top = (i + 1 < DARTT_STATS_NUM_BUCKETS) ? dartt_histogram_bucket_floor(i + 1) - 1u : UINT32_MAX;
+			return (top < hist->max) ? top : hist->max;
+		}
+	}
+	return hist->max;
+}
+
+/**
+ * @brief Clear all counters and histograms. The clock callback and its context are kept.
+ *
+ * @param stats Statistics to clear
+ */
+void dartt_stats_reset(dartt_stats_t * stats)
+{
+	DARTT_ASSERT(stats != NULL);
+	uint32_t (*clock_callback)(void *) = stats->clock_callback;
+	void * clock_context = stats->clock_context;
+	memset(stats, 0, sizeof(dartt_stats_t));
+	stats->clock_callback = clock_callback;
+	stats->clock_context = clock_context;
+}
@@ -0,0 +1,89 @@
+#ifndef DARTT_STATS_H
+#define DARTT_STATS_H
+#include <stdint.h>
+#include <stddef.h>
+#include "dartt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#ifndef DARTT_STATS_SUB_BUCKET_BITS
+#define DARTT_STATS_SUB_BUCKET_BITS	2	//each power of two is split in 1 << bits linear buckets. 2 keeps every bucket within 25% of its value
+#endif
+#define DARTT_STATS_SUB_BUCKETS		(1u << DARTT_STATS_SUB_BUCKET_BITS)
+#define DARTT_STATS_NUM_BUCKETS		((33u - DARTT_STATS_SUB_BUCKET_BITS) * DARTT_STATS_SUB_BUCKETS)	//covers the whole uint32_t range
+#define DARTT_STATS_NUM_ERRORS		(1 - DARTT_ERROR_TIMEOUT)	//error codes 0 to DARTT_ERROR_TIMEOUT
+
+/*
+	Operations timed by dartt_sync_t, indexing dartt_stats_t.ops
+*/
+typedef enum
+{
+	DARTT_OP_SYNC,
+	DARTT_OP_CTL_WRITE,
+	DARTT_OP_CTL_READ,
+	DARTT_OP_READ_MULTI,
+	DARTT_OP_WRITE_MULTI,
+	DARTT_OP_READ_MULTI_PIPELINED,
+	DARTT_OP_READ_POST,
+	DARTT_OP_READ_POLL,
+	DARTT_OP_COMMIT,
+	DARTT_OP_READ_CRC32,
+	DARTT_OP_BULK_WRITE,
+	DARTT_OP_BULK_READ,
+	DARTT_OP_TX,	//tx callback, and the flush callback when the frame is flushed
+	DARTT_OP_RX,	//rx callback
+	DARTT_NUM_OPS
+} dartt_op_t;
+
+/*
+	Log-bucketed histogram, in the style of HdrHistogram: values below DARTT_STATS_SUB_BUCKETS have a bucket each,
+	larger values share a bucket with the values within the same 1/DARTT_STATS_SUB_BUCKETS of their power of two.
+	Recording is a handful of integer operations and the size is fixed, so it can run on the target.
+*/
+typedef struct dartt_histogram_t
+{
+		uint32_t count;
+		uint32_t min;
+		uint32_t max;
+		uint64_t total;				// Sum of the recorded values, for the mean
+		uint32_t buckets[DARTT_STATS_NUM_BUCKETS];
+}dartt_histogram_t;
+
+typedef struct dartt_op_stats_t
+{
+		uint32_t calls;
+		uint32_t failures;			// Calls that returned an error code
+		dartt_histogram_t latency;	// In clock ticks. Only recorded if dartt_stats_t has a clock callback
+}dartt_op_stats_t;
+
+/*
+	Instrumentation of a dartt_sync_t. Only present with DARTT_ENABLE_STATS.
+*/
+typedef struct dartt_stats_t
+{
+		uint32_t (*clock_callback)(void * user_context);	//OPTIONAL free running clock in any unit (microseconds, CPU cycles...). Differences are taken modulo 2^32. Set to NULL to only count
+		void * clock_context;		//OPTIONAL resource used for the clock callback. Set to NULL if not needed
+		uint32_t tx_frames;			// Frames accepted by the tx callback
+		uint64_t tx_bytes;
+		uint32_t rx_frames;			// Non-empty frames returned by the rx callback
+		uint64_t rx_bytes;
+		uint32_t errors[DARTT_STATS_NUM_ERRORS];	// Failed frame exchanges (every retry counts) by error code, errors[-code]. errors[0] is unused
+		dartt_op_stats_t ops[DARTT_NUM_OPS];
+}dartt_stats_t;
+
+
+size_t dartt_histogram_bucket(uint32_t value);
+uint32_t dartt_histogram_bucket_floor(size_t bucket);
+void dartt_histogram_record(dartt_histogram_t * hist, uint32_t value);
+uint32_t dartt_histogram_quantile(const dartt_histogram_t * hist, uint32_t permille);
+void dartt_stats_reset(dartt_stats_t * stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
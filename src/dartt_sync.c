@@ -1,22 +1,263 @@
 #include "dartt_sync.h"
+#include "dartt_crc.h"
 #include "dartt_check_buffer.h"
+#include "dartt_copy.h"
 #include "dartt_assert.h"
 
 
-/**
- * @brief This function scans two buffers (one control and one peripheral) for the presence of any mismatch between control and peripheral.
- * If a difference is found, the master then writes the control copy content TO the target device, and reads it back into the shadow copy to verify a match.
- * Access to hardware is managed with callback function pointers. Callback function pointers must be loaded into *psync
- *
- * @param ctl Pointer to the region within ctl_base that should be synchronized. This is the subset of the master copy
- *            we are synchronizing to the peripheral device. Must be equal to or within psync->ctl_base or function returns error.
- *            The corresponding region in psync->periph_base is compared, and if different, the peripheral is updated and
- *            read back to verify the write succeeded.
- * @param psync Pointer to a dartt_sync_t structure containing the address, serial callbacks, message type, ctl_base,
- *              periph_base (shadow copy), and communication buffers.
- * @return DARTT_PROTOCOL_SUCCESS on success, error code on failure
- * */
-int dartt_sync(dartt_mem_t * ctl, dartt_sync_t * psync)
+#ifdef DARTT_ENABLE_STATS
+/*
+	Instrumentation hooks, see dartt_stats.h. Without DARTT_ENABLE_STATS the STATS_ macros expand to nothing
+*/
+static uint32_t stats_clock(const dartt_sync_t * psync)
+{
+	DARTT_ASSERT(psync != NULL);
+	if(psync->stats.clock_callback == NULL)
+	{
+		return 0;
+	}
+	return (*(psync->stats.clock_callback))(psync->stats.clock_context);
+}
+
+static void stats_op(dartt_sync_t * psync, dartt_op_t op, uint32_t start, int rc)
+{
+	dartt_op_stats_t * ops = &psync->stats.ops[op];
+	ops->calls++;
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		ops->failures++;
+	}
+	if(psync->stats.clock_callback != NULL)
+	{
+		dartt_histogram_record(&ops->latency, stats_clock(psync) - start);	//modulo 2^32, so a wrapping clock is fine
+	}
+}
+
+static void stats_error(dartt_sync_t * psync, int rc)
+{
+	if(rc < 0 && rc > -DARTT_STATS_NUM_ERRORS)
+	{
+		psync->stats.errors[-rc]++;
+	}
+}
+
+#define STATS_START(psync)				uint32_t stats_start = stats_clock(psync)
+#define STATS_STOP(psync, op, rc)		stats_op((psync), (op), stats_start, (rc))
+#define STATS_ERROR(psync, rc)			stats_error((psync), (rc))
+#define STATS_FRAME(psync, dir, len)	do{ (psync)->stats.dir##_frames++; (psync)->stats.dir##_bytes += (len); }while(0)
+#else
+#define STATS_START(psync)				(void)0
+#define STATS_STOP(psync, op, rc)		(void)0
+#define STATS_ERROR(psync, rc)			(void)0
+#define STATS_FRAME(psync, dir, len)	(void)0
+#endif
+
+
+/*
+	Retransmission policy check, called after every attempt at a frame. Returns 1 if the frame should be sent again,
+	after updating the counters and waiting out the backoff. Returns 0 when done, successful or not.
+*/
+static int retry_frame(dartt_sync_t * psync, int rc, uint32_t * attempt)
+{
+	dartt_retry_policy_t * policy = &psync->retry;
+	STATS_ERROR(psync, rc);
+	if(rc == DARTT_PROTOCOL_SUCCESS)
+	{
+		if(*attempt != 0)
+		{
+			psync->retry_stats.recovered++;
+		}
+		return 0;
+	}
+	if(rc > 0 || rc < -31 || (policy->retry_mask & DARTT_RETRY_BIT(rc)) == 0)
+	{
+		return 0;	//not a retryable error
+	}
+	if(*attempt + 1 >= policy->max_attempts)
+	{
+		if(policy->max_attempts > 1)
+		{
+			psync->retry_stats.exhausted++;
+		}
+		return 0;
+	}
+	if(policy->delay_callback != NULL && policy->backoff_ms != 0)
+	{
+		uint32_t shift = (*attempt < 16) ? *attempt : 16;	//cap the exponential backoff
+		(*(policy->delay_callback))(policy->backoff_ms << shift, policy->user_context);
+	}
+	(*attempt)++;
+	psync->retry_stats.retries++;
+	return 1;
+}
+
+/*
+	Message index of the word at field_index in ctl_base: base_offset applied, with DARTT_INDEX_EXTENDED_BIT set where
+	the word is beyond the standard index range
+*/
+static uint32_t msg_index(const dartt_sync_t * psync, size_t field_index)
+{
+	return DARTT_INDEX_OF_WORD(field_index + psync->base_offset);
+}
+
+/*
+	Framing overhead of the frames to the region. When the region extends beyond the standard index range, every frame
+	is sized for the word index of extended frames. 0 for an invalid message type
+*/
+static size_t region_overhead(const dartt_sync_t * psync)
+{
+	size_t overhead = dartt_rw_overhead(psync->msg_type);
+	size_t num_words = (psync->ctl_base.size + sizeof(int32_t) - 1)/sizeof(int32_t);
+	if(overhead != 0 && psync->base_offset + num_words > DARTT_INDEX_RESERVED_BASE)
+	{
+		overhead += NUM_BYTES_INDEX_EXTENDED;
+	}
+	return overhead;
+}
+
+/*
+	Hand tx_buf to the tx callback. A transport with a flush callback may hold the frame back, so it goes out in one
+	batch with the frames that follow. Pass defer = 0 for frames that are not followed by a reception, so they are
+	flushed right away. Frames followed by a reception are sent by the rx callback before it waits.
+*/
+static int send_tx_buf(dartt_sync_t * psync, unsigned char address, int defer)
+{
+	STATS_START(psync);
+	if(psync->trace != NULL)
+	{
+		dartt_trace_frame(psync->trace, DARTT_TRACE_TX, psync->msg_type, address, &psync->tx_buf);
+	}
+	int rc = (*(psync->blocking_tx_callback))(address, &psync->tx_buf, psync->user_context_tx, psync->timeout_ms);
+	if(rc == DARTT_PROTOCOL_SUCCESS)
+	{
+		STATS_FRAME(psync, tx, psync->tx_buf.len);
+		if(!defer && psync->flush_tx_callback != NULL)
+		{
+			rc = (*(psync->flush_tx_callback))(psync->user_context_tx, psync->timeout_ms);
+		}
+	}
+	STATS_STOP(psync, DARTT_OP_TX, rc);
+	return rc;
+}
+
+/*
+	Receive one frame into rx_buf with the rx callback
+*/
+static int receive_rx_buf(dartt_sync_t * psync)
+{
+	STATS_START(psync);
+	int rc = (*(psync->blocking_rx_callback))(&psync->rx_buf, psync->user_context_rx, psync->timeout_ms);
+	if(rc == DARTT_PROTOCOL_SUCCESS && psync->rx_buf.len != 0)
+	{
+		STATS_FRAME(psync, rx, psync->rx_buf.len);
+		if(psync->trace != NULL)
+		{
+			dartt_trace_frame(psync->trace, DARTT_TRACE_RX, psync->msg_type, 0, &psync->rx_buf);
+		}
+	}
+	STATS_STOP(psync, DARTT_OP_RX, rc);
+	return rc;
+}
+
+/*
+	Write one mismatched span [start_bidx, stop_bidx) of ctl to the peripheral, read it back, verify it, and update the shadow copy.
+	Helper for dartt_sync - arguments are validated by the caller.
+*/
+static int sync_span(dartt_mem_t * ctl, dartt_sync_t * psync, size_t base_bidx, int start_bidx, int stop_bidx)
+{
+	int field_index = index_of_field( (void*)(&ctl->buf[start_bidx]), (void*)(&psync->ctl_base.buf[0]), psync->ctl_base.size );
+	if(field_index < 0)
+	{
+		return field_index; //negative values are error codes, return if you get negative value
+	}
+	unsigned char misc_address = dartt_get_complementary_address(psync->address);
+	//write then read the word in question
+	misc_write_message_t write_msg =
+	{
+			.address = misc_address,
+			.index = msg_index(psync, (size_t)field_index),
+			.payload = {
+					.buf = &ctl->buf[start_bidx],
+					.size = (stop_bidx - start_bidx),
+					.len = (stop_bidx - start_bidx)
+			}
+	};
+	int rc = dartt_create_write_frame(&write_msg, psync->msg_type, &psync->tx_buf);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+
+	//blocking write callback. Held back with the read request that follows on batching transports
+	rc = send_tx_buf(psync, misc_address, 1);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+
+	misc_read_message_t read_msg =
+	{
+			.address = misc_address,
+			.index = write_msg.index,
+			.num_bytes = (uint16_t)(write_msg.payload.len)
+	};
+	rc = dartt_create_read_frame(&read_msg, psync->msg_type, &psync->tx_buf);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	rc = send_tx_buf(psync, misc_address, 1);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+
+	rc = receive_rx_buf(psync);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	if(psync->rx_buf.len == 0)  //check for failure to reply. rx blocking should return 0 length if 0 length was obtained
+	{
+		return DARTT_ERROR_MALFORMED_MESSAGE;
+	}
+	payload_layer_msg_t pld_msg = {};
+	rc = dartt_frame_to_payload(&psync->rx_buf, psync->msg_type, PAYLOAD_ALIAS, &pld_msg);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	rc = dartt_check_error_reply(&pld_msg);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;	//the peripheral rejected the read-back
+	}
+
+	if(write_msg.payload.len > pld_msg.msg.size)    //overrun guard for the comparison below. May be protected but I think that is non-obvious
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+
+	for(int i = 0; i < write_msg.payload.len; i++)
+	{
+		if(write_msg.payload.buf[i] != pld_msg.msg.buf[i])
+		{
+			return DARTT_ERROR_SYNC_MISMATCH;
+		}
+	}
+	if(write_msg.payload.len + base_bidx + start_bidx > psync->periph_base.size)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	dartt_copy(psync->periph_base.buf + base_bidx + start_bidx, ctl->buf + start_bidx, write_msg.payload.len);   //copy the mismatched word after confirming the peripheral matches
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+
+/*
+	Body of dartt_sync
+*/
+static int sync_region(dartt_mem_t * ctl, dartt_sync_t * psync)
 {
 	DARTT_ASSERT(psync != NULL);
 	DARTT_ASSERT(psync->blocking_rx_callback != NULL && psync->blocking_tx_callback != NULL && psync->ctl_base.buf != NULL && psync->ctl_base.size != 0);
@@ -46,25 +287,9 @@ int dartt_sync(dartt_mem_t * ctl, dartt_sync_t * psync)
     {
         return DARTT_ERROR_MEMORY_OVERRUN;
     }
-    if (ctl->buf + ctl->size > psync->ctl_base.buf + psync->ctl_base.size) 
-    {
-        return DARTT_ERROR_MEMORY_OVERRUN;
-    }
 
-    size_t nbytes_writemsg_overhead = 0;
-    if(psync->msg_type == TYPE_SERIAL_MESSAGE)
-    {
-    	nbytes_writemsg_overhead = (NUM_BYTES_ADDRESS + NUM_BYTES_INDEX + NUM_BYTES_CHECKSUM);	//serial message writes have the maximum overhead, 5 bytes
-    }
-    else if(psync->msg_type == TYPE_ADDR_MESSAGE)
-    {
-    	nbytes_writemsg_overhead = (NUM_BYTES_INDEX + NUM_BYTES_CHECKSUM);	//if inherently addressed, 4 bytes
-    }
-    else if(psync->msg_type == TYPE_ADDR_CRC_MESSAGE)
-    {
-    	nbytes_writemsg_overhead = NUM_BYTES_INDEX;	//if inherently addressed and error checked, only two bytes
-    }
-    else
+    size_t nbytes_writemsg_overhead = region_overhead(psync);	//5 bytes for serial messages, 4 if inherently addressed, 2 if also error checked. 4 more for extended frames
+    if(nbytes_writemsg_overhead == 0)
     {
     	return DARTT_ERROR_INVALID_ARGUMENT;
     }
@@ -148,90 +373,16 @@ int dartt_sync(dartt_mem_t * ctl, dartt_sync_t * psync)
 
 		if(stop_bidx >= 0)
 		{
-			// uint16_t field_index = field_bidx/sizeof(int32_t);
-            int field_index = index_of_field( (void*)(&ctl->buf[start_bidx]), (void*)(&psync->ctl_base.buf[0]), psync->ctl_base.size );
-            if(field_index < 0)
-            {
-                return field_index; //negative values are error codes, return if you get negative value
-            }
-            unsigned char misc_address = dartt_get_complementary_address(psync->address);
-			//write then read the word in question
-			misc_write_message_t write_msg =
-			{
-					.address = misc_address,
-					.index = field_index + psync->base_offset,
-					.payload = {
-							.buf = &ctl->buf[start_bidx],
-							.size = (stop_bidx - start_bidx),
-							.len = (stop_bidx - start_bidx)
-					}
-			};
-			int rc = dartt_create_write_frame(&write_msg, psync->msg_type, &psync->tx_buf);
-			if(rc != DARTT_PROTOCOL_SUCCESS)
-			{
-				return rc;
-			}
-
-            //blocking write callback
-			rc = (*(psync->blocking_tx_callback))(misc_address, &psync->tx_buf, psync->user_context_tx, psync->timeout_ms);
-			if(rc != DARTT_PROTOCOL_SUCCESS)
-			{
-				return rc;
-			}
-
-			misc_read_message_t read_msg =
-			{
-					.address = misc_address,
-					.index = field_index + psync->base_offset,
-					.num_bytes = (uint16_t)(write_msg.payload.len)
-			};
-			rc = dartt_create_read_frame(&read_msg, psync->msg_type, &psync->tx_buf);
-			if(rc != DARTT_PROTOCOL_SUCCESS)
-			{
-				return rc;
-			}
-			rc = (*(psync->blocking_tx_callback))(misc_address, &psync->tx_buf, psync->user_context_tx, psync->timeout_ms);
-			if(rc != DARTT_PROTOCOL_SUCCESS)
-			{
-				return rc;
-			}
-
-			rc = (*(psync->blocking_rx_callback))(&psync->rx_buf, psync->user_context_rx, psync->timeout_ms);
-			if(rc != DARTT_PROTOCOL_SUCCESS)
+			uint32_t attempt = 0;
+			int rc;
+			do
 			{
-				return rc;
-			}
-            if(psync->rx_buf.len == 0)  //check for failure to reply. rx blocking should return 0 length if 0 length was obtained
-            {
-                return DARTT_ERROR_MALFORMED_MESSAGE;
-            }
-			payload_layer_msg_t pld_msg = {};
-			rc = dartt_frame_to_payload(&psync->rx_buf, psync->msg_type, PAYLOAD_ALIAS, &pld_msg);
+				rc = sync_span(ctl, psync, base_bidx, start_bidx, stop_bidx);
+			}while(retry_frame(psync, rc, &attempt));
 			if(rc != DARTT_PROTOCOL_SUCCESS)
 			{
 				return rc;
 			}
-
-            if(write_msg.payload.len > pld_msg.msg.size)    //overrun guard for the comparison below. May be protected but I think that is non-obvious
-            {
-                return DARTT_ERROR_MEMORY_OVERRUN;
-            }
-
-            for(int i = 0; i < write_msg.payload.len; i++)
-            {
-                if(write_msg.payload.buf[i] != pld_msg.msg.buf[i])
-                {
-                    return DARTT_ERROR_SYNC_MISMATCH;
-                }
-            }
-			if(write_msg.payload.len + base_bidx + start_bidx > psync->periph_base.size)
-			{
-				return DARTT_ERROR_MEMORY_OVERRUN;
-			}
-            for(int i = 0; i < write_msg.payload.len; i++)
-            {
-                psync->periph_base.buf[base_bidx + start_bidx + i] = ctl->buf[start_bidx+i];   //copy the mismatched word after confirming the peripheral matches
-            }
             start_bidx = -1;
             stop_bidx = -1;
 		}
@@ -241,17 +392,33 @@ int dartt_sync(dartt_mem_t * ctl, dartt_sync_t * psync)
 }
 
 /**
- * @brief This function implements a full wrapper for dartt write frames.
- * You pass by reference a buffer to a region you want to write, located within the base control structure.
- * ctl must be within psync->ctl_base or the function will return an error. Additionally, if ctl->len
- * exceeds psync->tx_buf.size, this will return an error. Use dartt_write_multi to automatically manage
- * multi-frame transmission for undersized transmit buffers.
- * 
- * @param ctl Pointer to the memory within the master control structure that you want to write. Essentially just an alias into 
- * the master control structure
- * @param psync Sync structure defining the control memory base, blocking read/write callbacks and memory structures 
- */
-int dartt_ctl_write(dartt_mem_t * ctl, dartt_sync_t * psync)
+ * @brief This function scans two buffers (one control and one peripheral) for the presence of any mismatch between control and peripheral.
+ * If a difference is found, the master then writes the control copy content TO the target device, and reads it back into the shadow copy to verify a match.
+ * Access to hardware is managed with callback function pointers. Callback function pointers must be loaded into *psync
+ *
+ * @param ctl Pointer to the region within ctl_base that should be synchronized. This is the subset of the master copy
+ *            we are synchronizing to the peripheral device. Must be equal to or within psync->ctl_base or function returns error.
+ *            The corresponding region in psync->periph_base is compared, and if different, the peripheral is updated and
+ *            read back to verify the write succeeded.
+ * @param psync Pointer to a dartt_sync_t structure containing the address, serial callbacks, message type, ctl_base,
+ *              periph_base (shadow copy), and communication buffers.
+ * @return DARTT_PROTOCOL_SUCCESS on success, error code on failure. If the peripheral answers the read-back with an
+ *         error reply, its error code is returned without waiting for a timeout.
+ * @note Each mismatched span (write and read-back) is retransmitted according to psync->retry. Spans that were already
+ *       synchronized are not sent again, since the shadow copy is updated span by span.
+ * */
+int dartt_sync(dartt_mem_t * ctl, dartt_sync_t * psync)
+{
+	STATS_START(psync);
+	int rc = sync_region(ctl, psync);
+	STATS_STOP(psync, DARTT_OP_SYNC, rc);
+	return rc;
+}
+
+/*
+	Single attempt at dartt_ctl_write
+*/
+static int ctl_write_frame(dartt_mem_t * ctl, dartt_sync_t * psync)
 {
     DARTT_ASSERT(psync != NULL);
     DARTT_ASSERT(psync->ctl_base.buf != NULL && psync->blocking_tx_callback != NULL && psync->tx_buf.buf != NULL);
@@ -279,7 +446,7 @@ int dartt_ctl_write(dartt_mem_t * ctl, dartt_sync_t * psync)
     misc_write_message_t write_msg =
     {
             .address = misc_address,
-            .index = field_index + psync->base_offset,
+            .index = msg_index(psync, (size_t)field_index),
             .payload = {
                     .buf = ctl->buf,
                     .size = ctl->size,
@@ -292,84 +459,76 @@ int dartt_ctl_write(dartt_mem_t * ctl, dartt_sync_t * psync)
         return rc;
     }
     //blocking write callback
-    return (*(psync->blocking_tx_callback))(misc_address, &psync->tx_buf, psync->user_context_tx, psync->timeout_ms);
+    return send_tx_buf(psync, misc_address, 0);
 }
 
-
 /**
- * @brief This function creates a master dartt write/read sequence to read data from the peripheral device
- * and store it in the shadow copy (psync->periph_base). It is primarily used as a helper function -
- * the wrapper dartt_read_multi is preferred in almost all situations, unless the full reply will fit in psync->rx_buf.
- *
- * IMPORTANT: The ctl parameter specifies WHAT to read (the memory region), but results are stored in psync->periph_base
- * at the corresponding offset, NOT in the ctl buffer itself.
- *
- * @param ctl The region of memory (within ctl_base) specifying WHAT to read from the peripheral device.
- *            The ctl->len field specifies how many bytes to read. Results are stored in psync->periph_base
- *            at the offset corresponding to ctl's position within ctl_base.
- * @param psync Sync structure defining the control memory base (ctl_base), peripheral shadow copy base (periph_base),
- *              blocking read/write callbacks and memory structures.
- * @return DARTT_PROTOCOL_SUCCESS on success, error code on failure
+ * @brief This function implements a full wrapper for dartt write frames.
+ * You pass by reference a buffer to a region you want to write, located within the base control structure.
+ * ctl must be within psync->ctl_base or the function will return an error. Additionally, if ctl->len
+ * exceeds psync->tx_buf.size, this will return an error. Use dartt_write_multi to automatically manage
+ * multi-frame transmission for undersized transmit buffers.
+ * 
+ * @param ctl Pointer to the memory within the master control structure that you want to write. Essentially just an alias into 
+ * the master control structure
+ * @param psync Sync structure defining the control memory base, blocking read/write callbacks and memory structures 
+ * @note The frame is retransmitted according to psync->retry.
  */
-int dartt_ctl_read(dartt_mem_t * ctl, dartt_sync_t * psync)
+int dartt_ctl_write(dartt_mem_t * ctl, dartt_sync_t * psync)
+{
+	STATS_START(psync);
+	uint32_t attempt = 0;
+	int rc;
+	do
+	{
+		rc = ctl_write_frame(ctl, psync);
+	}while(retry_frame(psync, rc, &attempt));
+	STATS_STOP(psync, DARTT_OP_CTL_WRITE, rc);
+	return rc;
+}
+
+
+/*
+	Checks that ctl is a 32 bit aligned region within ctl_base and stores its byte offset in *bidx
+*/
+static int check_ctl_region(const dartt_mem_t * ctl, const dartt_sync_t * psync, size_t * bidx)
 {
-    DARTT_ASSERT(psync != NULL);
-	DARTT_ASSERT(psync->ctl_base.size == psync->periph_base.size);
-    DARTT_ASSERT(psync->ctl_base.buf != NULL && psync->blocking_tx_callback != NULL && psync->tx_buf.buf != NULL);
-	DARTT_ASSERT(psync->periph_base.buf != NULL);
-    DARTT_ASSERT(psync->rx_buf.size != 0);
-    DARTT_ASSERT(psync->tx_buf.size != 0);
     int cm = check_mem_base(ctl);
     if(cm != DARTT_PROTOCOL_SUCCESS)
     {
         return cm;
     }
     // Runtime checks for buffer bounds - these could be caused by developer error in ctl configuration
-    if(ctl->size == 0)
-    {
-        return DARTT_ERROR_INVALID_ARGUMENT;
-    }
-    if (ctl->buf < psync->ctl_base.buf || ctl->buf >= (psync->ctl_base.buf + psync->ctl_base.size)) 
-    {
-        return DARTT_ERROR_MEMORY_OVERRUN;
-    }
-    if (ctl->buf + ctl->size > psync->ctl_base.buf + psync->ctl_base.size) 
+    if(ctl->buf < psync->ctl_base.buf || ctl->buf >= (psync->ctl_base.buf + psync->ctl_base.size))
     {
         return DARTT_ERROR_MEMORY_OVERRUN;
     }
-    if (ctl->buf + ctl->size > psync->ctl_base.buf + psync->ctl_base.size) 
+    *bidx = (size_t)(ctl->buf - psync->ctl_base.buf);	//safe due to the guard above
+    if(ctl->size > psync->ctl_base.size - *bidx)
     {
         return DARTT_ERROR_MEMORY_OVERRUN;
     }
-    //ensure the read reply we're requesting won't overrun the read buffer
-    size_t nb_overhead_read_reply = NUM_BYTES_READ_REPLY_OVERHEAD_PLD;
-    if(psync->msg_type == TYPE_SERIAL_MESSAGE)
-    {
-    	nb_overhead_read_reply += NUM_BYTES_ADDRESS + NUM_BYTES_CHECKSUM;
-    }
-    else if(psync->msg_type == TYPE_ADDR_MESSAGE)
+    if(*bidx % sizeof(int32_t) != 0)
     {
-    	nb_overhead_read_reply += NUM_BYTES_CHECKSUM;
+        return DARTT_ERROR_INVALID_ARGUMENT;
     }
-	if(ctl->size + nb_overhead_read_reply > psync->rx_buf.size)
-	{
-		return DARTT_ERROR_MEMORY_OVERRUN;
-	}
-
-
+    return DARTT_PROTOCOL_SUCCESS;
+}
 
+/*
+	Single attempt at reading nbytes at byte offset bidx of the region into the shadow copy. Performs no argument
+	checks: the caller has checked the configuration, that the span is 32 bit aligned and within ctl_base, and that
+	its reply fits rx_buf
+*/
+static int ctl_read_frame_unchecked(dartt_sync_t * psync, size_t bidx, size_t nbytes)
+{
     unsigned char misc_address = dartt_get_complementary_address(psync->address);
-    
-    int field_index = index_of_field( (void*)(&ctl->buf[0]), (void*)(&psync->ctl_base.buf[0]), psync->ctl_base.size );
-    if(field_index < 0)
-    {
-        return field_index; //negative values are error codes, return if you get negative value
-    }
+    uint32_t field_index = (uint32_t)(bidx / sizeof(int32_t));
     misc_read_message_t read_msg =
     {
             .address = misc_address,
-            .index = field_index + psync->base_offset,	//load with offset to the destination
-            .num_bytes = (uint16_t)ctl->size
+            .index = msg_index(psync, field_index),	//load with offset to the destination
+            .num_bytes = (uint16_t)nbytes
     };
 
     int rc = dartt_create_read_frame(&read_msg, psync->msg_type, &psync->tx_buf);
@@ -378,129 +537,294 @@ int dartt_ctl_read(dartt_mem_t * ctl, dartt_sync_t * psync)
     {
         return rc;
     }
-    rc = (*(psync->blocking_tx_callback))(misc_address, &psync->tx_buf, psync->user_context_tx, psync->timeout_ms);
+    rc = send_tx_buf(psync, misc_address, 1);
     if(rc != DARTT_PROTOCOL_SUCCESS)
     {
         return rc;
     }
 
-    rc = (*(psync->blocking_rx_callback))(&psync->rx_buf, psync->user_context_rx, psync->timeout_ms);
-    if(rc != DARTT_PROTOCOL_SUCCESS)
-    {
-        return rc;
-    }
-    if(psync->rx_buf.len == 0)  //check for failure to reply. rx blocking should return 0 length if 0 length was obtained
-    {
-        return DARTT_ERROR_MALFORMED_MESSAGE;
-    }
-    payload_layer_msg_t pld_msg = {};
-    rc = dartt_frame_to_payload(&psync->rx_buf, psync->msg_type, PAYLOAD_ALIAS, &pld_msg);
-    if(rc != DARTT_PROTOCOL_SUCCESS)
-    {
-        return rc;
-    }
-	if(psync->base_offset != 0)
+	//a reply to an earlier attempt (or an earlier chunk) that arrived after its timeout is still queued on the link.
+	//Its word index differs from this request's: discard it and keep receiving, so it cannot land at the wrong offset
+	payload_layer_msg_t pld_msg = {};
+	for(int stale = 0; ; stale++)
 	{
+		if(stale > DARTT_MAX_STALE_REPLIES)
+		{
+			return DARTT_ERROR_TIMEOUT;
+		}
+		rc = receive_rx_buf(psync);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
+		if(psync->rx_buf.len == 0)  //check for failure to reply. rx blocking should return 0 length if 0 length was obtained
+		{
+			return DARTT_ERROR_MALFORMED_MESSAGE;
+		}
+		rc = dartt_frame_to_payload(&psync->rx_buf, psync->msg_type, PAYLOAD_ALIAS, &pld_msg);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
 		//parse read reply gets the shadow copy offset from the data itself, not from the read message.
-		//so if it's nonzero, do a little extra work: extract it, subtract it, and re-insert it to the raw message data.
-		pld_msg.index_arg -= psync->base_offset;
+		//so extract the word index, remove the offset, and re-insert it to the raw message data.
+		pld_msg.index_arg = DARTT_INDEX_WORD(pld_msg.index_arg) - psync->base_offset;
+		if(pld_msg.index_arg == read_msg.index)	//error replies echo the request index too
+		{
+			break;
+		}
 	}
     return dartt_parse_read_reply(&pld_msg, &read_msg, &psync->periph_base);
 }
 
+/*
+	dartt_ctl_read of a checked span: retransmitted according to psync->retry and counted as a DARTT_OP_CTL_READ
+*/
+static int ctl_read_unchecked(dartt_sync_t * psync, size_t bidx, size_t nbytes)
+{
+	STATS_START(psync);
+	uint32_t attempt = 0;
+	int rc;
+	do
+	{
+		rc = ctl_read_frame_unchecked(psync, bidx, nbytes);
+	}while(retry_frame(psync, rc, &attempt));
+	STATS_STOP(psync, DARTT_OP_CTL_READ, rc);
+	return rc;
+}
+
 /**
- * @brief Wrapper for dartt_ctl_read that automatically breaks large read operations into multiple
- * smaller read messages to fit within available buffer space.
+ * @brief This function creates a master dartt write/read sequence to read data from the peripheral device
+ * and store it in the shadow copy (psync->periph_base). It is primarily used as a helper function -
+ * the wrapper dartt_read_multi is preferred in almost all situations, unless the full reply will fit in psync->rx_buf.
  *
- * IMPORTANT: Like dartt_ctl_read, the ctl parameter specifies WHAT to read, but results go into psync->periph_base.
- * This function will automatically split the read into multiple operations if needed.
+ * IMPORTANT: The ctl parameter specifies WHAT to read (the memory region), but results are stored in psync->periph_base
+ * at the corresponding offset, NOT in the ctl buffer itself.
  *
- * @param ctl Pointer to region within ctl_base specifying WHAT to read. The function will automatically
- *            split this into multiple read operations if the requested length exceeds available rx buffer space.
- *            Results are stored in psync->periph_base at the corresponding offset.
- * @param psync Sync structure with ctl_base, periph_base, callbacks, and buffers.
- * @return DARTT_PROTOCOL_SUCCESS on success, error code on failure
+ * @param ctl The region of memory (within ctl_base) specifying WHAT to read from the peripheral device.
+ *            The ctl->len field specifies how many bytes to read. Results are stored in psync->periph_base
+ *            at the offset corresponding to ctl's position within ctl_base.
+ * @param psync Sync structure defining the control memory base (ctl_base), peripheral shadow copy base (periph_base),
+ *              blocking read/write callbacks and memory structures.
+ * @return DARTT_PROTOCOL_SUCCESS on success, error code on failure. If the peripheral rejects the request with an
+ *         error reply, its error code is returned (DARTT_ERROR_MEMORY_OVERRUN, DARTT_ERROR_ACCESS_DENIED, ...).
+ * @note The request is retransmitted according to psync->retry. The arguments are checked once, before the first attempt.
+ * @note Replies for another word index, such as a late reply to an earlier attempt, are discarded (at most
+ * DARTT_MAX_STALE_REPLIES per attempt) while waiting for the reply to this request.
  */
-int dartt_read_multi(dartt_mem_t * ctl, dartt_sync_t * psync)
+int dartt_ctl_read(dartt_mem_t * ctl, dartt_sync_t * psync)
 {
     DARTT_ASSERT(psync != NULL);
-	DARTT_ASSERT(psync->ctl_base.buf != NULL && psync->periph_base.buf != NULL);
-	DARTT_ASSERT(psync->ctl_base.buf != psync->periph_base.buf);	//basic sanity check - the master and shadow copy can't point to the same memory
-    int cm = check_mem_base(ctl);
-    if(cm != DARTT_PROTOCOL_SUCCESS)
-    {
-        return cm;
-    }
+	DARTT_ASSERT(psync->ctl_base.size == psync->periph_base.size);
+    DARTT_ASSERT(psync->ctl_base.buf != NULL && psync->blocking_tx_callback != NULL && psync->tx_buf.buf != NULL);
+	DARTT_ASSERT(psync->periph_base.buf != NULL);
+    DARTT_ASSERT(psync->rx_buf.size != 0);
+    DARTT_ASSERT(psync->tx_buf.size != 0);
+	size_t bidx = 0;
+	int rc = check_ctl_region(ctl, psync, &bidx);
+	if(rc == DARTT_PROTOCOL_SUCCESS)
+	{
+		//ensure the read reply we're requesting won't overrun the read buffer
+		size_t nb_overhead_read_reply = region_overhead(psync);
+		if(nb_overhead_read_reply == 0)
+		{
+			rc = DARTT_ERROR_INVALID_ARGUMENT;
+		}
+		else if(ctl->size + nb_overhead_read_reply > psync->rx_buf.size)
+		{
+			rc = DARTT_ERROR_MEMORY_OVERRUN;
+		}
+	}
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		STATS_START(psync);
+		STATS_ERROR(psync, rc);
+		STATS_STOP(psync, DARTT_OP_CTL_READ, rc);
+		return rc;
+	}
+	return ctl_read_unchecked(psync, bidx, ctl->size);
+}
+
+/*
+	Largest 32 bit aligned chunk that fits a buf_size buffer after overhead bytes of framing. With a
+	frame_len_callback, the chunk is instead the one that wastes the smallest share of its padded frame on padding,
+	largest first on ties, so that e.g. a CAN-FD link with 40 byte buffers sends 28 byte chunks in full 32 byte frames
+	rather than 36 byte chunks in 48 byte frames. Returns 0 if no chunk of at least one word can be sent
+*/
+static size_t chunk_size(const dartt_sync_t * psync, size_t buf_size, size_t overhead)
+{
+	if(buf_size < overhead + sizeof(int32_t))
+	{
+		return 0;
+	}
+	size_t limit = buf_size - overhead;
+	limit -= limit % sizeof(int32_t);
+	if(psync->frame_len_callback == NULL)
+	{
+		return limit;
+	}
+	size_t best = 0;
+	size_t best_wire = 0;
+	for(size_t chunk = limit; chunk >= sizeof(int32_t); chunk -= sizeof(int32_t))
+	{
+		size_t wire = psync->frame_len_callback(chunk + overhead);
+		if(wire < chunk + overhead)
+		{
+			continue;	//too long for the link
+		}
+		if(best == 0 || chunk * best_wire > best * wire)	//chunk/wire > best/best_wire
+		{
+			best = chunk;
+			best_wire = wire;
+		}
+	}
+	return best;
+}
+
+/**
+ * @brief Validate the configuration of a dartt_sync_t once, ahead of a run of transfers.
+ *
+ * Checks the callbacks, buffers, regions and message type, and caches the chunk sizes of dartt_read_multi and
+ * dartt_write_multi. While psync->prepared is set, those functions skip the configuration checks and only check the
+ * region they are given, once per call. dartt_read_multi then sends every chunk without further argument checks,
+ * which matters most on small frames (e.g. CAN), where a region is split into many chunks.
+ *
+ * @param psync Sync structure, fully configured
+ * @return DARTT_PROTOCOL_SUCCESS, with psync->prepared set. DARTT_ERROR_INVALID_ARGUMENT for a missing callback or
+ *         buffer, an invalid message type, or ctl_base and periph_base sharing memory. DARTT_ERROR_MEMORY_OVERRUN if
+ *         ctl_base and periph_base differ in size, the region extends beyond the extended index range, or tx_buf or rx_buf
+ *         cannot hold a frame with one word of data. psync->prepared is cleared on failure.
+ * @note Call again after changing msg_type, the buffers, the regions, base_offset or frame_len_callback, or clear
+ * psync->prepared to fall back to checking on every call.
+ */
+int dartt_sync_prepare(dartt_sync_t * psync)
+{
+	if(psync == NULL)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	psync->prepared = 0;
+	if(psync->blocking_tx_callback == NULL || psync->blocking_rx_callback == NULL)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	int cb = check_mem_base(&psync->ctl_base);
+	if(cb == DARTT_PROTOCOL_SUCCESS)
+	{
+		cb = check_mem_base(&psync->periph_base);
+	}
+	if(cb == DARTT_PROTOCOL_SUCCESS)
+	{
+		cb = check_buffer(&psync->tx_buf);
+	}
+	if(cb == DARTT_PROTOCOL_SUCCESS)
+	{
+		cb = check_buffer(&psync->rx_buf);
+	}
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	if(psync->ctl_base.buf == psync->periph_base.buf)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;	//the master and shadow copy can't point to the same memory
+	}
 	if(psync->ctl_base.size != psync->periph_base.size)
 	{
 		return DARTT_ERROR_MEMORY_OVERRUN;
 	}
-    if(!(ctl->buf >= psync->ctl_base.buf && ctl->buf < psync->ctl_base.buf + psync->ctl_base.size))
-    {
-        return DARTT_ERROR_MEMORY_OVERRUN;
-    }
-    size_t nbytes_read_overhead = NUM_BYTES_READ_REPLY_OVERHEAD_PLD;  //
-    if(psync->msg_type == TYPE_SERIAL_MESSAGE)
-    {
-		nbytes_read_overhead += (NUM_BYTES_ADDRESS + NUM_BYTES_CHECKSUM);
-    }
-    else if(psync->msg_type == TYPE_ADDR_MESSAGE)
-    {
-        nbytes_read_overhead += NUM_BYTES_CHECKSUM;
-    }
-    else if(psync->msg_type != TYPE_ADDR_CRC_MESSAGE)
-    {
-        return DARTT_ERROR_INVALID_ARGUMENT;
-    }
-	if(psync->rx_buf.size < nbytes_read_overhead + sizeof(int32_t))
+	if(psync->base_offset + (psync->ctl_base.size + sizeof(int32_t) - 1)/sizeof(int32_t) > DARTT_INDEX_EXTENDED_BIT)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	size_t overhead = region_overhead(psync);
+	if(overhead == 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	size_t rsize = chunk_size(psync, psync->rx_buf.size, overhead);
+	size_t wsize = chunk_size(psync, psync->tx_buf.size, overhead);
+	if(rsize == 0 || wsize == 0)
 	{
 		return DARTT_ERROR_MEMORY_OVERRUN;
 	}
-	size_t rsize = psync->rx_buf.size - nbytes_read_overhead;
-    rsize -= rsize % sizeof(uint32_t); //after making sure the dartt framing bytes are removed, you must ensure that the read size is 32 bit aligned for index_of_field
+	psync->read_chunk = rsize;
+	psync->write_chunk = wsize;
+	psync->prepared = 1;
+	return DARTT_PROTOCOL_SUCCESS;
+}
 
-    int num_full_reads_required = (int)(ctl->size/rsize); 
-    int i = 0;
-    for(i = 0; i < num_full_reads_required; i++)
-    {
-        dartt_mem_t ctl_chunk = 
-        {
-            .buf = ctl->buf + rsize * i,
-            .size = rsize,
-        };
-        int rc = dartt_ctl_read(&ctl_chunk, psync);
-        if(rc != DARTT_PROTOCOL_SUCCESS)
-        {
-            return rc;
-        }
-    }
-	size_t last_read_size = ctl->size % rsize;
-	if(last_read_size != 0)
+/*
+	Body of dartt_read_multi
+*/
+static int read_multi(dartt_mem_t * ctl, dartt_sync_t * psync)
+{
+    DARTT_ASSERT(psync != NULL);
+	DARTT_ASSERT(psync->ctl_base.buf != NULL && psync->periph_base.buf != NULL);
+	DARTT_ASSERT(psync->ctl_base.buf != psync->periph_base.buf);	//basic sanity check - the master and shadow copy can't point to the same memory
+	size_t rsize = psync->read_chunk;
+	if(!psync->prepared)
 	{
-		dartt_mem_t ctl_last_chunk = 
+		if(psync->ctl_base.size != psync->periph_base.size)
 		{
-			.buf = ctl->buf + rsize * i,
-			.size = last_read_size,
-		};
-		return dartt_ctl_read(&ctl_last_chunk, psync); //pass final read rc
+			return DARTT_ERROR_MEMORY_OVERRUN;
+		}
+		size_t nbytes_read_overhead = region_overhead(psync);
+		if(nbytes_read_overhead == 0)
+		{
+			return DARTT_ERROR_INVALID_ARGUMENT;
+		}
+		rsize = chunk_size(psync, psync->rx_buf.size, nbytes_read_overhead); //after making sure the dartt framing bytes are removed, you must ensure that the read size is 32 bit aligned for index_of_field
+		if(rsize == 0)
+		{
+			return DARTT_ERROR_MEMORY_OVERRUN;
+		}
+	}
+	size_t bidx = 0;
+	int rc = check_ctl_region(ctl, psync, &bidx);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
 	}
-	else
+
+	//the region is checked as a whole, so its chunks are read without the per frame checks of dartt_ctl_read
+	for(size_t offset = 0; offset < ctl->size; offset += rsize)
 	{
-		return DARTT_PROTOCOL_SUCCESS;
+		size_t nbytes = (ctl->size - offset < rsize) ? (ctl->size - offset) : rsize;
+		rc = ctl_read_unchecked(psync, bidx + offset, nbytes);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
 	}
+	return DARTT_PROTOCOL_SUCCESS;
 }
 
 /**
- * @brief Wrapper for dartt_ctl_write that automatically breaks large write operations into multiple
- * smaller write messages for undersized write buffers.
+ * @brief Wrapper for dartt_ctl_read that automatically breaks large read operations into multiple
+ * smaller read messages to fit within available buffer space.
  *
- * @param ctl Pointer to region within ctl_base specifying WHAT to write. The function will automatically
- *            split this into multiple write operations if the requested length exceeds available tx buffer space.
- * 
+ * IMPORTANT: Like dartt_ctl_read, the ctl parameter specifies WHAT to read, but results go into psync->periph_base.
+ * This function will automatically split the read into multiple operations if needed.
+ *
+ * @param ctl Pointer to region within ctl_base specifying WHAT to read. The function will automatically
+ *            split this into multiple read operations if the requested length exceeds available rx buffer space.
+ *            Results are stored in psync->periph_base at the corresponding offset.
  * @param psync Sync structure with ctl_base, periph_base, callbacks, and buffers.
  * @return DARTT_PROTOCOL_SUCCESS on success, error code on failure
  */
-int dartt_write_multi(dartt_mem_t * ctl, dartt_sync_t * psync)
+int dartt_read_multi(dartt_mem_t * ctl, dartt_sync_t * psync)
+{
+	STATS_START(psync);
+	int rc = read_multi(ctl, psync);
+	STATS_STOP(psync, DARTT_OP_READ_MULTI, rc);
+	return rc;
+}
+
+/*
+	Body of dartt_write_multi
+*/
+static int write_multi(dartt_mem_t * ctl, dartt_sync_t * psync)
 {
 	DARTT_ASSERT(psync != NULL);
     int cm = check_mem_base(ctl);
@@ -508,30 +832,20 @@ int dartt_write_multi(dartt_mem_t * ctl, dartt_sync_t * psync)
     {
         return cm;
     }
-    size_t nbytes_writemsg_overhead = 0;
-    if(psync->msg_type == TYPE_SERIAL_MESSAGE)
-    {
-    	nbytes_writemsg_overhead = (NUM_BYTES_ADDRESS + NUM_BYTES_INDEX + NUM_BYTES_CHECKSUM);	//serial message writes have the maximum overhead, 5 bytes
-    }
-    else if(psync->msg_type == TYPE_ADDR_MESSAGE)
-    {
-    	nbytes_writemsg_overhead = (NUM_BYTES_INDEX + NUM_BYTES_CHECKSUM);	//if inherently addressed, 4 bytes
-    }
-    else if(psync->msg_type == TYPE_ADDR_CRC_MESSAGE)
-    {
-    	nbytes_writemsg_overhead = NUM_BYTES_INDEX;	//if inherently addressed and error checked, only two bytes
-    }
-    else
-    {
-    	return DARTT_ERROR_INVALID_ARGUMENT;
-    }
-	if(psync->tx_buf.size < nbytes_writemsg_overhead + sizeof(int32_t)) 	//for completeness, due to DARTT indexing every 4 bytes, you must at minimum be able to write out one full 4 byte word for complete write access
+	size_t wsize = psync->write_chunk;
+	if(!psync->prepared)
 	{
-		return DARTT_ERROR_MEMORY_OVERRUN;
+		size_t nbytes_writemsg_overhead = region_overhead(psync);	//5 bytes for serial messages, 4 if inherently addressed, 2 if also error checked
+		if(nbytes_writemsg_overhead == 0)
+		{
+			return DARTT_ERROR_INVALID_ARGUMENT;
+		}
+		wsize = chunk_size(psync, psync->tx_buf.size, nbytes_writemsg_overhead);	//must make sure every chunkified write is 32bit aligned due to dartt indexing
+		if(wsize == 0) 	//for completeness, due to DARTT indexing every 4 bytes, you must at minimum be able to write out one full 4 byte word for complete write access
+		{
+			return DARTT_ERROR_MEMORY_OVERRUN;
+		}
 	}
-	
-	size_t wsize = psync->tx_buf.size - nbytes_writemsg_overhead;	
-	wsize -= wsize % sizeof(int32_t);	//must make sure every chunkified write is 32bit aligned due to dartt indexing
 
 	int num_undersized_writes = (int)(ctl->size / wsize);
 	int i = 0;
@@ -566,6 +880,24 @@ int dartt_write_multi(dartt_mem_t * ctl, dartt_sync_t * psync)
 	return DARTT_PROTOCOL_SUCCESS;
 }
 
+/**
+ * @brief Wrapper for dartt_ctl_write that automatically breaks large write operations into multiple
+ * smaller write messages for undersized write buffers.
+ *
+ * @param ctl Pointer to region within ctl_base specifying WHAT to write. The function will automatically
+ *            split this into multiple write operations if the requested length exceeds available tx buffer space.
+ * 
+ * @param psync Sync structure with ctl_base, periph_base, callbacks, and buffers.
+ * @return DARTT_PROTOCOL_SUCCESS on success, error code on failure
+ */
+int dartt_write_multi(dartt_mem_t * ctl, dartt_sync_t * psync)
+{
+	STATS_START(psync);
+	int rc = write_multi(ctl, psync);
+	STATS_STOP(psync, DARTT_OP_WRITE_MULTI, rc);
+	return rc;
+}
+
 
 /**
  * @brief Helper function for copying data FROM a specific region of the shadow copy TO the corresponding region in the controller copy.
@@ -601,9 +933,770 @@ int dartt_update_controller(dartt_mem_t * ctl, dartt_sync_t * psync)
 	{
 		return DARTT_ERROR_MEMORY_OVERRUN;	//memory overrun guard for the copy op we're about to do
 	}
-	for(int i = 0; i < ctl->size; i++)
+	dartt_copy(ctl->buf, psync->periph_base.buf + base_bidx, ctl->size);
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/*
+	Body of dartt_ctl_commit
+*/
+static int ctl_commit(dartt_sync_t * psync)
+{
+	DARTT_ASSERT(psync != NULL);
+	DARTT_ASSERT(psync->blocking_tx_callback != NULL && psync->tx_buf.buf != NULL);
+	unsigned char commit_pld = 0;	//write frames require a payload. Content is ignored by the peripheral
+	unsigned char misc_address = dartt_get_complementary_address(psync->address);
+	misc_write_message_t write_msg =
+	{
+			.address = misc_address,
+			.index = DARTT_INDEX_COMMIT,
+			.payload = {
+					.buf = &commit_pld,
+					.size = sizeof(commit_pld),
+					.len = sizeof(commit_pld)
+			}
+	};
+	int rc = dartt_create_write_frame(&write_msg, psync->msg_type, &psync->tx_buf);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	return send_tx_buf(psync, misc_address, 0);
+}
+
+/**
+ * @brief Commit staged writes on a peripheral that uses a staging buffer (see dartt_periph.h).
+ *
+ * Sends a write frame to the reserved index DARTT_INDEX_COMMIT. The peripheral applies all writes received since
+ * the last commit atomically. Peripherals without a staging buffer ignore the commit.
+ *
+ * @param psync Sync structure with address, message type, tx buffer and tx callback.
+ * @return DARTT_PROTOCOL_SUCCESS on success, error code on failure
+ *
+ * @note The commit index is absolute - psync->base_offset is not applied.
+ */
+int dartt_ctl_commit(dartt_sync_t * psync)
+{
+	STATS_START(psync);
+	int rc = ctl_commit(psync);
+	STATS_ERROR(psync, rc);
+	STATS_STOP(psync, DARTT_OP_COMMIT, rc);
+	return rc;
+}
+
+/*
+	Body of dartt_read_post
+*/
+static int read_post(dartt_mem_t * ctl, dartt_sync_t * psync, uint8_t * tag)
+{
+	DARTT_ASSERT(psync != NULL && tag != NULL);
+	DARTT_ASSERT(psync->ctl_base.buf != NULL && psync->blocking_tx_callback != NULL && psync->tx_buf.buf != NULL);
+	DARTT_ASSERT(psync->rx_buf.size != 0);
+	int cm = check_mem_base(ctl);
+	if(cm != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cm;
+	}
+	if(ctl->size == 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	if(ctl->buf < psync->ctl_base.buf || ctl->buf + ctl->size > psync->ctl_base.buf + psync->ctl_base.size)
 	{
-		ctl->buf[i] = psync->periph_base.buf[base_bidx + i];
+		return DARTT_ERROR_MEMORY_OVERRUN;
 	}
+	if(ctl->size + region_overhead(psync) + NUM_BYTES_TAG > psync->rx_buf.size)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	if(psync->num_pending >= DARTT_NUM_TAGS)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;	//table full. Poll for replies first
+	}
+	int field_index = index_of_field( (void*)(&ctl->buf[0]), (void*)(&psync->ctl_base.buf[0]), psync->ctl_base.size );
+	if(field_index < 0)
+	{
+		return field_index;
+	}
+
+	//next tag with a free slot. Tags run 1-255, skipping DARTT_TAG_NONE
+	uint8_t next = psync->last_tag;
+	do
+	{
+		next = (next == 0xFF) ? 1 : (uint8_t)(next + 1);
+	}while(psync->pending[next % DARTT_NUM_TAGS].tag != DARTT_TAG_NONE);
+
+	unsigned char misc_address = dartt_get_complementary_address(psync->address);
+	misc_read_message_t read_msg =
+	{
+			.address = misc_address,
+			.index = msg_index(psync, (size_t)field_index),
+			.num_bytes = (uint16_t)ctl->size,
+			.tag = next
+	};
+	int rc = dartt_create_read_frame(&read_msg, psync->msg_type, &psync->tx_buf);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	rc = send_tx_buf(psync, misc_address, 1);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	dartt_pending_read_t * slot = &psync->pending[next % DARTT_NUM_TAGS];
+	slot->index = (uint32_t)field_index;
+	slot->num_bytes = read_msg.num_bytes;
+	slot->tag = next;
+	psync->num_pending++;
+	psync->last_tag = next;
+	*tag = next;
 	return DARTT_PROTOCOL_SUCCESS;
 }
+
+/**
+ * @brief Send a tagged read request without waiting for the reply.
+ *
+ * Like dartt_ctl_read, but the request carries a tag that the peripheral echoes in its reply, and the request is
+ * recorded in psync->pending. Several requests can be in flight at once, and their replies may arrive in any order.
+ * Collect the replies with dartt_read_poll.
+ * On batching transports (see flush_tx_callback) the request may be queued until the next reception.
+ *
+ * @param ctl Region within ctl_base specifying WHAT to read. The reply must fit in psync->rx_buf.
+ *            Results are stored in psync->periph_base at the corresponding offset when the reply is polled.
+ * @param psync Sync structure with ctl_base, periph_base, tx callback and buffers.
+ * @param tag Receives the tag assigned to the request
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_MEMORY_OVERRUN if DARTT_NUM_TAGS requests are already
+ *         outstanding or the reply would not fit in rx_buf, error code on other failures
+ */
+int dartt_read_post(dartt_mem_t * ctl, dartt_sync_t * psync, uint8_t * tag)
+{
+	STATS_START(psync);
+	int rc = read_post(ctl, psync, tag);
+	STATS_ERROR(psync, rc);
+	STATS_STOP(psync, DARTT_OP_READ_POST, rc);
+	return rc;
+}
+
+/*
+	Body of dartt_read_poll
+*/
+static int read_poll(dartt_sync_t * psync, uint8_t * tag)
+{
+	DARTT_ASSERT(psync != NULL && tag != NULL);
+	DARTT_ASSERT(psync->blocking_rx_callback != NULL && psync->rx_buf.buf != NULL);
+	DARTT_ASSERT(psync->periph_base.buf != NULL);
+	int rc = receive_rx_buf(psync);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	if(psync->rx_buf.len == 0)
+	{
+		return DARTT_ERROR_MALFORMED_MESSAGE;
+	}
+	payload_layer_msg_t pld_msg = {};
+	rc = dartt_frame_to_payload(&psync->rx_buf, psync->msg_type, PAYLOAD_ALIAS, &pld_msg);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	uint8_t reply_tag = DARTT_TAG_NONE;
+	rc = dartt_strip_reply_tag(&pld_msg, &reply_tag);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	dartt_pending_read_t * slot = &psync->pending[reply_tag % DARTT_NUM_TAGS];
+	if(reply_tag == DARTT_TAG_NONE || slot->tag != reply_tag)
+	{
+		return DARTT_ERROR_TAG_MISMATCH;
+	}
+	misc_read_message_t read_msg =
+	{
+			.index = slot->index,
+			.num_bytes = slot->num_bytes,
+			.tag = slot->tag
+	};
+	slot->tag = DARTT_TAG_NONE;	//retire the request, whatever the outcome
+	psync->num_pending--;
+	*tag = reply_tag;
+
+	rc = dartt_check_error_reply(&pld_msg);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	pld_msg.index_arg = DARTT_INDEX_WORD(pld_msg.index_arg) - psync->base_offset;
+	if(pld_msg.index_arg != read_msg.index)
+	{
+		return DARTT_ERROR_MALFORMED_MESSAGE;
+	}
+	return dartt_parse_read_reply(&pld_msg, &read_msg, &psync->periph_base);
+}
+
+/**
+ * @brief Receive one reply to a tagged read request and match it to the outstanding request by tag.
+ *
+ * Calls blocking_rx_callback once. On a match the reply is copied into psync->periph_base and the request is retired.
+ *
+ * @param psync Sync structure with periph_base, rx callback and buffers.
+ * @param tag Receives the tag of the request the reply belongs to, if it matched one
+ * @return DARTT_PROTOCOL_SUCCESS if a reply was received and applied.
+ *         DARTT_ERROR_TAG_MISMATCH if the reply does not belong to an outstanding request (a stale or duplicate reply).
+ *         It is discarded, and the caller should poll again.
+ *         The peripheral's error code if the request was rejected (*tag identifies it, and it is retired).
+ *         Other error codes on rx or framing failures.
+ */
+int dartt_read_poll(dartt_sync_t * psync, uint8_t * tag)
+{
+	STATS_START(psync);
+	int rc = read_poll(psync, tag);
+	STATS_ERROR(psync, rc);
+	STATS_STOP(psync, DARTT_OP_READ_POLL, rc);
+	return rc;
+}
+
+/**
+ * @brief Forget all outstanding tagged reads, for instance after a timeout or a link reset.
+ * Late replies to flushed requests are reported as DARTT_ERROR_TAG_MISMATCH by dartt_read_poll.
+ *
+ * @param psync Sync structure
+ */
+void dartt_read_flush(dartt_sync_t * psync)
+{
+	DARTT_ASSERT(psync != NULL);
+	for(int i = 0; i < DARTT_NUM_TAGS; i++)
+	{
+		psync->pending[i].tag = DARTT_TAG_NONE;
+	}
+	psync->num_pending = 0;
+}
+
+/*
+	Body of dartt_read_multi_pipelined
+*/
+static int read_multi_pipelined(dartt_mem_t * ctl, dartt_sync_t * psync)
+{
+	DARTT_ASSERT(psync != NULL);
+	DARTT_ASSERT(psync->ctl_base.buf != NULL && psync->periph_base.buf != NULL);
+	DARTT_ASSERT(psync->ctl_base.buf != psync->periph_base.buf);
+	int cm = check_mem_base(ctl);
+	if(cm != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cm;
+	}
+	if(psync->ctl_base.size != psync->periph_base.size)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	if(ctl->buf < psync->ctl_base.buf || ctl->buf + ctl->size > psync->ctl_base.buf + psync->ctl_base.size)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	if(psync->num_pending != 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;	//replies to the caller's own requests could not be told apart from ours
+	}
+	size_t overhead = region_overhead(psync);
+	if(overhead == 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	size_t rsize = chunk_size(psync, psync->rx_buf.size, overhead + NUM_BYTES_TAG);	//chunks after the first must stay 32 bit aligned for index_of_field
+	if(rsize == 0)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+
+	size_t next = 0;
+	while(next < ctl->size || psync->num_pending != 0)
+	{
+		int rc;
+		uint8_t tag = DARTT_TAG_NONE;
+		if(next < ctl->size && psync->num_pending < DARTT_NUM_TAGS)
+		{
+			dartt_mem_t chunk =
+			{
+				.buf = ctl->buf + next,
+				.size = (ctl->size - next < rsize) ? (ctl->size - next) : rsize
+			};
+			rc = dartt_read_post(&chunk, psync, &tag);
+			next += chunk.size;
+		}
+		else
+		{
+			rc = dartt_read_poll(psync, &tag);
+			if(rc == DARTT_ERROR_TAG_MISMATCH)
+			{
+				continue;	//late reply to an earlier, abandoned request
+			}
+		}
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			dartt_read_flush(psync);
+			return rc;
+		}
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Pipelined version of dartt_read_multi.
+ *
+ * The region is split into chunks that fit psync->rx_buf, like dartt_read_multi, but up to DARTT_NUM_TAGS tagged
+ * requests are kept in flight instead of waiting for each reply before sending the next request. On links with a
+ * round trip much longer than a frame time (UDP, USB serial adapters) this divides the transfer time by up to
+ * DARTT_NUM_TAGS. On batching transports the requests and replies also share syscalls.
+ *
+ * @param ctl Region within ctl_base specifying WHAT to read. Results are stored in psync->periph_base at the
+ *            corresponding offset.
+ * @param psync Sync structure. Must have no tagged reads outstanding.
+ * @return DARTT_PROTOCOL_SUCCESS if every chunk was read, DARTT_ERROR_INVALID_ARGUMENT if tagged reads are already
+ *         outstanding, the first error code otherwise.
+ * @note The retransmission policy is not applied. On failure the outstanding requests are flushed, and the caller can
+ * fall back to dartt_read_multi, which retries frame by frame.
+ */
+int dartt_read_multi_pipelined(dartt_mem_t * ctl, dartt_sync_t * psync)
+{
+	STATS_START(psync);
+	int rc = read_multi_pipelined(ctl, psync);
+	STATS_STOP(psync, DARTT_OP_READ_MULTI_PIPELINED, rc);
+	return rc;
+}
+
+/*
+	Single attempt at a CRC32 query of nbytes at byte offset bidx of the region. Performs no argument checks
+*/
+static int crc32_frame_unchecked(dartt_sync_t * psync, size_t bidx, size_t nbytes, uint32_t * crc)
+{
+	unsigned char misc_address = dartt_get_complementary_address(psync->address);
+	misc_crc32_query_t query =
+	{
+			.address = misc_address,
+			.word = (uint32_t)(bidx / sizeof(int32_t) + psync->base_offset),
+			.num_bytes = (uint32_t)nbytes,
+			.tag = DARTT_TAG_NONE
+	};
+	int rc = dartt_create_crc32_query(&query, psync->msg_type, &psync->tx_buf);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	rc = send_tx_buf(psync, misc_address, 1);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	rc = receive_rx_buf(psync);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	if(psync->rx_buf.len == 0)
+	{
+		return DARTT_ERROR_MALFORMED_MESSAGE;
+	}
+	payload_layer_msg_t pld_msg = {};
+	rc = dartt_frame_to_payload(&psync->rx_buf, psync->msg_type, PAYLOAD_ALIAS, &pld_msg);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	return dartt_parse_crc32_reply(&pld_msg, crc);
+}
+
+/*
+	tx_buf and rx_buf must hold a CRC32 query and its reply. Checked before a bulk transfer starts, so it does not
+	fail after its first window
+*/
+static int check_crc32_room(const dartt_sync_t * psync)
+{
+	size_t overhead = dartt_rw_overhead(psync->msg_type);
+	if(overhead == 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	if(psync->tx_buf.size < overhead + NUM_BYTES_CRC32_QUERY || psync->rx_buf.size < overhead + NUM_BYTES_CRC32)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/*
+	dartt_read_crc32 of a checked span: retransmitted according to psync->retry and counted as a DARTT_OP_READ_CRC32
+*/
+static int read_crc32_unchecked(dartt_sync_t * psync, size_t bidx, size_t nbytes, uint32_t * crc)
+{
+	STATS_START(psync);
+	uint32_t attempt = 0;
+	int rc;
+	do
+	{
+		rc = crc32_frame_unchecked(psync, bidx, nbytes, crc);
+	}while(retry_frame(psync, rc, &attempt));
+	STATS_STOP(psync, DARTT_OP_READ_CRC32, rc);
+	return rc;
+}
+
+/**
+ * @brief Ask the peripheral for the CRC32 of a region of its memory.
+ *
+ * Sends a CRC32 query (see dartt_create_crc32_query) for the span of the peripheral corresponding to ctl, and waits for
+ * the reply. Compare the result with dartt_crc32() of the controller or shadow copy to verify a large region with a
+ * single short reply.
+ *
+ * @param ctl Region within ctl_base specifying WHICH span to check. Must start on a 32 bit boundary
+ * @param psync Sync structure with ctl_base, callbacks and buffers
+ * @param crc Receives the CRC32 computed by the peripheral
+ * @return DARTT_PROTOCOL_SUCCESS on success, the peripheral's error code if it rejected the query, error code on
+ *         other failures
+ * @note The query is retransmitted according to psync->retry. On peripherals with staged writes the CRC32 covers the
+ * staging block (see dartt_periph_parse).
+ */
+int dartt_read_crc32(dartt_mem_t * ctl, dartt_sync_t * psync, uint32_t * crc)
+{
+	DARTT_ASSERT(psync != NULL && crc != NULL);
+	DARTT_ASSERT(psync->ctl_base.buf != NULL && psync->blocking_tx_callback != NULL && psync->blocking_rx_callback != NULL);
+	size_t bidx = 0;
+	int rc = check_ctl_region(ctl, psync, &bidx);
+	if(rc == DARTT_PROTOCOL_SUCCESS)
+	{
+		rc = check_crc32_room(psync);
+	}
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		STATS_START(psync);
+		STATS_ERROR(psync, rc);
+		STATS_STOP(psync, DARTT_OP_READ_CRC32, rc);
+		return rc;
+	}
+	return read_crc32_unchecked(psync, bidx, ctl->size, crc);
+}
+
+/*
+	Queue a write frame for nbytes at byte offset bidx of the region, without waiting. A batching transport holds it
+	until the CRC32 query that acknowledges its window is received
+*/
+static int bulk_write_frame(dartt_sync_t * psync, size_t bidx, size_t nbytes)
+{
+	unsigned char misc_address = dartt_get_complementary_address(psync->address);
+	misc_write_message_t write_msg =
+	{
+			.address = misc_address,
+			.index = msg_index(psync, bidx / sizeof(int32_t)),
+			.payload = {
+					.buf = psync->ctl_base.buf + bidx,
+					.size = nbytes,
+					.len = nbytes
+			}
+	};
+	int rc = dartt_create_write_frame(&write_msg, psync->msg_type, &psync->tx_buf);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	return send_tx_buf(psync, misc_address, 1);
+}
+
+/*
+	Send one window of write frames [bidx, bidx + nbytes) in wsize chunks, then acknowledge the whole window with a
+	single CRC32 query. On a mismatch, each chunk is checked with its own query and only the chunks that did not land
+	are sent again. Each repair round is a retry of DARTT_ERROR_SYNC_MISMATCH under the retry policy, backoff included.
+	The shadow copy is updated once the window matches
+*/
+static int bulk_write_window(dartt_sync_t * psync, size_t bidx, size_t nbytes, size_t wsize)
+{
+	const unsigned char * src = psync->ctl_base.buf + bidx;
+	for(size_t offset = 0; offset < nbytes; offset += wsize)
+	{
+		int rc = bulk_write_frame(psync, bidx + offset, (nbytes - offset < wsize) ? (nbytes - offset) : wsize);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
+	}
+	uint32_t expected = dartt_crc32(src, nbytes);
+	uint32_t attempt = 0;
+	while(1)
+	{
+		uint32_t crc = 0;
+		int rc = read_crc32_unchecked(psync, bidx, nbytes, &crc);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
+		if(crc == expected)
+		{
+			break;
+		}
+		if(!retry_frame(psync, DARTT_ERROR_SYNC_MISMATCH, &attempt))
+		{
+			return DARTT_ERROR_SYNC_MISMATCH;
+		}
+		for(size_t offset = 0; offset < nbytes; offset += wsize)
+		{
+			size_t len = (nbytes - offset < wsize) ? (nbytes - offset) : wsize;
+			if(len != nbytes)	//a window of one chunk is simply sent again
+			{
+				rc = read_crc32_unchecked(psync, bidx + offset, len, &crc);
+				if(rc != DARTT_PROTOCOL_SUCCESS)
+				{
+					return rc;
+				}
+				if(crc == dartt_crc32(src + offset, len))
+				{
+					continue;
+				}
+			}
+			rc = bulk_write_frame(psync, bidx + offset, len);
+			if(rc != DARTT_PROTOCOL_SUCCESS)
+			{
+				return rc;
+			}
+		}
+	}
+	if(attempt != 0)
+	{
+		psync->retry_stats.recovered++;
+	}
+	dartt_copy(psync->periph_base.buf + bidx, src, nbytes);
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/*
+	Body of dartt_bulk_write
+*/
+static int bulk_write(dartt_mem_t * ctl, dartt_sync_t * psync)
+{
+	DARTT_ASSERT(psync != NULL);
+	DARTT_ASSERT(psync->ctl_base.buf != NULL && psync->periph_base.buf != NULL);
+	DARTT_ASSERT(psync->blocking_tx_callback != NULL && psync->blocking_rx_callback != NULL);
+	if(psync->ctl_base.size != psync->periph_base.size)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	size_t bidx = 0;
+	int rc = check_ctl_region(ctl, psync, &bidx);
+	if(rc == DARTT_PROTOCOL_SUCCESS)
+	{
+		rc = check_crc32_room(psync);
+	}
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	size_t wsize = psync->write_chunk;
+	if(!psync->prepared)
+	{
+		size_t overhead = region_overhead(psync);
+		if(overhead == 0)
+		{
+			return DARTT_ERROR_INVALID_ARGUMENT;
+		}
+		wsize = chunk_size(psync, psync->tx_buf.size, overhead);
+		if(wsize == 0)
+		{
+			return DARTT_ERROR_MEMORY_OVERRUN;
+		}
+	}
+	size_t window = wsize * ((psync->bulk_window != 0) ? psync->bulk_window : DARTT_BULK_WINDOW);
+	for(size_t offset = 0; offset < ctl->size; offset += window)
+	{
+		rc = bulk_write_window(psync, bidx + offset, (ctl->size - offset < window) ? (ctl->size - offset) : window, wsize);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Write a large region with windowed flow control and end-to-end verification.
+ *
+ * dartt_write_multi sends one frame per chunk with no acknowledgement, and dartt_sync reads every span back. Here the
+ * region is sent in windows of psync->bulk_window frames (DARTT_BULK_WINDOW by default), queued back to back without
+ * waiting. Each window is then acknowledged with a single CRC32 query, so the link carries one short round trip per
+ * window instead of a read-back of every byte. If the CRC32 of a window does not match, every chunk of the window is
+ * checked with its own query and only the chunks that did not land are sent again.
+ *
+ * Windows bound how many frames the peripheral receives before it has caught up, which keeps a slow peripheral or a
+ * small rx queue from being overrun. On batching transports (see flush_tx_callback) a window goes out in one batch.
+ *
+ * @param ctl Region within ctl_base specifying WHAT to write. Must start on a 32 bit boundary
+ * @param psync Sync structure with ctl_base, periph_base, callbacks and buffers. The shadow copy is updated for every
+ *              window that was verified.
+ * @return DARTT_PROTOCOL_SUCCESS if every window was written and verified. DARTT_ERROR_SYNC_MISMATCH if a window still
+ *         did not match after psync->retry.max_attempts rounds of repairs (after the first, unless
+ *         DARTT_RETRY_BIT(DARTT_ERROR_SYNC_MISMATCH) is in psync->retry.retry_mask).
+ *         DARTT_ERROR_MEMORY_OVERRUN if tx_buf cannot hold a CRC32 query or rx_buf its reply. The first error code of
+ *         a CRC32 query or transmission otherwise.
+ * @note A repair round is a retry of DARTT_ERROR_SYNC_MISMATCH: it follows psync->retry.retry_mask, waits out the
+ * backoff, and is counted in psync->retry_stats like a frame retry. CRC32 queries are retransmitted according to
+ * psync->retry.
+ * @note On peripherals with staged writes the windows are verified against the staging block. Call dartt_ctl_commit
+ * afterwards to apply them.
+ */
+int dartt_bulk_write(dartt_mem_t * ctl, dartt_sync_t * psync)
+{
+	STATS_START(psync);
+	int rc = bulk_write(ctl, psync);
+	STATS_STOP(psync, DARTT_OP_BULK_WRITE, rc);
+	return rc;
+}
+
+/*
+	Post the outstanding tagged requests again under new tags, after their replies were lost. Late replies to the
+	old tags are then discarded as stale
+*/
+static int repost_pending(dartt_sync_t * psync)
+{
+	dartt_pending_read_t lost[DARTT_NUM_TAGS];
+	size_t num_lost = 0;
+	for(int i = 0; i < DARTT_NUM_TAGS; i++)
+	{
+		if(psync->pending[i].tag != DARTT_TAG_NONE)
+		{
+			lost[num_lost++] = psync->pending[i];
+		}
+	}
+	dartt_read_flush(psync);
+	for(size_t i = 0; i < num_lost; i++)
+	{
+		dartt_mem_t chunk =
+		{
+			.buf = psync->ctl_base.buf + ((size_t)lost[i].index)*sizeof(int32_t),
+			.size = lost[i].num_bytes
+		};
+		uint8_t tag = DARTT_TAG_NONE;
+		int rc = read_post(&chunk, psync, &tag);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/*
+	Body of dartt_bulk_read
+*/
+static int bulk_read(dartt_mem_t * ctl, dartt_sync_t * psync)
+{
+	DARTT_ASSERT(psync != NULL);
+	DARTT_ASSERT(psync->ctl_base.buf != NULL && psync->periph_base.buf != NULL);
+	DARTT_ASSERT(psync->ctl_base.buf != psync->periph_base.buf);
+	if(psync->ctl_base.size != psync->periph_base.size)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	size_t bidx = 0;
+	int rc = check_ctl_region(ctl, psync, &bidx);
+	if(rc == DARTT_PROTOCOL_SUCCESS)
+	{
+		rc = check_crc32_room(psync);
+	}
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	if(psync->num_pending != 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;	//replies to the caller's own requests could not be told apart from ours
+	}
+	size_t overhead = region_overhead(psync);
+	if(overhead == 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	size_t rsize = chunk_size(psync, psync->rx_buf.size, overhead + NUM_BYTES_TAG);
+	if(rsize == 0)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+
+	//every reply acknowledges its request. Requests whose reply is lost are posted again when the link goes quiet
+	size_t next = 0;
+	uint32_t attempt = 0;
+	while(next < ctl->size || psync->num_pending != 0)
+	{
+		uint8_t tag = DARTT_TAG_NONE;
+		if(next < ctl->size && psync->num_pending < DARTT_NUM_TAGS)
+		{
+			dartt_mem_t chunk =
+			{
+				.buf = ctl->buf + next,
+				.size = (ctl->size - next < rsize) ? (ctl->size - next) : rsize
+			};
+			rc = read_post(&chunk, psync, &tag);
+			next += chunk.size;
+		}
+		else
+		{
+			rc = read_poll(psync, &tag);
+			if(rc == DARTT_ERROR_TAG_MISMATCH)
+			{
+				continue;	//late reply to a request that was posted again
+			}
+			if(rc == DARTT_PROTOCOL_SUCCESS)
+			{
+				retry_frame(psync, rc, &attempt);
+				attempt = 0;
+			}
+			else if(retry_frame(psync, rc, &attempt))
+			{
+				//a lost or damaged reply leaves its request pending, and the timeout that follows posts it again
+				rc = (rc == DARTT_ERROR_TIMEOUT) ? repost_pending(psync) : DARTT_PROTOCOL_SUCCESS;
+			}
+		}
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			dartt_read_flush(psync);
+			return rc;
+		}
+	}
+
+	uint32_t crc = 0;
+	rc = read_crc32_unchecked(psync, bidx, ctl->size, &crc);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	if(crc != dartt_crc32(psync->periph_base.buf + bidx, ctl->size))
+	{
+		STATS_ERROR(psync, DARTT_ERROR_SYNC_MISMATCH);
+		return DARTT_ERROR_SYNC_MISMATCH;
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Read a large region with a window of requests in flight, selective retransmission and end-to-end verification.
+ *
+ * Like dartt_read_multi_pipelined, up to DARTT_NUM_TAGS tagged requests are kept in flight, and every reply
+ * acknowledges its request. When the link goes quiet (the rx callback times out) with requests still outstanding,
+ * only those requests are posted again, according to psync->retry. Once every chunk has arrived, the CRC32 of the
+ * whole region is queried and compared with the shadow copy, which catches data that changed on the peripheral
+ * during the transfer.
+ *
+ * @param ctl Region within ctl_base specifying WHAT to read. Must start on a 32 bit boundary. Results are stored in
+ *            psync->periph_base at the corresponding offset.
+ * @param psync Sync structure. Must have no tagged reads outstanding.
+ * @return DARTT_PROTOCOL_SUCCESS if every chunk was read and the region CRC32 matches. DARTT_ERROR_SYNC_MISMATCH if
+ *         the CRC32 does not match the data read. DARTT_ERROR_INVALID_ARGUMENT if tagged reads are already
+ *         outstanding. DARTT_ERROR_MEMORY_OVERRUN if tx_buf cannot hold a CRC32 query or rx_buf its reply. The first
+ *         unrecovered error code otherwise, with the outstanding requests flushed.
+ * @note Without a retry policy the first lost reply fails the transfer, as in dartt_read_multi_pipelined. Set
+ * psync->retry with DARTT_ERROR_TIMEOUT in its mask to recover lost frames.
+ * @note On peripherals with staged writes the CRC32 covers the staging block, so the check only passes while no
+ * staged writes are pending.
+ */
+int dartt_bulk_read(dartt_mem_t * ctl, dartt_sync_t * psync)
+{
+	STATS_START(psync);
+	int rc = bulk_read(ctl, psync);
+	STATS_STOP(psync, DARTT_OP_BULK_READ, rc);
+	return rc;
+}
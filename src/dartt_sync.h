@@ -3,19 +3,68 @@
 #include <stdint.h>
 #include <stddef.h>
 #include "dartt.h"
+#include "dartt_trace.h"
 #include <stddef.h>
+#ifdef DARTT_ENABLE_STATS
+#include "dartt_stats.h"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 
+#ifndef DARTT_NUM_TAGS
+#define DARTT_NUM_TAGS	8	//maximum number of tagged reads in flight per dartt_sync_t. Power of two, 128 at most
+#endif
+
+#ifndef DARTT_MAX_STALE_REPLIES
+#define DARTT_MAX_STALE_REPLIES	8	//late replies to earlier requests a read discards while waiting for its own reply
+#endif
+
+#ifndef DARTT_BULK_WINDOW
+#define DARTT_BULK_WINDOW	16	//default number of write frames dartt_bulk_write sends per acknowledgement
+#endif
+
+/*
+	Outstanding tagged read request. The slot for a tag is pending[tag % DARTT_NUM_TAGS]
+*/
+typedef struct dartt_pending_read_t
+{
+		uint32_t index;			// Word index into the shadow copy (base_offset removed)
+		uint16_t num_bytes;		// Number of bytes requested
+		uint8_t tag;			// Tag of the outstanding request. DARTT_TAG_NONE if the slot is free
+}dartt_pending_read_t;
+
+#define DARTT_RETRY_BIT(error)		(1UL << (-(error)))	//retry mask bit for a (negative) error code
+#define DARTT_RETRY_DEFAULT_MASK	(DARTT_RETRY_BIT(DARTT_ERROR_CHECKSUM_MISMATCH) | DARTT_RETRY_BIT(DARTT_ERROR_MALFORMED_MESSAGE) | DARTT_RETRY_BIT(DARTT_ERROR_CTL_READ_LEN_MISMATCH) | DARTT_RETRY_BIT(DARTT_ERROR_TIMEOUT))	//link errors. Excludes argument and peripheral-reported errors
+
+/*
+	Retransmission policy. Applied per frame (or per write/read-back span for dartt_sync), so a multi-frame
+	operation only resends the frame that failed and resumes from there. Zero initialize to disable.
+*/
+typedef struct dartt_retry_policy_t
+{
+		uint8_t max_attempts;		// Attempts per frame, including the first. 0 or 1 disables retransmission
+		uint32_t backoff_ms;		// Delay before the first retry, doubled on every following retry
+		uint32_t retry_mask;		// Error codes to retry, one DARTT_RETRY_BIT(error) per code. See DARTT_RETRY_DEFAULT_MASK
+		void (*delay_callback)(uint32_t ms, void * user_context);	//OPTIONAL backoff delay. Set to NULL to retry immediately
+		void * user_context;		//OPTIONAL resource used for the delay callback. Set to NULL if not needed
+}dartt_retry_policy_t;
+
+typedef struct dartt_retry_stats_t
+{
+		uint32_t retries;			// Frames (or spans) sent again
+		uint32_t recovered;			// Frames that succeeded after at least one retry
+		uint32_t exhausted;			// Frames that still failed with a retryable error after max_attempts
+}dartt_retry_stats_t;
+
 typedef struct dartt_sync_t
 {
         unsigned char address;	 // Target peripheral address
 		dartt_mem_t ctl_base;			// Bounding region of controller control structure
 		dartt_mem_t periph_base;		 // Bounding region of shadow copy structure
-		uint16_t base_offset;			//offset into the true peripheral blob. Applied when the dartt_sync_t is indexing into a larger blob, with unknown surrounding structure. Should be set to 0 in most situations
+		uint32_t base_offset;			//offset into the true peripheral blob, in words. Applied when the dartt_sync_t is indexing into a larger blob, with unknown surrounding structure. Should be set to 0 in most situations. Words at or above DARTT_INDEX_RESERVED_BASE are reached with extended frames
 		serial_message_type_t msg_type;	// Message framing type
 		dartt_buffer_t tx_buf;		// Transmission buffer
 		void * user_context_tx;		//OPTIONAL resource used for tx callback - i.e. serial class, socket, etc. Set to NULL if not needed
@@ -23,17 +72,41 @@ typedef struct dartt_sync_t
 		void * user_context_rx;		//OPTIONAL resource used for rx callback - i.e. serial class,etc. Set to NULL if not needed
 		int (*blocking_tx_callback)(unsigned char, dartt_buffer_t*, void * user_context, uint32_t timeout);	//Callback for (blocking) transmissions with a millisecond timeout
 		int (*blocking_rx_callback)(dartt_buffer_t*, void * user_context, uint32_t timeout);		//Callback for (blocking) receptions with a millisecond timeout
+		int (*flush_tx_callback)(void * user_context, uint32_t timeout);	//OPTIONAL, for batching transports whose tx callback queues frames. Sends the queue (called with user_context_tx). Set to NULL if frames are sent immediately
+		size_t (*frame_len_callback)(size_t len);	//OPTIONAL, for links with a fixed set of frame lengths (e.g. dartt_canfd_len). Returns the padded length a frame occupies on the link, 0 if it cannot be sent. Multi-frame reads and writes size their chunks for the least padding. Set to NULL if frames go out at their own length
 		uint32_t timeout_ms;		// Communication timeout
+		dartt_pending_read_t pending[DARTT_NUM_TAGS];	// Outstanding tagged reads (dartt_read_post/dartt_read_poll). Zero initialize
+		uint8_t num_pending;		// Number of outstanding tagged reads
+		uint8_t last_tag;			// Last tag issued
+		dartt_retry_policy_t retry;	//OPTIONAL retransmission policy. Zero initialize to disable
+		dartt_retry_stats_t retry_stats;	// Retransmission counters. Reset by the application as needed
+		uint8_t prepared;			// Set by dartt_sync_prepare: the configuration was checked, multi-frame transfers skip the per call checks. Clear it after changing the configuration
+		size_t read_chunk;			// dartt_read_multi chunk size, cached by dartt_sync_prepare
+		size_t write_chunk;			// dartt_write_multi chunk size, cached by dartt_sync_prepare
+		uint16_t bulk_window;		//OPTIONAL write frames dartt_bulk_write sends before waiting for their acknowledgement. Set to 0 for DARTT_BULK_WINDOW
+		dartt_trace_t * trace;		//OPTIONAL frame capture ring (dartt_trace.h). Every frame handed to the tx callback or returned by the rx callback is recorded. Set to NULL to disable
+#ifdef DARTT_ENABLE_STATS
+		dartt_stats_t stats;		// Frame, byte and error counters and latency histograms. Set stats.clock_callback to record latencies. Zero initialize
+#endif
 }dartt_sync_t;
 
 
 
+int dartt_sync_prepare(dartt_sync_t * psync);
 int dartt_sync(dartt_mem_t * ctl, dartt_sync_t * psync);
 int dartt_ctl_write(dartt_mem_t * ctl, dartt_sync_t * psync);
 int dartt_ctl_read(dartt_mem_t * ctl, dartt_sync_t * psync);
 int dartt_read_multi(dartt_mem_t * ctl, dartt_sync_t * psync);
 int dartt_write_multi(dartt_mem_t * ctl, dartt_sync_t * psync);
 int dartt_update_controller(dartt_mem_t * ctl, dartt_sync_t * psync);
+int dartt_ctl_commit(dartt_sync_t * psync);
+int dartt_read_post(dartt_mem_t * ctl, dartt_sync_t * psync, uint8_t * tag);
+int dartt_read_poll(dartt_sync_t * psync, uint8_t * tag);
+void dartt_read_flush(dartt_sync_t * psync);
+int dartt_read_multi_pipelined(dartt_mem_t * ctl, dartt_sync_t * psync);
+int dartt_read_crc32(dartt_mem_t * ctl, dartt_sync_t * psync, uint32_t * crc);
+int dartt_bulk_write(dartt_mem_t * ctl, dartt_sync_t * psync);
+int dartt_bulk_read(dartt_mem_t * ctl, dartt_sync_t * psync);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,257 @@
+#include "dartt_trace.h"
+#include "dartt_assert.h"
+#include <string.h>
+
+
+/*
+	Publication of the ring head. The producer fills a record, then publishes it by incrementing head with release
+	semantics, so a reader that sees the new head also sees the record
+*/
+#if defined(__GNUC__)
+#define HEAD_LOAD(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define HEAD_STORE(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define READ_FENCE()		__atomic_thread_fence(__ATOMIC_ACQUIRE)
+#else
+#define HEAD_LOAD(p)		(*(volatile const uint32_t *)(p))
+#define HEAD_STORE(p, v)	(*(volatile uint32_t *)(p) = (v))
+#define READ_FENCE()		((void)0)
+#endif
+
+#define PCAPNG_SHB				0x0A0D0D0Au
+#define PCAPNG_IDB				0x00000001u
+#define PCAPNG_EPB				0x00000006u
+#define PCAPNG_BYTE_ORDER_MAGIC	0x1A2B3C4Du
+#define PCAPNG_OPT_ENDOFOPT		0
+#define PCAPNG_OPT_IF_TSRESOL	9
+#define PCAPNG_OPT_EPB_FLAGS	2
+#define PCAPNG_OPT_EPB_DROPCOUNT	4
+#define PCAPNG_FLAGS_INBOUND	0x1u
+#define PCAPNG_FLAGS_OUTBOUND	0x2u
+#define PAD4(n)					(((n) + 3u) & ~3u)
+#define EPB_MAX_LEN				(28u + PAD4(DARTT_TRACE_PSEUDO_HEADER_LEN + DARTT_TRACE_SNAPLEN) + 8u + 12u + 4u + 4u)
+
+/**
+ * @brief Set up a trace ring on application provided storage. The clock callback, its context and tsresol are left
+ * as set by the application.
+ *
+ * @param trace Trace ring
+ * @param records Ring storage
+ * @param num_records Number of records in the storage. Must be a power of two
+ * @return DARTT_PROTOCOL_SUCCESS, or DARTT_ERROR_INVALID_ARGUMENT if num_records is not a power of two
+ */
+int dartt_trace_init(dartt_trace_t * trace, dartt_trace_record_t * records, uint32_t num_records)
+{
+	DARTT_ASSERT(trace != NULL && records != NULL);
+	if(num_records == 0 || (num_records & (num_records - 1)) != 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	trace->records = records;
+	trace->num_records = num_records;
+	trace->head = 0;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Append a frame to the ring, overwriting the oldest record. O(1): one clock call and a copy of at most
+ * DARTT_TRACE_SNAPLEN bytes.
+ *
+ * @param trace Trace ring. Single producer
+ * @param dir DARTT_TRACE_TX or DARTT_TRACE_RX
+ * @param msg_type Framing of the frame
+ * @param address Misc address a TX frame is sent to, 0 for RX frames
+ * @param frame Frame, frame->len bytes
+ */
+void dartt_trace_frame(dartt_trace_t * trace, uint8_t dir, serial_message_type_t msg_type, unsigned char address, const dartt_buffer_t * frame)
+{
+	DARTT_ASSERT(trace != NULL && trace->records != NULL && frame != NULL);
+	uint32_t head = trace->head;	//only the producer writes head
+	dartt_trace_record_t * rec = &trace->records[head & (trace->num_records - 1)];
+	rec->timestamp = (trace->clock_callback != NULL) ? (*(trace->clock_callback))(trace->clock_context) : 0;
+	rec->len = (frame->len > UINT16_MAX) ? UINT16_MAX : (uint16_t)frame->len;
+	rec->dir = dir;
+	rec->msg_type = (uint8_t)msg_type;
+	rec->address = address;
+	memcpy(rec->data, frame->buf, (frame->len < DARTT_TRACE_SNAPLEN) ? frame->len : DARTT_TRACE_SNAPLEN);
+	HEAD_STORE(&trace->head, head + 1);
+}
+
+/**
+ * @brief Copy records out of the ring, oldest first.
+ *
+ * Safe to call while the producer is recording. The oldest record in the ring is the next one to be overwritten, so
+ * only the last num_records - 1 records are readable. Records that were overwritten before or while they were copied
+ * are skipped and counted in *lost.
+ *
+ * @param trace Trace ring
+ * @param cursor Sequence number of the next record to read, advanced past the records read or skipped. Start at 0,
+ * or at trace->head to only see new records
+ * @param out Receives up to max records
+ * @param max Capacity of out
+ * @param lost OPTIONAL, incremented by the number of skipped records. Set to NULL if not needed
+ * @return Number of records copied to out
+ */
+size_t dartt_trace_read(const dartt_trace_t * trace, uint32_t * cursor, dartt_trace_record_t * out, size_t max, uint32_t * lost)
+{
+	DARTT_ASSERT(trace != NULL && cursor != NULL && (out != NULL || max == 0));
+	size_t n = 0;
+	while(n < max)
+	{
+		uint32_t head = HEAD_LOAD(&trace->head);
+		if(head == *cursor)
+		{
+			break;
+		}
+		if(head - *cursor >= trace->num_records)	//overwritten before we got to them, or next to be
+		{
+			if(lost != NULL)
+			{
+				*lost += head - *cursor - (trace->num_records - 1);
+			}
+			*cursor = head - (trace->num_records - 1);
+		}
+		memcpy(&out[n], &trace->records[*cursor & (trace->num_records - 1)], sizeof(dartt_trace_record_t));
+		READ_FENCE();
+		//the producer writes record (cursor + num_records) into the same slot while head == cursor + num_records
+		if(HEAD_LOAD(&trace->head) - *cursor >= trace->num_records)
+		{
+			if(lost != NULL)
+			{
+				(*lost)++;
+			}
+		}
+		else
+		{
+			n++;
+		}
+		(*cursor)++;
+	}
+	return n;
+}
+
+static void put_u16(unsigned char * p, uint16_t v)
+{
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+}
+
+static void put_u32(unsigned char * p, uint32_t v)
+{
+	put_u16(p, (uint16_t)v);
+	put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+/*
+	Section header and interface description blocks. Everything is written little-endian
+*/
+static int write_pcapng_header(const dartt_trace_t * trace, dartt_pcapng_writer_t * writer)
+{
+	unsigned char hdr[28 + 32];
+	unsigned char * shb = hdr;
+	put_u32(shb, PCAPNG_SHB);
+	put_u32(shb + 4, 28);
+	put_u32(shb + 8, PCAPNG_BYTE_ORDER_MAGIC);
+	put_u16(shb + 12, 1);	//version 1.0
+	put_u16(shb + 14, 0);
+	put_u32(shb + 16, 0xFFFFFFFFu);	//section length unknown
+	put_u32(shb + 20, 0xFFFFFFFFu);
+	put_u32(shb + 24, 28);
+
+	unsigned char * idb = hdr + 28;
+	put_u32(idb, PCAPNG_IDB);
+	put_u32(idb + 4, 32);
+	put_u16(idb + 8, DARTT_TRACE_LINKTYPE);
+	put_u16(idb + 10, 0);
+	put_u32(idb + 12, DARTT_TRACE_PSEUDO_HEADER_LEN + DARTT_TRACE_SNAPLEN);
+	put_u16(idb + 16, PCAPNG_OPT_IF_TSRESOL);
+	put_u16(idb + 18, 1);
+	put_u32(idb + 20, (trace->tsresol != 0) ? trace->tsresol : 6);	//one byte of value, three of padding
+	put_u32(idb + 24, PCAPNG_OPT_ENDOFOPT);
+	put_u32(idb + 28, 32);
+	return (*(writer->write_callback))(hdr, sizeof(hdr), writer->user_context);
+}
+
+/**
+ * @brief Append the records written since the last call to a pcapng capture, one Enhanced Packet Block per frame.
+ *
+ * Each packet is a DARTT_TRACE_PSEUDO_HEADER_LEN byte pseudo-header [direction][msg_type][address][flags] followed by
+ * the captured frame, with link type DARTT_TRACE_LINKTYPE (dissected by tools/dartt.lua). The direction is also
+ * stored in the epb_flags option. Records lost to ring overwrites are reported in the epb_dropcount option of the
+ * next exported packet.
+ * 32 bit timestamps are unwrapped to 64 bits, which requires calls less than 2^32 clock ticks apart.
+ *
+ * @param trace Trace ring
+ * @param writer Exporter state, with the write callback set
+ * @return DARTT_PROTOCOL_SUCCESS, or the first error returned by the write callback
+ */
+int dartt_trace_export_pcapng(const dartt_trace_t * trace, dartt_pcapng_writer_t * writer)
+{
+	DARTT_ASSERT(trace != NULL && writer != NULL && writer->write_callback != NULL);
+	if(!writer->header_written)
+	{
+		int rc = write_pcapng_header(trace, writer);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
+		writer->header_written = 1;
+		writer->time = 0;
+		writer->last_timestamp = 0;
+		if(trace->head - writer->cursor >= trace->num_records)
+		{
+			writer->cursor = trace->head - (trace->num_records - 1);	//start at the oldest readable record
+		}
+	}
+
+	dartt_trace_record_t rec;
+	uint32_t dropped = 0;
+	while(dartt_trace_read(trace, &writer->cursor, &rec, 1, &dropped) == 1)
+	{
+		writer->time += (uint32_t)(rec.timestamp - writer->last_timestamp);
+		writer->last_timestamp = rec.timestamp;
+		writer->lost += dropped;
+
+		uint32_t caplen = (rec.len < DARTT_TRACE_SNAPLEN) ? rec.len : DARTT_TRACE_SNAPLEN;
+		uint32_t pkt_len = DARTT_TRACE_PSEUDO_HEADER_LEN + caplen;
+		uint32_t block_len = 28u + PAD4(pkt_len) + 8u + ((dropped != 0) ? 12u : 0u) + 4u + 4u;
+		unsigned char epb[EPB_MAX_LEN];
+		memset(epb, 0, block_len);
+		put_u32(epb, PCAPNG_EPB);
+		put_u32(epb + 4, block_len);
+		put_u32(epb + 8, 0);	//interface 0
+		put_u32(epb + 12, (uint32_t)(writer->time >> 32));
+		put_u32(epb + 16, (uint32_t)writer->time);
+		put_u32(epb + 20, pkt_len);
+		put_u32(epb + 24, DARTT_TRACE_PSEUDO_HEADER_LEN + (uint32_t)rec.len);
+		unsigned char * p = epb + 28;
+		p[0] = rec.dir;
+		p[1] = rec.msg_type;
+		p[2] = rec.address;
+		p[3] = (rec.len > DARTT_TRACE_SNAPLEN) ? DARTT_TRACE_FLAG_TRUNCATED : 0;
+		memcpy(p + DARTT_TRACE_PSEUDO_HEADER_LEN, rec.data, caplen);
+		p += PAD4(pkt_len);
+		put_u16(p, PCAPNG_OPT_EPB_FLAGS);
+		put_u16(p + 2, 4);
+		put_u32(p + 4, (rec.dir == DARTT_TRACE_TX) ? PCAPNG_FLAGS_OUTBOUND : PCAPNG_FLAGS_INBOUND);
+		p += 8;
+		if(dropped != 0)
+		{
+			put_u16(p, PCAPNG_OPT_EPB_DROPCOUNT);
+			put_u16(p + 2, 8);
+			put_u32(p + 4, dropped);
+			put_u32(p + 8, 0);
+			p += 12;
+		}
+		put_u32(p, PCAPNG_OPT_ENDOFOPT);
+		put_u32(p + 4, block_len);
+		dropped = 0;
+
+		int rc = (*(writer->write_callback))(epb, block_len, writer->user_context);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
+	}
+	writer->lost += dropped;
+	return DARTT_PROTOCOL_SUCCESS;
+}
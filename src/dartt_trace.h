@@ -0,0 +1,80 @@
+#ifndef DARTT_TRACE_H
+#define DARTT_TRACE_H
+#include <stdint.h>
+#include <stddef.h>
+#include "dartt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#ifndef DARTT_TRACE_SNAPLEN
+#define DARTT_TRACE_SNAPLEN		64		//bytes captured per frame. Longer frames are truncated, their original length is kept
+#endif
+#ifndef DARTT_TRACE_LINKTYPE
+#define DARTT_TRACE_LINKTYPE	147		//pcapng link type of exported captures. LINKTYPE_USER0, see tools/dartt.lua
+#endif
+#define DARTT_TRACE_PSEUDO_HEADER_LEN	4	//[direction][msg_type][address][flags] before every exported frame
+
+#define DARTT_TRACE_TX		0		//controller to peripheral
+#define DARTT_TRACE_RX		1		//peripheral to controller
+
+#define DARTT_TRACE_FLAG_TRUNCATED	0x01	//pseudo-header flag: the frame was longer than DARTT_TRACE_SNAPLEN
+
+/*
+	One captured frame
+*/
+typedef struct dartt_trace_record_t
+{
+		uint32_t timestamp;			// Clock ticks when the frame was handed to the tx callback or returned by the rx callback
+		uint16_t len;				// Original frame length. min(len, DARTT_TRACE_SNAPLEN) bytes were captured
+		uint8_t dir;				// DARTT_TRACE_TX or DARTT_TRACE_RX
+		uint8_t msg_type;			// serial_message_type_t of the frame
+		uint8_t address;			// Misc address a TX frame was sent to. 0 for RX frames
+		unsigned char data[DARTT_TRACE_SNAPLEN];
+}dartt_trace_record_t;
+
+/*
+	Frame capture ring. The ring holds the last num_records - 1 frames: recording never blocks and never fails, it
+	overwrites the oldest record. There must be a single writer (one thread, or several dartt_sync_t used from one
+	thread), but the ring can be drained by another thread or from a lower priority context while it is written.
+	Readers detect records that were overwritten under them and skip them.
+*/
+typedef struct dartt_trace_t
+{
+		dartt_trace_record_t * records;		// Ring storage, provided by the application
+		uint32_t num_records;		// Size of the ring. Power of two
+		uint32_t head;				// Records written since dartt_trace_init. Written by the producer only
+		uint32_t (*clock_callback)(void * user_context);	//OPTIONAL free running timestamp clock. Set to NULL for zero timestamps
+		void * clock_context;		//OPTIONAL resource used for the clock callback. Set to NULL if not needed
+		uint8_t tsresol;			// Clock resolution, for export: one tick is 10^-tsresol seconds. 6 (or 0) for microseconds, 9 for nanoseconds
+}dartt_trace_t;
+
+/*
+	Incremental pcapng exporter. Zero initialize, set the write callback, and call dartt_trace_export_pcapng as often
+	as needed: the first call writes the file header, and every call appends the records written since the last one.
+*/
+typedef struct dartt_pcapng_writer_t
+{
+		int (*write_callback)(const unsigned char * buf, size_t len, void * user_context);	// Appends bytes to the capture. Returns DARTT_PROTOCOL_SUCCESS or an error code
+		void * user_context;		//OPTIONAL resource used for the write callback, e.g. a FILE *. Set to NULL if not needed
+		uint32_t cursor;			// Next record to export
+		uint32_t lost;				// Records overwritten before they could be exported
+		uint32_t last_timestamp;	// Timestamp unwrapping state
+		uint64_t time;				// Unwrapped timestamp of the last exported record, in ticks
+		uint8_t header_written;
+}dartt_pcapng_writer_t;
+
+
+int dartt_trace_init(dartt_trace_t * trace, dartt_trace_record_t * records, uint32_t num_records);
+void dartt_trace_frame(dartt_trace_t * trace, uint8_t dir, serial_message_type_t msg_type, unsigned char address, const dartt_buffer_t * frame);
+size_t dartt_trace_read(const dartt_trace_t * trace, uint32_t * cursor, dartt_trace_record_t * out, size_t max, uint32_t * lost);
+int dartt_trace_export_pcapng(const dartt_trace_t * trace, dartt_pcapng_writer_t * writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
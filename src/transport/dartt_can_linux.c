@@ -0,0 +1,402 @@
+#include "dartt_can_linux.h"
+#include "dartt_check_buffer.h"
+#include "dartt_assert.h"
+#include "dartt_deadline.h"
+
+#include <linux/can/raw.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+
+/*
+	Identifier mask for the frame format in use
+*/
+static canid_t id_mask(const dartt_can_linux_t * port)
+{
+	return (port->id_base != 0) ? CAN_EFF_MASK : CAN_SFF_MASK;
+}
+
+/*
+	Install the receive filter for the side of the link the port is on. The padded flag is left out of the mask so
+	padded and unpadded frames both pass. On the controller side any address passes, and stale replies from another
+	peripheral are dropped by dartt_can_linux_rx
+*/
+static int apply_filter(const dartt_can_linux_t * port)
+{
+	canid_t eff = (port->id_base != 0) ? CAN_EFF_FLAG : 0;
+	struct can_filter filter;
+	if(port->peripheral)
+	{
+		filter.can_id = port->id_base | port->address | eff;
+		filter.can_mask = (id_mask(port) & ~(canid_t)DARTT_CAN_ID_PADDED) | CAN_EFF_FLAG | CAN_RTR_FLAG;
+	}
+	else
+	{
+		filter.can_id = port->id_base | DARTT_CAN_ID_REPLY | eff;
+		filter.can_mask = (id_mask(port) & ~(canid_t)(DARTT_CAN_ID_PADDED | DARTT_CAN_ID_ADDRESS)) | CAN_EFF_FLAG | CAN_RTR_FLAG;
+	}
+	if(setsockopt(port->fd, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter)) != 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Set up a transport on an already open and bound raw CAN socket, on the controller side.
+ *
+ * @param port Transport context to initialize
+ * @param fd Raw CAN socket (PF_CAN, SOCK_RAW, CAN_RAW), bound to an interface. Not closed by dartt_can_linux_close
+ * @param fd_frames Nonzero to send and receive CAN-FD frames. CAN_RAW_FD_FRAMES is enabled on the socket
+ * @param id_base Identifier base. 0 for 11 bit identifiers, or a multiple of 0x800 up to CAN_EFF_MASK for 29 bit
+ * extended identifiers
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_INVALID_ARGUMENT for a bad id_base or if the socket options
+ * could not be applied (errno holds the cause)
+ */
+int dartt_can_linux_attach(dartt_can_linux_t * port, int fd, int fd_frames, uint32_t id_base)
+{
+	DARTT_ASSERT(port != NULL);
+	port->fd = fd;
+	port->owns_fd = 0;
+	port->fd_frames = fd_frames;
+	port->id_base = id_base;
+	port->peripheral = 0;
+	port->address = 0;
+	if((id_base & DARTT_CAN_ID_BITS) != 0 || id_base > CAN_EFF_MASK)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	if(fd_frames)
+	{
+		int on = 1;
+		if(setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &on, sizeof(on)) != 0)
+		{
+			return DARTT_ERROR_INVALID_ARGUMENT;
+		}
+	}
+	return apply_filter(port);
+}
+
+/**
+ * @brief Open a raw CAN socket on an interface, on the controller side.
+ *
+ * @param port Transport context to initialize
+ * @param ifname Interface name, e.g. "can0" or "vcan0"
+ * @param fd_frames Nonzero for CAN-FD. The interface must then have the CAN-FD MTU (ip link set can0 type can fd on
+ * ...; vcan interfaces have it by default)
+ * @param id_base Identifier base, see dartt_can_linux_attach
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_INVALID_ARGUMENT if the interface does not exist, is not
+ * CAN-FD capable when fd_frames is set, or the socket could not be set up (errno holds the cause)
+ */
+int dartt_can_linux_open(dartt_can_linux_t * port, const char * ifname, int fd_frames, uint32_t id_base)
+{
+	DARTT_ASSERT(port != NULL && ifname != NULL);
+	port->fd = -1;
+	port->owns_fd = 0;
+	if(strlen(ifname) >= IFNAMSIZ)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	int fd = socket(PF_CAN, SOCK_RAW | SOCK_CLOEXEC, CAN_RAW);
+	if(fd < 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	port->fd = fd;
+	port->owns_fd = 1;
+
+	struct ifreq ifr;
+	memset(&ifr, 0, sizeof(ifr));
+	strcpy(ifr.ifr_name, ifname);
+	if(ioctl(fd, SIOCGIFINDEX, &ifr) != 0)
+	{
+		dartt_can_linux_close(port);
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	int ifindex = ifr.ifr_ifindex;
+	if(fd_frames && (ioctl(fd, SIOCGIFMTU, &ifr) != 0 || ifr.ifr_mtu != CANFD_MTU))
+	{
+		dartt_can_linux_close(port);
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+
+	int rc = dartt_can_linux_attach(port, fd, fd_frames, id_base);
+	port->owns_fd = 1;
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		dartt_can_linux_close(port);
+		return rc;
+	}
+	struct sockaddr_can addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.can_family = AF_CAN;
+	addr.can_ifindex = ifindex;
+	if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)	//after the filter, so nothing unfiltered is queued
+	{
+		dartt_can_linux_close(port);
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Switch the port to the peripheral side, for a Linux hosted peripheral or a simulated one.
+ *
+ * Only requests for address are received, and frames are sent as replies from address.
+ *
+ * @param port Open port
+ * @param address Misc address of the peripheral
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_INVALID_ARGUMENT if the filter could not be applied
+ */
+int dartt_can_linux_set_peripheral(dartt_can_linux_t * port, unsigned char address)
+{
+	DARTT_ASSERT(port != NULL);
+	port->peripheral = 1;
+	port->address = address;
+	return apply_filter(port);
+}
+
+/**
+ * @brief Close the socket if it was opened by dartt_can_linux_open.
+ */
+void dartt_can_linux_close(dartt_can_linux_t * port)
+{
+	DARTT_ASSERT(port != NULL);
+	if(port->owns_fd && port->fd >= 0)
+	{
+		close(port->fd);
+	}
+	port->fd = -1;
+	port->owns_fd = 0;
+}
+
+/**
+ * @brief Build the CAN frame carrying a DARTT frame.
+ *
+ * The identifier is the identifier base, the misc address and, from a peripheral, DARTT_CAN_ID_REPLY. On CAN-FD,
+ * a frame whose length is not a legal data length is padded up to the next one and flagged with
+ * DARTT_CAN_ID_PADDED. Every padding byte holds the number of padding bytes.
+ *
+ * @param port Transport context
+ * @param address Misc address of the peripheral the frame is sent to. Ignored on the peripheral side, which always
+ * sends from its own address
+ * @param tx DARTT frame
+ * @param frame CAN frame to fill. Only the first CAN_MTU bytes are used for classic CAN
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_MEMORY_OVERRUN if the frame is longer than 64 bytes (8 for
+ * classic CAN)
+ */
+int dartt_can_linux_pack(const dartt_can_linux_t * port, unsigned char address, const dartt_buffer_t * tx, struct canfd_frame * frame)
+{
+	DARTT_ASSERT(port != NULL && frame != NULL);
+	int cb = check_buffer(tx);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	size_t wire_len = port->fd_frames ? dartt_canfd_len(tx->len) : tx->len;
+	if(wire_len == 0 && tx->len != 0)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	if(!port->fd_frames && tx->len > CAN_MAX_DLEN)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+
+	memset(frame, 0, sizeof(*frame));
+	canid_t id = port->id_base;
+	if(port->peripheral)
+	{
+		id |= DARTT_CAN_ID_REPLY | port->address;
+	}
+	else
+	{
+		id |= address;
+	}
+	memcpy(frame->data, tx->buf, tx->len);
+	size_t pad = wire_len - tx->len;
+	if(pad != 0)
+	{
+		id |= DARTT_CAN_ID_PADDED;
+		memset(frame->data + tx->len, (int)pad, pad);
+	}
+	frame->can_id = id | ((port->id_base != 0) ? CAN_EFF_FLAG : 0);
+	frame->len = (uint8_t)wire_len;
+	if(port->fd_frames)
+	{
+		frame->flags = CANFD_BRS;
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Extract the DARTT frame carried by a received CAN frame, stripping any padding.
+ *
+ * @param port Transport context
+ * @param frame Received frame. Classic frames (read with CAN_MTU bytes) are accepted as well
+ * @param address Loaded with the misc address in the identifier
+ * @param rx Buffer to receive the DARTT frame
+ * @return DARTT_PROTOCOL_SUCCESS with rx->len set, DARTT_ADDRESS_FILTERED if the frame is not a DARTT frame for this
+ * side of the link (wrong identifier base, direction or format, RTR or error frame), DARTT_ERROR_MALFORMED_MESSAGE
+ * if the padding count is invalid, DARTT_ERROR_MEMORY_OVERRUN if the frame does not fit in rx
+ */
+int dartt_can_linux_unpack(const dartt_can_linux_t * port, const struct canfd_frame * frame, unsigned char * address, dartt_buffer_t * rx)
+{
+	DARTT_ASSERT(port != NULL && frame != NULL && address != NULL);
+	int cb = check_buffer(rx);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	canid_t eff = (port->id_base != 0) ? CAN_EFF_FLAG : 0;
+	if((frame->can_id & (CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_ERR_FLAG)) != eff)
+	{
+		return DARTT_ADDRESS_FILTERED;
+	}
+	canid_t id = frame->can_id & id_mask(port);
+	canid_t reply = port->peripheral ? 0 : DARTT_CAN_ID_REPLY;
+	if((id & ~(canid_t)DARTT_CAN_ID_BITS) != port->id_base || (id & DARTT_CAN_ID_REPLY) != reply)
+	{
+		return DARTT_ADDRESS_FILTERED;
+	}
+	*address = (unsigned char)(id & DARTT_CAN_ID_ADDRESS);
+
+	size_t len = frame->len;
+	if(len > CANFD_MAX_DLEN)
+	{
+		return DARTT_ERROR_MALFORMED_MESSAGE;
+	}
+	if(id & DARTT_CAN_ID_PADDED)
+	{
+		size_t pad = (len != 0) ? frame->data[len - 1] : 0;
+		if(pad == 0 || pad > len)
+		{
+			return DARTT_ERROR_MALFORMED_MESSAGE;
+		}
+		len -= pad;
+	}
+	if(len > rx->size)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	memcpy(rx->buf, frame->data, len);
+	rx->len = len;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief dartt_sync_t blocking_tx_callback. Sends a frame to the peripheral at address.
+ *
+ * @param address Misc address of the peripheral, as passed by dartt_sync_t. Ignored on the peripheral side
+ * @param tx Frame to send
+ * @param user_context dartt_can_linux_t of the port
+ * @param timeout Milliseconds to wait for room in the interface transmit queue
+ * @return DARTT_PROTOCOL_SUCCESS once the frame is queued, DARTT_ERROR_TIMEOUT if the queue stayed full,
+ * DARTT_ERROR_MEMORY_OVERRUN if the frame does not fit a CAN frame, DARTT_ERROR_INVALID_ARGUMENT if the socket
+ * failed (errno holds the cause)
+ */
+int dartt_can_linux_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	DARTT_ASSERT(user_context != NULL);
+	dartt_can_linux_t * port = (dartt_can_linux_t *)user_context;
+	struct canfd_frame frame;
+	int rc = dartt_can_linux_pack(port, address, tx, &frame);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	if(!port->peripheral)
+	{
+		port->address = address;
+	}
+
+	size_t mtu = port->fd_frames ? CANFD_MTU : CAN_MTU;
+	struct timespec deadline;
+	dartt_deadline_in(&deadline, timeout);
+	for(;;)
+	{
+		ssize_t n = write(port->fd, &frame, mtu);
+		if(n == (ssize_t)mtu)
+		{
+			return DARTT_PROTOCOL_SUCCESS;
+		}
+		if(n >= 0 || (errno != ENOBUFS && errno != EAGAIN && errno != EINTR))
+		{
+			return DARTT_ERROR_INVALID_ARGUMENT;
+		}
+		int ms = dartt_ms_until(&deadline);
+		if(ms == 0)
+		{
+			return DARTT_ERROR_TIMEOUT;
+		}
+		struct pollfd pfd = {.fd = port->fd, .events = POLLOUT};
+		poll(&pfd, 1, ms);	//CAN sockets report ENOBUFS on a full queue, and may report POLLOUT before it drains
+	}
+}
+
+/**
+ * @brief dartt_sync_t blocking_rx_callback. Waits for the next frame for this side of the link.
+ *
+ * On the controller side, replies from a peripheral other than the one last addressed (late replies after a timeout
+ * and a switch of peripheral) are dropped.
+ *
+ * @param rx Buffer to receive the frame, with padding stripped
+ * @param user_context dartt_can_linux_t of the port
+ * @param timeout Milliseconds to wait
+ * @return DARTT_PROTOCOL_SUCCESS with rx->len set, DARTT_ERROR_TIMEOUT if no frame arrived in time,
+ * DARTT_ERROR_MALFORMED_MESSAGE for a frame with an invalid padding count, DARTT_ERROR_MEMORY_OVERRUN if the frame
+ * does not fit in rx, DARTT_ERROR_INVALID_ARGUMENT if the socket failed (errno holds the cause)
+ */
+int dartt_can_linux_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout)
+{
+	DARTT_ASSERT(user_context != NULL);
+	dartt_can_linux_t * port = (dartt_can_linux_t *)user_context;
+	int cb = check_buffer(rx);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	rx->len = 0;
+
+	struct timespec deadline;
+	dartt_deadline_in(&deadline, timeout);
+	for(;;)
+	{
+		struct canfd_frame frame;
+		ssize_t n = recv(port->fd, &frame, sizeof(frame), MSG_DONTWAIT);
+		if(n == CANFD_MTU || n == CAN_MTU)
+		{
+			unsigned char address;
+			int rc = dartt_can_linux_unpack(port, &frame, &address, rx);
+			if(rc == DARTT_ADDRESS_FILTERED || (rc == DARTT_PROTOCOL_SUCCESS && !port->peripheral && address != port->address))
+			{
+				rx->len = 0;
+				continue;
+			}
+			return rc;
+		}
+		if(n >= 0 || errno == EINTR)
+		{
+			continue;
+		}
+		if(errno != EAGAIN)
+		{
+			return DARTT_ERROR_INVALID_ARGUMENT;
+		}
+		struct pollfd pfd = {.fd = port->fd, .events = POLLIN};
+		int np = poll(&pfd, 1, dartt_ms_until(&deadline));
+		if(np == 0)
+		{
+			return DARTT_ERROR_TIMEOUT;
+		}
+		if(np < 0 && errno != EINTR)
+		{
+			return DARTT_ERROR_INVALID_ARGUMENT;
+		}
+	}
+}
@@ -0,0 +1,58 @@
+#ifndef DARTT_CAN_LINUX_H
+#define DARTT_CAN_LINUX_H
+#include <stdint.h>
+#include <stddef.h>
+#include <linux/can.h>
+#include "dartt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+	CAN identifier layout. The low 11 bits of every identifier are
+		bit 10		DARTT_CAN_ID_REPLY, set on frames sent by a peripheral
+		bit 9		DARTT_CAN_ID_PADDED, set on frames padded up to a legal CAN-FD length
+		bit 8		reserved, 0
+		bits 7-0	misc address of the peripheral, in both directions
+	The identifier base (0 for 11 bit identifiers, or a multiple of 0x800 for 29 bit extended identifiers) is ORed on
+	top, so several DARTT buses or other traffic can share one CAN bus.
+*/
+#define DARTT_CAN_ID_REPLY		0x400
+#define DARTT_CAN_ID_PADDED		0x200	//the last data byte holds the number of padding bytes, which all carry that value
+#define DARTT_CAN_ID_ADDRESS	0x0FF
+#define DARTT_CAN_ID_BITS		0x7FF	//identifier bits used by DARTT. Bits above are the identifier base
+
+/*
+	Linux SocketCAN transport for TYPE_ADDR_CRC_MESSAGE frames, one frame per CAN or CAN-FD frame, on a raw socket
+	bound to one interface (can0, vcan0, ...). On CAN-FD, frames are padded to the next legal data length on
+	transmission and the padding is stripped on reception. Pair with dartt_sync_t frame_len_callback = dartt_canfd_len
+	so multi-frame transfers are chunked to need as little padding as possible.
+*/
+typedef struct dartt_can_linux_t
+{
+		int fd;					// Raw CAN socket
+		int owns_fd;			// Nonzero if fd is closed by dartt_can_linux_close
+		int fd_frames;			// Nonzero for CAN-FD frames of up to 64 bytes, sent with bit rate switching. Zero for classic 8 byte frames
+		uint32_t id_base;		// ORed into every identifier. 0, or a multiple of 0x800 for 29 bit extended identifiers
+		int peripheral;			// Nonzero on the peripheral side (see dartt_can_linux_set_peripheral)
+		unsigned char address;	// Peripheral side: own misc address. Controller side: address of the last frame sent, replies from other peripherals are dropped
+}dartt_can_linux_t;
+
+
+int dartt_can_linux_open(dartt_can_linux_t * port, const char * ifname, int fd_frames, uint32_t id_base);
+int dartt_can_linux_attach(dartt_can_linux_t * port, int fd, int fd_frames, uint32_t id_base);
+int dartt_can_linux_set_peripheral(dartt_can_linux_t * port, unsigned char address);
+void dartt_can_linux_close(dartt_can_linux_t * port);
+int dartt_can_linux_pack(const dartt_can_linux_t * port, unsigned char address, const dartt_buffer_t * tx, struct canfd_frame * frame);
+int dartt_can_linux_unpack(const dartt_can_linux_t * port, const struct canfd_frame * frame, unsigned char * address, dartt_buffer_t * rx);
+int dartt_can_linux_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout);
+int dartt_can_linux_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
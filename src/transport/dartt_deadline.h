@@ -0,0 +1,38 @@
+#ifndef DARTT_DEADLINE_H
+#define DARTT_DEADLINE_H
+#include <stdint.h>
+#include <time.h>
+
+/*
+	Millisecond deadlines on CLOCK_MONOTONIC, shared by the Linux transports. A callback timeout covers the whole
+	call, so every wait inside it is bounded by the time left rather than by the full timeout.
+*/
+
+static inline void dartt_deadline_in(struct timespec * deadline, uint32_t timeout)
+{
+	clock_gettime(CLOCK_MONOTONIC, deadline);
+	deadline->tv_sec += timeout/1000;
+	deadline->tv_nsec += (long)(timeout % 1000)*1000000;
+	if(deadline->tv_nsec >= 1000000000)
+	{
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000;
+	}
+}
+
+/*
+	Milliseconds left until deadline, clamped to [0, INT32_MAX] for poll and epoll_wait
+*/
+static inline int dartt_ms_until(const struct timespec * deadline)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t ms = ((int64_t)deadline->tv_sec - now.tv_sec)*1000 + ((int64_t)deadline->tv_nsec - now.tv_nsec)/1000000;
+	if(ms < 0)
+	{
+		return 0;
+	}
+	return (ms > INT32_MAX) ? INT32_MAX : (int)ms;
+}
+
+#endif
@@ -0,0 +1,132 @@
+#define _GNU_SOURCE	//pread, pwrite, ftruncate, O_CLOEXEC
+#include "dartt_flash_file.h"
+#include "dartt_assert.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+static int file_erase(void * context, uint32_t offset, size_t len)
+{
+	dartt_flash_file_t * file = (dartt_flash_file_t *)context;
+	if(file->fd < 0)
+	{
+		file->fd = open(file->part_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if(file->fd < 0)
+		{
+			return DARTT_ERROR_INVALID_ARGUMENT;
+		}
+	}
+	unsigned char erased[DARTT_FLASH_FILE_SECTOR];
+	memset(erased, 0xFF, sizeof(erased));
+	size_t first = ((size_t)offset/DARTT_FLASH_FILE_SECTOR)*DARTT_FLASH_FILE_SECTOR;
+	for(size_t pos = first; pos < (size_t)offset + len; pos += DARTT_FLASH_FILE_SECTOR)
+	{
+		if(pwrite(file->fd, erased, sizeof(erased), (off_t)pos) != (ssize_t)sizeof(erased))
+		{
+			return DARTT_ERROR_INVALID_ARGUMENT;
+		}
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/*
+	Programming can only clear bits of erased bytes. Writing over programmed or never erased bytes is refused, as the
+	flash controller of an MCU would.
+*/
+static int file_program(void * context, uint32_t offset, const unsigned char * buf, size_t len)
+{
+	dartt_flash_file_t * file = (dartt_flash_file_t *)context;
+	if(file->fd < 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;	//not erased
+	}
+	unsigned char current[DARTT_FLASH_FILE_SECTOR];
+	for(size_t done = 0; done < len; )
+	{
+		size_t n = (len - done < sizeof(current)) ? len - done : sizeof(current);
+		if(pread(file->fd, current, n, (off_t)(offset + done)) != (ssize_t)n)
+		{
+			return DARTT_ERROR_INVALID_ARGUMENT;
+		}
+		for(size_t i = 0; i < n; i++)
+		{
+			if(current[i] != 0xFF)
+			{
+				return DARTT_ERROR_INVALID_ARGUMENT;
+			}
+		}
+		done += n;
+	}
+	if(pwrite(file->fd, buf, len, (off_t)offset) != (ssize_t)len)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+static int file_commit(void * context, size_t len, uint32_t crc)
+{
+	(void)crc;	//checked by dartt_flash_run against the CRC32 of what was programmed
+	dartt_flash_file_t * file = (dartt_flash_file_t *)context;
+	if(file->fd < 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	int rc = DARTT_PROTOCOL_SUCCESS;
+	if(ftruncate(file->fd, (off_t)len) != 0 || fsync(file->fd) != 0)
+	{
+		rc = DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	close(file->fd);
+	file->fd = -1;
+	if(rc == DARTT_PROTOCOL_SUCCESS && rename(file->part_path, file->path) != 0)
+	{
+		rc = DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	return rc;
+}
+
+/**
+ * @brief Set up a file backed flash slot.
+ *
+ * @param file Backend to initialize. Point dartt_flash_t.backend at file->backend
+ * @param path Image file. Created or replaced on the first commit
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_INVALID_ARGUMENT if path is too long
+ *
+ * @note Nothing is opened until the first erase. Backend callbacks report I/O failures as
+ * DARTT_ERROR_INVALID_ARGUMENT, with errno holding the cause.
+ */
+int dartt_flash_file_open(dartt_flash_file_t * file, const char * path)
+{
+	DARTT_ASSERT(file != NULL && path != NULL);
+	file->fd = -1;
+	size_t len = strlen(path);
+	if(len == 0 || len >= sizeof(file->path))
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	memcpy(file->path, path, len + 1);
+	memcpy(file->part_path, path, len);
+	memcpy(file->part_path + len, ".part", sizeof(".part"));
+	file->backend.erase = &file_erase;
+	file->backend.program = &file_program;
+	file->backend.commit = &file_commit;
+	file->backend.context = file;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Abandon an upload in progress, removing its part file. The committed image is left in place.
+ */
+void dartt_flash_file_close(dartt_flash_file_t * file)
+{
+	DARTT_ASSERT(file != NULL);
+	if(file->fd >= 0)
+	{
+		close(file->fd);
+		file->fd = -1;
+		unlink(file->part_path);
+	}
+}
@@ -0,0 +1,43 @@
+#ifndef DARTT_FLASH_FILE_H
+#define DARTT_FLASH_FILE_H
+#include <stdint.h>
+#include <stddef.h>
+#include "dartt.h"
+#include "dartt_flash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#ifndef DARTT_FLASH_FILE_SECTOR
+#define DARTT_FLASH_FILE_SECTOR		4096	//erase granularity of the simulated flash, in bytes
+#endif
+#ifndef DARTT_FLASH_FILE_MAX_PATH
+#define DARTT_FLASH_FILE_MAX_PATH	256		//longest image path, including the terminator
+#endif
+
+/*
+	Flash backend simulated with files, to run the flash staging path (dartt_flash.h) on a Linux host. Uploads go to
+	<path>.part, which behaves like NOR flash: erase fills whole sectors with 0xFF, and programming a byte that is
+	not erased fails. Commit trims the part file to the image size and renames it over <path>, so the previous
+	image stays in place until a new one is complete.
+*/
+typedef struct dartt_flash_file_t
+{
+		char path[DARTT_FLASH_FILE_MAX_PATH];		// Committed image file
+		char part_path[DARTT_FLASH_FILE_MAX_PATH + 5];	// Upload in progress, path with ".part" appended
+		int fd;					// part_path, open from the first erase to the commit. -1 otherwise
+		dartt_flash_backend_t backend;	// Callbacks bound to this file. Point dartt_flash_t.backend here
+}dartt_flash_file_t;
+
+
+int dartt_flash_file_open(dartt_flash_file_t * file, const char * path);
+void dartt_flash_file_close(dartt_flash_file_t * file);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
@@ -0,0 +1,290 @@
+#include "dartt_linksim.h"
+#include "dartt_check_buffer.h"
+#include "dartt_assert.h"
+
+#include <string.h>
+
+
+static uint64_t max_u64(uint64_t a, uint64_t b)
+{
+	return (a > b) ? a : b;
+}
+
+/*
+	Bytes a frame occupies on the wire
+*/
+static size_t wire_bytes(dartt_linksim_t * sim, const dartt_buffer_t * frame)
+{
+	if(!sim->params.cobs)
+	{
+		return frame->len;
+	}
+	dartt_buffer_t enc = {.buf = sim->cobs_mem, .size = sizeof(sim->cobs_mem), .len = 0};
+	if(dartt_cobs_encode(frame, &enc) != DARTT_PROTOCOL_SUCCESS)
+	{
+		return DARTT_COBS_MAX_FRAME_LEN(frame->len);
+	}
+	return enc.len;
+}
+
+/*
+	Account for one frame on the request (controller to peripheral) or reply wire, starting no earlier than ready_ns.
+	Returns the time its last bit leaves the sender.
+*/
+static uint64_t put_on_wire(dartt_linksim_t * sim, int reply, uint64_t ready_ns, size_t nbytes)
+{
+	uint64_t wire_ns = dartt_linksim_wire_ns(sim, nbytes);
+	uint64_t start;
+	if(sim->params.full_duplex)
+	{
+		uint64_t * free_ns = reply ? &sim->rx_free_ns : &sim->tx_free_ns;
+		start = max_u64(ready_ns, *free_ns);
+		*free_ns = start + wire_ns;
+	}
+	else
+	{
+		uint64_t free_ns = sim->tx_free_ns;
+		if(sim->bus_owner != reply)
+		{
+			free_ns += sim->params.turnaround_ns;	//the bus changes direction
+		}
+		start = max_u64(ready_ns, free_ns);
+		sim->tx_free_ns = start + wire_ns;
+		sim->bus_owner = reply;
+	}
+	if(reply)
+	{
+		sim->cycle_rx_busy_ns += wire_ns;
+	}
+	else
+	{
+		sim->cycle_tx_busy_ns += wire_ns;
+	}
+	sim->cycle.frames++;
+	sim->stats.frames++;
+	sim->stats.wire_bytes += nbytes;
+	return start + wire_ns;
+}
+
+static dartt_linksim_periph_t * find_periph(dartt_linksim_t * sim, unsigned char address)
+{
+	for(size_t i = 0; i < sim->num_periphs; i++)
+	{
+		if(sim->periphs[i].address == address)
+		{
+			return &sim->periphs[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Set up a simulated bus with no peripherals, at virtual time 0.
+ *
+ * @param sim Simulator to initialize
+ * @param params Link model, copied
+ * @param type Message type the controllers use on this bus
+ * @param cycle_ns Cycle period used by dartt_linksim_begin_cycle, or 0 for cycles that start as soon as the last
+ * one ended
+ */
+void dartt_linksim_init(dartt_linksim_t * sim, const dartt_linksim_params_t * params, serial_message_type_t type, uint64_t cycle_ns)
+{
+	DARTT_ASSERT(sim != NULL && params != NULL);
+	DARTT_ASSERT(params->baud != 0 && params->bits_per_byte != 0);
+	memset(sim, 0, sizeof(dartt_linksim_t));
+	sim->params = *params;
+	sim->type = type;
+	sim->cycle_ns = cycle_ns;
+}
+
+/**
+ * @brief Attach a simulated peripheral to the bus.
+ *
+ * @param sim Simulator
+ * @param address Misc address of the peripheral, i.e. dartt_get_complementary_address of the dartt_sync_t address
+ * @param mem Peripheral memory. Requests are served from it with dartt_parse_general_message
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_MEMORY_OVERRUN if DARTT_LINKSIM_MAX_PERIPHS are attached,
+ * DARTT_ERROR_INVALID_ARGUMENT if mem is not valid
+ */
+int dartt_linksim_add(dartt_linksim_t * sim, unsigned char address, dartt_mem_t mem)
+{
+	DARTT_ASSERT(sim != NULL);
+	int cm = check_mem_base(&mem);
+	if(cm != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cm;
+	}
+	if(sim->num_periphs == DARTT_LINKSIM_MAX_PERIPHS)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	sim->periphs[sim->num_periphs].address = address;
+	sim->periphs[sim->num_periphs].mem = mem;
+	sim->num_periphs++;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Time a frame of nbytes wire bytes occupies the link.
+ *
+ * @param sim Simulator
+ * @param nbytes Bytes on the wire, after any COBS encoding
+ * @return Nanoseconds, rounded up
+ */
+uint64_t dartt_linksim_wire_ns(const dartt_linksim_t * sim, size_t nbytes)
+{
+	DARTT_ASSERT(sim != NULL);
+	uint64_t bits = (uint64_t)nbytes*sim->params.bits_per_byte + sim->params.frame_overhead_bits;
+	return (bits*1000000000u + sim->params.baud - 1)/sim->params.baud;
+}
+
+/**
+ * @brief Start a cycle.
+ *
+ * With a cycle period, virtual time advances to the scheduled start of the cycle, unless the last cycle ran
+ * late; the new cycle then starts at once. Without one, the cycle starts at the current virtual time.
+ */
+void dartt_linksim_begin_cycle(dartt_linksim_t * sim)
+{
+	DARTT_ASSERT(sim != NULL);
+	if(sim->cycle_ns != 0 && sim->stats.cycles != 0)
+	{
+		sim->now_ns = max_u64(sim->now_ns, sim->cycle_start_ns + sim->cycle_ns);
+	}
+	sim->cycle_start_ns = sim->now_ns;
+	sim->cycle_tx_busy_ns = 0;
+	sim->cycle_rx_busy_ns = 0;
+	memset(&sim->cycle, 0, sizeof(sim->cycle));
+}
+
+/**
+ * @brief End the cycle started by dartt_linksim_begin_cycle, and fold it into sim->stats.
+ *
+ * @return Traffic of the cycle. Bus utilization is busy_ns/cycle_ns
+ *
+ * @note A cycle ends when its last transaction has completed on the controller. A write without a reply counts
+ * until its last bit is received by the peripheral.
+ */
+dartt_linksim_cycle_t dartt_linksim_end_cycle(dartt_linksim_t * sim)
+{
+	DARTT_ASSERT(sim != NULL);
+	uint64_t end = max_u64(sim->now_ns, max_u64(sim->tx_free_ns, sim->rx_free_ns) + sim->params.propagation_ns);
+	sim->cycle.duration_ns = end - sim->cycle_start_ns;
+	sim->cycle.busy_ns = sim->params.full_duplex ? max_u64(sim->cycle_tx_busy_ns, sim->cycle_rx_busy_ns) : sim->cycle_tx_busy_ns + sim->cycle_rx_busy_ns;
+
+	sim->stats.cycles++;
+	if(sim->cycle_ns != 0 && sim->cycle.duration_ns > sim->cycle_ns)
+	{
+		sim->stats.overruns++;
+	}
+	sim->stats.max_duration_ns = max_u64(sim->stats.max_duration_ns, sim->cycle.duration_ns);
+	sim->stats.max_busy_ns = max_u64(sim->stats.max_busy_ns, sim->cycle.busy_ns);
+	sim->stats.total_busy_ns += sim->cycle.busy_ns;
+	sim->stats.max_latency_ns = max_u64(sim->stats.max_latency_ns, sim->cycle.max_latency_ns);
+	sim->now_ns = end;
+	return sim->cycle;
+}
+
+/**
+ * @brief dartt_sync_t blocking_tx_callback. Sends a frame on the simulated link.
+ *
+ * The peripheral at address serves the frame as soon as it has received it, and any reply is queued for
+ * dartt_linksim_rx with the time it reaches the controller. Virtual time advances to the end of the transmission.
+ * Frames to an address with no peripheral go on the wire and are dropped.
+ *
+ * @param address Misc address of the peripheral
+ * @param tx Frame to send
+ * @param user_context dartt_linksim_t of the bus
+ * @param timeout Unused. The link never blocks
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_MEMORY_OVERRUN if the frame is longer than
+ * DARTT_LINKSIM_MAX_FRAME or DARTT_LINKSIM_QUEUE replies are already waiting
+ */
+int dartt_linksim_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	(void)timeout;
+	DARTT_ASSERT(user_context != NULL);
+	dartt_linksim_t * sim = (dartt_linksim_t *)user_context;
+	int cb = check_buffer(tx);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	if(tx->len > DARTT_LINKSIM_MAX_FRAME || sim->reply_count == DARTT_LINKSIM_QUEUE)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	uint64_t request_ns = sim->now_ns;
+	uint64_t sent_ns = put_on_wire(sim, 0, sim->now_ns, wire_bytes(sim, tx));	//may wait for the bus first
+	sim->now_ns = sent_ns;	//blocking transmission
+
+	dartt_linksim_periph_t * periph = find_periph(sim, address);
+	if(periph == NULL)
+	{
+		return DARTT_PROTOCOL_SUCCESS;
+	}
+	uint64_t arrived_ns = sent_ns + sim->params.propagation_ns;
+	uint64_t done_ns = max_u64(arrived_ns, sim->periph_free_ns) + sim->params.periph_fixed_ns + (uint64_t)sim->params.periph_per_byte_ns*tx->len;
+	sim->periph_free_ns = done_ns;
+
+	dartt_linksim_reply_t * slot = &sim->replies[(sim->reply_head + sim->reply_count) % DARTT_LINKSIM_QUEUE];
+	dartt_buffer_t request = {.buf = tx->buf, .size = tx->size, .len = tx->len};
+	dartt_buffer_t reply = {.buf = slot->mem, .size = sizeof(slot->mem), .len = 0};
+	payload_layer_msg_t pld = {};
+	if(dartt_frame_to_payload(&request, sim->type, PAYLOAD_ALIAS, &pld) != DARTT_PROTOCOL_SUCCESS)
+	{
+		return DARTT_PROTOCOL_SUCCESS;	//a real peripheral drops it too
+	}
+	dartt_parse_general_message(&pld, sim->type, &periph->mem, &reply);
+	if(reply.len == 0)
+	{
+		return DARTT_PROTOCOL_SUCCESS;
+	}
+	slot->len = reply.len;
+	slot->request_ns = request_ns;
+	slot->received_ns = put_on_wire(sim, 1, done_ns, wire_bytes(sim, &reply)) + sim->params.propagation_ns;
+	sim->reply_count++;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief dartt_sync_t blocking_rx_callback. Receives the oldest queued reply.
+ *
+ * Virtual time advances to the moment the reply has been received, or by the timeout if there is none.
+ *
+ * @param rx Buffer to receive the frame
+ * @param user_context dartt_linksim_t of the bus
+ * @param timeout Milliseconds of virtual time to wait when no reply is queued
+ * @return DARTT_PROTOCOL_SUCCESS with rx->len set to the frame length, DARTT_ERROR_TIMEOUT if no reply is queued,
+ * DARTT_ERROR_MEMORY_OVERRUN if the reply does not fit in rx (it is consumed)
+ */
+int dartt_linksim_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout)
+{
+	DARTT_ASSERT(user_context != NULL);
+	dartt_linksim_t * sim = (dartt_linksim_t *)user_context;
+	int cb = check_buffer(rx);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	rx->len = 0;
+	if(sim->reply_count == 0)
+	{
+		sim->now_ns += (uint64_t)timeout*1000000u;
+		sim->cycle.timeouts++;
+		sim->stats.timeouts++;
+		return DARTT_ERROR_TIMEOUT;
+	}
+	dartt_linksim_reply_t * slot = &sim->replies[sim->reply_head];
+	sim->reply_head = (sim->reply_head + 1) % DARTT_LINKSIM_QUEUE;
+	sim->reply_count--;
+	sim->now_ns = max_u64(sim->now_ns, slot->received_ns);
+	uint64_t latency = slot->received_ns - slot->request_ns;
+	sim->cycle.max_latency_ns = max_u64(sim->cycle.max_latency_ns, latency);
+	if(slot->len > rx->size)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	memcpy(rx->buf, slot->mem, slot->len);
+	rx->len = slot->len;
+	return DARTT_PROTOCOL_SUCCESS;
+}
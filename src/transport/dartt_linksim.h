@@ -0,0 +1,120 @@
+#ifndef DARTT_LINKSIM_H
+#define DARTT_LINKSIM_H
+#include <stdint.h>
+#include <stddef.h>
+#include "dartt.h"
+#include "dartt_cobs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#ifndef DARTT_LINKSIM_MAX_PERIPHS
+#define DARTT_LINKSIM_MAX_PERIPHS	16		//simulated peripherals per bus
+#endif
+#ifndef DARTT_LINKSIM_MAX_FRAME
+#define DARTT_LINKSIM_MAX_FRAME		512		//largest frame, before COBS encoding
+#endif
+#ifndef DARTT_LINKSIM_QUEUE
+#define DARTT_LINKSIM_QUEUE			16		//replies in flight, for pipelined reads
+#endif
+
+/*
+	Physical link model. All times in nanoseconds
+*/
+typedef struct dartt_linksim_params_t
+{
+		uint32_t baud;				// Bits per second on the wire
+		uint8_t bits_per_byte;		// Including start, parity and stop bits. 10 for 8N1
+		uint8_t cobs;				// Nonzero if frames are COBS encoded with a delimiter on the wire (dartt_serial_linux)
+		uint8_t full_duplex;		// Nonzero if requests and replies use separate wires. Otherwise the bus is shared, as on RS485
+		uint32_t frame_overhead_bits;	// Bits added to every frame by the link, e.g. CAN arbitration, control and CRC fields. 0 for a UART
+		uint32_t turnaround_ns;		// Half duplex: gap between one side releasing the bus and the other driving it
+		uint32_t propagation_ns;	// Delay from the end of a frame to its reception, per direction. Includes adapter latency
+		uint32_t periph_fixed_ns;	// Peripheral processing per request
+		uint32_t periph_per_byte_ns;	// Peripheral processing per request byte
+}dartt_linksim_params_t;
+
+/*
+	Traffic of one cycle, as returned by dartt_linksim_end_cycle
+*/
+typedef struct dartt_linksim_cycle_t
+{
+		uint64_t duration_ns;		// Cycle start to the end of its last transaction
+		uint64_t busy_ns;			// Wire time of all frames. On a full duplex link, of the busier direction
+		uint64_t max_latency_ns;	// Worst time from handing a request to the tx callback to receiving its reply
+		uint32_t frames;			// Frames on the wire, both directions
+		uint32_t timeouts;			// Receptions that found no reply
+}dartt_linksim_cycle_t;
+
+typedef struct dartt_linksim_stats_t
+{
+		uint32_t cycles;
+		uint32_t overruns;			// Cycles longer than cycle_ns
+		uint64_t max_duration_ns;	// Longest cycle
+		uint64_t max_busy_ns;		// Most wire time in a cycle
+		uint64_t total_busy_ns;
+		uint64_t max_latency_ns;	// Worst latency of any transaction
+		uint32_t frames;
+		uint64_t wire_bytes;		// Bytes on the wire, after COBS encoding
+		uint32_t timeouts;
+}dartt_linksim_stats_t;
+
+typedef struct dartt_linksim_periph_t
+{
+		unsigned char address;		// Misc address the frames are sent to, dartt_get_complementary_address(psync->address)
+		dartt_mem_t mem;			// Peripheral memory, served with dartt_parse_general_message
+}dartt_linksim_periph_t;
+
+typedef struct dartt_linksim_reply_t
+{
+		unsigned char mem[DARTT_LINKSIM_MAX_FRAME];
+		size_t len;
+		uint64_t received_ns;		// Virtual time at which the controller has the whole reply
+		uint64_t request_ns;		// Virtual time at which the request was handed to the tx callback
+}dartt_linksim_reply_t;
+
+/*
+	Simulated bus. The tx and rx callbacks do not sleep: they serve the frames with the simulated peripherals at once,
+	and advance a virtual clock by the time the exchange would take on the modelled link. The controller itself is
+	assumed to take no time between calls.
+*/
+typedef struct dartt_linksim_t
+{
+		dartt_linksim_params_t params;
+		serial_message_type_t type;	// Message type used by the controllers on this bus
+		uint64_t cycle_ns;			// Cycle period. 0 for free running cycles
+		dartt_linksim_periph_t periphs[DARTT_LINKSIM_MAX_PERIPHS];
+		size_t num_periphs;
+		uint64_t now_ns;			// Virtual time of the controller
+		uint64_t tx_free_ns;		// Request wire (the bus, if half duplex) is free from here
+		uint64_t rx_free_ns;		// Reply wire is free from here. Unused if half duplex
+		uint64_t periph_free_ns;	// Peripherals are idle from here
+		int bus_owner;				// Half duplex: 0 if the controller drove the bus last, 1 if a peripheral did
+		dartt_linksim_reply_t replies[DARTT_LINKSIM_QUEUE];	// Replies not yet received by the controller
+		size_t reply_head;
+		size_t reply_count;
+		uint64_t cycle_start_ns;
+		uint64_t cycle_tx_busy_ns;
+		uint64_t cycle_rx_busy_ns;
+		dartt_linksim_cycle_t cycle;	// Cycle in progress
+		dartt_linksim_stats_t stats;
+		unsigned char cobs_mem[DARTT_COBS_MAX_FRAME_LEN(DARTT_LINKSIM_MAX_FRAME)];	// Encoding scratch, to count wire bytes
+}dartt_linksim_t;
+
+
+void dartt_linksim_init(dartt_linksim_t * sim, const dartt_linksim_params_t * params, serial_message_type_t type, uint64_t cycle_ns);
+int dartt_linksim_add(dartt_linksim_t * sim, unsigned char address, dartt_mem_t mem);
+uint64_t dartt_linksim_wire_ns(const dartt_linksim_t * sim, size_t nbytes);
+void dartt_linksim_begin_cycle(dartt_linksim_t * sim);
+dartt_linksim_cycle_t dartt_linksim_end_cycle(dartt_linksim_t * sim);
+int dartt_linksim_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout);
+int dartt_linksim_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
@@ -0,0 +1,373 @@
+
+#include "dartt_serial_linux.h"
+#include "dartt_check_buffer.h"
+#include "dartt_assert.h"
+#include "dartt_deadline.h"
+
+#include <asm/termbits.h>	//termios2 and BOTHER. Not compatible with <termios.h>, which must not be included here
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#define NO_FRAME	1	//internal: no complete frame buffered yet
+
+
+/*
+	Drop the first n bytes of the receive buffer
+*/
+static void consume_rx(dartt_serial_linux_t * port, size_t n)
+{
+	memmove(port->rx_mem, port->rx_mem + n, port->rx_len - n);
+	port->rx_len -= n;
+}
+
+/*
+	Decode the first complete frame in the receive buffer into rx.
+	Returns NO_FRAME if no delimiter has been received yet, otherwise the result of the decode. Empty frames
+	(back to back delimiters, used by some senders to flush line noise) are skipped.
+*/
+static int next_frame(dartt_serial_linux_t * port, dartt_buffer_t * rx)
+{
+	for(;;)
+	{
+		unsigned char * delim = memchr(port->rx_mem, DARTT_COBS_DELIMITER, port->rx_len);
+		if(delim == NULL)
+		{
+			if(port->rx_discard)
+			{
+				port->rx_len = 0;
+			}
+			return NO_FRAME;
+		}
+		size_t frame_len = (size_t)(delim - port->rx_mem);
+		if(port->rx_discard || frame_len == 0)
+		{
+			port->rx_discard = 0;	//tail of an overlong frame, or an empty frame
+			consume_rx(port, frame_len + 1);
+			continue;
+		}
+		dartt_buffer_t enc = {.buf = port->rx_mem, .size = sizeof(port->rx_mem), .len = frame_len};
+		int rc = dartt_cobs_decode(&enc, rx);
+		consume_rx(port, frame_len + 1);
+		return rc;
+	}
+}
+
+/**
+ * @brief Set the port to raw 8N1 mode at an arbitrary baud rate.
+ *
+ * Uses termios2 with BOTHER, so any rate the UART clock can generate is accepted (e.g. 2000000, 3000000), not
+ * only the Bxxxx constants.
+ *
+ * @param port Open port
+ * @param baud Baud rate in bits per second
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_INVALID_ARGUMENT if the driver rejects the settings
+ */
+int dartt_serial_linux_set_baud(dartt_serial_linux_t * port, uint32_t baud)
+{
+	DARTT_ASSERT(port != NULL);
+	struct termios2 tio;
+	if(ioctl(port->fd, TCGETS2, &tio) != 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF | IXANY);
+	tio.c_oflag &= ~OPOST;
+	tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+	tio.c_cflag &= ~(CSIZE | PARENB | CSTOPB | CRTSCTS | CBAUD | (CBAUD << IBSHIFT));
+	tio.c_cflag |= CS8 | CREAD | CLOCAL | BOTHER | (BOTHER << IBSHIFT);
+	tio.c_ispeed = baud;
+	tio.c_ospeed = baud;
+	tio.c_cc[VMIN] = 1;	//with O_NONBLOCK this makes an empty read fail with EAGAIN. VMIN = 0 would return 0 instead
+	tio.c_cc[VTIME] = 0;
+	if(ioctl(port->fd, TCSETS2, &tio) != 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Set up a transport on an already open tty.
+ *
+ * @param port Transport context to initialize
+ * @param fd Open tty file descriptor. It is switched to nonblocking mode, and is not closed by
+ * dartt_serial_linux_close
+ * @param baud Baud rate. The port is set to raw mode at this rate, ASYNC_LOW_LATENCY is requested and pending
+ * input is flushed. Pass 0 to leave the line settings untouched (e.g. the master side of a pty)
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_INVALID_ARGUMENT if the line settings or the epoll
+ * instance could not be set up (errno holds the cause)
+ *
+ * @note ASYNC_LOW_LATENCY is best effort. Drivers that honor it (ftdi_sio drops its latency timer from 16ms to 1ms)
+ * report it in port->low_latency. ptys and most on-board UARTs ignore it.
+ */
+int dartt_serial_linux_attach(dartt_serial_linux_t * port, int fd, uint32_t baud)
+{
+	DARTT_ASSERT(port != NULL);
+	port->fd = fd;
+	port->epoll_fd = -1;
+	port->owns_fd = 0;
+	port->low_latency = 0;
+	port->rx_len = 0;
+	port->rx_discard = 0;
+
+	int flags = fcntl(fd, F_GETFL);
+	if(flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	if(baud != 0)
+	{
+		int rc = dartt_serial_linux_set_baud(port, baud);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
+		struct serial_struct ser;
+		if(ioctl(fd, TIOCGSERIAL, &ser) == 0)
+		{
+			ser.flags |= ASYNC_LOW_LATENCY;
+			port->low_latency = (ioctl(fd, TIOCSSERIAL, &ser) == 0);
+		}
+		ioctl(fd, TCFLSH, TCIOFLUSH);	//drop anything received before the port was configured
+	}
+
+	port->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if(port->epoll_fd < 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	struct epoll_event ev = {.events = EPOLLIN, .data = {.fd = fd}};
+	if(epoll_ctl(port->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0)
+	{
+		close(port->epoll_fd);
+		port->epoll_fd = -1;
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Open and configure a serial port.
+ *
+ * @param port Transport context to initialize
+ * @param path Device path, e.g. "/dev/ttyUSB0"
+ * @param baud Baud rate in bits per second. Must not be 0
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_INVALID_ARGUMENT if the port could not be opened or
+ * configured (errno holds the cause)
+ *
+ * @note The port is opened for exclusive use (TIOCEXCL), so a second process cannot interleave bytes with ours.
+ */
+int dartt_serial_linux_open(dartt_serial_linux_t * port, const char * path, uint32_t baud)
+{
+	DARTT_ASSERT(port != NULL && path != NULL);
+	if(baud == 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if(fd < 0)
+	{
+		port->fd = -1;
+		port->epoll_fd = -1;
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	ioctl(fd, TIOCEXCL);
+	int rc = dartt_serial_linux_attach(port, fd, baud);
+	port->owns_fd = 1;
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		dartt_serial_linux_close(port);
+	}
+	return rc;
+}
+
+/**
+ * @brief Release the epoll instance, and the tty if it was opened by dartt_serial_linux_open.
+ */
+void dartt_serial_linux_close(dartt_serial_linux_t * port)
+{
+	DARTT_ASSERT(port != NULL);
+	if(port->epoll_fd >= 0)
+	{
+		close(port->epoll_fd);
+		port->epoll_fd = -1;
+	}
+	if(port->owns_fd && port->fd >= 0)
+	{
+		close(port->fd);
+	}
+	port->fd = -1;
+	port->owns_fd = 0;
+}
+
+/**
+ * @brief View into the transmit buffer of the port, with room in front for the COBS overhead and behind for the
+ * delimiter. Use it as dartt_sync_t tx_buf: frames built in it are encoded in place by dartt_serial_linux_tx
+ * instead of being copied into the transmit buffer.
+ *
+ * @param port Port
+ * @return Empty buffer of DARTT_SERIAL_LINUX_MAX_FRAME bytes
+ */
+dartt_buffer_t dartt_serial_linux_tx_buffer(dartt_serial_linux_t * port)
+{
+	DARTT_ASSERT(port != NULL);
+	dartt_buffer_t dma = {.buf = port->tx_mem, .size = sizeof(port->tx_mem), .len = 0};
+	dartt_buffer_t frame = {};
+	dartt_buffer_reserve(&dma, DARTT_COBS_HEADROOM(DARTT_SERIAL_LINUX_MAX_FRAME), DARTT_COBS_TAILROOM, &frame);
+	return frame;
+}
+
+/**
+ * @brief dartt_sync_t blocking_tx_callback. COBS encodes a frame and writes it to the port.
+ *
+ * @param address Unused. TYPE_SERIAL_MESSAGE frames carry their own address
+ * @param tx Frame to send
+ * @param user_context dartt_serial_linux_t of the port
+ * @param timeout Milliseconds to wait for room in the kernel transmit buffer
+ * @return DARTT_PROTOCOL_SUCCESS once the whole frame is queued in the kernel, DARTT_ERROR_TIMEOUT if it could not
+ * be queued in time, DARTT_ERROR_MEMORY_OVERRUN if the frame is longer than DARTT_SERIAL_LINUX_MAX_FRAME,
+ * DARTT_ERROR_INVALID_ARGUMENT if the port failed (errno holds the cause)
+ *
+ * @note A frame built in the view of dartt_serial_linux_tx_buffer is encoded in place, and its bytes are overwritten.
+ * @note The frame is not drained (tcdrain) before returning. The reply can only arrive after the frame is out, so
+ * waiting for it here would only add a syscall round trip to the transaction.
+ */
+int dartt_serial_linux_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	(void)address;
+	DARTT_ASSERT(user_context != NULL);
+	dartt_serial_linux_t * port = (dartt_serial_linux_t *)user_context;
+	int cb = check_buffer(tx);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	if(tx->len > DARTT_SERIAL_LINUX_MAX_FRAME)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	dartt_buffer_t dma = {.buf = port->tx_mem, .size = sizeof(port->tx_mem), .len = 0};
+	dartt_buffer_t enc = dma;
+	int rc;
+	if(tx->buf >= port->tx_mem && tx->buf < port->tx_mem + sizeof(port->tx_mem))
+	{
+		enc = *tx;
+		rc = dartt_cobs_encode_in_place(&dma, &enc);	//built in the view of dartt_serial_linux_tx_buffer: no copy
+	}
+	else
+	{
+		rc = dartt_cobs_encode(tx, &enc);
+	}
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+
+	struct timespec deadline;
+	dartt_deadline_in(&deadline, timeout);
+	size_t sent = 0;
+	while(sent < enc.len)
+	{
+		ssize_t n = write(port->fd, enc.buf + sent, enc.len - sent);
+		if(n > 0)
+		{
+			sent += (size_t)n;
+			continue;
+		}
+		if(n < 0 && errno != EAGAIN && errno != EINTR)
+		{
+			return DARTT_ERROR_INVALID_ARGUMENT;
+		}
+		struct pollfd pfd = {.fd = port->fd, .events = POLLOUT};
+		int np = poll(&pfd, 1, dartt_ms_until(&deadline));
+		if(np == 0)
+		{
+			return DARTT_ERROR_TIMEOUT;
+		}
+		if(np < 0 && errno != EINTR)
+		{
+			return DARTT_ERROR_INVALID_ARGUMENT;
+		}
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief dartt_sync_t blocking_rx_callback. Waits for the next COBS frame and decodes it into rx.
+ *
+ * Bytes are read as soon as epoll reports them, so the call returns as soon as the frame delimiter arrives. Bytes
+ * following the delimiter are kept for the next call.
+ *
+ * @param rx Buffer to receive the decoded frame
+ * @param user_context dartt_serial_linux_t of the port
+ * @param timeout Milliseconds to wait for a complete frame
+ * @return DARTT_PROTOCOL_SUCCESS with rx->len set to the frame length, DARTT_ERROR_TIMEOUT if no complete frame
+ * arrived in time, DARTT_ERROR_MALFORMED_MESSAGE for a frame that fails COBS decoding or is longer than
+ * DARTT_SERIAL_LINUX_MAX_FRAME (it is discarded up to its delimiter), DARTT_ERROR_MEMORY_OVERRUN if the frame does
+ * not fit in rx, DARTT_ERROR_INVALID_ARGUMENT if the port failed or hung up (errno holds the cause)
+ */
+int dartt_serial_linux_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout)
+{
+	DARTT_ASSERT(user_context != NULL);
+	dartt_serial_linux_t * port = (dartt_serial_linux_t *)user_context;
+	int cb = check_buffer(rx);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	rx->len = 0;
+
+	struct timespec deadline;
+	dartt_deadline_in(&deadline, timeout);
+	int hangup = 0;
+	for(;;)
+	{
+		int rc = next_frame(port, rx);
+		if(rc != NO_FRAME)
+		{
+			return rc;
+		}
+		if(port->rx_len == sizeof(port->rx_mem))
+		{
+			port->rx_len = 0;	//no delimiter in a full buffer. Drop the frame, and the rest of it as it arrives
+			port->rx_discard = 1;
+			return DARTT_ERROR_MALFORMED_MESSAGE;
+		}
+
+		ssize_t n = read(port->fd, port->rx_mem + port->rx_len, sizeof(port->rx_mem) - port->rx_len);
+		if(n > 0)
+		{
+			port->rx_len += (size_t)n;
+			continue;
+		}
+		if(n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if((n < 0 && errno != EAGAIN) || hangup)
+		{
+			return DARTT_ERROR_INVALID_ARGUMENT;
+		}
+
+		struct epoll_event ev;
+		int ne = epoll_wait(port->epoll_fd, &ev, 1, dartt_ms_until(&deadline));
+		if(ne == 0)
+		{
+			return DARTT_ERROR_TIMEOUT;
+		}
+		if(ne < 0 && errno != EINTR)
+		{
+			return DARTT_ERROR_INVALID_ARGUMENT;
+		}
+		if(ne > 0 && (ev.events & (EPOLLHUP | EPOLLERR)))
+		{
+			hangup = 1;	//read whatever is left, then fail
+		}
+	}
+}
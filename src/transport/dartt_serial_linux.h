@@ -0,0 +1,48 @@
+#ifndef DARTT_SERIAL_LINUX_H
+#define DARTT_SERIAL_LINUX_H
+#include <stdint.h>
+#include <stddef.h>
+#include "dartt.h"
+#include "dartt_cobs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#ifndef DARTT_SERIAL_LINUX_MAX_FRAME
+#define DARTT_SERIAL_LINUX_MAX_FRAME	512	//largest decoded frame (address, payload and CRC) accepted by the transport
+#endif
+
+/*
+	Linux serial transport. COBS framed DARTT frames over a tty (/dev/ttyUSB*, /dev/ttyACM*, pty).
+	Reads are nonblocking and woken by epoll, so a reply is returned as soon as its delimiter arrives instead of
+	after a VTIME inter-byte timeout.
+*/
+typedef struct dartt_serial_linux_t
+{
+		int fd;					// tty file descriptor, opened O_NONBLOCK
+		int epoll_fd;			// epoll instance watching fd
+		int owns_fd;			// Nonzero if fd is closed by dartt_serial_linux_close
+		int low_latency;		// Nonzero if ASYNC_LOW_LATENCY was applied to the port
+		unsigned char rx_mem[DARTT_COBS_MAX_FRAME_LEN(DARTT_SERIAL_LINUX_MAX_FRAME)];	// Encoded bytes received but not yet returned
+		size_t rx_len;			// Number of bytes in rx_mem
+		int rx_discard;			// Nonzero while discarding an overlong frame up to its delimiter
+		unsigned char tx_mem[DARTT_COBS_MAX_FRAME_LEN(DARTT_SERIAL_LINUX_MAX_FRAME)];	// Encoding scratch for transmissions. Frames can also be built in place, see dartt_serial_linux_tx_buffer
+}dartt_serial_linux_t;
+
+
+int dartt_serial_linux_open(dartt_serial_linux_t * port, const char * path, uint32_t baud);
+int dartt_serial_linux_attach(dartt_serial_linux_t * port, int fd, uint32_t baud);
+void dartt_serial_linux_close(dartt_serial_linux_t * port);
+int dartt_serial_linux_set_baud(dartt_serial_linux_t * port, uint32_t baud);
+dartt_buffer_t dartt_serial_linux_tx_buffer(dartt_serial_linux_t * port);
+int dartt_serial_linux_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout);
+int dartt_serial_linux_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
@@ -0,0 +1,431 @@
+#define _GNU_SOURCE	//memfd_create
+#include "dartt_shm_linux.h"
+#include "dartt_check_buffer.h"
+#include "dartt_assert.h"
+#include "dartt_deadline.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#define SHM_MAGIC		0x54524144u	//"DART"
+#define SHM_VERSION		1u
+#define SLOT_MASK		(DARTT_SHM_LINUX_SLOTS - 1u)
+#define CTL_TO_PERIPH	0
+#define PERIPH_TO_CTL	1
+
+_Static_assert((DARTT_SHM_LINUX_SLOTS & SLOT_MASK) == 0, "DARTT_SHM_LINUX_SLOTS must be a power of two");
+
+/*
+	Single producer, single consumer ring of frames. head and tail are free running counters, and are also the futex
+	words the consumer (tail) and producer (head) sleep on. Each side announces that it is about to sleep in its
+	sleeping flag, so the other side only makes the FUTEX_WAKE syscall when someone is actually asleep.
+*/
+typedef struct shm_ring_t
+{
+	_Alignas(64) _Atomic uint32_t tail;		// Written by the producer
+	_Atomic uint32_t consumer_sleeping;
+	_Alignas(64) _Atomic uint32_t head;		// Written by the consumer
+	_Atomic uint32_t producer_sleeping;
+	_Alignas(64) uint32_t len[DARTT_SHM_LINUX_SLOTS];
+	unsigned char data[DARTT_SHM_LINUX_SLOTS][DARTT_SHM_LINUX_MAX_FRAME];
+}shm_ring_t;
+
+struct dartt_shm_region_t
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slots;
+	uint32_t max_frame;
+	shm_ring_t ring[2];
+};
+
+static shm_ring_t * tx_ring(dartt_shm_linux_t * link)
+{
+	return &link->region->ring[link->peripheral ? PERIPH_TO_CTL : CTL_TO_PERIPH];
+}
+
+static shm_ring_t * rx_ring(dartt_shm_linux_t * link)
+{
+	return &link->region->ring[link->peripheral ? CTL_TO_PERIPH : PERIPH_TO_CTL];
+}
+
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+/*
+	Wake the other side if it announced that it is asleep on word. The sequentially consistent load pairs with the
+	store of the sleeping flag in wait_change, so either the sleeper sees the new value of word before sleeping, or
+	we see its flag here.
+*/
+static void wake(_Atomic uint32_t * word, _Atomic uint32_t * sleeping)
+{
+	if(atomic_load_explicit(sleeping, memory_order_seq_cst) != 0)
+	{
+		syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE, 1, NULL, NULL, 0);	//not FUTEX_PRIVATE_FLAG: the other side may be another process
+	}
+}
+
+/*
+	Wait until word no longer holds seen. Polls link->spin times, then calls the pump callback if one is set, then
+	sleeps on the futex for whatever is left of the deadline.
+	Returns DARTT_PROTOCOL_SUCCESS once word has changed, DARTT_ERROR_TIMEOUT at the deadline.
+*/
+static int wait_change(dartt_shm_linux_t * link, _Atomic uint32_t * word, uint32_t seen, _Atomic uint32_t * sleeping, const struct timespec * deadline)
+{
+	for(uint32_t i = 0; i < link->spin; i++)
+	{
+		if(atomic_load_explicit(word, memory_order_acquire) != seen)
+		{
+			return DARTT_PROTOCOL_SUCCESS;
+		}
+		cpu_relax();
+	}
+	for(;;)
+	{
+		if(link->pump_callback != NULL && link->pump_callback(link->pump_context) != 0)
+		{
+			if(atomic_load_explicit(word, memory_order_acquire) != seen)
+			{
+				return DARTT_PROTOCOL_SUCCESS;
+			}
+			continue;	//the peripheral made progress, e.g. consumed a write that has no reply
+		}
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		struct timespec left = {.tv_sec = deadline->tv_sec - now.tv_sec, .tv_nsec = deadline->tv_nsec - now.tv_nsec};
+		if(left.tv_nsec < 0)
+		{
+			left.tv_sec--;
+			left.tv_nsec += 1000000000;
+		}
+		if(left.tv_sec < 0 || (left.tv_sec == 0 && left.tv_nsec == 0))
+		{
+			return (atomic_load_explicit(word, memory_order_acquire) != seen) ? DARTT_PROTOCOL_SUCCESS : DARTT_ERROR_TIMEOUT;
+		}
+		atomic_store_explicit(sleeping, 1, memory_order_seq_cst);
+		if(atomic_load_explicit(word, memory_order_seq_cst) == seen)
+		{
+			syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT, seen, &left, NULL, 0);	//EAGAIN, EINTR and ETIMEDOUT are all handled by the loop
+		}
+		atomic_store_explicit(sleeping, 0, memory_order_relaxed);
+		if(atomic_load_explicit(word, memory_order_acquire) != seen)
+		{
+			return DARTT_PROTOCOL_SUCCESS;
+		}
+	}
+}
+
+/*
+	Wait for a free slot in the transmit ring. Returns its index in *slot.
+*/
+static int wait_tx_slot(dartt_shm_linux_t * link, const struct timespec * deadline, uint32_t * slot)
+{
+	shm_ring_t * ring = tx_ring(link);
+	uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	for(;;)
+	{
+		uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+		if(tail - head < DARTT_SHM_LINUX_SLOTS)
+		{
+			*slot = tail & SLOT_MASK;
+			return DARTT_PROTOCOL_SUCCESS;
+		}
+		int rc = wait_change(link, &ring->head, head, &ring->producer_sleeping, deadline);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
+	}
+}
+
+/*
+	Publish the frame written to the transmit slot returned by wait_tx_slot
+*/
+static void publish_tx(dartt_shm_linux_t * link, uint32_t len)
+{
+	shm_ring_t * ring = tx_ring(link);
+	uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	ring->len[tail & SLOT_MASK] = len;
+	atomic_store_explicit(&ring->tail, tail + 1, memory_order_seq_cst);
+	wake(&ring->tail, &ring->consumer_sleeping);
+}
+
+/*
+	Wait for a frame in the receive ring. Returns its index in *slot. The frame stays in the ring until release_rx.
+*/
+static int wait_rx_slot(dartt_shm_linux_t * link, const struct timespec * deadline, uint32_t * slot)
+{
+	shm_ring_t * ring = rx_ring(link);
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+	if(tail == head)
+	{
+		int rc = wait_change(link, &ring->tail, tail, &ring->consumer_sleeping, deadline);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
+	}
+	*slot = head & SLOT_MASK;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+static void release_rx(dartt_shm_linux_t * link)
+{
+	shm_ring_t * ring = rx_ring(link);
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	atomic_store_explicit(&ring->head, head + 1, memory_order_seq_cst);
+	wake(&ring->head, &ring->producer_sleeping);
+}
+
+/**
+ * @brief Map an existing shared memory link.
+ *
+ * @param link Link context to initialize. spin is set for the host (0 on a single core), and the pump callback is
+ * cleared; change either after the call
+ * @param fd memfd of dartt_shm_linux_create, inherited or received from the process that created it. Not closed by
+ * dartt_shm_linux_close
+ * @param peripheral Nonzero to attach the peripheral side, zero for the controller side. Each side must be attached
+ * once
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_INVALID_ARGUMENT if fd could not be mapped or was not
+ * created with the same DARTT_SHM_LINUX_SLOTS and DARTT_SHM_LINUX_MAX_FRAME
+ */
+int dartt_shm_linux_attach(dartt_shm_linux_t * link, int fd, int peripheral)
+{
+	DARTT_ASSERT(link != NULL);
+	link->fd = fd;
+	link->owns_fd = 0;
+	link->peripheral = peripheral;
+	link->region = NULL;
+	link->spin = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? DARTT_SHM_LINUX_SPIN : 0;	//polling only helps if the other side runs meanwhile
+	link->pump_callback = NULL;
+	link->pump_context = NULL;
+	struct stat st;
+	if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct dartt_shm_region_t))
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	void * map = mmap(NULL, sizeof(struct dartt_shm_region_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(map == MAP_FAILED)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	struct dartt_shm_region_t * region = (struct dartt_shm_region_t *)map;
+	if(region->magic != SHM_MAGIC || region->version != SHM_VERSION || region->slots != DARTT_SHM_LINUX_SLOTS || region->max_frame != DARTT_SHM_LINUX_MAX_FRAME)
+	{
+		munmap(map, sizeof(struct dartt_shm_region_t));
+		errno = EPROTO;
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	link->region = region;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Create a shared memory link and attach its controller side.
+ *
+ * @param link Link context to initialize, as in dartt_shm_linux_attach
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_INVALID_ARGUMENT if the memfd could not be created (errno
+ * holds the cause)
+ *
+ * @note Attach the peripheral side with dartt_shm_linux_attach(&other, link->fd, 1), in this process or in one that
+ * received the descriptor. The memfd is created close-on-exec.
+ */
+int dartt_shm_linux_create(dartt_shm_linux_t * link)
+{
+	DARTT_ASSERT(link != NULL);
+	link->fd = -1;
+	link->owns_fd = 0;
+	link->region = NULL;
+	int fd = memfd_create("dartt_shm", MFD_CLOEXEC);
+	if(fd < 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	if(ftruncate(fd, sizeof(struct dartt_shm_region_t)) != 0)
+	{
+		close(fd);
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	//a fresh memfd reads as zeros, so the rings start empty. Stamp the header before the other side can attach
+	struct dartt_shm_region_t header = {.magic = SHM_MAGIC, .version = SHM_VERSION, .slots = DARTT_SHM_LINUX_SLOTS, .max_frame = DARTT_SHM_LINUX_MAX_FRAME};
+	if(pwrite(fd, &header, offsetof(struct dartt_shm_region_t, ring), 0) != (ssize_t)offsetof(struct dartt_shm_region_t, ring))
+	{
+		close(fd);
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	int rc = dartt_shm_linux_attach(link, fd, 0);
+	link->owns_fd = 1;
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		dartt_shm_linux_close(link);
+	}
+	return rc;
+}
+
+/**
+ * @brief Unmap the link, and close the memfd if it was created by dartt_shm_linux_create. Frames still in the
+ * rings are kept until both sides have closed.
+ */
+void dartt_shm_linux_close(dartt_shm_linux_t * link)
+{
+	DARTT_ASSERT(link != NULL);
+	if(link->region != NULL)
+	{
+		munmap(link->region, sizeof(struct dartt_shm_region_t));
+	}
+	if(link->owns_fd && link->fd >= 0)
+	{
+		close(link->fd);
+	}
+	link->region = NULL;
+	link->fd = -1;
+	link->owns_fd = 0;
+}
+
+/**
+ * @brief dartt_sync_t blocking_tx_callback, and the reply path of a peripheral loop. Copies a frame into the ring
+ * towards the other side.
+ *
+ * @param address Unused. A link connects a single controller and peripheral
+ * @param tx Frame to send
+ * @param user_context dartt_shm_linux_t of this side
+ * @param timeout Milliseconds to wait for a free slot if the other side is DARTT_SHM_LINUX_SLOTS frames behind
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_MEMORY_OVERRUN if the frame is longer than
+ * DARTT_SHM_LINUX_MAX_FRAME, DARTT_ERROR_TIMEOUT if no slot was freed in time
+ */
+int dartt_shm_linux_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	(void)address;
+	DARTT_ASSERT(user_context != NULL);
+	dartt_shm_linux_t * link = (dartt_shm_linux_t *)user_context;
+	DARTT_ASSERT(link->region != NULL);
+	int cb = check_buffer(tx);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	if(tx->len > DARTT_SHM_LINUX_MAX_FRAME)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	struct timespec deadline;
+	dartt_deadline_in(&deadline, timeout);
+	uint32_t slot;
+	int rc = wait_tx_slot(link, &deadline, &slot);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	memcpy(tx_ring(link)->data[slot], tx->buf, tx->len);
+	publish_tx(link, (uint32_t)tx->len);
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief dartt_sync_t blocking_rx_callback, and the request path of a peripheral loop. Returns the next frame from
+ * the other side.
+ *
+ * While the ring is empty the call polls it link->spin times, then calls the pump callback if one is set, then
+ * sleeps on a futex until a frame arrives or the timeout expires.
+ *
+ * @param rx Buffer to receive the frame
+ * @param user_context dartt_shm_linux_t of this side
+ * @param timeout Milliseconds to wait for a frame
+ * @return DARTT_PROTOCOL_SUCCESS with rx->len set to the frame length, DARTT_ERROR_TIMEOUT if no frame arrived in
+ * time, DARTT_ERROR_MEMORY_OVERRUN if the frame does not fit in rx. The frame is consumed either way.
+ */
+int dartt_shm_linux_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout)
+{
+	DARTT_ASSERT(user_context != NULL);
+	dartt_shm_linux_t * link = (dartt_shm_linux_t *)user_context;
+	DARTT_ASSERT(link->region != NULL);
+	int cb = check_buffer(rx);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	rx->len = 0;
+	struct timespec deadline;
+	dartt_deadline_in(&deadline, timeout);
+	uint32_t slot;
+	int rc = wait_rx_slot(link, &deadline, &slot);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	shm_ring_t * ring = rx_ring(link);
+	uint32_t len = ring->len[slot];
+	if(len > rx->size)
+	{
+		rc = DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	else
+	{
+		memcpy(rx->buf, ring->data[slot], len);
+		rx->len = len;
+	}
+	release_rx(link);
+	return rc;
+}
+
+/**
+ * @brief Peripheral loop step. Waits for one request and answers it from mem_base.
+ *
+ * The request is parsed in place in the receive ring with dartt_parse_general_message, and the reply is written in
+ * place into the transmit ring, so a transaction copies no frame on this side.
+ *
+ * @param link Peripheral side of the link
+ * @param mem_base Peripheral memory
+ * @param type Message type used by the controller
+ * @param timeout Milliseconds to wait for a request, and then for a free reply slot
+ * @return DARTT_PROTOCOL_SUCCESS if a request was answered, DARTT_ERROR_TIMEOUT if none arrived in time, otherwise
+ * the error of dartt_frame_to_payload or dartt_parse_general_message. The request is consumed either way.
+ *
+ * @note The address of TYPE_SERIAL_MESSAGE frames is not checked - a link has a single peripheral.
+ */
+int dartt_shm_linux_serve(dartt_shm_linux_t * link, const dartt_mem_t * mem_base, serial_message_type_t type, uint32_t timeout)
+{
+	DARTT_ASSERT(link != NULL && link->region != NULL);
+	struct timespec deadline;
+	dartt_deadline_in(&deadline, timeout);
+	uint32_t rx_slot;
+	int rc = wait_rx_slot(link, &deadline, &rx_slot);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	uint32_t tx_slot;
+	rc = wait_tx_slot(link, &deadline, &tx_slot);	//claimed before parsing, so a write is not applied without its reply
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;	//the request stays queued for the next call
+	}
+	shm_ring_t * in = rx_ring(link);
+	dartt_buffer_t request = {.buf = in->data[rx_slot], .size = DARTT_SHM_LINUX_MAX_FRAME, .len = in->len[rx_slot]};
+	dartt_buffer_t reply = {.buf = tx_ring(link)->data[tx_slot], .size = DARTT_SHM_LINUX_MAX_FRAME, .len = 0};
+	payload_layer_msg_t pld = {};
+	rc = dartt_frame_to_payload(&request, type, PAYLOAD_ALIAS, &pld);
+	if(rc == DARTT_PROTOCOL_SUCCESS)
+	{
+		rc = dartt_parse_general_message(&pld, type, mem_base, &reply);
+	}
+	if(reply.len != 0)
+	{
+		publish_tx(link, (uint32_t)reply.len);
+	}
+	release_rx(link);
+	return rc;
+}
@@ -0,0 +1,54 @@
+#ifndef DARTT_SHM_LINUX_H
+#define DARTT_SHM_LINUX_H
+#include <stdint.h>
+#include <stddef.h>
+#include "dartt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#ifndef DARTT_SHM_LINUX_SLOTS
+#define DARTT_SHM_LINUX_SLOTS		16		//frames per direction. Power of two
+#endif
+#ifndef DARTT_SHM_LINUX_MAX_FRAME
+#define DARTT_SHM_LINUX_MAX_FRAME	512		//largest frame
+#endif
+#ifndef DARTT_SHM_LINUX_SPIN
+#define DARTT_SHM_LINUX_SPIN		2000	//default polls of an empty ring before sleeping on its futex, on multi-core hosts
+#endif
+
+struct dartt_shm_region_t;
+
+/*
+	Shared memory transport between a controller and a peripheral in the same process or in sibling processes. A
+	memfd holds one single producer, single consumer ring of frames per direction. The receiver polls its ring for
+	a while and then sleeps on a futex, which the sender wakes only if the receiver is asleep.
+	Frames are passed as is, so any message type works. TYPE_ADDR_CRC_MESSAGE has the least overhead.
+*/
+typedef struct dartt_shm_linux_t
+{
+		int fd;					// memfd holding the rings. Pass it to a sibling process (fork, SCM_RIGHTS) to attach the other side
+		int owns_fd;			// Nonzero if fd is closed by dartt_shm_linux_close
+		int peripheral;			// Nonzero on the peripheral side
+		struct dartt_shm_region_t * region;	// Mapping of fd
+		uint32_t spin;			// Polls of an empty ring before sleeping. 0 sleeps at once (best on a single core)
+		int (*pump_callback)(void * pump_context);	//OPTIONAL, for a peripheral run on the caller's thread. Called by rx while its ring is empty, instead of sleeping. Set to NULL otherwise
+		void * pump_context;	//OPTIONAL resource used for the pump callback. Set to NULL if not needed
+}dartt_shm_linux_t;
+
+
+int dartt_shm_linux_create(dartt_shm_linux_t * link);
+int dartt_shm_linux_attach(dartt_shm_linux_t * link, int fd, int peripheral);
+void dartt_shm_linux_close(dartt_shm_linux_t * link);
+int dartt_shm_linux_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout);
+int dartt_shm_linux_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout);
+int dartt_shm_linux_serve(dartt_shm_linux_t * link, const dartt_mem_t * mem_base, serial_message_type_t type, uint32_t timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
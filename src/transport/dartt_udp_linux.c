@@ -0,0 +1,339 @@
+#define _GNU_SOURCE	//sendmmsg, recvmmsg
+#include "dartt_udp_linux.h"
+#include "dartt_check_buffer.h"
+#include "dartt_assert.h"
+
+#include <sys/socket.h>
+#include <netdb.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+
+
+/*
+	Apply timeout to blocking socket calls in the given direction (SO_RCVTIMEO or SO_SNDTIMEO). The value is cached,
+	so the setsockopt syscall is only made when the timeout changes, normally once.
+*/
+static int set_timeout(int fd, int optname, uint32_t * current, uint32_t timeout)
+{
+	if(*current == timeout)
+	{
+		return DARTT_PROTOCOL_SUCCESS;
+	}
+	struct timeval tv = {.tv_sec = timeout/1000, .tv_usec = (timeout % 1000)*1000};
+	if(setsockopt(fd, SOL_SOCKET, optname, &tv, sizeof(tv)) != 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	*current = timeout;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/*
+	Map a failed socket call. EAGAIN is the socket timeout expiring. ECONNREFUSED is the ICMP port unreachable of an
+	earlier datagram - the peripheral is not listening (yet), which the caller should treat like a lost frame.
+*/
+static int socket_error(void)
+{
+	if(errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNREFUSED)
+	{
+		return DARTT_ERROR_TIMEOUT;
+	}
+	return DARTT_ERROR_INVALID_ARGUMENT;
+}
+
+/*
+	Send every queued frame, batching them into as few sendmmsg calls as the socket buffer allows. The queue is
+	empty afterwards either way - frames that could not be sent are dropped, as a lost datagram would be.
+*/
+static int flush_queue(dartt_udp_linux_t * port, uint32_t timeout)
+{
+	if(port->tx_count == 0)
+	{
+		return DARTT_PROTOCOL_SUCCESS;
+	}
+	int rc = set_timeout(port->fd, SO_SNDTIMEO, &port->snd_timeout, timeout);
+	struct mmsghdr msgs[DARTT_UDP_LINUX_BATCH];
+	struct iovec iov[DARTT_UDP_LINUX_BATCH];
+	memset(msgs, 0, sizeof(msgs[0])*port->tx_count);
+	for(size_t i = 0; i < port->tx_count; i++)
+	{
+		iov[i].iov_base = port->tx_mem[i];
+		iov[i].iov_len = port->tx_len[i];
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	size_t sent = 0;
+	while(rc == DARTT_PROTOCOL_SUCCESS && sent < port->tx_count)
+	{
+		int n = sendmmsg(port->fd, &msgs[sent], (unsigned int)(port->tx_count - sent), (timeout == 0) ? MSG_DONTWAIT : 0);
+		if(n > 0)
+		{
+			sent += (size_t)n;
+		}
+		else if(n < 0 && errno != EINTR)
+		{
+			rc = socket_error();
+		}
+	}
+	port->tx_count = 0;
+	return rc;
+}
+
+/**
+ * @brief Set up a transport on an existing UDP socket.
+ *
+ * @param port Transport context to initialize
+ * @param fd UDP socket, connected to the peripheral. It is switched to blocking mode, and is not closed by
+ * dartt_udp_linux_close
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_INVALID_ARGUMENT if fd could not be switched to blocking
+ * mode
+ *
+ * @note Callback timeouts are applied with SO_RCVTIMEO and SO_SNDTIMEO rather than poll, so a transaction costs one
+ * syscall per direction, like plain send and recv.
+ */
+int dartt_udp_linux_attach(dartt_udp_linux_t * port, int fd)
+{
+	DARTT_ASSERT(port != NULL);
+	port->fd = fd;
+	port->owns_fd = 0;
+	port->tx_count = 0;
+	port->rx_count = 0;
+	port->rx_next = 0;
+	port->rcv_timeout = UINT32_MAX;	//not set yet
+	port->snd_timeout = UINT32_MAX;
+	int flags = fcntl(fd, F_GETFL);
+	if(flags < 0 || fcntl(fd, F_SETFL, flags & ~O_NONBLOCK) != 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Open a UDP socket connected to a peripheral.
+ *
+ * @param port Transport context to initialize
+ * @param host Peripheral host name or address (IPv4 or IPv6)
+ * @param remote_port Peripheral UDP port
+ * @param local_port Local UDP port to bind, or 0 for an ephemeral port
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_INVALID_ARGUMENT if the host could not be resolved or the
+ * socket could not be set up
+ *
+ * @note The socket is connected, so datagrams from other sources are dropped by the kernel.
+ */
+int dartt_udp_linux_open(dartt_udp_linux_t * port, const char * host, uint16_t remote_port, uint16_t local_port)
+{
+	DARTT_ASSERT(port != NULL && host != NULL);
+	port->fd = -1;
+	port->owns_fd = 0;
+	char service[8];
+	snprintf(service, sizeof(service), "%u", (unsigned)remote_port);
+	struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_DGRAM};
+	struct addrinfo * res = NULL;
+	if(getaddrinfo(host, service, &hints, &res) != 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	int rc = DARTT_ERROR_INVALID_ARGUMENT;
+	for(struct addrinfo * ai = res; ai != NULL; ai = ai->ai_next)
+	{
+		int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+		if(fd < 0)
+		{
+			continue;
+		}
+		if(local_port != 0)
+		{
+			struct sockaddr_storage local;
+			memset(&local, 0, sizeof(local));
+			memcpy(&local, ai->ai_addr, ai->ai_addrlen);
+			uint16_t nport = htons(local_port);
+			if(ai->ai_family == AF_INET)
+			{
+				struct sockaddr_in * in4 = (struct sockaddr_in *)&local;
+				in4->sin_addr.s_addr = htonl(INADDR_ANY);
+				in4->sin_port = nport;
+			}
+			else
+			{
+				struct sockaddr_in6 * in6 = (struct sockaddr_in6 *)&local;
+				in6->sin6_addr = in6addr_any;
+				in6->sin6_port = nport;
+			}
+			if(bind(fd, (struct sockaddr *)&local, ai->ai_addrlen) != 0)
+			{
+				close(fd);
+				continue;
+			}
+		}
+		if(connect(fd, ai->ai_addr, ai->ai_addrlen) != 0)
+		{
+			close(fd);
+			continue;
+		}
+		rc = dartt_udp_linux_attach(port, fd);
+		port->owns_fd = 1;
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			dartt_udp_linux_close(port);
+		}
+		break;
+	}
+	freeaddrinfo(res);
+	return rc;
+}
+
+/**
+ * @brief Close the socket if it was opened by dartt_udp_linux_open. Queued frames are dropped.
+ */
+void dartt_udp_linux_close(dartt_udp_linux_t * port)
+{
+	DARTT_ASSERT(port != NULL);
+	if(port->owns_fd && port->fd >= 0)
+	{
+		close(port->fd);
+	}
+	port->fd = -1;
+	port->owns_fd = 0;
+	port->tx_count = 0;
+}
+
+/**
+ * @brief dartt_sync_t blocking_tx_callback. Queues a frame for the next batch.
+ *
+ * The queue is sent by dartt_udp_linux_flush (set it as flush_tx_callback), before dartt_udp_linux_rx waits for a
+ * reply, or when it is full.
+ *
+ * @param address Unused. The socket is connected to a single peripheral
+ * @param tx Frame to send
+ * @param user_context dartt_udp_linux_t of the socket
+ * @param timeout Milliseconds to wait for socket buffer space if the queue has to be sent
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_MEMORY_OVERRUN if the frame is longer than
+ * DARTT_UDP_LINUX_MAX_FRAME, errors of dartt_udp_linux_flush if the queue was full
+ */
+int dartt_udp_linux_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	(void)address;
+	DARTT_ASSERT(user_context != NULL);
+	dartt_udp_linux_t * port = (dartt_udp_linux_t *)user_context;
+	int cb = check_buffer(tx);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	if(tx->len > DARTT_UDP_LINUX_MAX_FRAME)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	if(port->tx_count == DARTT_UDP_LINUX_BATCH)
+	{
+		int rc = flush_queue(port, timeout);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
+	}
+	memcpy(port->tx_mem[port->tx_count], tx->buf, tx->len);
+	port->tx_len[port->tx_count] = tx->len;
+	port->tx_count++;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief dartt_sync_t flush_tx_callback. Sends every queued frame.
+ *
+ * @param user_context dartt_udp_linux_t of the socket
+ * @param timeout Milliseconds to wait for socket buffer space
+ * @return DARTT_PROTOCOL_SUCCESS once every frame is handed to the kernel, DARTT_ERROR_TIMEOUT if there was no
+ * socket buffer space in time or the peripheral port is unreachable, DARTT_ERROR_INVALID_ARGUMENT if the socket
+ * failed (errno holds the cause). The queue is empty after the call either way.
+ */
+int dartt_udp_linux_flush(void * user_context, uint32_t timeout)
+{
+	DARTT_ASSERT(user_context != NULL);
+	return flush_queue((dartt_udp_linux_t *)user_context, timeout);
+}
+
+/**
+ * @brief dartt_sync_t blocking_rx_callback. Returns the next received frame.
+ *
+ * Datagrams left over from the last recvmmsg are returned without a syscall. Otherwise queued frames are sent, and
+ * every datagram that has arrived is drained with one recvmmsg.
+ *
+ * @param rx Buffer to receive the frame
+ * @param user_context dartt_udp_linux_t of the socket
+ * @param timeout Milliseconds to wait for a frame
+ * @return DARTT_PROTOCOL_SUCCESS with rx->len set to the frame length, DARTT_ERROR_TIMEOUT if no frame arrived in
+ * time or the peripheral port is unreachable, DARTT_ERROR_MALFORMED_MESSAGE for a datagram longer than
+ * DARTT_UDP_LINUX_MAX_FRAME, DARTT_ERROR_MEMORY_OVERRUN if the frame does not fit in rx,
+ * DARTT_ERROR_INVALID_ARGUMENT if the socket failed (errno holds the cause)
+ */
+int dartt_udp_linux_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout)
+{
+	DARTT_ASSERT(user_context != NULL);
+	dartt_udp_linux_t * port = (dartt_udp_linux_t *)user_context;
+	int cb = check_buffer(rx);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	rx->len = 0;
+
+	if(port->rx_next == port->rx_count)
+	{
+		int rc = flush_queue(port, timeout);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
+		rc = set_timeout(port->fd, SO_RCVTIMEO, &port->rcv_timeout, timeout);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			return rc;
+		}
+		struct mmsghdr msgs[DARTT_UDP_LINUX_BATCH];
+		struct iovec iov[DARTT_UDP_LINUX_BATCH];
+		memset(msgs, 0, sizeof(msgs));
+		for(size_t i = 0; i < DARTT_UDP_LINUX_BATCH; i++)
+		{
+			iov[i].iov_base = port->rx_mem[i];
+			iov[i].iov_len = DARTT_UDP_LINUX_MAX_FRAME;
+			msgs[i].msg_hdr.msg_iov = &iov[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+		int n;
+		do
+		{
+			//MSG_WAITFORONE blocks for the first datagram only, then takes whatever else has arrived
+			n = recvmmsg(port->fd, msgs, DARTT_UDP_LINUX_BATCH, (timeout == 0) ? MSG_DONTWAIT : MSG_WAITFORONE, NULL);
+		}while(n < 0 && errno == EINTR);
+		if(n <= 0)
+		{
+			return socket_error();
+		}
+		for(int i = 0; i < n; i++)
+		{
+			port->rx_len[i] = msgs[i].msg_len;
+			port->rx_trunc[i] = (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+		}
+		port->rx_count = (size_t)n;
+		port->rx_next = 0;
+	}
+
+	size_t i = port->rx_next++;
+	if(port->rx_trunc[i])
+	{
+		return DARTT_ERROR_MALFORMED_MESSAGE;
+	}
+	if(port->rx_len[i] > rx->size)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	memcpy(rx->buf, port->rx_mem[i], port->rx_len[i]);
+	rx->len = port->rx_len[i];
+	return DARTT_PROTOCOL_SUCCESS;
+}
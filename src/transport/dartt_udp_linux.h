@@ -0,0 +1,53 @@
+#ifndef DARTT_UDP_LINUX_H
+#define DARTT_UDP_LINUX_H
+#include <stdint.h>
+#include <stddef.h>
+#include "dartt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#ifndef DARTT_UDP_LINUX_BATCH
+#define DARTT_UDP_LINUX_BATCH		16		//datagrams per sendmmsg/recvmmsg call
+#endif
+#ifndef DARTT_UDP_LINUX_MAX_FRAME
+#define DARTT_UDP_LINUX_MAX_FRAME	1472	//largest datagram, the UDP payload of a 1500 byte Ethernet MTU
+#endif
+
+/*
+	Linux UDP transport for TYPE_ADDR_CRC_MESSAGE frames, one frame per datagram, on a socket connected to a single
+	peripheral. Outgoing frames are queued and sent together with sendmmsg. Replies are drained together with recvmmsg
+	and handed out one per rx call.
+*/
+typedef struct dartt_udp_linux_t
+{
+		int fd;					// UDP socket, connected to the peripheral
+		int owns_fd;			// Nonzero if fd is closed by dartt_udp_linux_close
+		unsigned char tx_mem[DARTT_UDP_LINUX_BATCH][DARTT_UDP_LINUX_MAX_FRAME];	// Queued frames
+		size_t tx_len[DARTT_UDP_LINUX_BATCH];
+		size_t tx_count;		// Number of queued frames
+		unsigned char rx_mem[DARTT_UDP_LINUX_BATCH][DARTT_UDP_LINUX_MAX_FRAME];	// Received datagrams not yet returned
+		size_t rx_len[DARTT_UDP_LINUX_BATCH];
+		int rx_trunc[DARTT_UDP_LINUX_BATCH];	// Nonzero if the datagram was longer than DARTT_UDP_LINUX_MAX_FRAME
+		size_t rx_count;		// Number of datagrams in rx_mem
+		size_t rx_next;			// Next datagram to return
+		uint32_t rcv_timeout;	// Timeout currently applied with SO_RCVTIMEO, in milliseconds
+		uint32_t snd_timeout;	// Timeout currently applied with SO_SNDTIMEO, in milliseconds
+}dartt_udp_linux_t;
+
+
+int dartt_udp_linux_open(dartt_udp_linux_t * port, const char * host, uint16_t remote_port, uint16_t local_port);
+int dartt_udp_linux_attach(dartt_udp_linux_t * port, int fd);
+void dartt_udp_linux_close(dartt_udp_linux_t * port);
+int dartt_udp_linux_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout);
+int dartt_udp_linux_flush(void * user_context, uint32_t timeout);
+int dartt_udp_linux_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
@@ -0,0 +1,569 @@
+#include "dartt_uring_linux.h"
+#include "dartt_check_buffer.h"
+#include "dartt_assert.h"
+#include "dartt_deadline.h"
+
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#define OP_READ		1
+#define OP_WRITE	2
+/*
+	Completion tag: operation, endpoint, transmit length and slot. The length lets a short write be detected without
+	keeping per slot state
+*/
+#define USER_DATA(op, ep, len, slot)	(((uint64_t)(op) << 56) | ((uint64_t)(ep) << 40) | ((uint64_t)(len) << 16) | (uint64_t)(slot))
+#define USER_DATA_OP(ud)	((unsigned)((ud) >> 56))
+#define USER_DATA_EP(ud)	((unsigned)(((ud) >> 40) & 0xFFFF))
+#define USER_DATA_LEN(ud)	((unsigned)(((ud) >> 16) & 0xFFFFFF))
+#define USER_DATA_SLOT(ud)	((unsigned)((ud) & 0xFFFF))
+
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params * p)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void * arg, size_t argsz)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void * arg, unsigned nr_args)
+{
+	return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static unsigned char * read_slot(dartt_uring_linux_t * ring, unsigned id)
+{
+	return ring->slots + (size_t)id*DARTT_URING_LINUX_SLOT_SIZE;
+}
+
+static unsigned char * tx_slot(dartt_uring_linux_t * ring, unsigned slot)
+{
+	return ring->slots + (size_t)(DARTT_URING_LINUX_MAX_ENDPOINTS + slot)*DARTT_URING_LINUX_SLOT_SIZE;
+}
+
+/*
+	Queue a submission entry, to be sent by the next io_uring_enter. The submission queue has one entry per read
+	slot and per transmit slot, so it cannot overflow
+*/
+static void queue_sqe(dartt_uring_linux_t * ring, uint8_t opcode, int fd, unsigned char * buf, size_t len, uint64_t user_data)
+{
+	unsigned tail = *ring->sq_tail;
+	DARTT_ASSERT(tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) < ring->sq_entries);
+	unsigned idx = tail & *ring->sq_mask;
+	struct io_uring_sqe * sqe = &ring->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->off = (uint64_t)-1;	//current position. Ignored by sockets and ttys
+	sqe->addr = (uint64_t)(uintptr_t)buf;
+	sqe->len = (uint32_t)len;
+	sqe->buf_index = 0;		//the whole slot region is registered buffer 0
+	sqe->user_data = user_data;
+	ring->sq_array[idx] = idx;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	ring->to_submit++;
+}
+
+static void post_read(dartt_uring_linux_t * ring, dartt_uring_linux_ep_t * ep)
+{
+	queue_sqe(ring, ring->fixed ? IORING_OP_READ_FIXED : IORING_OP_READ, ep->fd, read_slot(ring, ep->id),
+		DARTT_URING_LINUX_SLOT_SIZE, USER_DATA(OP_READ, ep->id, 0, ep->id));
+	ep->read_posted = 1;
+}
+
+/*
+	Next free position in the receive queue of an endpoint, or -1 (and the frame is counted as dropped) if it is full
+*/
+static int push_rx(dartt_uring_linux_ep_t * ep)
+{
+	if(ep->rx_count == DARTT_URING_LINUX_RX_QUEUE)
+	{
+		ep->rx_dropped++;
+		return -1;
+	}
+	int q = (int)((ep->rx_head + ep->rx_count) % DARTT_URING_LINUX_RX_QUEUE);
+	ep->rx_count++;
+	return q;
+}
+
+/*
+	Split received stream bytes into COBS frames and decode them into the receive queue. Returns the number of
+	frames queued
+*/
+static int deliver_cobs(dartt_uring_linux_ep_t * ep, const unsigned char * data, size_t n)
+{
+	int frames = 0;
+	size_t i = 0;
+	while(i < n)
+	{
+		const unsigned char * delim = memchr(data + i, DARTT_COBS_DELIMITER, n - i);
+		size_t seg = (delim != NULL) ? (size_t)(delim - (data + i)) : (n - i);
+		if(!ep->stream_discard)
+		{
+			if(ep->stream_len + seg > sizeof(ep->stream))
+			{
+				ep->stream_len = 0;		//overlong frame. Report it once, and drop the rest of it up to its delimiter
+				ep->stream_discard = 1;
+				int q = push_rx(ep);
+				if(q >= 0)
+				{
+					ep->rx_len[q] = 0;
+					ep->rx_status[q] = DARTT_ERROR_MALFORMED_MESSAGE;
+					frames++;
+				}
+			}
+			else
+			{
+				memcpy(ep->stream + ep->stream_len, data + i, seg);
+				ep->stream_len += seg;
+			}
+		}
+		i += seg;
+		if(delim == NULL)
+		{
+			break;
+		}
+		i++;
+		if(ep->stream_discard)
+		{
+			ep->stream_discard = 0;
+		}
+		else if(ep->stream_len != 0)	//empty frames are skipped
+		{
+			int q = push_rx(ep);
+			if(q >= 0)
+			{
+				dartt_buffer_t enc = {.buf = ep->stream, .size = sizeof(ep->stream), .len = ep->stream_len};
+				dartt_buffer_t out = {.buf = ep->rx_mem[q], .size = DARTT_URING_LINUX_MAX_FRAME, .len = 0};
+				ep->rx_status[q] = dartt_cobs_decode(&enc, &out);
+				ep->rx_len[q] = out.len;
+				frames++;
+			}
+			ep->stream_len = 0;
+		}
+	}
+	return frames;
+}
+
+/*
+	Handle every completion available, without a system call. Reads are queued for reposting. Returns the number of
+	frames added to receive queues
+*/
+static int reap(dartt_uring_linux_t * ring)
+{
+	int frames = 0;
+	unsigned head = *ring->cq_head;
+	unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+	for(; head != tail; head++)
+	{
+		struct io_uring_cqe * cqe = &ring->cqes[head & *ring->cq_mask];
+		uint64_t ud = cqe->user_data;
+		int res = cqe->res;
+		dartt_uring_linux_ep_t * ep = ring->eps[USER_DATA_EP(ud)];
+		if(USER_DATA_OP(ud) == OP_WRITE)
+		{
+			if(res != (int)USER_DATA_LEN(ud))
+			{
+				ep->tx_failed++;
+			}
+			ring->tx_free[ring->num_tx_free++] = (uint16_t)USER_DATA_SLOT(ud);
+			continue;
+		}
+
+		ep->read_posted = 0;
+		if(res > 0)
+		{
+			const unsigned char * data = read_slot(ring, ep->id);
+			if(ep->kind == DARTT_URING_COBS)
+			{
+				frames += deliver_cobs(ep, data, (size_t)res);
+			}
+			else
+			{
+				int q = push_rx(ep);
+				if(q >= 0)
+				{
+					int fits = (res <= DARTT_URING_LINUX_MAX_FRAME);	//a datagram filling the whole slot was truncated
+					ep->rx_status[q] = fits ? DARTT_PROTOCOL_SUCCESS : DARTT_ERROR_MALFORMED_MESSAGE;
+					ep->rx_len[q] = fits ? (size_t)res : 0;
+					memcpy(ep->rx_mem[q], data, ep->rx_len[q]);
+					frames++;
+				}
+			}
+		}
+		else if(res == 0 && ep->kind == DARTT_URING_COBS)
+		{
+			ep->error = EPIPE;	//end of file, e.g. the other end of a pty closed
+			continue;
+		}
+		else if(res < 0 && res != -EAGAIN && res != -EINTR && res != -ECONNREFUSED)
+		{
+			ep->error = -res;
+			continue;
+		}
+		post_read(ring, ep);	//empty datagrams, and ICMP errors on UDP, leave the endpoint running
+	}
+	__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+	return frames;
+}
+
+/**
+ * @brief Set up an io_uring instance with no endpoints.
+ *
+ * @param ring Ring to initialize
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_INVALID_ARGUMENT if io_uring is unavailable (kernels before
+ * 5.11, or disabled by seccomp or sysctl) or the ring could not be mapped (errno holds the cause)
+ *
+ * @note The read and transmit slots are registered as one fixed buffer when the locked memory limit allows it, and
+ * the plain READ / WRITE operations are used otherwise. ring->fixed tells which.
+ */
+int dartt_uring_linux_init(dartt_uring_linux_t * ring)
+{
+	DARTT_ASSERT(ring != NULL);
+	memset(ring, 0, sizeof(*ring));
+	ring->ring_fd = -1;
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	int fd = sys_io_uring_setup(DARTT_URING_LINUX_MAX_ENDPOINTS + DARTT_URING_LINUX_TX_SLOTS, &p);
+	if(fd < 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	ring->ring_fd = fd;
+	if(!(p.features & IORING_FEAT_EXT_ARG))	//needed for timed waits in io_uring_enter
+	{
+		dartt_uring_linux_exit(ring);
+		errno = ENOSYS;
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+
+	ring->sq_map_len = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+	ring->cq_map_len = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+	if(p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if(ring->cq_map_len > ring->sq_map_len)
+		{
+			ring->sq_map_len = ring->cq_map_len;
+		}
+		ring->cq_map_len = 0;	//shares the submission queue mapping
+	}
+	ring->sq_map = mmap(NULL, ring->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if(ring->sq_map == MAP_FAILED)
+	{
+		ring->sq_map = NULL;
+		dartt_uring_linux_exit(ring);
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	ring->cq_map = ring->sq_map;
+	if(ring->cq_map_len != 0)
+	{
+		ring->cq_map = mmap(NULL, ring->cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if(ring->cq_map == MAP_FAILED)
+		{
+			ring->cq_map = NULL;
+			dartt_uring_linux_exit(ring);
+			return DARTT_ERROR_INVALID_ARGUMENT;
+		}
+	}
+	ring->sqes_map_len = p.sq_entries*sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if(ring->sqes == MAP_FAILED)
+	{
+		ring->sqes = NULL;
+		dartt_uring_linux_exit(ring);
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	unsigned char * sq = (unsigned char *)ring->sq_map;
+	unsigned char * cq = (unsigned char *)ring->cq_map;
+	ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+	ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+	ring->sq_entries = p.sq_entries;
+	ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+	ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+	ring->slots_len = (size_t)(DARTT_URING_LINUX_MAX_ENDPOINTS + DARTT_URING_LINUX_TX_SLOTS)*DARTT_URING_LINUX_SLOT_SIZE;
+	ring->slots = mmap(NULL, ring->slots_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(ring->slots == MAP_FAILED)
+	{
+		ring->slots = NULL;
+		dartt_uring_linux_exit(ring);
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	struct iovec iov = {.iov_base = ring->slots, .iov_len = ring->slots_len};
+	ring->fixed = (sys_io_uring_register(fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0);
+	for(unsigned i = 0; i < DARTT_URING_LINUX_TX_SLOTS; i++)
+	{
+		ring->tx_free[i] = (uint16_t)i;
+	}
+	ring->num_tx_free = DARTT_URING_LINUX_TX_SLOTS;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Tear down the ring. Operations in flight are cancelled. Endpoint file descriptors are left open.
+ */
+void dartt_uring_linux_exit(dartt_uring_linux_t * ring)
+{
+	DARTT_ASSERT(ring != NULL);
+	if(ring->ring_fd >= 0)
+	{
+		close(ring->ring_fd);
+		ring->ring_fd = -1;
+	}
+	if(ring->sqes != NULL)
+	{
+		munmap(ring->sqes, ring->sqes_map_len);
+		ring->sqes = NULL;
+	}
+	if(ring->cq_map != NULL && ring->cq_map != ring->sq_map)
+	{
+		munmap(ring->cq_map, ring->cq_map_len);
+	}
+	ring->cq_map = NULL;
+	if(ring->sq_map != NULL)
+	{
+		munmap(ring->sq_map, ring->sq_map_len);
+		ring->sq_map = NULL;
+	}
+	if(ring->slots != NULL)
+	{
+		munmap(ring->slots, ring->slots_len);
+		ring->slots = NULL;
+	}
+	ring->num_eps = 0;
+}
+
+/**
+ * @brief Add a peripheral link to the ring, and post its first read.
+ *
+ * Pass the endpoint as user_context_tx and user_context_rx of the dartt_sync_t for that peripheral.
+ *
+ * @param ring Initialized ring
+ * @param ep Endpoint to initialize. Must stay valid for the lifetime of the ring
+ * @param fd Open file descriptor, e.g. the fd of a dartt_udp_linux_t or dartt_serial_linux_t port, which also does
+ * the socket and line setup. Not closed by the ring
+ * @param kind DARTT_URING_DGRAM for datagram sockets, DARTT_URING_COBS for COBS framed byte streams
+ * @return DARTT_PROTOCOL_SUCCESS on success, DARTT_ERROR_MEMORY_OVERRUN if the ring already has
+ * DARTT_URING_LINUX_MAX_ENDPOINTS endpoints
+ */
+int dartt_uring_linux_add(dartt_uring_linux_t * ring, dartt_uring_linux_ep_t * ep, int fd, dartt_uring_linux_kind_t kind)
+{
+	DARTT_ASSERT(ring != NULL && ep != NULL && ring->ring_fd >= 0);
+	if(ring->num_eps == DARTT_URING_LINUX_MAX_ENDPOINTS)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	memset(ep, 0, sizeof(*ep));
+	ep->ring = ring;
+	ep->fd = fd;
+	ep->kind = kind;
+	ep->id = (uint16_t)ring->num_eps;
+	ring->eps[ring->num_eps++] = ep;
+	post_read(ring, ep);
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief Submit everything queued on the ring and collect completions, with a single io_uring_enter.
+ *
+ * Queued transmissions and reads to repost, for all endpoints, go out together. Completions are handled in one
+ * batch and received frames are queued on their endpoints.
+ *
+ * @param ring Ring
+ * @param timeout Milliseconds to wait for a completion if none is available. 0 returns at once, and makes no system
+ * call at all if nothing is queued
+ * @return Number of frames received (0 if the timeout expired), or DARTT_ERROR_INVALID_ARGUMENT if io_uring_enter
+ * failed (errno holds the cause)
+ */
+int dartt_uring_linux_run(dartt_uring_linux_t * ring, uint32_t timeout)
+{
+	DARTT_ASSERT(ring != NULL);
+	int frames = reap(ring);
+	int wait = (frames == 0 && timeout != 0);
+	if(ring->to_submit == 0 && !wait)
+	{
+		return frames;
+	}
+	struct __kernel_timespec ts = {.tv_sec = timeout/1000, .tv_nsec = (long long)(timeout % 1000)*1000000};
+	struct io_uring_getevents_arg arg = {.ts = (uint64_t)(uintptr_t)&ts};
+	unsigned flags = wait ? (IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG) : 0;
+	int rc = sys_io_uring_enter(ring->ring_fd, ring->to_submit, wait ? 1 : 0, flags, wait ? &arg : NULL, wait ? sizeof(arg) : 0);
+	ring->enters++;
+	if(rc >= 0)
+	{
+		ring->to_submit -= ((unsigned)rc < ring->to_submit) ? (unsigned)rc : ring->to_submit;
+	}
+	else if(errno != ETIME && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	return frames + reap(ring);
+}
+
+/**
+ * @brief Nonzero if the rx callback of the endpoint will return without waiting, i.e. a frame or an error is queued.
+ */
+int dartt_uring_linux_ready(const dartt_uring_linux_ep_t * ep)
+{
+	DARTT_ASSERT(ep != NULL);
+	return (ep->rx_count != 0 || ep->error != 0);
+}
+
+/**
+ * @brief dartt_sync_t blocking_tx_callback. Copies the frame (COBS encoded for DARTT_URING_COBS) into a transmit slot
+ * and queues it. It is sent by the next dartt_uring_linux_run, flush or rx call on any endpoint of the ring.
+ *
+ * @param address Unused. The endpoint is the peripheral
+ * @param tx Frame to send
+ * @param user_context dartt_uring_linux_ep_t of the peripheral
+ * @param timeout Milliseconds to wait for a free transmit slot, if all DARTT_URING_LINUX_TX_SLOTS are in flight
+ * @return DARTT_PROTOCOL_SUCCESS once queued, DARTT_ERROR_TIMEOUT if no slot freed up in time,
+ * DARTT_ERROR_MEMORY_OVERRUN if the frame is longer than DARTT_URING_LINUX_MAX_FRAME, DARTT_ERROR_INVALID_ARGUMENT if
+ * the endpoint or the ring failed
+ */
+int dartt_uring_linux_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	(void)address;
+	DARTT_ASSERT(user_context != NULL);
+	dartt_uring_linux_ep_t * ep = (dartt_uring_linux_ep_t *)user_context;
+	dartt_uring_linux_t * ring = ep->ring;
+	int cb = check_buffer(tx);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	if(tx->len > DARTT_URING_LINUX_MAX_FRAME)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	if(ep->error != 0)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	struct timespec deadline;
+	dartt_deadline_in(&deadline, timeout);
+	while(ring->num_tx_free == 0)
+	{
+		int ms = dartt_ms_until(&deadline);
+		int rc = dartt_uring_linux_run(ring, (uint32_t)ms);
+		if(rc < 0)
+		{
+			return rc;
+		}
+		if(ring->num_tx_free == 0 && ms == 0)
+		{
+			return DARTT_ERROR_TIMEOUT;
+		}
+	}
+
+	uint16_t slot = ring->tx_free[--ring->num_tx_free];
+	dartt_buffer_t out = {.buf = tx_slot(ring, slot), .size = DARTT_URING_LINUX_SLOT_SIZE, .len = 0};
+	if(ep->kind == DARTT_URING_COBS)
+	{
+		int rc = dartt_cobs_encode(tx, &out);
+		if(rc != DARTT_PROTOCOL_SUCCESS)
+		{
+			ring->tx_free[ring->num_tx_free++] = slot;
+			return rc;
+		}
+	}
+	else
+	{
+		memcpy(out.buf, tx->buf, tx->len);
+		out.len = tx->len;
+	}
+	queue_sqe(ring, ring->fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, ep->fd, out.buf, out.len,
+		USER_DATA(OP_WRITE, ep->id, out.len, slot));
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief dartt_sync_t flush_tx_callback. Submits everything queued on the ring, for all endpoints, without waiting.
+ *
+ * @param user_context dartt_uring_linux_ep_t of the peripheral
+ * @param timeout Unused
+ * @return DARTT_PROTOCOL_SUCCESS, or DARTT_ERROR_INVALID_ARGUMENT if io_uring_enter failed
+ */
+int dartt_uring_linux_flush(void * user_context, uint32_t timeout)
+{
+	(void)timeout;
+	DARTT_ASSERT(user_context != NULL);
+	dartt_uring_linux_ep_t * ep = (dartt_uring_linux_ep_t *)user_context;
+	int rc = dartt_uring_linux_run(ep->ring, 0);
+	return (rc < 0) ? rc : DARTT_PROTOCOL_SUCCESS;
+}
+
+/**
+ * @brief dartt_sync_t blocking_rx_callback. Returns the oldest frame received on the endpoint.
+ *
+ * If none is queued, the ring is run until one arrives, which also collects frames for the other endpoints. With a
+ * timeout_ms of 0 in the dartt_sync_t, the call never waits, which is how a single thread drives many peripherals
+ * (see docs/TRANSPORTS.md).
+ *
+ * @param rx Buffer to receive the frame
+ * @param user_context dartt_uring_linux_ep_t of the peripheral
+ * @param timeout Milliseconds to wait for a frame
+ * @return DARTT_PROTOCOL_SUCCESS with rx->len set, DARTT_ERROR_TIMEOUT if no frame arrived in time,
+ * DARTT_ERROR_MALFORMED_MESSAGE for a frame that failed COBS decoding or was longer than DARTT_URING_LINUX_MAX_FRAME,
+ * DARTT_ERROR_MEMORY_OVERRUN if the frame does not fit in rx, DARTT_ERROR_INVALID_ARGUMENT if the endpoint failed
+ * (ep->error holds the errno) or the ring failed
+ */
+int dartt_uring_linux_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout)
+{
+	DARTT_ASSERT(user_context != NULL);
+	dartt_uring_linux_ep_t * ep = (dartt_uring_linux_ep_t *)user_context;
+	int cb = check_buffer(rx);
+	if(cb != DARTT_PROTOCOL_SUCCESS)
+	{
+		return cb;
+	}
+	rx->len = 0;
+
+	struct timespec deadline;
+	dartt_deadline_in(&deadline, timeout);
+	for(;;)
+	{
+		if(ep->rx_count != 0)
+		{
+			size_t q = ep->rx_head;
+			ep->rx_head = (ep->rx_head + 1) % DARTT_URING_LINUX_RX_QUEUE;
+			ep->rx_count--;
+			if(ep->rx_status[q] != DARTT_PROTOCOL_SUCCESS)
+			{
+				return ep->rx_status[q];
+			}
+			if(ep->rx_len[q] > rx->size)
+			{
+				return DARTT_ERROR_MEMORY_OVERRUN;
+			}
+			memcpy(rx->buf, ep->rx_mem[q], ep->rx_len[q]);
+			rx->len = ep->rx_len[q];
+			return DARTT_PROTOCOL_SUCCESS;
+		}
+		if(ep->error != 0)
+		{
+			return DARTT_ERROR_INVALID_ARGUMENT;
+		}
+		int ms = dartt_ms_until(&deadline);
+		int rc = dartt_uring_linux_run(ep->ring, (uint32_t)ms);
+		if(rc < 0)
+		{
+			return rc;
+		}
+		if(ms == 0 && ep->rx_count == 0 && ep->error == 0)
+		{
+			return DARTT_ERROR_TIMEOUT;
+		}
+	}
+}
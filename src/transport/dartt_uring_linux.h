@@ -0,0 +1,109 @@
+#ifndef DARTT_URING_LINUX_H
+#define DARTT_URING_LINUX_H
+#include <stdint.h>
+#include <stddef.h>
+#include <linux/io_uring.h>
+#include "dartt.h"
+#include "dartt_cobs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#ifndef DARTT_URING_LINUX_MAX_ENDPOINTS
+#define DARTT_URING_LINUX_MAX_ENDPOINTS	64		//endpoints per ring
+#endif
+#ifndef DARTT_URING_LINUX_TX_SLOTS
+#define DARTT_URING_LINUX_TX_SLOTS		64		//frames in flight, shared by all endpoints of a ring
+#endif
+#ifndef DARTT_URING_LINUX_RX_QUEUE
+#define DARTT_URING_LINUX_RX_QUEUE		8		//received frames buffered per endpoint until its rx callback is called
+#endif
+#ifndef DARTT_URING_LINUX_MAX_FRAME
+#define DARTT_URING_LINUX_MAX_FRAME		1472	//largest frame, decoded (COBS) or datagram
+#endif
+#define DARTT_URING_LINUX_SLOT_SIZE		(DARTT_COBS_MAX_FRAME_LEN(DARTT_URING_LINUX_MAX_FRAME) + 1)	//registered buffer per read and per transmission. One byte spare to detect oversized datagrams
+
+typedef enum
+{
+	DARTT_URING_DGRAM = 0,	//one frame per read/write, e.g. a connected UDP socket. TYPE_ADDR_CRC_MESSAGE
+	DARTT_URING_COBS = 1	//COBS framed byte stream, e.g. a tty. TYPE_SERIAL_MESSAGE
+}dartt_uring_linux_kind_t;
+
+struct dartt_uring_linux_t;
+
+/*
+	One peripheral link driven by a dartt_uring_linux_t. A read is kept posted on the file descriptor at all times,
+	and its completions are queued here until the dartt_sync_t of the endpoint asks for them.
+*/
+typedef struct dartt_uring_linux_ep_t
+{
+		struct dartt_uring_linux_t * ring;	// Ring driving the endpoint
+		int fd;					// Socket or tty. Not closed by the ring
+		dartt_uring_linux_kind_t kind;
+		uint16_t id;			// Position in the ring, also its read slot
+		int read_posted;		// Nonzero while a read is in flight
+		int error;				// errno of a failed read, or EPIPE after end of file. The endpoint is then stopped
+		unsigned char rx_mem[DARTT_URING_LINUX_RX_QUEUE][DARTT_URING_LINUX_MAX_FRAME];	// Received frames not yet returned
+		size_t rx_len[DARTT_URING_LINUX_RX_QUEUE];
+		int rx_status[DARTT_URING_LINUX_RX_QUEUE];	// DARTT_PROTOCOL_SUCCESS, or the error to report for the frame
+		size_t rx_head;			// Oldest queued frame
+		size_t rx_count;		// Number of queued frames
+		unsigned char stream[DARTT_COBS_MAX_FRAME_LEN(DARTT_URING_LINUX_MAX_FRAME)];	// COBS only: bytes of an incomplete frame
+		size_t stream_len;
+		int stream_discard;		// COBS only: nonzero while discarding an overlong frame up to its delimiter
+		uint32_t rx_dropped;	// Frames dropped because the queue was full
+		uint32_t tx_failed;		// Transmissions that completed with an error or short
+}dartt_uring_linux_ep_t;
+
+/*
+	io_uring instance driving many endpoints from one thread. Transmissions are queued as submission entries and
+	sent together, with any reads to repost, by the next io_uring_enter. Reads and writes use one registered buffer
+	region when the kernel allows it (ring->fixed).
+*/
+typedef struct dartt_uring_linux_t
+{
+		int ring_fd;
+		unsigned * sq_head;
+		unsigned * sq_tail;
+		unsigned * sq_mask;
+		unsigned * sq_array;
+		unsigned sq_entries;
+		struct io_uring_sqe * sqes;
+		unsigned * cq_head;
+		unsigned * cq_tail;
+		unsigned * cq_mask;
+		struct io_uring_cqe * cqes;
+		void * sq_map;
+		size_t sq_map_len;
+		void * cq_map;
+		size_t cq_map_len;
+		size_t sqes_map_len;
+		unsigned to_submit;		// Entries queued since the last io_uring_enter
+		unsigned char * slots;	// Read slots (one per endpoint) followed by transmit slots
+		size_t slots_len;
+		int fixed;				// Nonzero if slots is registered with the ring (READ_FIXED / WRITE_FIXED)
+		dartt_uring_linux_ep_t * eps[DARTT_URING_LINUX_MAX_ENDPOINTS];
+		size_t num_eps;
+		uint16_t tx_free[DARTT_URING_LINUX_TX_SLOTS];	// Free transmit slots
+		size_t num_tx_free;
+		uint32_t enters;		// io_uring_enter calls made, i.e. system calls spent on I/O
+}dartt_uring_linux_t;
+
+
+int dartt_uring_linux_init(dartt_uring_linux_t * ring);
+void dartt_uring_linux_exit(dartt_uring_linux_t * ring);
+int dartt_uring_linux_add(dartt_uring_linux_t * ring, dartt_uring_linux_ep_t * ep, int fd, dartt_uring_linux_kind_t kind);
+int dartt_uring_linux_run(dartt_uring_linux_t * ring, uint32_t timeout);
+int dartt_uring_linux_ready(const dartt_uring_linux_ep_t * ep);
+int dartt_uring_linux_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout);
+int dartt_uring_linux_flush(void * user_context, uint32_t timeout);
+int dartt_uring_linux_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
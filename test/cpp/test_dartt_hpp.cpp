@@ -0,0 +1,207 @@
+/*
+	Tests of the C++ field handles (dartt.hpp), built by CMake and run with ctest.
+
+	A controller drives an in-process peripheral through dartt_sync_t, as in examples/example_cpp_fields.cpp, over a
+	map that extends past the standard index range, so the last fields are sent in extended frames.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include "dartt.hpp"
+
+struct map_t
+{
+	float kp;										// Word 0
+	float ki;										// Word 1
+	uint16_t mode;									// Word 2
+	uint32_t status;								// Word 3
+	int32_t table[DARTT_INDEX_RESERVED_BASE - 4];	// Words 4 to DARTT_INDEX_RESERVED_BASE - 1
+	uint32_t far_flags;								// Word DARTT_INDEX_RESERVED_BASE, the first extended index
+	float far_gain;									// Word DARTT_INDEX_RESERVED_BASE + 1
+};
+
+using kp = DARTT_FIELD(map_t, kp);
+using ki = DARTT_FIELD(map_t, ki);
+using mode = DARTT_FIELD(map_t, mode);
+using status = DARTT_FIELD(map_t, status);
+using table_end = DARTT_FIELD(map_t, table[DARTT_INDEX_RESERVED_BASE - 5]);
+using far_flags = DARTT_FIELD(map_t, far_flags);
+using far_gain = DARTT_FIELD(map_t, far_gain);
+
+static_assert(kp::index == 0 && status::index == 3, "");
+static_assert(table_end::index == DARTT_INDEX_RESERVED_BASE - 1, "the last standard word keeps its plain index");
+static_assert(far_flags::index == (DARTT_INDEX_RESERVED_BASE | DARTT_INDEX_EXTENDED_BIT), "");
+static_assert(far_gain::index == ((DARTT_INDEX_RESERVED_BASE + 1) | DARTT_INDEX_EXTENDED_BIT), "");
+static_assert(dartt::num_spans<far_gain, kp, status, ki, far_flags>() == 3, "");
+static_assert(dartt::num_spans<table_end, far_flags>() == 1, "spans cross into the extended range");
+
+static map_t periph_map;
+static map_t ctl_map;
+static map_t shadow_map;
+static unsigned char reply_mem[64];
+static dartt_buffer_t reply = dartt::buffer(reply_mem);
+static int frames = 0;			// requests served by the loopback
+static uint32_t last_index = 0;	// message index of the last request
+static int failures = 0;
+
+#define CHECK(...)	do{ if(!(__VA_ARGS__)) { std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #__VA_ARGS__); failures++; } }while(0)	//variadic: template arguments contain commas
+
+// The peripheral serves each request as soon as it is sent
+static int loopback_tx(unsigned char, dartt_buffer_t * tx, void *, uint32_t)
+{
+	payload_layer_msg_t pld = {};
+	int rc = dartt_frame_to_payload(tx, TYPE_SERIAL_MESSAGE, PAYLOAD_ALIAS, &pld);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	frames++;
+	last_index = pld.index_arg;
+	dartt_mem_t periph = dartt::mem_of(periph_map);
+	reply.len = 0;
+	return dartt_parse_general_message(&pld, TYPE_SERIAL_MESSAGE, &periph, &reply);
+}
+
+static int loopback_rx(dartt_buffer_t * rx, void *, uint32_t)
+{
+	if(reply.len == 0)
+	{
+		rx->len = 0;
+		return DARTT_ERROR_TIMEOUT;
+	}
+	std::memcpy(rx->buf, reply.buf, reply.len);
+	rx->len = reply.len;
+	reply.len = 0;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+static unsigned char tx_mem[64];
+static unsigned char rx_mem[64];
+
+static dartt_sync_t init_sync()
+{
+	std::memset(&ctl_map, 0, sizeof(ctl_map));
+	std::memset(&shadow_map, 0, sizeof(shadow_map));
+	dartt_sync_t ds = {};
+	ds.address = 3;
+	ds.ctl_base = dartt::mem_of(ctl_map);
+	ds.periph_base = dartt::mem_of(shadow_map);
+	ds.msg_type = TYPE_SERIAL_MESSAGE;
+	ds.tx_buf = dartt::buffer(tx_mem);
+	ds.rx_buf = dartt::buffer(rx_mem);
+	ds.blocking_tx_callback = &loopback_tx;
+	ds.blocking_rx_callback = &loopback_rx;
+	ds.timeout_ms = 10;
+	return ds;
+}
+
+/*
+	read, sync and write run one operation per merged span, on both sides of the standard index range
+*/
+static void test_spans()
+{
+	std::memset(&periph_map, 0, sizeof(periph_map));
+	periph_map.kp = 0.5f;
+	periph_map.ki = 0.25f;
+	periph_map.status = 0x5A;
+	periph_map.far_flags = 0xA5A5A5A5;
+	periph_map.far_gain = 2.5f;
+	dartt_sync_t ds = init_sync();
+
+	frames = 0;
+	CHECK(dartt::read<far_gain, kp, status, ki, far_flags>(ds) == DARTT_PROTOCOL_SUCCESS);
+	CHECK(frames == 3);
+	CHECK(DARTT_INDEX_IS_EXTENDED(last_index));
+	CHECK(dartt::periph<kp>(ds) == 0.5f && dartt::periph<ki>(ds) == 0.25f);
+	CHECK(dartt::periph<status>(ds) == 0x5A);
+	CHECK(dartt::periph<far_flags>(ds) == 0xA5A5A5A5 && dartt::periph<far_gain>(ds) == 2.5f);
+	ctl_map = shadow_map;
+
+	//two spans: a write and a read-back each
+	dartt::ctl<ki>(ds) = 0.125f;
+	dartt::ctl<far_gain>(ds) = -4.0f;
+	frames = 0;
+	CHECK(dartt::sync<ki, far_gain>(ds) == DARTT_PROTOCOL_SUCCESS);
+	CHECK(frames == 4);
+	CHECK(periph_map.ki == 0.125f && periph_map.far_gain == -4.0f);
+	CHECK(dartt::periph<far_gain>(ds) == -4.0f);
+
+	//nothing differs from the shadow copy: nothing is sent
+	frames = 0;
+	CHECK(dartt::sync<ki, far_gain>(ds) == DARTT_PROTOCOL_SUCCESS);
+	CHECK(frames == 0);
+
+	//one span across the boundary, sent without verification
+	dartt::ctl<table_end>(ds) = -7;
+	dartt::ctl<far_flags>(ds) = 0x01020304;
+	frames = 0;
+	CHECK(dartt::write<table_end, far_flags>(ds) == DARTT_PROTOCOL_SUCCESS);
+	CHECK(periph_map.table[DARTT_INDEX_RESERVED_BASE - 5] == -7 && periph_map.far_flags == 0x01020304);
+	CHECK(frames == 1);
+}
+
+/*
+	Regions smaller than the struct of the fields are rejected before anything is sent
+*/
+static void test_fits()
+{
+	dartt_sync_t ds = init_sync();
+	frames = 0;
+	ds.ctl_base.size = sizeof(map_t) - sizeof(uint32_t);
+	CHECK(dartt::read<kp>(ds) == DARTT_ERROR_INVALID_ARGUMENT);
+	CHECK(dartt::sync<kp>(ds) == DARTT_ERROR_INVALID_ARGUMENT);
+	ds = init_sync();
+	ds.periph_base.buf = nullptr;
+	CHECK(dartt::write<kp>(ds) == DARTT_ERROR_INVALID_ARGUMENT);
+	CHECK(frames == 0);
+}
+
+/*
+	Frames built from field handles carry the constant index, extended past the standard range
+*/
+static void test_frames()
+{
+	std::memset(&periph_map, 0, sizeof(periph_map));
+	dartt_mem_t periph = dartt::mem_of(periph_map);
+	unsigned char frame_mem[32];
+	dartt_buffer_t frame = dartt::buffer(frame_mem);
+
+	CHECK(dartt::write_frame<far_gain>(dartt_get_complementary_address(3), 1.75f, TYPE_SERIAL_MESSAGE, frame) == DARTT_PROTOCOL_SUCCESS);
+	payload_layer_msg_t pld = {};
+	CHECK(dartt_frame_to_payload(&frame, TYPE_SERIAL_MESSAGE, PAYLOAD_ALIAS, &pld) == DARTT_PROTOCOL_SUCCESS);
+	CHECK(pld.index_arg == far_gain::index && DARTT_INDEX_IS_EXTENDED(pld.index_arg));
+	reply.len = 0;
+	CHECK(dartt_parse_general_message(&pld, TYPE_SERIAL_MESSAGE, &periph, &reply) == DARTT_PROTOCOL_SUCCESS);
+	CHECK(periph_map.far_gain == 1.75f);
+	size_t far_len = frame.len;
+
+	CHECK(dartt::write_frame<kp>(dartt_get_complementary_address(3), 0.5f, TYPE_SERIAL_MESSAGE, frame) == DARTT_PROTOCOL_SUCCESS);
+	CHECK(dartt_frame_to_payload(&frame, TYPE_SERIAL_MESSAGE, PAYLOAD_ALIAS, &pld) == DARTT_PROTOCOL_SUCCESS);
+	CHECK(pld.index_arg == 0);
+	CHECK(frame.len + NUM_BYTES_INDEX_EXTENDED == far_len);	//the extended word index follows the index word
+
+	//read request and reply, through the loopback
+	periph_map.far_flags = 0xCAFEF00D;
+	CHECK(dartt::read_frame<far_flags>(dartt_get_complementary_address(3), TYPE_SERIAL_MESSAGE, frame) == DARTT_PROTOCOL_SUCCESS);
+	CHECK(loopback_tx(3, &frame, nullptr, 0) == DARTT_PROTOCOL_SUCCESS);
+	CHECK(last_index == far_flags::index);
+	dartt_buffer_t rx = dartt::buffer(rx_mem);
+	CHECK(loopback_rx(&rx, nullptr, 0) == DARTT_PROTOCOL_SUCCESS);
+	payload_layer_msg_t reply_pld = {};
+	CHECK(dartt_frame_to_payload(&rx, TYPE_SERIAL_MESSAGE, PAYLOAD_ALIAS, &reply_pld) == DARTT_PROTOCOL_SUCCESS);
+	CHECK(reply_pld.index_arg == far_flags::index);
+	misc_read_message_t read_msg = {3, far_flags::index, static_cast<uint16_t>(far_flags::nbytes), DARTT_TAG_NONE};
+	std::memset(&shadow_map, 0, sizeof(shadow_map));
+	dartt_mem_t shadow = dartt::mem_of(shadow_map);
+	CHECK(dartt_parse_read_reply(&reply_pld, &read_msg, &shadow) == DARTT_PROTOCOL_SUCCESS);
+	CHECK(shadow_map.far_flags == 0xCAFEF00D);
+}
+
+int main()
+{
+	test_spans();
+	test_fits();
+	test_frames();
+	std::printf("test_dartt_hpp: %d failures\n", failures);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+#define _GNU_SOURCE
+#include "sim_periph.h"
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/*
+	Peripheral serving sim->regs over link, without staging or access control. Tests may point periph.mem_base at
+	their own map and add hooks afterwards
+*/
+void sim_periph_init(sim_periph_t * sim, const sim_link_t * link)
+{
+	memset(sim, 0, sizeof(sim_periph_t));
+	sim->link = *link;
+	sim->periph.mem_base.buf = (unsigned char *)&sim->regs;
+	sim->periph.mem_base.size = sizeof(sim_regs_t);
+}
+
+/*
+	Parse one received request frame and build its reply. Returns the dartt_frame_to_payload error if the frame is
+	not a request for the peripheral. reply->len is 0 if there is nothing to send back
+*/
+static int sim_periph_reply(dartt_periph_t * periph, serial_message_type_t type, dartt_buffer_t * rx, dartt_buffer_t * reply)
+{
+	reply->len = 0;
+	payload_layer_msg_t pld = {};
+	int rc = dartt_frame_to_payload(rx, type, PAYLOAD_ALIAS, &pld);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	dartt_periph_parse(periph, &pld, type, reply);	//rejected requests are answered with an error reply
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+static void * sim_periph_thread(void * arg)
+{
+	sim_periph_t * sim = (sim_periph_t *)arg;
+	unsigned char rx_mem[SIM_MAX_FRAME];
+	unsigned char reply_mem[SIM_MAX_FRAME];
+	while(!sim->stop)
+	{
+		dartt_buffer_t rx = {.buf = rx_mem, .size = sizeof(rx_mem), .len = 0};
+		if((*(sim->link.rx))(&rx, sim->link.context, 10) != DARTT_PROTOCOL_SUCCESS)
+		{
+			continue;
+		}
+		dartt_buffer_t reply = {.buf = reply_mem, .size = sizeof(reply_mem), .len = 0};
+		if(sim_periph_reply(&sim->periph, sim->link.type, &rx, &reply) != DARTT_PROTOCOL_SUCCESS)
+		{
+			continue;
+		}
+		sim->frames++;
+		if(reply.len != 0)
+		{
+			(*(sim->link.tx))(sim->link.reply_address, &reply, sim->link.context, 100);
+		}
+	}
+	return NULL;
+}
+
+/*
+	Controller end of a link served synchronously by sim, without a thread: tx parses the request and rx returns its
+	reply. Pass the result to sim_periph_init, then to sim_sync_init
+*/
+sim_link_t sim_loopback_link(sim_periph_t * sim, serial_message_type_t type)
+{
+	sim_link_t link = {type, &sim_loopback_tx, &sim_loopback_rx, sim, 0};
+	return link;
+}
+
+int sim_loopback_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	(void)address;
+	(void)timeout;
+	sim_periph_t * sim = (sim_periph_t *)user_context;
+	dartt_buffer_t reply = {.buf = sim->reply_mem, .size = sizeof(sim->reply_mem), .len = 0};
+	int rc = sim_periph_reply(&sim->periph, sim->link.type, tx, &reply);
+	sim->reply_len = reply.len;
+	if(rc == DARTT_PROTOCOL_SUCCESS)
+	{
+		sim->frames++;
+	}
+	return rc;
+}
+
+/*
+	Reply to the last request, once. DARTT_ERROR_TIMEOUT if there is none
+*/
+int sim_loopback_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout)
+{
+	(void)timeout;
+	sim_periph_t * sim = (sim_periph_t *)user_context;
+	rx->len = 0;
+	if(sim->reply_len == 0)
+	{
+		return DARTT_ERROR_TIMEOUT;
+	}
+	if(sim->reply_len > rx->size)
+	{
+		sim->reply_len = 0;
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	memcpy(rx->buf, sim->reply_mem, sim->reply_len);
+	rx->len = sim->reply_len;
+	sim->reply_len = 0;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/*
+	Serve requests from a thread until sim_periph_stop. Returns the pthread_create result
+*/
+int sim_periph_start(sim_periph_t * sim)
+{
+	sim->stop = 0;
+	return pthread_create(&sim->thread, NULL, &sim_periph_thread, sim);
+}
+
+void sim_periph_stop(sim_periph_t * sim)
+{
+	sim->stop = 1;
+	pthread_join(sim->thread, NULL);
+}
+
+/*
+	Controller for the peripheral at address 3, covering size bytes of ctl and shadow, with a 200 ms timeout
+*/
+void sim_sync_init(dartt_sync_t * ds, const sim_link_t * link, void * ctl, void * shadow, size_t size, unsigned char * tx_mem, unsigned char * rx_mem, size_t mem_size)
+{
+	memset(ds, 0, sizeof(dartt_sync_t));
+	ds->address = 3;
+	ds->ctl_base.buf = (unsigned char *)ctl;
+	ds->ctl_base.size = size;
+	ds->periph_base.buf = (unsigned char *)shadow;
+	ds->periph_base.size = size;
+	ds->msg_type = link->type;
+	ds->tx_buf = (dartt_buffer_t){.buf = tx_mem, .size = mem_size, .len = 0};
+	ds->rx_buf = (dartt_buffer_t){.buf = rx_mem, .size = mem_size, .len = 0};
+	ds->blocking_tx_callback = link->tx;
+	ds->blocking_rx_callback = link->rx;
+	ds->user_context_tx = link->context;
+	ds->user_context_rx = link->context;
+	ds->timeout_ms = 200;
+}
+
+/*
+	Bind a UDP socket to an ephemeral loopback port. Returns the port, or 0 on failure
+*/
+uint16_t sim_dgram_bind(sim_dgram_t * dgram)
+{
+	memset(dgram, 0, sizeof(sim_dgram_t));
+	dgram->fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if(dgram->fd < 0)
+	{
+		return 0;
+	}
+	struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = 0, .sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)}};
+	socklen_t len = sizeof(addr);
+	if(bind(dgram->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || getsockname(dgram->fd, (struct sockaddr *)&addr, &len) != 0)
+	{
+		close(dgram->fd);
+		dgram->fd = -1;
+		return 0;
+	}
+	return ntohs(addr.sin_port);
+}
+
+int sim_dgram_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	(void)address;
+	(void)timeout;
+	sim_dgram_t * dgram = (sim_dgram_t *)user_context;
+	if(dgram->from_len == 0 || sendto(dgram->fd, tx->buf, tx->len, 0, (struct sockaddr *)&dgram->from, dgram->from_len) != (ssize_t)tx->len)
+	{
+		return DARTT_ERROR_INVALID_ARGUMENT;
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+int sim_dgram_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout)
+{
+	sim_dgram_t * dgram = (sim_dgram_t *)user_context;
+	rx->len = 0;
+	struct pollfd pfd = {.fd = dgram->fd, .events = POLLIN};
+	if(poll(&pfd, 1, (int)timeout) <= 0)
+	{
+		return DARTT_ERROR_TIMEOUT;
+	}
+	dgram->from_len = sizeof(dgram->from);
+	ssize_t n = recvfrom(dgram->fd, rx->buf, rx->size, MSG_DONTWAIT, (struct sockaddr *)&dgram->from, &dgram->from_len);
+	if(n <= 0)
+	{
+		return DARTT_ERROR_TIMEOUT;
+	}
+	rx->len = (size_t)n;
+	return DARTT_PROTOCOL_SUCCESS;
+}
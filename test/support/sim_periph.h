@@ -0,0 +1,74 @@
+#ifndef SIM_PERIPH_H
+#define SIM_PERIPH_H
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include "dartt.h"
+#include "dartt_sync.h"
+#include "dartt_periph.h"
+
+/*
+	Simulated peripheral shared by the transport tests: a register block served with dartt_periph_parse from a
+	thread, and the dartt_sync_t of the controller talking to it. Each test only provides the link. Tests without a
+	transport use the loopback link instead, which parses requests in the controller tx callback.
+*/
+
+#define SIM_MAX_FRAME	1472	//largest frame the simulated peripheral receives or replies with
+
+typedef struct sim_regs_t
+{
+	int32_t setpoint[64];
+	int32_t gain[4];
+	int32_t status;
+	uint32_t flags;
+}sim_regs_t;
+
+/*
+	One end of a link, as seen by dartt_sync_t: the blocking callbacks and their context
+*/
+typedef struct sim_link_t
+{
+		serial_message_type_t type;	// Framing used on the link
+		int (*tx)(unsigned char, dartt_buffer_t*, void * user_context, uint32_t timeout);
+		int (*rx)(dartt_buffer_t*, void * user_context, uint32_t timeout);
+		void * context;				// Passed to tx and rx
+		unsigned char reply_address;	// Address passed to tx with replies (peripheral side only)
+}sim_link_t;
+
+typedef struct sim_periph_t
+{
+		sim_link_t link;			// Peripheral end of the link
+		dartt_periph_t periph;		// Serves regs
+		sim_regs_t regs;
+		volatile int stop;			// Set by sim_periph_stop
+		uint32_t frames;			// Requests parsed
+		pthread_t thread;
+		unsigned char reply_mem[SIM_MAX_FRAME];	// Reply held for sim_loopback_rx
+		size_t reply_len;
+}sim_periph_t;
+
+/*
+	Raw datagram socket for a simulated peripheral: replies go to the sender of the last request
+*/
+typedef struct sim_dgram_t
+{
+		int fd;
+		struct sockaddr_storage from;
+		socklen_t from_len;
+}sim_dgram_t;
+
+
+void sim_periph_init(sim_periph_t * sim, const sim_link_t * link);
+int sim_periph_start(sim_periph_t * sim);
+void sim_periph_stop(sim_periph_t * sim);
+sim_link_t sim_loopback_link(sim_periph_t * sim, serial_message_type_t type);
+int sim_loopback_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout);
+int sim_loopback_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout);
+void sim_sync_init(dartt_sync_t * ds, const sim_link_t * link, void * ctl, void * shadow, size_t size, unsigned char * tx_mem, unsigned char * rx_mem, size_t mem_size);
+
+uint16_t sim_dgram_bind(sim_dgram_t * dgram);
+int sim_dgram_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout);
+int sim_dgram_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout);
+
+#endif
@@ -0,0 +1,143 @@
+#define _GNU_SOURCE
+#include "dartt.h"
+#include "dartt_sync.h"
+#include "dartt_periph.h"
+#include "dartt_can_linux.h"
+#include "sim_periph.h"
+#include "unity.h"
+#include <string.h>
+
+/*
+	Frame packing is tested on its own. The end to end test runs dartt_sync_t over a vcan interface against a
+	simulated peripheral on a second socket, and is skipped if vcan0 is not up:
+		sudo modprobe vcan && sudo ip link add dev vcan0 type vcan && sudo ip link set up vcan0
+*/
+
+#define VCAN_IFNAME	"vcan0"
+#define SIM_ADDRESS	(0xFF - 3)	//misc address of motor address 3
+
+void test_can_linux_pack_unpack(void)
+{
+	dartt_can_linux_t ctl = {.fd = -1, .fd_frames = 1};
+	dartt_can_linux_t periph = {.fd = -1, .fd_frames = 1, .peripheral = 1, .address = SIM_ADDRESS};
+	unsigned char mem[80];
+	for(int i = 0; i < (int)sizeof(mem); i++)
+	{
+		mem[i] = (unsigned char)(0x40 + i);
+	}
+	unsigned char out_mem[64];
+	dartt_buffer_t out = {.buf = out_mem, .size = sizeof(out_mem), .len = 0};
+	struct canfd_frame frame;
+	unsigned char address = 0;
+
+	//legal length, sent as is
+	dartt_buffer_t tx = {.buf = mem, .size = sizeof(mem), .len = 6};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_can_linux_pack(&ctl, SIM_ADDRESS, &tx, &frame));
+	TEST_ASSERT_EQUAL_HEX32(SIM_ADDRESS, frame.can_id);
+	TEST_ASSERT_EQUAL(6, frame.len);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_can_linux_unpack(&periph, &frame, &address, &out));
+	TEST_ASSERT_EQUAL(SIM_ADDRESS, address);
+	TEST_ASSERT_EQUAL(6, out.len);
+	TEST_ASSERT_EQUAL_HEX8_ARRAY(mem, out.buf, 6);
+	TEST_ASSERT_EQUAL(DARTT_ADDRESS_FILTERED, dartt_can_linux_unpack(&ctl, &frame, &address, &out));	//requests are not replies
+
+	//padded up to the next legal length, and stripped on reception
+	tx.len = 30;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_can_linux_pack(&periph, 0, &tx, &frame));
+	TEST_ASSERT_EQUAL_HEX32(DARTT_CAN_ID_REPLY | DARTT_CAN_ID_PADDED | SIM_ADDRESS, frame.can_id);
+	TEST_ASSERT_EQUAL(32, frame.len);
+	TEST_ASSERT_EQUAL(2, frame.data[30]);
+	TEST_ASSERT_EQUAL(2, frame.data[31]);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_can_linux_unpack(&ctl, &frame, &address, &out));
+	TEST_ASSERT_EQUAL(SIM_ADDRESS, address);
+	TEST_ASSERT_EQUAL(30, out.len);
+	TEST_ASSERT_EQUAL_HEX8_ARRAY(mem, out.buf, 30);
+
+	out.size = 29;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_can_linux_unpack(&ctl, &frame, &address, &out));
+	out.size = sizeof(out_mem);
+	frame.data[31] = 0;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MALFORMED_MESSAGE, dartt_can_linux_unpack(&ctl, &frame, &address, &out));
+	frame.data[31] = 33;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MALFORMED_MESSAGE, dartt_can_linux_unpack(&ctl, &frame, &address, &out));
+
+	tx.len = 62;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_can_linux_pack(&ctl, SIM_ADDRESS, &tx, &frame));
+	TEST_ASSERT_EQUAL(64, frame.len);
+	tx.len = 65;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_can_linux_pack(&ctl, SIM_ADDRESS, &tx, &frame));
+
+	//classic CAN is never padded, and stops at 8 bytes
+	ctl.fd_frames = 0;
+	tx.len = 8;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_can_linux_pack(&ctl, SIM_ADDRESS, &tx, &frame));
+	TEST_ASSERT_EQUAL(8, frame.len);
+	tx.len = 9;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_can_linux_pack(&ctl, SIM_ADDRESS, &tx, &frame));
+
+	//extended identifiers with a base. Standard frames and other bases are not ours
+	ctl.fd_frames = 1;
+	ctl.id_base = 0x1000;
+	periph.id_base = 0x1000;
+	tx.len = 10;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_can_linux_pack(&ctl, SIM_ADDRESS, &tx, &frame));
+	TEST_ASSERT_EQUAL_HEX32(CAN_EFF_FLAG | 0x1000 | DARTT_CAN_ID_PADDED | SIM_ADDRESS, frame.can_id);
+	TEST_ASSERT_EQUAL(12, frame.len);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_can_linux_unpack(&periph, &frame, &address, &out));
+	TEST_ASSERT_EQUAL(10, out.len);
+	periph.id_base = 0x2000;
+	TEST_ASSERT_EQUAL(DARTT_ADDRESS_FILTERED, dartt_can_linux_unpack(&periph, &frame, &address, &out));
+	periph.id_base = 0;
+	TEST_ASSERT_EQUAL(DARTT_ADDRESS_FILTERED, dartt_can_linux_unpack(&periph, &frame, &address, &out));
+}
+
+void test_can_linux_vcan_sync(void)
+{
+	static dartt_can_linux_t port;
+	if(dartt_can_linux_open(&port, VCAN_IFNAME, 1, 0) != DARTT_PROTOCOL_SUCCESS)
+	{
+		TEST_IGNORE_MESSAGE("no " VCAN_IFNAME " interface");
+	}
+	static dartt_can_linux_t sim_port;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_can_linux_open(&sim_port, VCAN_IFNAME, 1, 0));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_can_linux_set_peripheral(&sim_port, SIM_ADDRESS));
+	static sim_periph_t sim;
+	sim_link_t sim_link = {TYPE_ADDR_CRC_MESSAGE, &dartt_can_linux_tx, &dartt_can_linux_rx, &sim_port, SIM_ADDRESS};
+	sim_periph_init(&sim, &sim_link);
+	TEST_ASSERT_EQUAL(0, sim_periph_start(&sim));
+
+	sim_regs_t ctl = {};
+	sim_regs_t shadow = {};
+	unsigned char tx_mem[DARTT_CANFD_MAX_LEN];
+	unsigned char rx_mem[DARTT_CANFD_MAX_LEN];
+	dartt_sync_t ds;
+	sim_link_t ctl_link = {TYPE_ADDR_CRC_MESSAGE, &dartt_can_linux_tx, &dartt_can_linux_rx, &port, 0};
+	sim_sync_init(&ds, &ctl_link, &ctl, &shadow, sizeof(ctl), tx_mem, rx_mem, 40);
+	ds.frame_len_callback = &dartt_canfd_len;
+	dartt_mem_t ctl_alias = {.buf = (unsigned char *)&ctl, .size = sizeof(ctl)};
+
+	for(int i = 0; i < 64; i++)
+	{
+		ctl.setpoint[i] = 7*i - 100;
+	}
+	ctl.flags = 0xBEEF;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_write_multi(&ctl_alias, &ds));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_read_multi(&ctl_alias, &ds));
+	TEST_ASSERT_EQUAL(0, memcmp(&ctl, &shadow, sizeof(ctl)));
+
+	ctl.status = -5;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_sync(&ctl_alias, &ds));
+	TEST_ASSERT_EQUAL(-5, shadow.status);
+
+	//a peripheral that is not there times out
+	ds.address = 4;
+	ds.timeout_ms = 20;
+	dartt_mem_t status = {.buf = (unsigned char *)&ctl.status, .size = sizeof(int32_t)};
+	TEST_ASSERT_EQUAL(DARTT_ERROR_TIMEOUT, dartt_ctl_read(&status, &ds));
+
+	sim_periph_stop(&sim);
+	TEST_ASSERT_EQUAL(-5, sim.regs.status);
+	TEST_ASSERT_EQUAL(0xBEEF, sim.regs.flags);
+	dartt_can_linux_close(&sim_port);
+	dartt_can_linux_close(&port);
+}
@@ -0,0 +1,162 @@
+
+#include "dartt_cobs.h"
+#include "dartt.h"
+#include "unity.h"
+#include <string.h>
+
+
+/*
+	Encode in, compare against the expected encoded frame (delimiter included), then decode it back
+*/
+static void check_roundtrip(const unsigned char * raw, size_t raw_len, const unsigned char * expected, size_t expected_len)
+{
+	unsigned char enc_mem[DARTT_COBS_MAX_FRAME_LEN(300)] = {};
+	unsigned char dec_mem[300] = {};
+	dartt_buffer_t in = {.buf = (unsigned char *)raw, .size = raw_len ? raw_len : 1, .len = raw_len};
+	dartt_buffer_t enc = {.buf = enc_mem, .size = sizeof(enc_mem), .len = 0};
+	dartt_buffer_t dec = {.buf = dec_mem, .size = sizeof(dec_mem), .len = 0};
+
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_cobs_encode(&in, &enc));
+	TEST_ASSERT_EQUAL(expected_len, enc.len);
+	TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, enc.buf, expected_len);
+	TEST_ASSERT_LESS_OR_EQUAL(DARTT_COBS_MAX_FRAME_LEN(raw_len), enc.len);
+	for(size_t i = 0; i + 1 < enc.len; i++)
+	{
+		TEST_ASSERT_NOT_EQUAL(0, enc.buf[i]);
+	}
+
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_cobs_decode(&enc, &dec));
+	TEST_ASSERT_EQUAL(raw_len, dec.len);
+	if(raw_len != 0)
+	{
+		TEST_ASSERT_EQUAL_HEX8_ARRAY(raw, dec.buf, raw_len);
+	}
+
+	//same frame built in place, behind its headroom
+	unsigned char dma_mem[DARTT_COBS_MAX_FRAME_LEN(300)] = {};
+	dartt_buffer_t dma = {.buf = dma_mem, .size = sizeof(dma_mem), .len = 0};
+	dartt_buffer_t frame = {};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_buffer_reserve(&dma, DARTT_COBS_HEADROOM(raw_len), DARTT_COBS_TAILROOM, &frame));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_buffer_put(&dma, &frame, raw_len));
+	memcpy(frame.buf, raw, raw_len);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_cobs_encode_in_place(&dma, &frame));
+	TEST_ASSERT_EQUAL_PTR(dma_mem, frame.buf);
+	TEST_ASSERT_EQUAL(expected_len, frame.len);
+	TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, frame.buf, expected_len);
+}
+
+void test_cobs_vectors(void)
+{
+	{
+		unsigned char raw[] = {0};	//placeholder, encoded as an empty frame
+		unsigned char expected[] = {0x01, 0x00};
+		check_roundtrip(raw, 0, expected, sizeof(expected));
+	}
+	{
+		unsigned char raw[] = {0x00};
+		unsigned char expected[] = {0x01, 0x01, 0x00};
+		check_roundtrip(raw, sizeof(raw), expected, sizeof(expected));
+	}
+	{
+		unsigned char raw[] = {0x00, 0x00};
+		unsigned char expected[] = {0x01, 0x01, 0x01, 0x00};
+		check_roundtrip(raw, sizeof(raw), expected, sizeof(expected));
+	}
+	{
+		unsigned char raw[] = {0x11, 0x22, 0x00, 0x33};
+		unsigned char expected[] = {0x03, 0x11, 0x22, 0x02, 0x33, 0x00};
+		check_roundtrip(raw, sizeof(raw), expected, sizeof(expected));
+	}
+	{
+		unsigned char raw[] = {0x11, 0x00, 0x00, 0x00};
+		unsigned char expected[] = {0x02, 0x11, 0x01, 0x01, 0x01, 0x00};
+		check_roundtrip(raw, sizeof(raw), expected, sizeof(expected));
+	}
+
+	//254 non-zero bytes fill exactly one block
+	unsigned char raw[256];
+	unsigned char expected[258];
+	for(int i = 0; i < 254; i++)
+	{
+		raw[i] = (unsigned char)(i + 1);
+		expected[i + 1] = (unsigned char)(i + 1);
+	}
+	expected[0] = 0xFF;
+	expected[255] = 0x00;
+	check_roundtrip(raw, 254, expected, 256);
+
+	//a leading zero, then a full block
+	raw[0] = 0x00;
+	for(int i = 1; i < 255; i++)
+	{
+		raw[i] = (unsigned char)i;
+	}
+	expected[0] = 0x01;
+	expected[1] = 0xFF;
+	for(int i = 1; i < 255; i++)
+	{
+		expected[i + 1] = (unsigned char)i;
+	}
+	expected[256] = 0x00;
+	check_roundtrip(raw, 255, expected, 257);
+
+	//255 non-zero bytes spill one byte into a second block
+	for(int i = 0; i < 255; i++)
+	{
+		raw[i] = (unsigned char)(i + 1);
+	}
+	expected[0] = 0xFF;
+	for(int i = 0; i < 254; i++)
+	{
+		expected[i + 1] = (unsigned char)(i + 1);
+	}
+	expected[255] = 0x02;
+	expected[256] = 0xFF;
+	expected[257] = 0x00;
+	check_roundtrip(raw, 255, expected, 258);
+}
+
+void test_cobs_errors(void)
+{
+	unsigned char raw[] = {0x11, 0x22, 0x00, 0x33};
+	unsigned char enc_mem[16] = {};
+	unsigned char dec_mem[16] = {};
+	dartt_buffer_t in = {.buf = raw, .size = sizeof(raw), .len = sizeof(raw)};
+	dartt_buffer_t enc = {.buf = enc_mem, .size = 5, .len = 0};
+	dartt_buffer_t dec = {.buf = dec_mem, .size = sizeof(dec_mem), .len = 0};
+
+	//encoded frame (6 bytes) does not fit
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_cobs_encode(&in, &enc));
+	enc.size = sizeof(enc_mem);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_cobs_encode(&in, &enc));
+
+	//decoding stops at the delimiter, so trailing bytes of the next frame are ignored
+	enc_mem[enc.len] = 0x02;
+	enc_mem[enc.len + 1] = 0x55;
+	enc.len += 2;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_cobs_decode(&enc, &dec));
+	TEST_ASSERT_EQUAL(sizeof(raw), dec.len);
+	TEST_ASSERT_EQUAL_HEX8_ARRAY(raw, dec.buf, sizeof(raw));
+
+	//block truncated by the delimiter
+	unsigned char truncated[] = {0x05, 0x11, 0x22, 0x00};
+	dartt_buffer_t bad = {.buf = truncated, .size = sizeof(truncated), .len = sizeof(truncated)};
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MALFORMED_MESSAGE, dartt_cobs_decode(&bad, &dec));
+	TEST_ASSERT_EQUAL(0, dec.len);
+
+	//decoded frame does not fit
+	dec.size = 3;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_cobs_decode(&enc, &dec));
+
+	//in place: no headroom for the overhead byte, or no tailroom for the delimiter
+	dartt_buffer_t dma = {.buf = enc_mem, .size = 6, .len = 0};
+	dartt_buffer_t frame = {.buf = enc_mem, .size = 5, .len = sizeof(raw)};
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_cobs_encode_in_place(&dma, &frame));
+	frame.buf = enc_mem + 1;
+	dma.size = 5;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_cobs_encode_in_place(&dma, &frame));
+	dma.size = 6;
+	memcpy(frame.buf, raw, sizeof(raw));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_cobs_encode_in_place(&dma, &frame));
+	TEST_ASSERT_EQUAL(6, frame.len);
+}
@@ -50,3 +50,118 @@ void test_crc32_algo(void)
 	}
 }
 
+void test_crc32_update(void)
+{
+	unsigned char arr[] = {0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0, 0x12, 0x3f, 0xff, 0xff};
+	uint32_t crc = 0;
+	for(size_t i = 0; i < sizeof(arr); i += 5)	//uneven pieces
+	{
+		size_t n = (sizeof(arr) - i < 5) ? sizeof(arr) - i : 5;
+		crc = dartt_crc32_update(crc, arr + i, n);
+	}
+	TEST_ASSERT_EQUAL_HEX32(0xAEA095F9, crc);
+	TEST_ASSERT_EQUAL_HEX32(crc, dartt_crc32_update(crc, arr, 0));
+	TEST_ASSERT_EQUAL_HEX32(0, dartt_crc32(arr, 0));
+}
+
+
+/*
+	Test double for a CRC peripheral: counts calls and computes the CRC bit by bit, independently of the lookup table
+*/
+typedef struct
+{
+	uint16_t crc;
+	int inits;
+	int updates;
+	int finals;
+	size_t bytes;
+	uint16_t corrupt;	//xored into the result, to check that the backend result is the one used
+}crc_double_t;
+
+static void crc_double_init(void * context)
+{
+	crc_double_t * d = (crc_double_t *)context;
+	d->crc = DARTT_CRC16_INIT;
+	d->inits++;
+}
+
+static void crc_double_update(void * context, const unsigned char * buf, size_t size)
+{
+	crc_double_t * d = (crc_double_t *)context;
+	for(size_t i = 0; i < size; i++)
+	{
+		d->crc ^= buf[i];
+		for(int j = 0; j < 8; j++)
+		{
+			d->crc = (d->crc & 1) ? (uint16_t)((d->crc >> 1) ^ 0xA001) : (uint16_t)(d->crc >> 1);
+		}
+	}
+	d->updates++;
+	d->bytes += size;
+}
+
+static uint16_t crc_double_final(void * context)
+{
+	crc_double_t * d = (crc_double_t *)context;
+	d->finals++;
+	return d->crc ^ d->corrupt;
+}
+
+void test_crc16_update(void)
+{
+	unsigned char array[] = {1,2,3,4,5,6,7,8,0xff,0xfe,0xfd};
+	uint16_t crc = dartt_crc16_update(DARTT_CRC16_INIT, array, 4);
+	crc = dartt_crc16_update(crc, array + 4, sizeof(array) - 4);
+	TEST_ASSERT_EQUAL_HEX16(dartt_crc16(array, sizeof(array)), crc);
+	TEST_ASSERT_EQUAL_HEX16(0xC6E5, crc);
+}
+
+void test_crc16_backend(void)
+{
+	unsigned char payload[] = {0x10, 0x51, 0x05, 0x17, 0x58, 0x92, 0x35, 0xff};
+	misc_write_message_t msg = {
+		.address = 3,
+		.index = 7,
+		.payload = {.buf = payload, .size = sizeof(payload), .len = sizeof(payload)}
+	};
+	unsigned char sw_mem[32] = {};
+	unsigned char hw_mem[32] = {};
+	dartt_buffer_t sw_frame = {.buf = sw_mem, .size = sizeof(sw_mem), .len = 0};
+	dartt_buffer_t hw_frame = {.buf = hw_mem, .size = sizeof(hw_mem), .len = 0};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_write_frame(&msg, TYPE_SERIAL_MESSAGE, &sw_frame));
+
+	crc_double_t d = {};
+	dartt_crc16_backend_t backend = {
+		.init = &crc_double_init,
+		.update = &crc_double_update,
+		.final = &crc_double_final,
+		.context = &d
+	};
+	dartt_crc16_set_backend(&backend);
+
+	//frames built through the backend match the software path
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_write_frame(&msg, TYPE_SERIAL_MESSAGE, &hw_frame));
+	TEST_ASSERT_EQUAL(sw_frame.len, hw_frame.len);
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(sw_frame.buf, hw_frame.buf, sw_frame.len);
+	TEST_ASSERT_EQUAL(1, d.inits);
+	TEST_ASSERT_EQUAL(1, d.updates);
+	TEST_ASSERT_EQUAL(1, d.finals);
+	TEST_ASSERT_EQUAL(sw_frame.len - NUM_BYTES_CHECKSUM, d.bytes);
+
+	//and so are the checks on reception
+	payload_layer_msg_t pld = {};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload(&sw_frame, TYPE_SERIAL_MESSAGE, PAYLOAD_ALIAS, &pld));
+	TEST_ASSERT_EQUAL(2, d.finals);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload(&sw_frame, TYPE_ADDR_MESSAGE, PAYLOAD_ALIAS, &pld));
+	TEST_ASSERT_EQUAL(3, d.finals);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload(&sw_frame, TYPE_ADDR_CRC_MESSAGE, PAYLOAD_ALIAS, &pld));
+	TEST_ASSERT_EQUAL(3, d.finals);	//no CRC in this message type
+
+	//a faulty unit is caught by the receiver
+	d.corrupt = 0x0100;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_CHECKSUM_MISMATCH, dartt_frame_to_payload(&sw_frame, TYPE_SERIAL_MESSAGE, PAYLOAD_ALIAS, &pld));
+
+	dartt_crc16_set_backend(NULL);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload(&sw_frame, TYPE_SERIAL_MESSAGE, PAYLOAD_ALIAS, &pld));
+	TEST_ASSERT_EQUAL(4, d.finals);
+}
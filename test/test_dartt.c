@@ -2,6 +2,8 @@
 #include "dartt.h"
 #include "unity.h"
 #include "dartt_check_buffer.h"
+#include "dartt_inline.h"
+#include "dartt_copy.h"
 /*
 	TODO:
 		Add test of dartt_frame_to_payload of a type 0 serial message consisting of only address and crc
@@ -47,6 +49,25 @@ void test_read_request_overhead(void)
 	TEST_ASSERT_EQUAL(0, size);
 }
 
+void test_canfd_len(void)
+{
+	size_t expected[DARTT_CANFD_MAX_LEN + 1] = {};
+	for(size_t len = 0; len <= DARTT_CANFD_MAX_LEN; len++)
+	{
+		if(len <= 8) expected[len] = len;
+		else if(len <= 12) expected[len] = 12;
+		else if(len <= 16) expected[len] = 16;
+		else if(len <= 20) expected[len] = 20;
+		else if(len <= 24) expected[len] = 24;
+		else if(len <= 32) expected[len] = 32;
+		else if(len <= 48) expected[len] = 48;
+		else expected[len] = 64;
+		TEST_ASSERT_EQUAL(expected[len], dartt_canfd_len(len));
+	}
+	TEST_ASSERT_EQUAL(0, dartt_canfd_len(DARTT_CANFD_MAX_LEN + 1));
+	TEST_ASSERT_EQUAL(0, dartt_canfd_len(1000));
+}
+
 void test_check_write_args(void)
 {
 	int rc;
@@ -1345,4 +1366,545 @@ void test_dartt_frame_to_payload(void)
 	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
 	TEST_ASSERT_EQUAL(output.buf[0], pld.address);
 	TEST_ASSERT_EQUAL(output.len, pld.msg.len + NUM_BYTES_ADDRESS + NUM_BYTES_INDEX + NUM_BYTES_CHECKSUM);
-}
\ No newline at end of file
+}
+/*
+	Rejected read requests must produce an error reply the controller can decode, for every frame type.
+	Rejected writes must stay silent.
+*/
+void test_error_reply(void)
+{
+	uint32_t mem_words[4] = {};
+	dartt_mem_t mem = {.buf = (unsigned char *)mem_words, .size = sizeof(mem_words)};
+	serial_message_type_t types[] = {TYPE_SERIAL_MESSAGE, TYPE_ADDR_MESSAGE, TYPE_ADDR_CRC_MESSAGE};
+	for(int t = 0; t < 3; t++)
+	{
+		unsigned char frame_mem[32] = {};
+		dartt_buffer_t frame = {.buf = frame_mem, .size = sizeof(frame_mem), .len = 0};
+		unsigned char reply_mem[32] = {};
+		dartt_buffer_t reply = {.buf = reply_mem, .size = sizeof(reply_mem), .len = 0};
+
+		//read past the end of the memory block
+		misc_read_message_t read_msg = {.address = 0x34, .index = 3, .num_bytes = 8};
+		int rc = dartt_create_read_frame(&read_msg, types[t], &frame);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+		payload_layer_msg_t pld = {};
+		rc = dartt_frame_to_payload(&frame, types[t], PAYLOAD_ALIAS, &pld);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+		rc = dartt_parse_general_message(&pld, types[t], &mem, &reply);
+		TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, rc);
+		TEST_ASSERT_EQUAL(dartt_rw_overhead(types[t]) + 1, reply.len);
+
+		//controller side
+		payload_layer_msg_t reply_pld = {};
+		rc = dartt_frame_to_payload(&reply, types[t], PAYLOAD_ALIAS, &reply_pld);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+		TEST_ASSERT_NOT_EQUAL(0, reply_pld.rw_bit);
+		TEST_ASSERT_EQUAL(3, reply_pld.index_arg);
+		TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_check_error_reply(&reply_pld));
+		TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_parse_read_reply(&reply_pld, &read_msg, &mem));
+
+		//a valid read is not an error reply
+		read_msg.index = 0;
+		read_msg.num_bytes = 4;
+		dartt_create_read_frame(&read_msg, types[t], &frame);
+		dartt_frame_to_payload(&frame, types[t], PAYLOAD_ALIAS, &pld);
+		rc = dartt_parse_general_message(&pld, types[t], &mem, &reply);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+		dartt_frame_to_payload(&reply, types[t], PAYLOAD_ALIAS, &reply_pld);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_check_error_reply(&reply_pld));
+
+		//rejected writes are not replied to
+		uint32_t data[2] = {1, 2};
+		misc_write_message_t write_msg = {.address = 0x34, .index = 3, .payload = {.buf = (unsigned char *)data, .size = sizeof(data), .len = sizeof(data)}};
+		dartt_create_write_frame(&write_msg, types[t], &frame);
+		dartt_frame_to_payload(&frame, types[t], PAYLOAD_ALIAS, &pld);
+		rc = dartt_parse_general_message(&pld, types[t], &mem, &reply);
+		TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, rc);
+		TEST_ASSERT_EQUAL(0, reply.len);
+
+		//framed error reply matches the one produced by the parser
+		unsigned char direct_mem[32] = {};
+		dartt_buffer_t direct = {.buf = direct_mem, .size = sizeof(direct_mem), .len = 0};
+		rc = dartt_create_error_reply(&pld, DARTT_ERROR_ACCESS_DENIED, types[t], &direct);	//pld holds the rejected write, index 3
+		TEST_ASSERT_EQUAL(DARTT_ERROR_ACCESS_DENIED, rc);
+		TEST_ASSERT_EQUAL(dartt_rw_overhead(types[t]) + 1, direct.len);
+		rc = dartt_frame_to_payload(&direct, types[t], PAYLOAD_ALIAS, &reply_pld);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+		TEST_ASSERT_EQUAL(DARTT_ERROR_ACCESS_DENIED, dartt_check_error_reply(&reply_pld));
+	}
+
+	//malformed read request (wrong payload length)
+	unsigned char req[] = {0x00, 0x80, 0x04, 0x00, 0x00, 0x00};
+	payload_layer_msg_t pld = {.rw_bit = READ_WRITE_BITMASK, .index_arg = 0, .msg = {.buf = req + NUM_BYTES_INDEX, .size = 4, .len = 4}};
+	unsigned char reply_mem[8] = {};
+	dartt_buffer_t reply = {.buf = reply_mem, .size = sizeof(reply_mem), .len = 0};
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MALFORMED_MESSAGE, dartt_parse_base_serial_message(&pld, &mem, &reply));
+	TEST_ASSERT_EQUAL(NUM_BYTES_ERROR_REPLY_PLD, reply.len);
+	TEST_ASSERT_EQUAL((int8_t)DARTT_ERROR_MALFORMED_MESSAGE, (int8_t)reply.buf[2]);
+
+	//no room for the error reply: fail silently
+	reply.size = NUM_BYTES_ERROR_REPLY_PLD - 1;
+	reply.len = 0;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MALFORMED_MESSAGE, dartt_parse_base_serial_message(&pld, &mem, &reply));
+	TEST_ASSERT_EQUAL(0, reply.len);
+
+	//error reply with a non-negative code is malformed
+	unsigned char bad[] = {0x05};
+	payload_layer_msg_t bad_pld = {.rw_bit = READ_WRITE_BITMASK, .index_arg = 0, .msg = {.buf = bad, .size = 1, .len = 1}};
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MALFORMED_MESSAGE, dartt_check_error_reply(&bad_pld));
+	bad_pld.msg.len = 0;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MALFORMED_MESSAGE, dartt_check_error_reply(&bad_pld));
+}
+
+/*
+	Tagged read requests: the tag is appended to the request and echoed as the last byte of the reply,
+	including error replies
+*/
+void test_tagged_read(void)
+{
+	uint32_t mem_words[4] = {0x11111111, 0x22222222, 0x33333333, 0x44444444};
+	dartt_mem_t mem = {.buf = (unsigned char *)mem_words, .size = sizeof(mem_words)};
+	serial_message_type_t types[] = {TYPE_SERIAL_MESSAGE, TYPE_ADDR_MESSAGE, TYPE_ADDR_CRC_MESSAGE};
+	for(int t = 0; t < 3; t++)
+	{
+		unsigned char frame_mem[32] = {};
+		dartt_buffer_t frame = {.buf = frame_mem, .size = sizeof(frame_mem), .len = 0};
+		unsigned char reply_mem[32] = {};
+		dartt_buffer_t reply = {.buf = reply_mem, .size = sizeof(reply_mem), .len = 0};
+
+		misc_read_message_t read_msg = {.address = 0x34, .index = 1, .num_bytes = 8, .tag = 0xA5};
+		int rc = dartt_create_read_frame(&read_msg, types[t], &frame);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+		TEST_ASSERT_EQUAL(dartt_rw_overhead(types[t]) + NUM_BYTES_NUMWORDS_READREQUEST + NUM_BYTES_TAG, frame.len);
+
+		//output buffer one byte short for the tag
+		dartt_buffer_t short_frame = {.buf = frame_mem, .size = frame.len - 1, .len = 0};
+		TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, check_read_args(&read_msg, types[t], &short_frame));
+
+		payload_layer_msg_t pld = {};
+		rc = dartt_frame_to_payload(&frame, types[t], PAYLOAD_ALIAS, &pld);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+		rc = dartt_parse_general_message(&pld, types[t], &mem, &reply);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+		TEST_ASSERT_EQUAL(dartt_rw_overhead(types[t]) + 8 + NUM_BYTES_TAG, reply.len);
+
+		payload_layer_msg_t reply_pld = {};
+		rc = dartt_frame_to_payload(&reply, types[t], PAYLOAD_ALIAS, &reply_pld);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+		uint8_t tag = 0;
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_strip_reply_tag(&reply_pld, &tag));
+		TEST_ASSERT_EQUAL(0xA5, tag);
+		uint32_t dest_words[4] = {};
+		dartt_mem_t dest = {.buf = (unsigned char *)dest_words, .size = sizeof(dest_words)};
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_parse_read_reply(&reply_pld, &read_msg, &dest));
+		TEST_ASSERT_EQUAL_HEX32(0x22222222, dest_words[1]);
+		TEST_ASSERT_EQUAL_HEX32(0x33333333, dest_words[2]);
+
+		//tagged error reply
+		read_msg.index = 3;
+		dartt_create_read_frame(&read_msg, types[t], &frame);
+		dartt_frame_to_payload(&frame, types[t], PAYLOAD_ALIAS, &pld);
+		rc = dartt_parse_general_message(&pld, types[t], &mem, &reply);
+		TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, rc);
+		TEST_ASSERT_EQUAL(dartt_rw_overhead(types[t]) + 1 + NUM_BYTES_TAG, reply.len);
+		dartt_frame_to_payload(&reply, types[t], PAYLOAD_ALIAS, &reply_pld);
+		tag = 0;
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_strip_reply_tag(&reply_pld, &tag));
+		TEST_ASSERT_EQUAL(0xA5, tag);
+		TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_check_error_reply(&reply_pld));
+	}
+}
+
+/*
+	Extended frames: word indices beyond the standard index range, on a map larger than 128 KB
+*/
+#define EXT_WORD	0x12345
+static uint32_t ext_mem_words[EXT_WORD + 4];
+
+void test_extended_index(void)
+{
+	dartt_mem_t mem = {.buf = (unsigned char *)ext_mem_words, .size = sizeof(ext_mem_words)};
+	serial_message_type_t types[] = {TYPE_SERIAL_MESSAGE, TYPE_ADDR_MESSAGE, TYPE_ADDR_CRC_MESSAGE};
+	for(int t = 0; t < 3; t++)
+	{
+		memset(ext_mem_words, 0, sizeof(ext_mem_words));
+		unsigned char frame_mem[32] = {};
+		dartt_buffer_t frame = {.buf = frame_mem, .size = sizeof(frame_mem), .len = 0};
+		unsigned char reply_mem[32] = {};
+		dartt_buffer_t reply = {.buf = reply_mem, .size = sizeof(reply_mem), .len = 0};
+		size_t head = (types[t] == TYPE_SERIAL_MESSAGE) ? NUM_BYTES_ADDRESS : 0;
+
+		//standard frames are unchanged, extended frames carry the word index after DARTT_INDEX_EXTENDED
+		uint32_t data[2] = {0xA1B2C3D4, 0x01020304};
+		misc_write_message_t write_msg = {.address = 0x85, .index = DARTT_INDEX_OF_WORD(EXT_WORD), .payload = {.buf = (unsigned char *)data, .size = sizeof(data), .len = sizeof(data)}};
+		TEST_ASSERT_EQUAL_HEX32(EXT_WORD | DARTT_INDEX_EXTENDED_BIT, write_msg.index);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_write_frame(&write_msg, types[t], &frame));
+		TEST_ASSERT_EQUAL(dartt_rw_overhead(types[t]) + NUM_BYTES_INDEX_EXTENDED + sizeof(data), frame.len);
+		unsigned char ext_header[] = {0xFE, 0x7F, 0x45, 0x23, 0x01, 0x00};
+		TEST_ASSERT_EQUAL_HEX8_ARRAY(ext_header, frame.buf + head, sizeof(ext_header));
+
+		payload_layer_msg_t pld = {};
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload(&frame, types[t], PAYLOAD_ALIAS, &pld));
+		TEST_ASSERT_EQUAL_HEX32(write_msg.index, pld.index_arg);
+		TEST_ASSERT_EQUAL(sizeof(data), pld.msg.len);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_parse_general_message(&pld, types[t], &mem, &reply));
+		TEST_ASSERT_EQUAL(0, reply.len);
+		TEST_ASSERT_EQUAL_HEX32(0xA1B2C3D4, ext_mem_words[EXT_WORD]);
+		TEST_ASSERT_EQUAL_HEX32(0x01020304, ext_mem_words[EXT_WORD + 1]);
+
+		//the read reply echoes the extended index
+		misc_read_message_t read_msg = {.address = 0x85, .index = DARTT_INDEX_OF_WORD(EXT_WORD + 1), .num_bytes = 4, .tag = DARTT_TAG_NONE};
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_read_frame(&read_msg, types[t], &frame));
+		TEST_ASSERT_EQUAL(dartt_rw_overhead(types[t]) + NUM_BYTES_INDEX_EXTENDED + NUM_BYTES_NUMWORDS_READREQUEST, frame.len);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload(&frame, types[t], PAYLOAD_ALIAS, &pld));
+		TEST_ASSERT_NOT_EQUAL(0, pld.rw_bit);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_parse_general_message(&pld, types[t], &mem, &reply));
+		TEST_ASSERT_EQUAL(dartt_rw_overhead(types[t]) + NUM_BYTES_INDEX_EXTENDED + 4, reply.len);
+		payload_layer_msg_t reply_pld = {};
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload(&reply, types[t], PAYLOAD_ALIAS, &reply_pld));
+		TEST_ASSERT_EQUAL_HEX32(read_msg.index, reply_pld.index_arg);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_parse_read_reply(&reply_pld, &read_msg, &mem));
+
+		//out of range extended reads get an extended error reply
+		read_msg.index = DARTT_INDEX_OF_WORD(EXT_WORD + 4);
+		dartt_create_read_frame(&read_msg, types[t], &frame);
+		dartt_frame_to_payload(&frame, types[t], PAYLOAD_ALIAS, &pld);
+		TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_parse_general_message(&pld, types[t], &mem, &reply));
+		TEST_ASSERT_EQUAL(dartt_rw_overhead(types[t]) + NUM_BYTES_INDEX_EXTENDED + 1, reply.len);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload(&reply, types[t], PAYLOAD_ALIAS, &reply_pld));
+		TEST_ASSERT_EQUAL_HEX32(read_msg.index, reply_pld.index_arg);
+		TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_check_error_reply(&reply_pld));
+
+		//words far beyond the map must not wrap around into it
+		read_msg.index = DARTT_INDEX_OF_WORD(0x7FFFFFFF);
+		dartt_create_read_frame(&read_msg, types[t], &frame);
+		dartt_frame_to_payload(&frame, types[t], PAYLOAD_ALIAS, &pld);
+		TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_parse_general_message(&pld, types[t], &mem, &reply));
+
+		//an extended frame cut short of its word index
+		frame.len = head + NUM_BYTES_INDEX + 2;
+		frame.buf[head] = 0xFE;
+		frame.buf[head + 1] = 0x7F;
+		if(types[t] != TYPE_ADDR_CRC_MESSAGE)
+		{
+			append_crc(&frame);
+		}
+		TEST_ASSERT_EQUAL(DARTT_ERROR_MALFORMED_MESSAGE, dartt_frame_to_payload(&frame, types[t], PAYLOAD_ALIAS, &pld));
+
+		//indices above 0x7FFF need the extended bit
+		write_msg.index = 0x8000;
+		TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, dartt_create_write_frame(&write_msg, types[t], &frame));
+		read_msg.index = 0x8000;
+		TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, dartt_create_read_frame(&read_msg, types[t], &frame));
+	}
+	//reserved indices stay standard, words below the reserved range are unchanged
+	TEST_ASSERT_EQUAL_HEX32(5, DARTT_INDEX_OF_WORD(5));
+	TEST_ASSERT_EQUAL_HEX32(DARTT_INDEX_RESERVED_BASE | DARTT_INDEX_EXTENDED_BIT, DARTT_INDEX_OF_WORD(DARTT_INDEX_RESERVED_BASE));
+	TEST_ASSERT_EQUAL(NUM_BYTES_INDEX, DARTT_INDEX_NUM_BYTES(DARTT_INDEX_COMMIT));
+}
+
+/*
+	Reserved indices in standard frames never reach memory, even when the map extends past them
+*/
+void test_reserved_index_rejected(void)
+{
+	TEST_ASSERT_TRUE(sizeof(ext_mem_words)/sizeof(uint32_t) > 0x8000);
+	dartt_mem_t mem = {.buf = (unsigned char *)ext_mem_words, .size = sizeof(ext_mem_words)};
+	serial_message_type_t types[] = {TYPE_SERIAL_MESSAGE, TYPE_ADDR_MESSAGE, TYPE_ADDR_CRC_MESSAGE};
+	for(int t = 0; t < 3; t++)
+	{
+		memset(ext_mem_words, 0, sizeof(ext_mem_words));
+		unsigned char frame_mem[32] = {};
+		dartt_buffer_t frame = {.buf = frame_mem, .size = sizeof(frame_mem), .len = 0};
+		unsigned char reply_mem[32] = {};
+		dartt_buffer_t reply = {.buf = reply_mem, .size = sizeof(reply_mem), .len = 0};
+		payload_layer_msg_t pld = {};
+		payload_layer_msg_t reply_pld = {};
+		uint32_t data = 0xDEADBEEF;
+
+		//writes: the commit is ignored, the rest rejected. Nothing lands in memory
+		for(uint32_t index = DARTT_INDEX_RESERVED_BASE; index <= DARTT_INDEX_COMMIT; index++)
+		{
+			if(index == DARTT_INDEX_EXTENDED)
+			{
+				continue;	//parsed as an extended frame
+			}
+			misc_write_message_t write_msg = {.address = 0x85, .index = index, .payload = {.buf = (unsigned char *)&data, .size = sizeof(data), .len = sizeof(data)}};
+			TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_write_frame(&write_msg, types[t], &frame));
+			TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload(&frame, types[t], PAYLOAD_ALIAS, &pld));
+			int expected = (index == DARTT_INDEX_COMMIT) ? DARTT_PROTOCOL_SUCCESS : DARTT_ERROR_INVALID_ARGUMENT;
+			TEST_ASSERT_EQUAL(expected, dartt_parse_general_message(&pld, types[t], &mem, &reply));
+			TEST_ASSERT_EQUAL(0, reply.len);
+			TEST_ASSERT_EQUAL_HEX32(0, ext_mem_words[index]);
+		}
+
+		//reads other than CRC32 queries get an error reply instead of memory content
+		ext_mem_words[DARTT_INDEX_RESERVED_BASE] = 0x5A5A5A5A;
+		for(uint32_t index = DARTT_INDEX_RESERVED_BASE; index <= DARTT_INDEX_COMMIT; index++)
+		{
+			if(index == DARTT_INDEX_EXTENDED || index == DARTT_INDEX_CRC32)
+			{
+				continue;
+			}
+			misc_read_message_t read_msg = {.address = 0x85, .index = index, .num_bytes = 4, .tag = DARTT_TAG_NONE};
+			TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_read_frame(&read_msg, types[t], &frame));
+			TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload(&frame, types[t], PAYLOAD_ALIAS, &pld));
+			TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, dartt_parse_general_message(&pld, types[t], &mem, &reply));
+			TEST_ASSERT_EQUAL(dartt_rw_overhead(types[t]) + 1, reply.len);
+			TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload(&reply, types[t], PAYLOAD_ALIAS, &reply_pld));
+			TEST_ASSERT_EQUAL_HEX32(index, reply_pld.index_arg);
+			TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, dartt_check_error_reply(&reply_pld));
+		}
+
+		//the same words are reachable through extended frames
+		misc_write_message_t write_msg = {.address = 0x85, .index = DARTT_INDEX_OF_WORD(DARTT_INDEX_COMMIT), .payload = {.buf = (unsigned char *)&data, .size = sizeof(data), .len = sizeof(data)}};
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_write_frame(&write_msg, types[t], &frame));
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload(&frame, types[t], PAYLOAD_ALIAS, &pld));
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_parse_general_message(&pld, types[t], &mem, &reply));
+		TEST_ASSERT_EQUAL_HEX32(0xDEADBEEF, ext_mem_words[DARTT_INDEX_COMMIT]);
+		misc_read_message_t read_msg = {.address = 0x85, .index = DARTT_INDEX_OF_WORD(DARTT_INDEX_RESERVED_BASE), .num_bytes = 4, .tag = DARTT_TAG_NONE};
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_read_frame(&read_msg, types[t], &frame));
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload(&frame, types[t], PAYLOAD_ALIAS, &pld));
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_parse_general_message(&pld, types[t], &mem, &reply));
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload(&reply, types[t], PAYLOAD_ALIAS, &reply_pld));
+		TEST_ASSERT_EQUAL(0, memcmp(reply_pld.msg.buf, &ext_mem_words[DARTT_INDEX_RESERVED_BASE], sizeof(uint32_t)));
+	}
+}
+
+/*
+	CRC32 queries: a read request to DARTT_INDEX_CRC32 carrying a span, answered with the CRC32 of the span
+*/
+void test_crc32_query(void)
+{
+	unsigned char mem_bytes[64];
+	for(int i = 0; i < (int)sizeof(mem_bytes); i++)
+	{
+		mem_bytes[i] = (unsigned char)(i*3 + 1);
+	}
+	dartt_mem_t mem = {.buf = mem_bytes, .size = sizeof(mem_bytes)};
+	serial_message_type_t types[] = {TYPE_SERIAL_MESSAGE, TYPE_ADDR_MESSAGE, TYPE_ADDR_CRC_MESSAGE};
+	for(int t = 0; t < 3; t++)
+	{
+		unsigned char frame_mem[32] = {};
+		dartt_buffer_t frame = {.buf = frame_mem, .size = sizeof(frame_mem), .len = 0};
+		unsigned char reply_mem[32] = {};
+		dartt_buffer_t reply = {.buf = reply_mem, .size = sizeof(reply_mem), .len = 0};
+		size_t head = (types[t] == TYPE_SERIAL_MESSAGE) ? NUM_BYTES_ADDRESS : 0;
+
+		misc_crc32_query_t query = {.address = 0x85, .word = 2, .num_bytes = 37, .tag = DARTT_TAG_NONE};
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_crc32_query(&query, types[t], &frame));
+		TEST_ASSERT_EQUAL(dartt_rw_overhead(types[t]) + NUM_BYTES_CRC32_QUERY, frame.len);
+		unsigned char query_bytes[] = {0xFD, 0xFF, 0x02, 0x00, 0x00, 0x00, 37, 0x00, 0x00, 0x00};
+		TEST_ASSERT_EQUAL_HEX8_ARRAY(query_bytes, frame.buf + head, sizeof(query_bytes));
+
+		payload_layer_msg_t pld = {};
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload(&frame, types[t], PAYLOAD_ALIAS, &pld));
+		uint32_t word = 0, num_bytes = 0;
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_parse_crc32_query(&pld, &word, &num_bytes));
+		TEST_ASSERT_EQUAL(2, word);
+		TEST_ASSERT_EQUAL(37, num_bytes);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_parse_general_message(&pld, types[t], &mem, &reply));
+		TEST_ASSERT_EQUAL(dartt_rw_overhead(types[t]) + NUM_BYTES_CRC32, reply.len);
+
+		payload_layer_msg_t reply_pld = {};
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload(&reply, types[t], PAYLOAD_ALIAS, &reply_pld));
+		uint32_t crc = 0;
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_parse_crc32_reply(&reply_pld, &crc));
+		TEST_ASSERT_EQUAL_HEX32(dartt_crc32(mem_bytes + 8, 37), crc);
+
+		//tagged queries echo the tag
+		query.tag = 0x42;
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_crc32_query(&query, types[t], &frame));
+		TEST_ASSERT_EQUAL(dartt_rw_overhead(types[t]) + NUM_BYTES_CRC32_QUERY + NUM_BYTES_TAG, frame.len);
+		dartt_frame_to_payload(&frame, types[t], PAYLOAD_ALIAS, &pld);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_parse_general_message(&pld, types[t], &mem, &reply));
+		dartt_frame_to_payload(&reply, types[t], PAYLOAD_ALIAS, &reply_pld);
+		uint8_t tag = 0;
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_strip_reply_tag(&reply_pld, &tag));
+		TEST_ASSERT_EQUAL(0x42, tag);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_parse_crc32_reply(&reply_pld, &crc));
+		TEST_ASSERT_EQUAL_HEX32(dartt_crc32(mem_bytes + 8, 37), crc);
+
+		//spans beyond the block get a tagged error reply
+		query.num_bytes = sizeof(mem_bytes) - 7;
+		dartt_create_crc32_query(&query, types[t], &frame);
+		dartt_frame_to_payload(&frame, types[t], PAYLOAD_ALIAS, &pld);
+		TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_parse_general_message(&pld, types[t], &mem, &reply));
+		dartt_frame_to_payload(&reply, types[t], PAYLOAD_ALIAS, &reply_pld);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_strip_reply_tag(&reply_pld, &tag));
+		TEST_ASSERT_EQUAL(0x42, tag);
+		TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_parse_crc32_reply(&reply_pld, &crc));
+		query.word = 0xFFFFFFFF;
+		query.num_bytes = 4;
+		dartt_create_crc32_query(&query, types[t], &frame);
+		dartt_frame_to_payload(&frame, types[t], PAYLOAD_ALIAS, &pld);
+		TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_parse_general_message(&pld, types[t], &mem, &reply));
+
+		//a plain read request to the reserved index is not a query
+		misc_read_message_t read_msg = {.address = 0x85, .index = DARTT_INDEX_CRC32, .num_bytes = 4, .tag = DARTT_TAG_NONE};
+		dartt_create_read_frame(&read_msg, types[t], &frame);
+		dartt_frame_to_payload(&frame, types[t], PAYLOAD_ALIAS, &pld);
+		TEST_ASSERT_EQUAL(DARTT_ERROR_MALFORMED_MESSAGE, dartt_parse_crc32_query(&pld, &word, &num_bytes));
+		TEST_ASSERT_EQUAL(DARTT_ERROR_MALFORMED_MESSAGE, dartt_parse_general_message(&pld, types[t], &mem, &reply));
+		TEST_ASSERT_NOT_EQUAL(0, reply.len);
+
+		//the frame must fit
+		query.tag = DARTT_TAG_NONE;
+		frame.size = dartt_rw_overhead(types[t]) + NUM_BYTES_CRC32_QUERY - 1;
+		TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_create_crc32_query(&query, types[t], &frame));
+	}
+	//ordinary read replies are not CRC32 replies
+	unsigned char data[4] = {1, 2, 3, 4};
+	payload_layer_msg_t read_reply = {.rw_bit = 0, .index_arg = 3, .msg = {.buf = data, .size = 4, .len = 4}};
+	uint32_t crc = 0;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MALFORMED_MESSAGE, dartt_parse_crc32_reply(&read_reply, &crc));
+}
+
+/*
+	The fixed-type inline variants must produce the same frames, payloads, replies and errors as the generic functions
+*/
+void test_fixed_type_variants(void)
+{
+	uint32_t words[4] = {0x11111111, 0x22222222, 0x33333333, 0x44444444};
+	dartt_mem_t mem = {.buf = (unsigned char *)words, .size = sizeof(words)};
+	unsigned char payload_mem[] = {1, 2, 3, 4, 5, 6, 7, 8};
+	misc_write_message_t write_msg = {.address = 0x83, .index = 1, .payload = {.buf = payload_mem, .size = sizeof(payload_mem), .len = sizeof(payload_mem)}};
+	misc_read_message_t read_msg = {.address = 0x83, .index = 2, .num_bytes = 8, .tag = 7};
+
+	unsigned char a_mem[32], b_mem[32], ra_mem[32], rb_mem[32];
+	dartt_buffer_t a = {.buf = a_mem, .size = sizeof(a_mem), .len = 0};
+	dartt_buffer_t b = {.buf = b_mem, .size = sizeof(b_mem), .len = 0};
+	dartt_buffer_t ra = {.buf = ra_mem, .size = sizeof(ra_mem), .len = 0};
+	dartt_buffer_t rb = {.buf = rb_mem, .size = sizeof(rb_mem), .len = 0};
+	payload_layer_msg_t pa = {};
+	payload_layer_msg_t pb = {};
+
+	//TYPE_SERIAL_MESSAGE
+	TEST_ASSERT_EQUAL(dartt_rw_overhead(TYPE_SERIAL_MESSAGE), dartt_rw_overhead_serial());
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_write_frame(&write_msg, TYPE_SERIAL_MESSAGE, &a));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_write_frame_serial(&write_msg, &b));
+	TEST_ASSERT_EQUAL(a.len, b.len);
+	TEST_ASSERT_EQUAL_MEMORY(a.buf, b.buf, a.len);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_read_frame(&read_msg, TYPE_SERIAL_MESSAGE, &a));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_read_frame_serial(&read_msg, &b));
+	TEST_ASSERT_EQUAL(a.len, b.len);
+	TEST_ASSERT_EQUAL_MEMORY(a.buf, b.buf, a.len);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload(&a, TYPE_SERIAL_MESSAGE, PAYLOAD_ALIAS, &pa));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload_serial(&b, PAYLOAD_ALIAS, &pb));
+	TEST_ASSERT_EQUAL(pa.address, pb.address);
+	TEST_ASSERT_EQUAL(pa.index_arg, pb.index_arg);
+	TEST_ASSERT_EQUAL(pa.msg.len, pb.msg.len);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_parse_general_message(&pa, TYPE_SERIAL_MESSAGE, &mem, &ra));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_parse_general_message_serial(&pb, &mem, &rb));
+	TEST_ASSERT_EQUAL(ra.len, rb.len);
+	TEST_ASSERT_EQUAL_MEMORY(ra.buf, rb.buf, ra.len);
+	b.buf[1] ^= 0x01;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_CHECKSUM_MISMATCH, dartt_frame_to_payload_serial(&b, PAYLOAD_ALIAS, &pb));
+
+	//TYPE_ADDR_MESSAGE
+	TEST_ASSERT_EQUAL(dartt_rw_overhead(TYPE_ADDR_MESSAGE), dartt_rw_overhead_addr());
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_write_frame(&write_msg, TYPE_ADDR_MESSAGE, &a));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_write_frame_addr(&write_msg, &b));
+	TEST_ASSERT_EQUAL(a.len, b.len);
+	TEST_ASSERT_EQUAL_MEMORY(a.buf, b.buf, a.len);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_read_frame(&read_msg, TYPE_ADDR_MESSAGE, &a));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_read_frame_addr(&read_msg, &b));
+	TEST_ASSERT_EQUAL_MEMORY(a.buf, b.buf, a.len);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload(&a, TYPE_ADDR_MESSAGE, PAYLOAD_ALIAS, &pa));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload_addr(&b, PAYLOAD_ALIAS, &pb));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_parse_general_message(&pa, TYPE_ADDR_MESSAGE, &mem, &ra));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_parse_general_message_addr(&pb, &mem, &rb));
+	TEST_ASSERT_EQUAL(ra.len, rb.len);
+	TEST_ASSERT_EQUAL_MEMORY(ra.buf, rb.buf, ra.len);
+
+	//TYPE_ADDR_CRC_MESSAGE, with an error reply
+	TEST_ASSERT_EQUAL(dartt_rw_overhead(TYPE_ADDR_CRC_MESSAGE), dartt_rw_overhead_addr_crc());
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_write_frame(&write_msg, TYPE_ADDR_CRC_MESSAGE, &a));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_write_frame_addr_crc(&write_msg, &b));
+	TEST_ASSERT_EQUAL(a.len, b.len);
+	TEST_ASSERT_EQUAL_MEMORY(a.buf, b.buf, a.len);
+	read_msg.index = 3;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_read_frame(&read_msg, TYPE_ADDR_CRC_MESSAGE, &a));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_read_frame_addr_crc(&read_msg, &b));
+	TEST_ASSERT_EQUAL_MEMORY(a.buf, b.buf, a.len);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload(&a, TYPE_ADDR_CRC_MESSAGE, PAYLOAD_ALIAS, &pa));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_frame_to_payload_addr_crc(&b, PAYLOAD_ALIAS, &pb));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_parse_general_message(&pa, TYPE_ADDR_CRC_MESSAGE, &mem, &ra));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_parse_general_message_addr_crc(&pb, &mem, &rb));
+	TEST_ASSERT_EQUAL(ra.len, rb.len);
+	TEST_ASSERT_EQUAL_MEMORY(ra.buf, rb.buf, ra.len);
+
+	//output too short for the payload
+	dartt_buffer_t small = {.buf = b_mem, .size = 4, .len = 0};
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_create_write_frame_addr_crc(&write_msg, &small));
+}
+
+/*
+	dartt_copy against a byte loop, for every source and destination alignment and lengths around a word
+*/
+void test_copy_alignment(void)
+{
+	uint32_t src_words[8];
+	uint32_t dst_words[8];
+	unsigned char * src = (unsigned char *)src_words;
+	unsigned char * dst = (unsigned char *)dst_words;
+	for(size_t i = 0; i < sizeof(src_words); i++)
+	{
+		src[i] = (unsigned char)(i * 7 + 1);
+	}
+	for(size_t so = 0; so < sizeof(uint32_t); so++)
+	{
+		for(size_t d_o = 0; d_o < sizeof(uint32_t); d_o++)
+		{
+			for(size_t n = 0; n <= 13; n++)
+			{
+				memset(dst, 0xEE, sizeof(dst_words));
+				dartt_copy(dst + d_o, src + so, n);
+				for(size_t i = 0; i < sizeof(dst_words); i++)
+				{
+					unsigned char expected = (i >= d_o && i < d_o + n) ? src[so + i - d_o] : 0xEE;
+					TEST_ASSERT_EQUAL_HEX8(expected, dst[i]);
+				}
+			}
+		}
+	}
+}
+
+void test_buffer_room(void)
+{
+	unsigned char dma_mem[16] = {};
+	dartt_buffer_t dma = {.buf = dma_mem, .size = sizeof(dma_mem), .len = 0};
+	dartt_buffer_t frame = {};
+
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_buffer_reserve(&dma, 16, 0, &frame));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_buffer_reserve(&dma, 8, 8, &frame));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_buffer_reserve(&dma, 4, 2, &frame));
+	TEST_ASSERT_EQUAL_PTR(dma_mem + 4, frame.buf);
+	TEST_ASSERT_EQUAL(10, frame.size);
+	TEST_ASSERT_EQUAL(0, frame.len);
+	TEST_ASSERT_EQUAL(4, dartt_buffer_headroom(&dma, &frame));
+
+	//write frame built behind the headroom
+	unsigned char data[4] = {1, 2, 3, 4};
+	misc_write_message_t msg = {.address = 3, .index = 1, .payload = {.buf = data, .size = sizeof(data), .len = sizeof(data)}};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_write_frame(&msg, TYPE_ADDR_MESSAGE, &frame));
+	TEST_ASSERT_EQUAL(8, frame.len);
+
+	//prepend a header and append a trailer without moving the frame
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_buffer_push(&dma, &frame, 5));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_buffer_push(&dma, &frame, 4));
+	TEST_ASSERT_EQUAL_PTR(dma_mem, frame.buf);
+	TEST_ASSERT_EQUAL(12, frame.len);
+	TEST_ASSERT_EQUAL_HEX8_ARRAY(data, frame.buf + 4 + 2, sizeof(data));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_buffer_put(&dma, &frame, 4));
+	TEST_ASSERT_EQUAL(16, frame.len);
+	TEST_ASSERT_EQUAL(16, frame.size);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_buffer_put(&dma, &frame, 1));
+	TEST_ASSERT_EQUAL(16, frame.len);
+
+	//a frame outside the dma buffer has no headroom
+	unsigned char other[4];
+	dartt_buffer_t outside = {.buf = other, .size = sizeof(other), .len = 0};
+	TEST_ASSERT_EQUAL(0, dartt_buffer_headroom(&dma, &outside));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_buffer_push(&dma, &outside, 1));
+}
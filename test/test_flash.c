@@ -0,0 +1,204 @@
+#include "dartt_crc.h"
+#include "dartt.h"
+#include "dartt_sync.h"
+#include "dartt_periph.h"
+#include "dartt_flash.h"
+#include "dartt_flash_file.h"
+#include "sim_periph.h"
+#include "unity.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define WINDOW_SIZE		256
+#define FLASH_WORD		4	//control block after 4 application registers
+
+typedef struct flash_map_t
+{
+	uint32_t regs[4];
+	dartt_flash_ctl_t flash;
+	unsigned char window[WINDOW_SIZE];
+}flash_map_t;
+
+/*
+	Loopback peripheral serving flash_map_t, with the file backend behind the flash hook. drop_mask drops frames by
+	their position in the upload (bit N: frame N)
+*/
+typedef struct flash_sim_t
+{
+	sim_periph_t sim;
+	flash_map_t map;
+	dartt_flash_t flash;
+	dartt_flash_file_t file;
+	dartt_write_hook_t hook;
+	uint64_t drop_mask;
+	int frames;
+}flash_sim_t;
+
+static flash_sim_t fsim;
+static flash_map_t ctl_map;
+static flash_map_t shadow_map;
+static char image_path[64];
+
+static int drop_tx_blocking(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	int n = fsim.frames++;
+	if(n < 64 && (fsim.drop_mask & (1ULL << n)) != 0)
+	{
+		fsim.sim.reply_len = 0;
+		return DARTT_PROTOCOL_SUCCESS;
+	}
+	return sim_loopback_tx(address, tx, user_context, timeout);
+}
+
+static void init_sim(size_t capacity)
+{
+	memset(&fsim, 0, sizeof(fsim));
+	snprintf(image_path, sizeof(image_path), "/tmp/dartt_test_flash_%d.bin", (int)getpid());
+	unlink(image_path);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_flash_file_open(&fsim.file, image_path));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_flash_init(&fsim.map.flash, WINDOW_SIZE));
+	fsim.flash.backend = &fsim.file.backend;
+	fsim.flash.capacity = capacity;
+	dartt_write_hook_t hook = DARTT_FLASH_HOOK(FLASH_WORD, &fsim.flash);
+	fsim.hook = hook;
+	sim_link_t link = sim_loopback_link(&fsim.sim, TYPE_SERIAL_MESSAGE);
+	sim_periph_init(&fsim.sim, &link);
+	fsim.sim.periph.mem_base.buf = (unsigned char *)&fsim.map;
+	fsim.sim.periph.mem_base.size = sizeof(flash_map_t);
+	fsim.sim.periph.hooks = &fsim.hook;
+	fsim.sim.periph.num_hooks = 1;
+}
+
+static void init_ctl(dartt_sync_t * ds, unsigned char * tx_mem, unsigned char * rx_mem, size_t mem_size)
+{
+	memset(&ctl_map, 0, sizeof(ctl_map));
+	memset(&shadow_map, 0, sizeof(shadow_map));
+	sim_link_t link = sim_loopback_link(&fsim.sim, TYPE_SERIAL_MESSAGE);
+	link.tx = &drop_tx_blocking;
+	sim_sync_init(ds, &link, &ctl_map, &shadow_map, sizeof(flash_map_t), tx_mem, rx_mem, mem_size);
+	ds->retry.max_attempts = 3;
+	ds->retry.retry_mask = DARTT_RETRY_DEFAULT_MASK | DARTT_RETRY_BIT(DARTT_ERROR_SYNC_MISMATCH);
+}
+
+static size_t read_image(unsigned char * buf, size_t size)
+{
+	FILE * fp = fopen(image_path, "rb");
+	if(fp == NULL)
+	{
+		return 0;
+	}
+	size_t n = fread(buf, 1, size, fp);
+	fclose(fp);
+	return n;
+}
+
+void test_flash_upload(void)
+{
+	static unsigned char image[1000];
+	static unsigned char readback[2048];
+	for(size_t i = 0; i < sizeof(image); i++)
+	{
+		image[i] = (unsigned char)(i*7 + (i >> 8));
+	}
+	init_sim(4096);
+	unsigned char tx_mem[40] = {};
+	unsigned char rx_mem[40] = {};
+	dartt_sync_t ds;
+	init_ctl(&ds, tx_mem, rx_mem, sizeof(tx_mem));
+	dartt_mem_t region = {(unsigned char *)&ctl_map.flash, sizeof(dartt_flash_ctl_t) + WINDOW_SIZE};
+
+	//1000 bytes in 4 windows, the last one partial
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_flash_upload(&region, &ds, image, sizeof(image)));
+	TEST_ASSERT_EQUAL(1, fsim.flash.commits);
+	TEST_ASSERT_EQUAL(sizeof(image), fsim.map.flash.written);
+	TEST_ASSERT_EQUAL_HEX32(dartt_crc32(image, sizeof(image)), fsim.map.flash.image_crc);
+	TEST_ASSERT_EQUAL(sizeof(image), read_image(readback, sizeof(readback)));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(image, readback, sizeof(image));
+	TEST_ASSERT_EQUAL(-1, access(fsim.file.part_path, F_OK));
+
+	//a second, smaller image replaces the first. Lose a window frame, the query repairing it and a program command
+	fsim.frames = 0;
+	fsim.drop_mask = (1ULL << 4) | (1ULL << 12) | (1ULL << 23);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_flash_upload(&region, &ds, image + 100, 300));
+	TEST_ASSERT_EQUAL(2, fsim.flash.commits);
+	TEST_ASSERT_EQUAL(300, read_image(readback, sizeof(readback)));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(image + 100, readback, 300);
+	TEST_ASSERT_TRUE(ds.retry_stats.recovered >= 2);
+
+	//an odd length ends on a partial word, in the last window and in the image
+	fsim.drop_mask = 0;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_flash_upload(&region, &ds, image + 3, 301));
+	TEST_ASSERT_EQUAL(3, fsim.flash.commits);
+	TEST_ASSERT_EQUAL(301, fsim.map.flash.written);
+	TEST_ASSERT_EQUAL_HEX32(dartt_crc32(image + 3, 301), fsim.map.flash.image_crc);
+	TEST_ASSERT_EQUAL(301, read_image(readback, sizeof(readback)));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(image + 3, readback, 301);
+
+	//images larger than the slot are rejected by the erase, and the committed image stays
+	static unsigned char big[5000];
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_flash_upload(&region, &ds, big, sizeof(big)));
+	TEST_ASSERT_EQUAL(301, read_image(readback, sizeof(readback)));
+
+	dartt_flash_file_close(&fsim.file);
+	unlink(image_path);
+}
+
+static int run(uint32_t command, uint32_t offset, uint32_t len, uint32_t crc)
+{
+	fsim.map.flash.offset = offset;
+	fsim.map.flash.len = len;
+	fsim.map.flash.crc = crc;
+	fsim.map.flash.seq++;
+	fsim.map.flash.command = command;
+	return dartt_flash_run(&fsim.flash, &fsim.map.flash);
+}
+
+/*
+	Commands run once per seq, windows are programmed in order after their CRC32 is checked, and commit only takes an
+	image whose CRC32 matches what was programmed
+*/
+void test_flash_commands(void)
+{
+	init_sim(8192);
+	unsigned char * window = fsim.map.window;
+	memset(window, 0x5A, WINDOW_SIZE);
+	uint32_t window_crc = dartt_crc32(window, WINDOW_SIZE);
+
+	//the file behaves like flash: nothing can be programmed before an erase
+	TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, run(DARTT_FLASH_CMD_PROGRAM, 0, WINDOW_SIZE, window_crc));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, fsim.map.flash.status);
+	TEST_ASSERT_EQUAL(fsim.map.flash.seq, fsim.map.flash.ack);
+
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, run(DARTT_FLASH_CMD_ERASE, 0, 2*WINDOW_SIZE, 0));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_SYNC_MISMATCH, run(DARTT_FLASH_CMD_PROGRAM, 0, WINDOW_SIZE, window_crc ^ 1));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, run(DARTT_FLASH_CMD_PROGRAM, WINDOW_SIZE, WINDOW_SIZE, window_crc));	//out of order
+	TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, run(DARTT_FLASH_CMD_PROGRAM, 0, WINDOW_SIZE + 4, window_crc));	//beyond the window
+	TEST_ASSERT_EQUAL(0, fsim.map.flash.written);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, run(DARTT_FLASH_CMD_PROGRAM, 0, WINDOW_SIZE, window_crc));
+	TEST_ASSERT_EQUAL(WINDOW_SIZE, fsim.map.flash.written);
+
+	//the same command received again is not run again
+	fsim.map.flash.status = 1;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_flash_run(&fsim.flash, &fsim.map.flash));
+	TEST_ASSERT_EQUAL(1, fsim.map.flash.status);
+	TEST_ASSERT_EQUAL(WINDOW_SIZE, fsim.map.flash.written);
+
+	//through the hook, only once the whole command word is written
+	fsim.map.flash.seq++;
+	dartt_flash_hook((unsigned char *)&fsim.map.flash.command, FLASH_WORD + DARTT_FLASH_COMMAND_WORD, 2, &fsim.flash);
+	TEST_ASSERT_EQUAL(WINDOW_SIZE, fsim.map.flash.written);
+	dartt_flash_hook((unsigned char *)&fsim.map.flash.command, FLASH_WORD + DARTT_FLASH_COMMAND_WORD, 4, &fsim.flash);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, fsim.map.flash.status);	//offset 0 again, out of order
+	TEST_ASSERT_EQUAL(fsim.map.flash.seq, fsim.map.flash.ack);
+
+	uint32_t image_crc = fsim.map.flash.image_crc;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, run(DARTT_FLASH_CMD_COMMIT, 0, 2*WINDOW_SIZE, image_crc));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_SYNC_MISMATCH, run(DARTT_FLASH_CMD_COMMIT, 0, WINDOW_SIZE, image_crc ^ 1));
+	TEST_ASSERT_EQUAL(-1, access(image_path, F_OK));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, run(DARTT_FLASH_CMD_COMMIT, 0, WINDOW_SIZE, image_crc));
+	TEST_ASSERT_EQUAL(1, fsim.flash.commits);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, run(7, 0, 0, 0));
+
+	unlink(image_path);
+}
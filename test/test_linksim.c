@@ -0,0 +1,153 @@
+#include "dartt.h"
+#include "dartt_sync.h"
+#include "dartt_linksim.h"
+#include "sim_periph.h"
+#include "unity.h"
+#include <string.h>
+
+/*
+	Link simulator timings are checked against hand computed values: at 1 Mbaud and 10 bits per byte, every wire
+	byte takes 10 us.
+*/
+
+#define BYTE_NS		10000u
+
+static const dartt_linksim_params_t uart_params =
+{
+	.baud = 1000000,
+	.bits_per_byte = 10,
+	.cobs = 0,
+	.full_duplex = 0,
+	.frame_overhead_bits = 0,
+	.turnaround_ns = 2000,
+	.propagation_ns = 500,
+	.periph_fixed_ns = 3000,
+	.periph_per_byte_ns = 0
+};
+
+static void setup_sync(dartt_sync_t * ds, dartt_linksim_t * sim, sim_regs_t * ctl, sim_regs_t * shadow, unsigned char * tx_mem, unsigned char * rx_mem, size_t buf_size)
+{
+	sim_link_t link = {sim->type, &dartt_linksim_tx, &dartt_linksim_rx, sim, 0};
+	sim_sync_init(ds, &link, ctl, shadow, sizeof(sim_regs_t), tx_mem, rx_mem, buf_size);
+	ds->timeout_ms = 2;
+}
+
+void test_linksim_transaction_timing(void)
+{
+	static dartt_linksim_t sim;
+	static sim_regs_t periph_regs;
+	dartt_linksim_init(&sim, &uart_params, TYPE_ADDR_CRC_MESSAGE, 1000000);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_linksim_add(&sim, dartt_get_complementary_address(3), (dartt_mem_t){.buf = (unsigned char *)&periph_regs, .size = sizeof(periph_regs)}));
+	TEST_ASSERT_EQUAL(15*BYTE_NS, dartt_linksim_wire_ns(&sim, 15));
+
+	sim_regs_t ctl = {};
+	sim_regs_t shadow = {};
+	unsigned char tx_mem[64];
+	unsigned char rx_mem[64];
+	dartt_sync_t ds;
+	setup_sync(&ds, &sim, &ctl, &shadow, tx_mem, rx_mem, sizeof(tx_mem));
+
+	//read request [index][num_bytes] = 4 bytes, reply [index][data] = 6 bytes
+	periph_regs.status = 77;
+	dartt_mem_t status = {.buf = (unsigned char *)&ctl.status, .size = sizeof(int32_t)};
+	dartt_linksim_begin_cycle(&sim);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_ctl_read(&status, &ds));
+	TEST_ASSERT_EQUAL(77, shadow.status);
+	dartt_linksim_cycle_t cycle = dartt_linksim_end_cycle(&sim);
+	uint64_t expected = 4*BYTE_NS + 500 + 3000 + 6*BYTE_NS + 500;
+	TEST_ASSERT_EQUAL(expected, cycle.duration_ns);
+	TEST_ASSERT_EQUAL(expected, cycle.max_latency_ns);
+	TEST_ASSERT_EQUAL(10*BYTE_NS, cycle.busy_ns);
+	TEST_ASSERT_EQUAL(2, cycle.frames);
+	TEST_ASSERT_EQUAL(expected, sim.now_ns);
+
+	//an instant peripheral still has to wait for the bus turnaround before replying
+	sim.params.periph_fixed_ns = 0;
+	sim.params.propagation_ns = 0;
+	dartt_linksim_begin_cycle(&sim);
+	TEST_ASSERT_EQUAL(1000000, sim.now_ns);	//scheduled start of the second cycle
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_ctl_read(&status, &ds));
+	cycle = dartt_linksim_end_cycle(&sim);
+	TEST_ASSERT_EQUAL(4*BYTE_NS + 2000 + 6*BYTE_NS, cycle.duration_ns);
+
+	//writes have no reply. The cycle ends when the peripheral has the frame
+	sim.params.propagation_ns = 500;
+	ctl.setpoint[0] = 5;
+	dartt_mem_t setpoint = {.buf = (unsigned char *)&ctl.setpoint[0], .size = sizeof(int32_t)};
+	dartt_linksim_begin_cycle(&sim);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_ctl_write(&setpoint, &ds));
+	cycle = dartt_linksim_end_cycle(&sim);
+	TEST_ASSERT_EQUAL(6*BYTE_NS + 500, cycle.duration_ns);
+	TEST_ASSERT_EQUAL(0, cycle.max_latency_ns);
+	TEST_ASSERT_EQUAL(5, periph_regs.setpoint[0]);
+
+	//no peripheral: the timeout passes in virtual time
+	ds.address = 4;
+	dartt_linksim_begin_cycle(&sim);
+	uint64_t start = sim.now_ns;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_TIMEOUT, dartt_ctl_read(&status, &ds));
+	cycle = dartt_linksim_end_cycle(&sim);
+	TEST_ASSERT_EQUAL(1, cycle.timeouts);
+	TEST_ASSERT_EQUAL(4*BYTE_NS + 2000000, cycle.duration_ns);
+	TEST_ASSERT_EQUAL(start + cycle.duration_ns, sim.now_ns);
+
+	TEST_ASSERT_EQUAL(4, sim.stats.cycles);
+	TEST_ASSERT_EQUAL(1, sim.stats.overruns);
+	TEST_ASSERT_EQUAL(expected, sim.stats.max_latency_ns);
+	TEST_ASSERT_EQUAL(10*BYTE_NS, sim.stats.max_busy_ns);
+	TEST_ASSERT_EQUAL(1, sim.stats.timeouts);
+}
+
+void test_linksim_cobs_and_duplex(void)
+{
+	static dartt_linksim_t sim;
+	static sim_regs_t periph_regs;
+	dartt_linksim_params_t params = uart_params;
+	params.cobs = 1;
+	params.turnaround_ns = 0;
+	params.propagation_ns = 0;
+	params.periph_fixed_ns = 0;
+	dartt_linksim_init(&sim, &params, TYPE_SERIAL_MESSAGE, 0);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_linksim_add(&sim, dartt_get_complementary_address(3), (dartt_mem_t){.buf = (unsigned char *)&periph_regs, .size = sizeof(periph_regs)}));
+
+	sim_regs_t ctl = {};
+	sim_regs_t shadow = {};
+	unsigned char tx_mem[64];
+	unsigned char rx_mem[64];
+	dartt_sync_t ds;
+	setup_sync(&ds, &sim, &ctl, &shadow, tx_mem, rx_mem, sizeof(tx_mem));
+
+	//[address][index][num_bytes][crc] = 7 bytes, 9 encoded with the delimiter. [address][index][data][crc] = 9, 11 encoded
+	dartt_mem_t status = {.buf = (unsigned char *)&ctl.status, .size = sizeof(int32_t)};
+	dartt_linksim_begin_cycle(&sim);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_ctl_read(&status, &ds));
+	dartt_linksim_cycle_t cycle = dartt_linksim_end_cycle(&sim);
+	TEST_ASSERT_EQUAL(20*BYTE_NS, cycle.busy_ns);
+	TEST_ASSERT_EQUAL(20, sim.stats.wire_bytes);
+
+	//on a full duplex link, back to back requests overlap with the replies
+	sim.params.full_duplex = 1;
+	sim.params.periph_fixed_ns = 100000;	//slower than a frame
+	dartt_linksim_begin_cycle(&sim);
+	uint64_t start = sim.now_ns;
+	dartt_buffer_t req = {.buf = tx_mem, .size = sizeof(tx_mem), .len = 0};
+	misc_read_message_t msg = {.address = dartt_get_complementary_address(3), .index = 0, .num_bytes = 4, .tag = DARTT_TAG_NONE};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_create_read_frame(&msg, TYPE_SERIAL_MESSAGE, &req));
+	for(int i = 0; i < 3; i++)
+	{
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_linksim_tx(msg.address, &req, &sim, 0));
+	}
+	dartt_buffer_t rx = {.buf = rx_mem, .size = sizeof(rx_mem), .len = 0};
+	for(int i = 0; i < 3; i++)
+	{
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_linksim_rx(&rx, &sim, 0));
+		TEST_ASSERT_EQUAL(9, rx.len);
+	}
+	TEST_ASSERT_EQUAL(DARTT_ERROR_TIMEOUT, dartt_linksim_rx(&rx, &sim, 0));
+	cycle = dartt_linksim_end_cycle(&sim);
+	//requests arrive every 90 us and are served in 100 us, but each reply takes 110 us: after the first request and
+	//its processing, the reply wire is the bottleneck
+	TEST_ASSERT_EQUAL(9*BYTE_NS + 100000 + 3*11*BYTE_NS, cycle.duration_ns);
+	TEST_ASSERT_EQUAL(33*BYTE_NS, cycle.busy_ns);
+	TEST_ASSERT_EQUAL(start + cycle.duration_ns, sim.now_ns);
+}
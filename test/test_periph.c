@@ -0,0 +1,645 @@
+#include "dartt_crc.h"
+#include "dartt.h"
+#include "dartt_sync.h"
+#include "dartt_periph.h"
+#include "unity.h"
+#include <string.h>
+
+//gain block used to model a multi-word parameter set that must never be observed half-applied
+typedef struct gains_t
+{
+	int32_t kp;
+	int32_t ki;
+	int32_t kd;
+	int32_t x;	//'sensor' word written by the application
+}gains_t;
+
+static gains_t live_mem = {};
+static gains_t staging_mem = {};
+static const dartt_word_range_t sensor_words[] = {{3, 4}};	//x
+
+static void init_staged_periph(dartt_periph_t * periph)
+{
+	memset(&live_mem, 0, sizeof(gains_t));
+	memset(&staging_mem, 0, sizeof(gains_t));
+	periph->mem_base.buf = (unsigned char *)&live_mem;
+	periph->mem_base.size = sizeof(gains_t);
+	periph->staging.buf = (unsigned char *)&staging_mem;
+	periph->staging.size = sizeof(gains_t);
+	periph->app_owned = sensor_words;
+	periph->num_app_owned = 1;
+	periph->commit_count = 0;
+}
+
+/*
+	Helper - build a frame with the controller API, strip it to the payload layer and hand it to the peripheral
+*/
+static int periph_write(dartt_periph_t * periph, uint16_t index, unsigned char * data, size_t len, serial_message_type_t type, dartt_buffer_t * reply)
+{
+	unsigned char frame_mem[64] = {};
+	dartt_buffer_t frame = {.buf = frame_mem, .size = sizeof(frame_mem), .len = 0};
+	misc_write_message_t msg = {
+		.address = 0xFE,
+		.index = index,
+		.payload = {.buf = data, .size = len, .len = len}
+	};
+	int rc = dartt_create_write_frame(&msg, type, &frame);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	payload_layer_msg_t pld = {};
+	rc = dartt_frame_to_payload(&frame, type, PAYLOAD_ALIAS, &pld);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	return dartt_periph_parse(periph, &pld, type, reply);
+}
+
+static int periph_read(dartt_periph_t * periph, uint16_t index, uint16_t num_bytes, serial_message_type_t type, dartt_buffer_t * reply)
+{
+	unsigned char frame_mem[64] = {};
+	dartt_buffer_t frame = {.buf = frame_mem, .size = sizeof(frame_mem), .len = 0};
+	misc_read_message_t msg = {.address = 0xFE, .index = index, .num_bytes = num_bytes};
+	int rc = dartt_create_read_frame(&msg, type, &frame);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	payload_layer_msg_t pld = {};
+	rc = dartt_frame_to_payload(&frame, type, PAYLOAD_ALIAS, &pld);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	return dartt_periph_parse(periph, &pld, type, reply);
+}
+
+/*
+	Staged writes must not be visible in the live block until commit, and must all appear at once on commit.
+*/
+void test_periph_staged_write_commit(void)
+{
+	dartt_periph_t periph = {};
+	init_staged_periph(&periph);
+	unsigned char reply_mem[32] = {};
+	dartt_buffer_t reply = {.buf = reply_mem, .size = sizeof(reply_mem), .len = 0};
+
+	gains_t new_gains = {.kp = 100, .ki = 20, .kd = 3};
+	int rc = periph_write(&periph, 0, (unsigned char *)&new_gains, 3*sizeof(int32_t), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(0, reply.len);
+
+	gains_t * live = (gains_t *)dartt_periph_live(&periph);
+	TEST_ASSERT_EQUAL_PTR(&live_mem, live);
+	TEST_ASSERT_EQUAL(0, live->kp);
+	TEST_ASSERT_EQUAL(0, live->ki);
+	TEST_ASSERT_EQUAL(0, live->kd);
+	TEST_ASSERT_EQUAL(100, staging_mem.kp);
+
+	//reads are serviced from the live block
+	rc = periph_read(&periph, 0, sizeof(int32_t), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(NUM_BYTES_ADDRESS + NUM_BYTES_INDEX + sizeof(int32_t) + NUM_BYTES_CHECKSUM, reply.len);
+	int32_t kp_read = 0;
+	memcpy(&kp_read, reply.buf + NUM_BYTES_ADDRESS + NUM_BYTES_INDEX, sizeof(int32_t));
+	TEST_ASSERT_EQUAL(0, kp_read);
+
+	//application updates a sensor word in the live block, then ends its iteration
+	live->x = 55;
+	dartt_periph_release(&periph);
+
+	//commit through the reserved index
+	unsigned char dummy = 0;
+	rc = periph_write(&periph, DARTT_INDEX_COMMIT, &dummy, sizeof(dummy), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(0, reply.len);
+	TEST_ASSERT_EQUAL(1, periph.commit_count);
+
+	live = (gains_t *)dartt_periph_live(&periph);
+	TEST_ASSERT_EQUAL_PTR(&staging_mem, live);	//pointers were swapped, not copied
+	TEST_ASSERT_EQUAL(100, live->kp);
+	TEST_ASSERT_EQUAL(20, live->ki);
+	TEST_ASSERT_EQUAL(3, live->kd);
+	TEST_ASSERT_EQUAL(55, live->x);	//carried over: app_owned
+	dartt_periph_release(&periph);
+
+	//staging must now mirror the committed block, so a later partial write does not revert the other gains
+	TEST_ASSERT_EQUAL_PTR(&live_mem, periph.staging.buf);
+	TEST_ASSERT_EQUAL(0, memcmp(periph.staging.buf, periph.mem_base.buf, sizeof(gains_t)));
+	int32_t new_ki = 21;
+	rc = periph_write(&periph, 1, (unsigned char *)&new_ki, sizeof(new_ki), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	rc = dartt_periph_commit(&periph);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	live = (gains_t *)dartt_periph_live(&periph);
+	TEST_ASSERT_EQUAL(100, live->kp);
+	TEST_ASSERT_EQUAL(21, live->ki);
+	TEST_ASSERT_EQUAL(3, live->kd);
+	TEST_ASSERT_EQUAL(55, live->x);
+	TEST_ASSERT_EQUAL(2, periph.commit_count);
+}
+
+/*
+	Commits copy only the written ranges into the next staging block, and carry the fields the application owns into
+	the new live block, across any number of commits
+*/
+void test_periph_commit_written_ranges(void)
+{
+	dartt_periph_t periph = {};
+	init_staged_periph(&periph);
+	unsigned char reply_mem[32] = {};
+	dartt_buffer_t reply = {.buf = reply_mem, .size = sizeof(reply_mem), .len = 0};
+
+	//adjacent writes merge into one range, separate ones are kept apart
+	int32_t kp = 10;
+	int32_t ki = 11;
+	int32_t kd = 12;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, periph_write(&periph, 0, (unsigned char *)&kp, sizeof(kp), TYPE_SERIAL_MESSAGE, &reply));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, periph_write(&periph, 2, (unsigned char *)&kd, sizeof(kd), TYPE_SERIAL_MESSAGE, &reply));
+	TEST_ASSERT_EQUAL(2, periph.staged.num);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, periph_write(&periph, 1, (unsigned char *)&ki, sizeof(ki), TYPE_SERIAL_MESSAGE, &reply));
+	TEST_ASSERT_EQUAL(1, periph.staged.num);
+	TEST_ASSERT_EQUAL(0, periph.staged.start[0]);
+	TEST_ASSERT_EQUAL(3*sizeof(int32_t), periph.staged.end[0]);
+
+	//the sensor word written by the application in the live block is carried into the new one
+	gains_t * live = (gains_t *)dartt_periph_live(&periph);
+	live->x = 1234;
+	dartt_periph_release(&periph);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_periph_commit(&periph));
+	TEST_ASSERT_EQUAL(0, periph.staged.num);
+	live = (gains_t *)dartt_periph_live(&periph);
+	TEST_ASSERT_EQUAL(10, live->kp);
+	TEST_ASSERT_EQUAL(11, live->ki);
+	TEST_ASSERT_EQUAL(12, live->kd);
+	TEST_ASSERT_EQUAL(1234, live->x);
+
+	//the application owns x: it survives every commit, whatever the controller writes
+	for(int i = 0; i < 5; i++)
+	{
+		live->x = 2000 + i;
+		dartt_periph_release(&periph);
+		kp = 20 + i;
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, periph_write(&periph, 0, (unsigned char *)&kp, sizeof(kp), TYPE_SERIAL_MESSAGE, &reply));
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_periph_commit(&periph));
+		live = (gains_t *)dartt_periph_live(&periph);
+		TEST_ASSERT_EQUAL(20 + i, live->kp);
+		TEST_ASSERT_EQUAL(11, live->ki);
+		TEST_ASSERT_EQUAL(12, live->kd);
+		TEST_ASSERT_EQUAL(2000 + i, live->x);
+	}
+	TEST_ASSERT_EQUAL(6, periph.commit_count);
+}
+
+/*
+	Without a spare block, a commit arriving while the control loop holds the live block waits for the loop to
+	release it, and is applied before the next message is handled
+*/
+void test_periph_commit_deferred(void)
+{
+	dartt_periph_t periph = {};
+	init_staged_periph(&periph);
+	unsigned char reply_mem[32] = {};
+	dartt_buffer_t reply = {.buf = reply_mem, .size = sizeof(reply_mem), .len = 0};
+
+	gains_t * loop = (gains_t *)dartt_periph_live(&periph);
+	int32_t kp = 300;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, periph_write(&periph, 0, (unsigned char *)&kp, sizeof(kp), TYPE_SERIAL_MESSAGE, &reply));
+	unsigned char dummy = 0;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, periph_write(&periph, DARTT_INDEX_COMMIT, &dummy, sizeof(dummy), TYPE_SERIAL_MESSAGE, &reply));
+	TEST_ASSERT_EQUAL(1, periph.commit_pending);
+	TEST_ASSERT_EQUAL(0, periph.commit_count);
+	TEST_ASSERT_EQUAL_PTR(loop, periph.mem_base.buf);
+	TEST_ASSERT_EQUAL(0, loop->kp);
+
+	//still held: a message does not apply it either
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, periph_read(&periph, 0, sizeof(int32_t), TYPE_SERIAL_MESSAGE, &reply));
+	TEST_ASSERT_EQUAL(1, periph.commit_pending);
+	TEST_ASSERT_EQUAL(0, loop->kp);
+
+	//released: the next message applies it first, so its read sees the committed value
+	dartt_periph_release(&periph);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, periph_read(&periph, 0, sizeof(int32_t), TYPE_SERIAL_MESSAGE, &reply));
+	TEST_ASSERT_EQUAL(0, periph.commit_pending);
+	TEST_ASSERT_EQUAL(1, periph.commit_count);
+	int32_t kp_read = 0;
+	memcpy(&kp_read, reply.buf + NUM_BYTES_ADDRESS + NUM_BYTES_INDEX, sizeof(int32_t));
+	TEST_ASSERT_EQUAL(300, kp_read);
+	TEST_ASSERT_EQUAL(300, loop->kp);	//the block the loop used is now staging, refreshed with the commit
+	TEST_ASSERT_EQUAL_PTR(loop, periph.staging.buf);
+}
+
+/*
+	Commits from a context preempting the control loop, e.g. a receive interrupt. With a spare block, neither the
+	refresh nor the writes staged after the commit may touch the block the running iteration holds
+*/
+void test_periph_commit_preempts_loop(void)
+{
+	static gains_t spare_mem = {};
+	dartt_periph_t periph = {};
+	init_staged_periph(&periph);
+	memset(&spare_mem, 0, sizeof(gains_t));
+	periph.spare.buf = (unsigned char *)&spare_mem;
+	periph.spare.size = sizeof(gains_t);
+	unsigned char reply_mem[32] = {};
+	dartt_buffer_t reply = {.buf = reply_mem, .size = sizeof(reply_mem), .len = 0};
+
+	//iteration starts, and computes from its block
+	gains_t * loop = (gains_t *)dartt_periph_live(&periph);
+	TEST_ASSERT_EQUAL_PTR(&live_mem, loop);
+	loop->x = 55;
+
+	//two commits land during the iteration
+	for(int32_t kp = 100; kp <= 101; kp++)
+	{
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, periph_write(&periph, 0, (unsigned char *)&kp, sizeof(kp), TYPE_SERIAL_MESSAGE, &reply));
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_periph_commit(&periph));
+		TEST_ASSERT_TRUE(periph.staging.buf != (unsigned char *)loop);
+		TEST_ASSERT_EQUAL(0, memcmp(periph.staging.buf, periph.mem_base.buf, 3*sizeof(int32_t)));	//the gains
+		TEST_ASSERT_EQUAL(55, ((gains_t *)periph.mem_base.buf)->x);
+	}
+	TEST_ASSERT_EQUAL(0, loop->kp);
+	TEST_ASSERT_EQUAL(55, loop->x);
+	TEST_ASSERT_EQUAL(101, ((gains_t *)periph.mem_base.buf)->kp);
+
+	//next iteration picks up the last commit, and the block it left is reused for staging again
+	loop = (gains_t *)dartt_periph_live(&periph);
+	TEST_ASSERT_EQUAL(101, loop->kp);
+	int32_t kp = 102;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, periph_write(&periph, 0, (unsigned char *)&kp, sizeof(kp), TYPE_SERIAL_MESSAGE, &reply));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_periph_commit(&periph));
+	TEST_ASSERT_EQUAL(101, loop->kp);
+	TEST_ASSERT_TRUE(periph.staging.buf != (unsigned char *)loop);
+	TEST_ASSERT_EQUAL_PTR(loop, periph.spare.buf);
+	TEST_ASSERT_EQUAL(102, ((gains_t *)dartt_periph_live(&periph))->kp);
+	TEST_ASSERT_EQUAL(3, periph.commit_count);
+
+	//spare size mismatch
+	periph.spare.size = sizeof(gains_t) - sizeof(int32_t);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_periph_commit(&periph));
+}
+
+/*
+	Without a staging block, writes are applied directly and commit is a no-op
+*/
+void test_periph_no_staging(void)
+{
+	dartt_periph_t periph = {};
+	init_staged_periph(&periph);
+	periph.staging.buf = NULL;
+	periph.staging.size = 0;
+	unsigned char reply_mem[32] = {};
+	dartt_buffer_t reply = {.buf = reply_mem, .size = sizeof(reply_mem), .len = 0};
+
+	int32_t kd = 9;
+	serial_message_type_t types[] = {TYPE_SERIAL_MESSAGE, TYPE_ADDR_MESSAGE, TYPE_ADDR_CRC_MESSAGE};
+	for(int t = 0; t < 3; t++)
+	{
+		kd++;
+		int rc = periph_write(&periph, 2, (unsigned char *)&kd, sizeof(kd), types[t], &reply);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+		TEST_ASSERT_EQUAL(kd, live_mem.kd);
+	}
+	unsigned char dummy = 0;
+	int rc = periph_write(&periph, DARTT_INDEX_COMMIT, &dummy, sizeof(dummy), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL_PTR(&live_mem, periph.mem_base.buf);
+	TEST_ASSERT_EQUAL(0, periph.commit_count);
+}
+
+/*
+	Bad configurations and out of range staged writes
+*/
+void test_periph_bad_inputs(void)
+{
+	dartt_periph_t periph = {};
+	init_staged_periph(&periph);
+	unsigned char reply_mem[32] = {};
+	dartt_buffer_t reply = {.buf = reply_mem, .size = sizeof(reply_mem), .len = 0};
+
+	//staging size mismatch
+	periph.staging.size = sizeof(gains_t) - sizeof(int32_t);
+	int32_t val = 1;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, periph_write(&periph, 0, (unsigned char *)&val, sizeof(val), TYPE_SERIAL_MESSAGE, &reply));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_periph_commit(&periph));
+
+	//staged write past the end of the block
+	init_staged_periph(&periph);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, periph_write(&periph, 4, (unsigned char *)&val, sizeof(val), TYPE_SERIAL_MESSAGE, &reply));
+
+	//uninitialized live block
+	periph.mem_base.buf = NULL;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, dartt_periph_commit(&periph));
+}
+
+/*
+	Controller side - dartt_ctl_commit must produce a write frame to the reserved commit index, with no base offset applied
+*/
+static dartt_buffer_t * p_commit_tx;
+static int commit_tx_count = 0;
+static int commit_tx_callback(unsigned char addr, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	p_commit_tx = tx;
+	commit_tx_count++;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+void test_ctl_commit(void)
+{
+	unsigned char tx_mem[16] = {};
+	dartt_sync_t sync = {};
+	sync.address = 3;
+	sync.base_offset = 10;
+	sync.tx_buf.buf = tx_mem;
+	sync.tx_buf.size = sizeof(tx_mem);
+	sync.blocking_tx_callback = &commit_tx_callback;
+
+	serial_message_type_t types[] = {TYPE_SERIAL_MESSAGE, TYPE_ADDR_MESSAGE, TYPE_ADDR_CRC_MESSAGE};
+	for(int t = 0; t < 3; t++)
+	{
+		sync.msg_type = types[t];
+		commit_tx_count = 0;
+		int rc = dartt_ctl_commit(&sync);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+		TEST_ASSERT_EQUAL(1, commit_tx_count);
+
+		payload_layer_msg_t pld = {};
+		rc = dartt_frame_to_payload(p_commit_tx, sync.msg_type, PAYLOAD_ALIAS, &pld);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+		TEST_ASSERT_EQUAL(0, pld.rw_bit);
+		TEST_ASSERT_EQUAL(DARTT_INDEX_COMMIT, pld.index_arg);
+
+		//and the peripheral must accept it
+		dartt_periph_t periph = {};
+		init_staged_periph(&periph);
+		staging_mem.kp = 77;
+		unsigned char reply_mem[32] = {};
+		dartt_buffer_t reply = {.buf = reply_mem, .size = sizeof(reply_mem), .len = 0};
+		rc = dartt_periph_parse(&periph, &pld, sync.msg_type, &reply);
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+		TEST_ASSERT_EQUAL(77, ((gains_t *)dartt_periph_live(&periph))->kp);
+	}
+}
+
+/*
+	Write notification hooks - only regions touched by a write are notified, with the touched range clipped to the region
+*/
+typedef struct hook_record_t
+{
+	int count;
+	unsigned char * field;
+	uint32_t index;
+	size_t nbytes;
+}hook_record_t;
+
+static void record_hook(unsigned char * field, uint32_t index, size_t nbytes, void * user_context)
+{
+	hook_record_t * rec = (hook_record_t *)user_context;
+	rec->count++;
+	rec->field = field;
+	rec->index = index;
+	rec->nbytes = nbytes;
+}
+
+void test_periph_write_hooks(void)
+{
+	uint32_t mem_words[16] = {};
+	dartt_periph_t periph = {};
+	periph.mem_base.buf = (unsigned char *)mem_words;
+	periph.mem_base.size = sizeof(mem_words);
+
+	hook_record_t rec[3] = {};
+	dartt_write_hook_t hooks[] = {
+		{.start = 1, .end = 4, .callback = &record_hook, .user_context = &rec[0]},	//words 1-3
+		{.start = 4, .end = 5, .callback = &record_hook, .user_context = &rec[1]},	//word 4
+		{.start = 10, .end = 16, .callback = &record_hook, .user_context = &rec[2]},	//words 10-15
+	};
+	periph.hooks = hooks;
+	periph.num_hooks = sizeof(hooks)/sizeof(dartt_write_hook_t);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_periph_check_hooks(periph.hooks, periph.num_hooks));
+
+	unsigned char reply_mem[32] = {};
+	dartt_buffer_t reply = {.buf = reply_mem, .size = sizeof(reply_mem), .len = 0};
+	uint32_t data[4] = {1, 2, 3, 4};
+
+	//write to word 0 only - no region touched
+	int rc = periph_write(&periph, 0, (unsigned char *)data, sizeof(uint32_t), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(0, rec[0].count + rec[1].count + rec[2].count);
+
+	//write words 3-5: tail of region 0 and all of region 1
+	rc = periph_write(&periph, 3, (unsigned char *)data, 3*sizeof(uint32_t), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(1, rec[0].count);
+	TEST_ASSERT_EQUAL(3, rec[0].index);
+	TEST_ASSERT_EQUAL(sizeof(uint32_t), rec[0].nbytes);
+	TEST_ASSERT_EQUAL_PTR(&mem_words[3], rec[0].field);
+	TEST_ASSERT_EQUAL(1, rec[1].count);
+	TEST_ASSERT_EQUAL(4, rec[1].index);
+	TEST_ASSERT_EQUAL(sizeof(uint32_t), rec[1].nbytes);
+	TEST_ASSERT_EQUAL(0, rec[2].count);
+
+	//partial word write inside region 2
+	rc = periph_write(&periph, 12, (unsigned char *)data, 2, TYPE_ADDR_CRC_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(1, rec[2].count);
+	TEST_ASSERT_EQUAL(12, rec[2].index);
+	TEST_ASSERT_EQUAL(2, rec[2].nbytes);
+
+	//reads and failed writes never notify
+	rc = periph_read(&periph, 1, 4*sizeof(uint32_t), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	rc = periph_write(&periph, 15, (unsigned char *)data, 2*sizeof(uint32_t), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, rc);
+	TEST_ASSERT_EQUAL(1, rec[0].count);
+	TEST_ASSERT_EQUAL(1, rec[1].count);
+	TEST_ASSERT_EQUAL(1, rec[2].count);
+
+	//with staging, the hook points into the staging block
+	uint32_t staging_words[16] = {};
+	periph.staging.buf = (unsigned char *)staging_words;
+	periph.staging.size = sizeof(staging_words);
+	rc = periph_write(&periph, 2, (unsigned char *)data, sizeof(uint32_t), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(2, rec[0].count);
+	TEST_ASSERT_EQUAL_PTR(&staging_words[2], rec[0].field);
+}
+
+void test_periph_check_hooks(void)
+{
+	hook_record_t rec = {};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_periph_check_hooks(NULL, 0));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, dartt_periph_check_hooks(NULL, 1));
+	{
+		dartt_write_hook_t hooks[] = {{.start = 2, .end = 2, .callback = &record_hook, .user_context = &rec}};	//empty region
+		TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, dartt_periph_check_hooks(hooks, 1));
+	}
+	{
+		dartt_write_hook_t hooks[] = {{.start = 0, .end = 2, .callback = NULL}};	//no callback
+		TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, dartt_periph_check_hooks(hooks, 1));
+	}
+	{
+		dartt_write_hook_t hooks[] = {
+			{.start = 0, .end = 3, .callback = &record_hook},
+			{.start = 2, .end = 5, .callback = &record_hook},	//overlap
+		};
+		TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, dartt_periph_check_hooks(hooks, 2));
+	}
+	{
+		dartt_write_hook_t hooks[] = {
+			{.start = 5, .end = 6, .callback = &record_hook},
+			{.start = 0, .end = 2, .callback = &record_hook},	//unsorted
+		};
+		TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, dartt_periph_check_hooks(hooks, 2));
+	}
+}
+
+/*
+	Access control - denied requests are rejected whole, with no memory change and no hook call
+*/
+void test_periph_access_map(void)
+{
+	uint32_t words[40] = {};
+	uint32_t access_map[DARTT_ACCESS_MAP_LEN(sizeof(words))] = {};
+	TEST_ASSERT_EQUAL(3, sizeof(access_map)/sizeof(uint32_t));
+	access_map[0] = (DARTT_ACCESS_RO << (2*1)) | (DARTT_ACCESS_WO << (2*2)) | (DARTT_ACCESS_NA << (2*3));	//word 1 RO, word 2 WO, word 3 NA
+	access_map[1] = (DARTT_ACCESS_RO << (2*0));	//word 16 RO
+
+	hook_record_t rec = {};
+	dartt_write_hook_t hooks[] = {{.start = 0, .end = 40, .callback = &record_hook, .user_context = &rec}};
+	dartt_periph_t periph = {
+		.mem_base = {.buf = (unsigned char *)words, .size = sizeof(words)},
+		.hooks = hooks,
+		.num_hooks = 1,
+		.access_map = access_map,
+		.access_map_len = sizeof(access_map)/sizeof(uint32_t)
+	};
+	unsigned char reply_mem[64] = {};
+	dartt_buffer_t reply = {.buf = reply_mem, .size = sizeof(reply_mem), .len = 0};
+	uint32_t data[4] = {11, 22, 33, 44};
+
+	//rw word
+	int rc = periph_write(&periph, 0, (unsigned char *)data, sizeof(uint32_t), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(11, words[0]);
+	TEST_ASSERT_EQUAL(1, rec.count);
+
+	//write to RO word
+	rc = periph_write(&periph, 1, (unsigned char *)data, sizeof(uint32_t), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_ACCESS_DENIED, rc);
+	TEST_ASSERT_EQUAL(0, words[1]);
+	TEST_ASSERT_EQUAL(0, reply.len);
+	TEST_ASSERT_EQUAL(1, rec.count);
+
+	//write spanning RW into RO is rejected whole
+	rc = periph_write(&periph, 0, (unsigned char *)data, 2*sizeof(uint32_t), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_ACCESS_DENIED, rc);
+	TEST_ASSERT_EQUAL(0, words[1]);
+
+	//a partial word still counts as the whole word
+	rc = periph_write(&periph, 0, (unsigned char *)data, sizeof(uint32_t) + 1, TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_ACCESS_DENIED, rc);
+
+	//WO word can be written but not read
+	rc = periph_write(&periph, 2, (unsigned char *)data, sizeof(uint32_t), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(11, words[2]);
+	rc = periph_read(&periph, 2, sizeof(uint32_t), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_ACCESS_DENIED, rc);
+	TEST_ASSERT_EQUAL(NUM_BYTES_ADDRESS + NUM_BYTES_ERROR_REPLY_PLD + NUM_BYTES_CHECKSUM, reply.len);	//denied reads are answered with an error reply
+
+	//RO word can be read
+	rc = periph_read(&periph, 0, 2*sizeof(uint32_t), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(NUM_BYTES_ADDRESS + NUM_BYTES_INDEX + 2*sizeof(uint32_t) + NUM_BYTES_CHECKSUM, reply.len);
+
+	//NA word denies both
+	rc = periph_read(&periph, 3, sizeof(uint32_t), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_ACCESS_DENIED, rc);
+	rc = periph_write(&periph, 3, (unsigned char *)data, sizeof(uint32_t), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_ACCESS_DENIED, rc);
+	TEST_ASSERT_EQUAL(0, words[3]);
+
+	//requests spanning map entries
+	rc = periph_write(&periph, 12, (unsigned char *)data, 4*sizeof(uint32_t), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);	//words 12..15
+	rc = periph_write(&periph, 13, (unsigned char *)data, 4*sizeof(uint32_t), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_ACCESS_DENIED, rc);	//words 13..16, 16 is RO
+	rc = periph_read(&periph, 13, 4*sizeof(uint32_t), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+
+	//map too short for the request
+	periph.access_map_len = 1;
+	rc = periph_read(&periph, 20, sizeof(uint32_t), TYPE_SERIAL_MESSAGE, &reply);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, rc);
+}
+
+static int periph_crc32(dartt_periph_t * periph, uint32_t word, uint32_t num_bytes, uint32_t * crc)
+{
+	unsigned char frame_mem[64] = {};
+	dartt_buffer_t frame = {.buf = frame_mem, .size = sizeof(frame_mem), .len = 0};
+	unsigned char reply_mem[64] = {};
+	dartt_buffer_t reply = {.buf = reply_mem, .size = sizeof(reply_mem), .len = 0};
+	misc_crc32_query_t query = {.address = 0xFE, .word = word, .num_bytes = num_bytes, .tag = DARTT_TAG_NONE};
+	int rc = dartt_create_crc32_query(&query, TYPE_ADDR_CRC_MESSAGE, &frame);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	payload_layer_msg_t pld = {};
+	dartt_frame_to_payload(&frame, TYPE_ADDR_CRC_MESSAGE, PAYLOAD_ALIAS, &pld);
+	dartt_periph_parse(periph, &pld, TYPE_ADDR_CRC_MESSAGE, &reply);
+	if(reply.len == 0)
+	{
+		return DARTT_ERROR_TIMEOUT;
+	}
+	payload_layer_msg_t reply_pld = {};
+	dartt_frame_to_payload(&reply, TYPE_ADDR_CRC_MESSAGE, PAYLOAD_ALIAS, &reply_pld);
+	return dartt_parse_crc32_reply(&reply_pld, crc);
+}
+
+/*
+	CRC32 queries cover the block writes land in, and are checked against the access map like reads
+*/
+void test_periph_crc32_query(void)
+{
+	dartt_periph_t periph = {};
+	init_staged_periph(&periph);
+	unsigned char reply_mem[64] = {};
+	dartt_buffer_t reply = {.buf = reply_mem, .size = sizeof(reply_mem), .len = 0};
+	int32_t gains[3] = {100, 20, 3};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, periph_write(&periph, 0, (unsigned char *)gains, sizeof(gains), TYPE_ADDR_CRC_MESSAGE, &reply));
+
+	//staged writes are verified before the commit
+	uint32_t crc = 0;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, periph_crc32(&periph, 0, sizeof(gains), &crc));
+	TEST_ASSERT_EQUAL_HEX32(dartt_crc32((unsigned char *)gains, sizeof(gains)), crc);
+	TEST_ASSERT_EQUAL(0, live_mem.kp);
+
+	periph.staging.buf = NULL;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, periph_crc32(&periph, 0, sizeof(gains), &crc));
+	TEST_ASSERT_EQUAL_HEX32(dartt_crc32((unsigned char *)&live_mem, sizeof(gains)), crc);
+
+	//read denied words cannot be checked
+	uint32_t access_map[DARTT_ACCESS_MAP_LEN(sizeof(gains_t))] = {DARTT_ACCESS_WO << (2*3)};
+	periph.access_map = access_map;
+	periph.access_map_len = sizeof(access_map)/sizeof(uint32_t);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, periph_crc32(&periph, 0, 3*sizeof(int32_t), &crc));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_ACCESS_DENIED, periph_crc32(&periph, 1, 3*sizeof(int32_t), &crc));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, periph_crc32(&periph, 100, sizeof(int32_t), &crc));
+}
+
+void test_access_check(void)
+{
+	uint32_t map[2] = {0, 0};
+	TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, dartt_access_check(NULL, 0, 0, 4, READ_MESSAGE));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_access_check(map, 2, 0, 128, WRITE_MESSAGE));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_access_check(map, 2, 0, 129, WRITE_MESSAGE));
+	map[1] = (uint32_t)DARTT_ACCESS_NA << (2*15);	//last word
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_access_check(map, 2, 0, 124, WRITE_MESSAGE));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_ACCESS_DENIED, dartt_access_check(map, 2, 31, 4, WRITE_MESSAGE));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_ACCESS_DENIED, dartt_access_check(map, 2, 2, 120, READ_MESSAGE));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_access_check(map, 2, 31, 0, READ_MESSAGE));
+}
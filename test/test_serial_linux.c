@@ -0,0 +1,188 @@
+#define _GNU_SOURCE
+#include "dartt.h"
+#include "dartt_sync.h"
+#include "dartt_periph.h"
+#include "dartt_cobs.h"
+#include "dartt_serial_linux.h"
+#include "sim_periph.h"
+#include "unity.h"
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h>
+
+/*
+	The controller runs dartt_sync_t over the slave side of a pty pair, exactly as it would over /dev/ttyUSB0.
+	A simulated peripheral serves the master side from a thread, through the same transport.
+*/
+
+static int master_fd = -1;
+static int slave_fd = -1;
+
+static int open_pty_pair(void)
+{
+	master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if(master_fd < 0)
+	{
+		return -1;
+	}
+	if(grantpt(master_fd) != 0 || unlockpt(master_fd) != 0)
+	{
+		close(master_fd);
+		return -1;
+	}
+	slave_fd = open(ptsname(master_fd), O_RDWR | O_NOCTTY);
+	if(slave_fd < 0)
+	{
+		close(master_fd);
+		return -1;
+	}
+	return 0;
+}
+
+void setUp(void)
+{
+	master_fd = -1;
+	slave_fd = -1;
+}
+
+void tearDown(void)
+{
+	if(slave_fd >= 0)
+	{
+		close(slave_fd);
+	}
+	if(master_fd >= 0)
+	{
+		close(master_fd);
+	}
+}
+
+void test_serial_linux_pty_sync(void)
+{
+	if(open_pty_pair() != 0)
+	{
+		TEST_IGNORE_MESSAGE("no pty support");
+	}
+	static dartt_serial_linux_t ctl_port;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_serial_linux_attach(&ctl_port, slave_fd, 3000000));
+
+	//non-standard rates are set through BOTHER
+	struct termios2 tio;
+	TEST_ASSERT_EQUAL(0, ioctl(slave_fd, TCGETS2, &tio));
+	TEST_ASSERT_EQUAL(BOTHER, tio.c_cflag & CBAUD);
+	TEST_ASSERT_EQUAL(3000000, tio.c_ospeed);
+	TEST_ASSERT_EQUAL(0, tio.c_lflag & ICANON);
+
+	static dartt_serial_linux_t sim_port;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_serial_linux_attach(&sim_port, master_fd, 0));
+	static sim_periph_t sim;
+	sim_link_t sim_link = {TYPE_SERIAL_MESSAGE, &dartt_serial_linux_tx, &dartt_serial_linux_rx, &sim_port, 0};
+	sim_periph_init(&sim, &sim_link);
+	TEST_ASSERT_EQUAL(0, sim_periph_start(&sim));
+
+	sim_regs_t ctl = {};
+	sim_regs_t shadow = {};
+	unsigned char tx_mem[64];
+	unsigned char rx_mem[64];
+	dartt_sync_t ds;
+	sim_link_t ctl_link = {TYPE_SERIAL_MESSAGE, &dartt_serial_linux_tx, &dartt_serial_linux_rx, &ctl_port, 0};
+	sim_sync_init(&ds, &ctl_link, &ctl, &shadow, sizeof(ctl), tx_mem, rx_mem, sizeof(tx_mem));
+	dartt_mem_t ctl_alias = {.buf = (unsigned char *)&ctl, .size = sizeof(ctl)};
+
+	//values with embedded zero bytes exercise the COBS stuffing
+	ctl.setpoint[0] = 0x00110022;
+	ctl.setpoint[5] = -1;
+	ctl.gain[2] = 0x01000000;
+	ctl.flags = 0x80000000;
+	int rc = dartt_sync(&ctl_alias, &ds);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(0, memcmp(&ctl, &shadow, sizeof(ctl)));
+
+	//peripheral side update, read back in full
+	sim.regs.status = 0x12003400;
+	rc = dartt_read_multi(&ctl_alias, &ds);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(0x12003400, shadow.status);
+	TEST_ASSERT_EQUAL(0x00110022, shadow.setpoint[0]);
+	TEST_ASSERT_EQUAL(-1, shadow.setpoint[5]);
+
+	//pipelined reads share the stream. Replies are split at their delimiters
+	dartt_mem_t head = {.buf = (unsigned char *)ctl.setpoint, .size = 12*sizeof(int32_t)};
+	uint8_t tags[3];
+	for(int i = 0; i < 3; i++)
+	{
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_read_post(&head, &ds, &tags[i]));
+	}
+	for(int i = 0; i < 3; i++)
+	{
+		uint8_t tag = 0;
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_read_poll(&ds, &tag));
+		TEST_ASSERT_EQUAL(tags[i], tag);
+	}
+
+	//frames built in the transmit buffer of the port are encoded in place
+	ds.tx_buf = dartt_serial_linux_tx_buffer(&ctl_port);
+	TEST_ASSERT_EQUAL(DARTT_SERIAL_LINUX_MAX_FRAME, ds.tx_buf.size);
+	ctl.gain[0] = 0x00AB0000;
+	ctl.setpoint[3] = 0x7F;
+	rc = dartt_sync(&ctl_alias, &ds);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(0x00AB0000, sim.regs.gain[0]);
+	TEST_ASSERT_EQUAL(0, memcmp(&ctl, &shadow, sizeof(ctl)));
+
+	sim_periph_stop(&sim);
+	TEST_ASSERT_GREATER_THAN(3, sim.frames);
+	dartt_serial_linux_close(&sim_port);
+	dartt_serial_linux_close(&ctl_port);
+}
+
+void test_serial_linux_timeout_and_resync(void)
+{
+	if(open_pty_pair() != 0)
+	{
+		TEST_IGNORE_MESSAGE("no pty support");
+	}
+	static dartt_serial_linux_t port;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_serial_linux_attach(&port, slave_fd, 115200));
+	unsigned char rx_mem[64];
+	dartt_buffer_t rx = {.buf = rx_mem, .size = sizeof(rx_mem), .len = 0};
+
+	//nothing on the line
+	TEST_ASSERT_EQUAL(DARTT_ERROR_TIMEOUT, dartt_serial_linux_rx(&rx, &port, 5));
+
+	//a partial frame is held until its delimiter arrives
+	unsigned char part1[] = {0x00, 0x03, 0x11};
+	unsigned char part2[] = {0x22, 0x02, 0x33, 0x00};
+	TEST_ASSERT_EQUAL(sizeof(part1), write(master_fd, part1, sizeof(part1)));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_TIMEOUT, dartt_serial_linux_rx(&rx, &port, 5));
+	TEST_ASSERT_EQUAL(sizeof(part2), write(master_fd, part2, sizeof(part2)));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_serial_linux_rx(&rx, &port, 100));
+	unsigned char expected[] = {0x11, 0x22, 0x00, 0x33};
+	TEST_ASSERT_EQUAL(sizeof(expected), rx.len);
+	TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, rx.buf, sizeof(expected));
+
+	//line noise is reported once, and the next frame is received intact
+	unsigned char noise[] = {0x07, 0x55, 0x00, 0x02, 0x44, 0x00};
+	TEST_ASSERT_EQUAL(sizeof(noise), write(master_fd, noise, sizeof(noise)));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MALFORMED_MESSAGE, dartt_serial_linux_rx(&rx, &port, 100));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_serial_linux_rx(&rx, &port, 100));
+	TEST_ASSERT_EQUAL(1, rx.len);
+	TEST_ASSERT_EQUAL(0x44, rx.buf[0]);
+
+	//an overlong frame is dropped up to its delimiter
+	unsigned char junk[sizeof(port.rx_mem) + 16];
+	memset(junk, 0x01, sizeof(junk));
+	junk[sizeof(junk) - 1] = 0x00;
+	TEST_ASSERT_EQUAL(sizeof(junk), write(master_fd, junk, sizeof(junk)));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MALFORMED_MESSAGE, dartt_serial_linux_rx(&rx, &port, 100));
+	unsigned char frame[] = {0x02, 0x44, 0x00};
+	TEST_ASSERT_EQUAL(sizeof(frame), write(master_fd, frame, sizeof(frame)));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_serial_linux_rx(&rx, &port, 100));
+	TEST_ASSERT_EQUAL(1, rx.len);
+	TEST_ASSERT_EQUAL(0x44, rx.buf[0]);
+
+	dartt_serial_linux_close(&port);
+}
@@ -0,0 +1,211 @@
+#define _GNU_SOURCE
+#include "dartt.h"
+#include "dartt_sync.h"
+#include "dartt_shm_linux.h"
+#include "sim_periph.h"
+#include "unity.h"
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+/*
+	The controller runs dartt_sync_t through a shared memory link against a peripheral served with
+	dartt_shm_linux_serve, either on the same thread through the pump callback or in a forked process.
+*/
+
+#define SIM_STOP	0xDEAD
+
+/*
+	Pump callback: answer one request if there is one, without waiting
+*/
+static int sim_pump(void * context)
+{
+	sim_periph_t * sim = (sim_periph_t *)context;
+	if(dartt_shm_linux_serve(sim->link.context, &sim->periph.mem_base, sim->link.type, 0) == DARTT_ERROR_TIMEOUT)
+	{
+		return 0;
+	}
+	sim->frames++;
+	return 1;
+}
+
+static void setup_sync(dartt_sync_t * ds, sim_regs_t * ctl, sim_regs_t * shadow, dartt_shm_linux_t * link, unsigned char * tx_mem, unsigned char * rx_mem, size_t buf_size)
+{
+	sim_link_t ctl_link = {TYPE_ADDR_CRC_MESSAGE, &dartt_shm_linux_tx, &dartt_shm_linux_rx, link, 0};
+	sim_sync_init(ds, &ctl_link, ctl, shadow, sizeof(sim_regs_t), tx_mem, rx_mem, buf_size);
+}
+
+void test_shm_linux_ring(void)
+{
+	static dartt_shm_linux_t ctl;
+	static dartt_shm_linux_t periph;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_shm_linux_create(&ctl));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_shm_linux_attach(&periph, ctl.fd, 1));
+
+	//frames arrive in order, and a full ring times out
+	unsigned char frame_mem[DARTT_SHM_LINUX_MAX_FRAME + 1];
+	for(int i = 0; i < DARTT_SHM_LINUX_SLOTS; i++)
+	{
+		memset(frame_mem, i, sizeof(frame_mem));
+		dartt_buffer_t frame = {.buf = frame_mem, .size = sizeof(frame_mem), .len = (size_t)(i + 1)};
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_shm_linux_tx(0, &frame, &ctl, 0));
+	}
+	dartt_buffer_t frame = {.buf = frame_mem, .size = sizeof(frame_mem), .len = 1};
+	TEST_ASSERT_EQUAL(DARTT_ERROR_TIMEOUT, dartt_shm_linux_tx(0, &frame, &ctl, 2));
+	unsigned char rx_mem[16];
+	dartt_buffer_t rx = {.buf = rx_mem, .size = 8, .len = 0};
+	for(int i = 0; i < 8; i++)
+	{
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_shm_linux_rx(&rx, &periph, 0));
+		TEST_ASSERT_EQUAL(i + 1, rx.len);
+		TEST_ASSERT_EQUAL(i, rx.buf[i]);
+	}
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_shm_linux_rx(&rx, &periph, 0));	//9 bytes, consumed anyway
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_shm_linux_rx(&rx, &periph, 0));
+	rx.size = sizeof(rx_mem);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_shm_linux_rx(&rx, &periph, 0));
+	TEST_ASSERT_EQUAL(11, rx.len);
+
+	//the directions are independent
+	TEST_ASSERT_EQUAL(DARTT_ERROR_TIMEOUT, dartt_shm_linux_rx(&rx, &ctl, 5));
+	frame.len = 3;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_shm_linux_tx(0, &frame, &periph, 0));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_shm_linux_rx(&rx, &ctl, 0));
+	TEST_ASSERT_EQUAL(3, rx.len);
+
+	frame.len = DARTT_SHM_LINUX_MAX_FRAME + 1;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_shm_linux_tx(0, &frame, &ctl, 0));
+
+	//only links made by dartt_shm_linux_create can be attached
+	int other = memfd_create("other", MFD_CLOEXEC);
+	TEST_ASSERT_GREATER_OR_EQUAL(0, other);
+	static dartt_shm_linux_t bad;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, dartt_shm_linux_attach(&bad, other, 1));
+	TEST_ASSERT_EQUAL(0, ftruncate(other, 1 << 20));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, dartt_shm_linux_attach(&bad, other, 1));
+	close(other);
+
+	dartt_shm_linux_close(&periph);
+	dartt_shm_linux_close(&ctl);
+}
+
+/*
+	Peripheral run from the rx callback of the controller: no second thread, and no syscall per transaction
+*/
+void test_shm_linux_pump_sync(void)
+{
+	static dartt_shm_linux_t link;
+	static dartt_shm_linux_t sim_shm;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_shm_linux_create(&link));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_shm_linux_attach(&sim_shm, link.fd, 1));
+	static sim_periph_t sim;
+	sim_link_t sim_link = {TYPE_ADDR_CRC_MESSAGE, &dartt_shm_linux_tx, &dartt_shm_linux_rx, &sim_shm, 0};
+	sim_periph_init(&sim, &sim_link);
+	link.spin = 0;
+	link.pump_callback = &sim_pump;
+	link.pump_context = &sim;
+
+	sim_regs_t ctl = {};
+	sim_regs_t shadow = {};
+	unsigned char tx_mem[64];
+	unsigned char rx_mem[64];
+	dartt_sync_t ds;
+	setup_sync(&ds, &ctl, &shadow, &link, tx_mem, rx_mem, sizeof(tx_mem));
+	dartt_mem_t ctl_alias = {.buf = (unsigned char *)&ctl, .size = sizeof(ctl)};
+
+	for(int i = 0; i < 64; i++)
+	{
+		ctl.setpoint[i] = 3*i + 1;
+	}
+	ctl.flags = 0x5A5A;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_sync(&ctl_alias, &ds));
+	TEST_ASSERT_EQUAL(0, memcmp(&ctl, &shadow, sizeof(ctl)));
+	TEST_ASSERT_EQUAL(0, memcmp(&ctl, &sim.regs, sizeof(ctl)));
+
+	//plain writes have no reply, and are applied by the next pump
+	ctl.status = 42;
+	dartt_mem_t status = {.buf = (unsigned char *)&ctl.status, .size = sizeof(int32_t)};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_ctl_write(&status, &ds));
+	for(int i = 0; i < 64; i++)
+	{
+		sim.regs.setpoint[i] = -i;
+	}
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_read_multi_pipelined(&ctl_alias, &ds));
+	TEST_ASSERT_EQUAL(42, shadow.status);
+	TEST_ASSERT_EQUAL(-63, shadow.setpoint[63]);
+
+	//a peripheral that is not pumped times out
+	uint32_t frames = sim.frames;
+	link.pump_callback = NULL;
+	ds.timeout_ms = 5;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_TIMEOUT, dartt_ctl_read(&status, &ds));
+	TEST_ASSERT_EQUAL(frames, sim.frames);
+
+	dartt_shm_linux_close(&sim_shm);
+	dartt_shm_linux_close(&link);
+}
+
+/*
+	Peripheral in a child process, woken through the futexes of the shared mapping
+*/
+void test_shm_linux_fork_sync(void)
+{
+	static dartt_shm_linux_t link;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_shm_linux_create(&link));
+	pid_t pid = fork();
+	TEST_ASSERT_GREATER_OR_EQUAL(0, pid);
+	if(pid == 0)
+	{
+		static dartt_shm_linux_t sim_shm;
+		if(dartt_shm_linux_attach(&sim_shm, link.fd, 1) != DARTT_PROTOCOL_SUCCESS)
+		{
+			_exit(1);
+		}
+		static sim_periph_t sim;
+		sim_link_t sim_link = {TYPE_ADDR_CRC_MESSAGE, &dartt_shm_linux_tx, &dartt_shm_linux_rx, &sim_shm, 0};
+		sim_periph_init(&sim, &sim_link);
+		while(sim.regs.flags != SIM_STOP)
+		{
+			int rc = dartt_shm_linux_serve(&sim_shm, &sim.periph.mem_base, sim.link.type, 2000);
+			if(rc == DARTT_ERROR_TIMEOUT)
+			{
+				_exit(2);
+			}
+		}
+		_exit(sim.regs.status == 1000 ? 0 : 3);
+	}
+
+	sim_regs_t ctl = {};
+	sim_regs_t shadow = {};
+	unsigned char tx_mem[64];
+	unsigned char rx_mem[64];
+	dartt_sync_t ds;
+	setup_sync(&ds, &ctl, &shadow, &link, tx_mem, rx_mem, sizeof(tx_mem));
+	dartt_mem_t ctl_alias = {.buf = (unsigned char *)&ctl, .size = sizeof(ctl)};
+	dartt_mem_t status = {.buf = (unsigned char *)&ctl.status, .size = sizeof(int32_t)};
+
+	for(int i = 0; i < 64; i++)
+	{
+		ctl.setpoint[i] = 1000 - i;
+	}
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_sync(&ctl_alias, &ds));
+	for(int i = 1; i <= 1000; i++)
+	{
+		ctl.status = i;
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_sync(&ctl_alias, &ds));
+	}
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_read_multi(&ctl_alias, &ds));
+	TEST_ASSERT_EQUAL(0, memcmp(&ctl, &shadow, sizeof(ctl)));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_ctl_read(&status, &ds));
+	TEST_ASSERT_EQUAL(1000, shadow.status);
+
+	ctl.flags = SIM_STOP;
+	dartt_mem_t flags = {.buf = (unsigned char *)&ctl.flags, .size = sizeof(uint32_t)};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_ctl_write(&flags, &ds));	//no reply, the child exits once applied
+	int wstatus = 0;
+	TEST_ASSERT_EQUAL(pid, waitpid(pid, &wstatus, 0));
+	TEST_ASSERT_TRUE(WIFEXITED(wstatus));
+	TEST_ASSERT_EQUAL(0, WEXITSTATUS(wstatus));
+	dartt_shm_linux_close(&link);
+}
@@ -0,0 +1,177 @@
+#include "dartt.h"
+#include "dartt_sync.h"
+#include "dartt_stats.h"
+#include "unity.h"
+#include <string.h>
+
+/*
+	Built with DARTT_ENABLE_STATS (see project.yml). The clock is a counter that the loopback callbacks advance by a
+	fixed amount, so every latency is known exactly.
+*/
+
+#define TX_TICKS	100u
+#define RX_TICKS	50u
+
+typedef struct stats_regs_t
+{
+	int32_t setpoint[4];
+	int32_t status[4];
+}stats_regs_t;
+
+static stats_regs_t gl_periph;
+static uint32_t gl_now;
+static int gl_rx_timeouts;		//next rx calls that time out
+static int gl_rx_corrupt;		//next rx calls that flip a bit of the reply
+static unsigned char gl_reply_mem[64];
+static dartt_buffer_t gl_reply = {.buf = gl_reply_mem, .size = sizeof(gl_reply_mem), .len = 0};
+
+static uint32_t stats_test_clock(void * user_context)
+{
+	return gl_now;
+}
+
+static int stats_test_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	//the peripheral serves the frame at once. Writes have no reply
+	gl_now += TX_TICKS;
+	payload_layer_msg_t pld = {};
+	int rc = dartt_frame_to_payload(tx, TYPE_SERIAL_MESSAGE, PAYLOAD_ALIAS, &pld);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	dartt_mem_t periph = {.buf = (unsigned char *)&gl_periph, .size = sizeof(gl_periph)};
+	gl_reply.len = 0;
+	return dartt_parse_general_message(&pld, TYPE_SERIAL_MESSAGE, &periph, &gl_reply);
+}
+
+static int stats_test_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout)
+{
+	gl_now += RX_TICKS;
+	rx->len = 0;
+	if(gl_rx_timeouts > 0)
+	{
+		gl_rx_timeouts--;
+		return DARTT_ERROR_TIMEOUT;
+	}
+	memcpy(rx->buf, gl_reply.buf, gl_reply.len);
+	rx->len = gl_reply.len;
+	if(gl_rx_corrupt > 0 && rx->len != 0)
+	{
+		gl_rx_corrupt--;
+		rx->buf[1] ^= 0x01;
+	}
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+void test_histogram_buckets(void)
+{
+	for(uint32_t v = 0; v < DARTT_STATS_SUB_BUCKETS; v++)
+	{
+		TEST_ASSERT_EQUAL(v, dartt_histogram_bucket(v));	//exact below the first power of two that is split
+	}
+	TEST_ASSERT_EQUAL(8, dartt_histogram_bucket(8));
+	TEST_ASSERT_EQUAL(8, dartt_histogram_bucket(9));	//8 and 9 share a bucket
+	TEST_ASSERT_EQUAL(9, dartt_histogram_bucket(10));
+	TEST_ASSERT_EQUAL(DARTT_STATS_NUM_BUCKETS - 1, dartt_histogram_bucket(UINT32_MAX));
+
+	//every value lies in [floor(bucket), floor(bucket + 1)), and no bucket is wider than 1/DARTT_STATS_SUB_BUCKETS of its floor
+	for(uint32_t v = 1; v != 0 && v < 0xF0000000u; v += (v >> 3) + 1)
+	{
+		size_t b = dartt_histogram_bucket(v);
+		uint32_t floor = dartt_histogram_bucket_floor(b);
+		uint32_t next = dartt_histogram_bucket_floor(b + 1);
+		TEST_ASSERT_TRUE(floor <= v && v < next);
+		TEST_ASSERT_TRUE(next - floor <= floor / DARTT_STATS_SUB_BUCKETS + 1);
+	}
+
+	dartt_histogram_t hist = {};
+	TEST_ASSERT_EQUAL(0, dartt_histogram_quantile(&hist, 500));
+	for(uint32_t v = 1; v <= 1000; v++)
+	{
+		dartt_histogram_record(&hist, v);
+	}
+	TEST_ASSERT_EQUAL(1000, hist.count);
+	TEST_ASSERT_EQUAL(1, hist.min);
+	TEST_ASSERT_EQUAL(1000, hist.max);
+	TEST_ASSERT_EQUAL(500500, hist.total);
+	TEST_ASSERT_EQUAL(1, dartt_histogram_quantile(&hist, 0));
+	TEST_ASSERT_EQUAL(511, dartt_histogram_quantile(&hist, 500));	//500 is in [448, 512). Quantiles are rounded up to the bucket end
+	TEST_ASSERT_EQUAL(1000, dartt_histogram_quantile(&hist, 999));	//capped to the maximum
+	TEST_ASSERT_EQUAL(1000, dartt_histogram_quantile(&hist, 1000));
+}
+
+void test_stats_sync_counters(void)
+{
+	stats_regs_t ctl = {};
+	stats_regs_t shadow = {};
+	unsigned char tx_mem[32];
+	unsigned char rx_mem[32];
+	dartt_sync_t ds = {};
+	ds.address = 3;
+	ds.ctl_base = (dartt_mem_t){.buf = (unsigned char *)&ctl, .size = sizeof(ctl)};
+	ds.periph_base = (dartt_mem_t){.buf = (unsigned char *)&shadow, .size = sizeof(shadow)};
+	ds.msg_type = TYPE_SERIAL_MESSAGE;
+	ds.tx_buf = (dartt_buffer_t){.buf = tx_mem, .size = sizeof(tx_mem), .len = 0};
+	ds.rx_buf = (dartt_buffer_t){.buf = rx_mem, .size = sizeof(rx_mem), .len = 0};
+	ds.blocking_tx_callback = &stats_test_tx;
+	ds.blocking_rx_callback = &stats_test_rx;
+	ds.timeout_ms = 10;
+	ds.retry.max_attempts = 2;
+	ds.retry.retry_mask = DARTT_RETRY_DEFAULT_MASK;
+	ds.stats.clock_callback = &stats_test_clock;
+	memset(&gl_periph, 0, sizeof(gl_periph));
+	gl_now = 0xFFFFFF00u;	//latencies are taken modulo 2^32
+	gl_rx_timeouts = 0;
+	gl_rx_corrupt = 0;
+
+	//[address][index][num_bytes][crc] = 7 bytes, reply [address][index][data][crc] = 9 bytes
+	gl_periph.status[1] = 42;
+	dartt_mem_t status = {.buf = (unsigned char *)&ctl.status[1], .size = sizeof(int32_t)};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_ctl_read(&status, &ds));
+	TEST_ASSERT_EQUAL(42, shadow.status[1]);
+	TEST_ASSERT_EQUAL(1, ds.stats.tx_frames);
+	TEST_ASSERT_EQUAL(7, ds.stats.tx_bytes);
+	TEST_ASSERT_EQUAL(1, ds.stats.rx_frames);
+	TEST_ASSERT_EQUAL(9, ds.stats.rx_bytes);
+	TEST_ASSERT_EQUAL(1, ds.stats.ops[DARTT_OP_CTL_READ].calls);
+	TEST_ASSERT_EQUAL(TX_TICKS + RX_TICKS, ds.stats.ops[DARTT_OP_CTL_READ].latency.max);
+	TEST_ASSERT_EQUAL(TX_TICKS, ds.stats.ops[DARTT_OP_TX].latency.max);
+	TEST_ASSERT_EQUAL(RX_TICKS, ds.stats.ops[DARTT_OP_RX].latency.max);
+
+	//sync: write [address][index][data][crc] = 9 bytes, then the read-back
+	ctl.setpoint[2] = 7;
+	dartt_mem_t setpoints = {.buf = (unsigned char *)&ctl.setpoint, .size = sizeof(ctl.setpoint)};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_sync(&setpoints, &ds));
+	TEST_ASSERT_EQUAL(7, gl_periph.setpoint[2]);
+	TEST_ASSERT_EQUAL(3, ds.stats.tx_frames);
+	TEST_ASSERT_EQUAL(7 + 9 + 7, ds.stats.tx_bytes);
+	TEST_ASSERT_EQUAL(2, ds.stats.rx_frames);
+	TEST_ASSERT_EQUAL(2*TX_TICKS + RX_TICKS, ds.stats.ops[DARTT_OP_SYNC].latency.max);
+	TEST_ASSERT_EQUAL(0, ds.stats.ops[DARTT_OP_CTL_WRITE].calls);	//dartt_sync does not go through dartt_ctl_write
+
+	//a timeout and a checksum failure, both recovered by a retry: every failed attempt is counted by error code
+	gl_rx_timeouts = 1;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_ctl_read(&status, &ds));
+	gl_rx_corrupt = 1;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_ctl_read(&status, &ds));
+	TEST_ASSERT_EQUAL(1, ds.stats.errors[-DARTT_ERROR_TIMEOUT]);
+	TEST_ASSERT_EQUAL(1, ds.stats.errors[-DARTT_ERROR_CHECKSUM_MISMATCH]);
+	TEST_ASSERT_EQUAL(1, ds.stats.ops[DARTT_OP_RX].failures);
+	TEST_ASSERT_EQUAL(3, ds.stats.ops[DARTT_OP_CTL_READ].calls);
+	TEST_ASSERT_EQUAL(0, ds.stats.ops[DARTT_OP_CTL_READ].failures);
+	TEST_ASSERT_EQUAL(2*(TX_TICKS + RX_TICKS), ds.stats.ops[DARTT_OP_CTL_READ].latency.max);
+	TEST_ASSERT_EQUAL(TX_TICKS + RX_TICKS, ds.stats.ops[DARTT_OP_CTL_READ].latency.min);
+	TEST_ASSERT_EQUAL(5*(TX_TICKS + RX_TICKS), ds.stats.ops[DARTT_OP_CTL_READ].latency.total);
+
+	//read_multi splits the region into frames that fit rx_buf and times each one
+	dartt_mem_t all = {.buf = (unsigned char *)&ctl, .size = sizeof(ctl)};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_read_multi(&all, &ds));
+	TEST_ASSERT_EQUAL(1, ds.stats.ops[DARTT_OP_READ_MULTI].calls);
+	TEST_ASSERT_EQUAL(5, ds.stats.ops[DARTT_OP_CTL_READ].calls);	//two frames of up to 24 bytes
+
+	dartt_stats_reset(&ds.stats);
+	TEST_ASSERT_EQUAL(0, ds.stats.tx_frames);
+	TEST_ASSERT_EQUAL(0, ds.stats.ops[DARTT_OP_CTL_READ].latency.count);
+	TEST_ASSERT_TRUE(ds.stats.clock_callback == &stats_test_clock);
+}
@@ -900,6 +900,81 @@ void test_dartt_read_multi_fdcan(void)
 
 }
 
+void test_dartt_sync_prepare(void)
+{
+    test_struct_t ctl_master = {};
+    dartt_mem_t ctl_master_alias;
+    init_struct_mem(&ctl_master, &ctl_master_alias);
+    test_struct_t periph_master = {};
+    dartt_mem_t periph_master_alias;
+    init_struct_mem(&periph_master, &periph_master_alias);
+    dartt_sync_t ctl_sync = {};
+    ctl_sync.address = 3;
+    init_struct_mem(&ctl_master, &ctl_sync.ctl_base);
+	init_struct_mem(&periph_master, &ctl_sync.periph_base);
+    ctl_sync.msg_type = TYPE_ADDR_CRC_MESSAGE;
+    int rc = dartt_init_buffer(&ctl_sync.tx_buf, tx_mem, 8);    //classic CAN frames
+    TEST_ASSERT_EQUAL(0,rc);
+    rc = dartt_init_buffer(&ctl_sync.rx_buf, rx_mem, 8);
+    TEST_ASSERT_EQUAL(0,rc);
+    ctl_sync.blocking_rx_callback = &synctest_rx_blocking_fdcan;
+	gl_msg_type = ctl_sync.msg_type;
+    ctl_sync.blocking_tx_callback = &synctest_tx_blocking_fdcan;
+    ctl_sync.timeout_ms = 10;
+    p_sync_tx_buf = &ctl_sync.tx_buf;
+    for(int i = 0; i < periph_master_alias.size; i++)
+    {
+        periph_master_alias.buf[i] = (i % 254) + 1;
+        periph_alias.buf[i] = 0;
+    }
+
+    rc = dartt_sync_prepare(&ctl_sync);
+    TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+    TEST_ASSERT_EQUAL(1, ctl_sync.prepared);
+    TEST_ASSERT_EQUAL(4, ctl_sync.read_chunk);     //8 byte frames, 2 bytes of index: one word per frame
+    TEST_ASSERT_EQUAL(4, ctl_sync.write_chunk);
+
+    rc = dartt_read_multi(&ctl_master_alias, &ctl_sync);
+    TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(periph_master_alias.buf, periph_alias.buf, periph_alias.size);
+
+    //the region is still checked on every call
+    dartt_mem_t past_end = {.buf = ctl_master_alias.buf + sizeof(int32_t), .size = ctl_master_alias.size};
+    rc = dartt_read_multi(&past_end, &ctl_sync);
+    TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, rc);
+    dartt_mem_t unaligned = {.buf = ctl_master_alias.buf + 2, .size = sizeof(int32_t)};
+    rc = dartt_read_multi(&unaligned, &ctl_sync);
+    TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, rc);
+
+    //configuration errors are reported once, by dartt_sync_prepare
+    ctl_sync.rx_buf.size = 5;
+    rc = dartt_sync_prepare(&ctl_sync);
+    TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, rc);
+    TEST_ASSERT_EQUAL(0, ctl_sync.prepared);
+    ctl_sync.rx_buf.size = 8;
+    ctl_sync.periph_base = ctl_sync.ctl_base;
+    rc = dartt_sync_prepare(&ctl_sync);
+    TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, rc);
+    init_struct_mem(&periph_master, &ctl_sync.periph_base);
+    ctl_sync.msg_type = (serial_message_type_t)7;
+    rc = dartt_sync_prepare(&ctl_sync);
+    TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, rc);
+    ctl_sync.msg_type = TYPE_ADDR_CRC_MESSAGE;
+
+    //a region beyond the standard index range is sized for extended frames, 4 bytes longer
+    ctl_sync.base_offset = DARTT_INDEX_RESERVED_BASE - 1;
+    rc = dartt_sync_prepare(&ctl_sync);
+    TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, rc);
+    ctl_sync.tx_buf.size = 12;
+    ctl_sync.rx_buf.size = 12;
+    rc = dartt_sync_prepare(&ctl_sync);
+    TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+    TEST_ASSERT_EQUAL(4, ctl_sync.read_chunk);
+    ctl_sync.base_offset = DARTT_INDEX_EXTENDED_BIT - 1;
+    rc = dartt_sync_prepare(&ctl_sync);
+    TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, rc);
+}
+
 
 
 
@@ -1616,6 +1691,82 @@ void test_base_offset_sync(void)
 	gl_msg_type  = saved_msg;
 }
 
+/*
+	A region at the end of a peripheral map larger than the standard index range. It straddles
+	DARTT_INDEX_RESERVED_BASE, so its first words are addressed with standard frames and the rest with extended frames
+*/
+#define EXT_BASE_OFFSET		(DARTT_INDEX_RESERVED_BASE - 8)
+static uint32_t ext_periph[EXT_BASE_OFFSET + sizeof(test_struct_t)/sizeof(uint32_t) + 4];
+
+void test_base_offset_extended(void)
+{
+	test_struct_t ctl_copy    = {};
+	test_struct_t shadow_copy = {};
+	memset(ext_periph, 0, sizeof(ext_periph));
+	test_struct_t * inner = (test_struct_t *)&ext_periph[EXT_BASE_OFFSET];
+	uint32_t * guard = &ext_periph[EXT_BASE_OFFSET + sizeof(test_struct_t)/sizeof(uint32_t)];
+	guard[0] = 0x0AFEBABE;
+	ext_periph[EXT_BASE_OFFSET - 1] = 0x0BADF00D;
+
+	dartt_mem_t           saved_alias = periph_alias;
+	serial_message_type_t saved_msg   = gl_msg_type;
+	periph_alias.buf  = (unsigned char *)ext_periph;
+	periph_alias.size = sizeof(ext_periph);
+	gl_msg_type = TYPE_SERIAL_MESSAGE;
+
+	dartt_sync_t ds = {};
+	ds.address          = 0x3;
+	ds.base_offset      = EXT_BASE_OFFSET;
+	ds.ctl_base.buf     = (unsigned char *)&ctl_copy;
+	ds.ctl_base.size    = sizeof(test_struct_t);
+	ds.periph_base.buf  = (unsigned char *)&shadow_copy;
+	ds.periph_base.size = sizeof(test_struct_t);
+	ds.msg_type         = TYPE_SERIAL_MESSAGE;
+	dartt_init_buffer(&ds.tx_buf, tx_mem, sizeof(tx_mem));
+	dartt_init_buffer(&ds.rx_buf, rx_mem, sizeof(rx_mem));
+	ds.blocking_tx_callback = &synctest_tx_blocking;
+	ds.blocking_rx_callback = &synctest_rx_blocking;
+	ds.timeout_ms = 10;
+	p_sync_tx_buf = &ds.tx_buf;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_sync_prepare(&ds));
+	TEST_ASSERT_EQUAL(sizeof(rx_mem) - 12, ds.read_chunk);	//5 bytes of serial framing, 6 bytes of extended index, word aligned
+
+	//one field on each side of the boundary
+	ctl_copy.m1_set = 100;
+	ctl_copy.mp[31].pi_vq.x = -555;
+	dartt_mem_t ctl_alias = {.buf = (unsigned char *)&ctl_copy, .size = sizeof(test_struct_t)};
+	int rc = dartt_sync(&ctl_alias, &ds);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(100, inner->m1_set);
+	TEST_ASSERT_EQUAL(-555, inner->mp[31].pi_vq.x);
+	TEST_ASSERT_EQUAL_UINT8_ARRAY((unsigned char *)&ctl_copy, (unsigned char *)inner, sizeof(test_struct_t));
+	TEST_ASSERT_EQUAL_UINT8_ARRAY((unsigned char *)&ctl_copy, (unsigned char *)&shadow_copy, sizeof(test_struct_t));
+
+	//peripheral side changes, read back in bulk, then one tagged read beyond the boundary
+	for(size_t i = 0; i < sizeof(test_struct_t); i++)
+	{
+		((unsigned char *)inner)[i] = (unsigned char)(i * 13 + 7);
+	}
+	rc = dartt_read_multi(&ctl_alias, &ds);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL_UINT8_ARRAY((unsigned char *)inner, (unsigned char *)&shadow_copy, sizeof(test_struct_t));
+	inner->mp[30].pi_vq.x = 0x12345;
+	dartt_mem_t ctl_field = {.buf = (unsigned char *)&ctl_copy.mp[30].pi_vq.x, .size = sizeof(int32_t)};
+	uint8_t tag = DARTT_TAG_NONE;
+	uint8_t reply_tag = DARTT_TAG_NONE;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_read_post(&ctl_field, &ds, &tag));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_read_poll(&ds, &reply_tag));
+	TEST_ASSERT_EQUAL(tag, reply_tag);
+	TEST_ASSERT_EQUAL(0x12345, shadow_copy.mp[30].pi_vq.x);
+
+	//guards around the region are untouched
+	TEST_ASSERT_EQUAL_HEX32(0x0BADF00D, ext_periph[EXT_BASE_OFFSET - 1]);
+	TEST_ASSERT_EQUAL_HEX32(0x0AFEBABE, guard[0]);
+
+	periph_alias = saved_alias;
+	gl_msg_type  = saved_msg;
+}
+
 void test_base_offset_zero(void)
 {
 	// Regression: base_offset = 0 must behave identically to the pre-feature baseline.
@@ -1677,4 +1828,795 @@ void test_base_offset_zero(void)
 	TEST_ASSERT_EQUAL(12345, shadow_copy.mp[31].pi_vq.x);
 
 	gl_msg_type = saved_msg;
-}
\ No newline at end of file
+}
+/*
+	Peripheral model that transmits its reply whenever there is one, including error replies
+*/
+int synctest_rx_blocking_error_reply(dartt_buffer_t * rx, void * user_context, uint32_t timeout)
+{
+    payload_layer_msg_t rxpld_msg = {};
+    int rc = dartt_frame_to_payload(p_sync_tx_buf, gl_msg_type, PAYLOAD_ALIAS, &rxpld_msg);
+    if(rc != DARTT_PROTOCOL_SUCCESS)
+    {
+        return rc;
+    }
+    dartt_parse_general_message(&rxpld_msg, gl_msg_type, &periph_alias, rx);
+    return DARTT_PROTOCOL_SUCCESS;	//rx->len is 0 if the peripheral stayed silent
+}
+
+void test_ctl_read_error_reply(void)
+{
+	dartt_mem_t saved_alias = periph_alias;
+	serial_message_type_t saved_msg = gl_msg_type;
+	gl_msg_type = TYPE_SERIAL_MESSAGE;
+	periph_alias.size = 2*sizeof(int32_t);	//peripheral is smaller than the controller thinks
+
+	test_struct_t ctl_copy = {};
+	test_struct_t shadow_copy = {};
+	dartt_sync_t ds = {};
+	ds.address          = 0x3;
+	ds.ctl_base.buf     = (unsigned char *)&ctl_copy;
+	ds.ctl_base.size    = sizeof(test_struct_t);
+	ds.periph_base.buf  = (unsigned char *)&shadow_copy;
+	ds.periph_base.size = sizeof(test_struct_t);
+	ds.msg_type         = TYPE_SERIAL_MESSAGE;
+	dartt_init_buffer(&ds.tx_buf, tx_mem, sizeof(tx_mem));
+	dartt_init_buffer(&ds.rx_buf, rx_mem, sizeof(rx_mem));
+	ds.blocking_tx_callback = &synctest_tx_blocking;
+	ds.blocking_rx_callback = &synctest_rx_blocking_error_reply;
+	ds.timeout_ms = 10;
+	p_sync_tx_buf = &ds.tx_buf;
+
+	dartt_mem_t ctl = {.buf = (unsigned char *)&ctl_copy.mp[0], .size = sizeof(int32_t)};
+	shadow_copy.mp[0].pi_vq.kp.i32 = 77;
+	int rc = dartt_ctl_read(&ctl, &ds);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, rc);	//the peripheral's error, not a timeout
+	TEST_ASSERT_EQUAL(77, shadow_copy.mp[0].pi_vq.kp.i32);	//shadow copy untouched
+
+	//in range reads still work
+	dartt_mem_t ctl_ok = {.buf = (unsigned char *)&ctl_copy.m1_set, .size = 2*sizeof(int32_t)};
+	gl_periph.m2_set = 31;
+	rc = dartt_ctl_read(&ctl_ok, &ds);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(31, shadow_copy.m2_set);
+
+	//dartt_sync read-back is rejected. The write itself is dropped silently by the peripheral
+	ctl_copy.mp[0].pi_vq.kp.i32 = 5;
+	rc = dartt_sync(&ctl, &ds);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, rc);
+
+	periph_alias = saved_alias;
+	gl_msg_type = saved_msg;
+	gl_periph.m2_set = 0;
+}
+
+/*
+	Peripheral model for pipelined reads: requests are queued on tx, and answered last-in first-out on rx
+	to model a transport that reorders frames
+*/
+#define REORDER_QUEUE_LEN 16
+static unsigned char reorder_frames[REORDER_QUEUE_LEN][64];
+static size_t reorder_lens[REORDER_QUEUE_LEN];
+static int reorder_count = 0;
+int reorder_tx_blocking(unsigned char addr, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	if(reorder_count >= REORDER_QUEUE_LEN || tx->len > sizeof(reorder_frames[0]))
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	memcpy(reorder_frames[reorder_count], tx->buf, tx->len);
+	reorder_lens[reorder_count] = tx->len;
+	reorder_count++;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+int reorder_rx_blocking(dartt_buffer_t * rx, void * user_context, uint32_t timeout)
+{
+	rx->len = 0;
+	if(reorder_count == 0)
+	{
+		return DARTT_PROTOCOL_SUCCESS;	//nothing to reply to - models a timeout
+	}
+	reorder_count--;
+	dartt_buffer_t frame = {.buf = reorder_frames[reorder_count], .size = sizeof(reorder_frames[0]), .len = reorder_lens[reorder_count]};
+	payload_layer_msg_t pld = {};
+	int rc = dartt_frame_to_payload(&frame, gl_msg_type, PAYLOAD_ALIAS, &pld);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	dartt_parse_general_message(&pld, gl_msg_type, &periph_alias, rx);
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+void test_tagged_read_pipeline(void)
+{
+	serial_message_type_t types[] = {TYPE_SERIAL_MESSAGE, TYPE_ADDR_MESSAGE, TYPE_ADDR_CRC_MESSAGE};
+	serial_message_type_t saved_msg = gl_msg_type;
+	for(int t = 0; t < 3; t++)
+	{
+		gl_msg_type = types[t];
+		reorder_count = 0;
+		for(int i = 0; i < 32; i++)
+		{
+			gl_periph.mp[i].pi_vq.x = 1000 + i;
+		}
+		test_struct_t ctl_copy = {};
+		test_struct_t shadow_copy = {};
+		dartt_sync_t ds = {};
+		ds.address          = 0x3;
+		ds.ctl_base.buf     = (unsigned char *)&ctl_copy;
+		ds.ctl_base.size    = sizeof(test_struct_t);
+		ds.periph_base.buf  = (unsigned char *)&shadow_copy;
+		ds.periph_base.size = sizeof(test_struct_t);
+		ds.msg_type         = types[t];
+		dartt_init_buffer(&ds.tx_buf, tx_mem, sizeof(tx_mem));
+		dartt_init_buffer(&ds.rx_buf, rx_mem, sizeof(rx_mem));
+		ds.blocking_tx_callback = &reorder_tx_blocking;
+		ds.blocking_rx_callback = &reorder_rx_blocking;
+		ds.timeout_ms = 10;
+
+		//fill the table
+		uint8_t tags[DARTT_NUM_TAGS] = {};
+		for(int i = 0; i < DARTT_NUM_TAGS; i++)
+		{
+			dartt_mem_t ctl = {.buf = (unsigned char *)&ctl_copy.mp[i].pi_vq.x, .size = sizeof(int32_t)};
+			int rc = dartt_read_post(&ctl, &ds, &tags[i]);
+			TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+			TEST_ASSERT_NOT_EQUAL(DARTT_TAG_NONE, tags[i]);
+		}
+		TEST_ASSERT_EQUAL(DARTT_NUM_TAGS, ds.num_pending);
+		dartt_mem_t ctl_extra = {.buf = (unsigned char *)&ctl_copy.m1_set, .size = sizeof(int32_t)};
+		uint8_t extra_tag = 0;
+		TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_read_post(&ctl_extra, &ds, &extra_tag));
+
+		//replies arrive in reverse order, and still land in the right place
+		for(int i = DARTT_NUM_TAGS - 1; i >= 0; i--)
+		{
+			uint8_t tag = 0;
+			int rc = dartt_read_poll(&ds, &tag);
+			TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+			TEST_ASSERT_EQUAL(tags[i], tag);
+			TEST_ASSERT_EQUAL(1000 + i, shadow_copy.mp[i].pi_vq.x);
+		}
+		TEST_ASSERT_EQUAL(0, ds.num_pending);
+
+		//tags keep advancing and skip DARTT_TAG_NONE on wrap
+		ds.last_tag = 0xFE;
+		uint8_t tag_a = 0, tag_b = 0;
+		dartt_mem_t ctl_a = {.buf = (unsigned char *)&ctl_copy.m1_set, .size = sizeof(int32_t)};
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_read_post(&ctl_a, &ds, &tag_a));
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_read_post(&ctl_a, &ds, &tag_b));
+		TEST_ASSERT_EQUAL(0xFF, tag_a);
+		TEST_ASSERT_EQUAL(1, tag_b);
+
+		//a reply for a flushed request is stale
+		dartt_read_flush(&ds);
+		TEST_ASSERT_EQUAL(0, ds.num_pending);
+		uint8_t tag = 0;
+		TEST_ASSERT_EQUAL(DARTT_ERROR_TAG_MISMATCH, dartt_read_poll(&ds, &tag));
+		reorder_count = 0;
+
+		//rejected tagged request reports its tag
+		dartt_mem_t saved_alias = periph_alias;
+		periph_alias.size = sizeof(int32_t);
+		dartt_mem_t ctl_oob = {.buf = (unsigned char *)&ctl_copy.mp[3], .size = sizeof(int32_t)};
+		uint8_t oob_tag = 0;
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_read_post(&ctl_oob, &ds, &oob_tag));
+		tag = 0;
+		TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_read_poll(&ds, &tag));
+		TEST_ASSERT_EQUAL(oob_tag, tag);
+		TEST_ASSERT_EQUAL(0, ds.num_pending);
+		periph_alias = saved_alias;
+	}
+	gl_msg_type = saved_msg;
+	memset(&gl_periph, 0, sizeof(gl_periph));
+}
+
+/*
+	Lossy link model - the rx callback drops the replies whose sequence number is flagged in lossy_drop_mask
+*/
+static uint32_t lossy_rx_count = 0;
+static uint64_t lossy_drop_mask = 0;
+int lossy_rx_blocking(dartt_buffer_t * rx, void * user_context, uint32_t timeout)
+{
+	uint32_t n = lossy_rx_count++;
+	if(n < 64 && (lossy_drop_mask & (1ULL << n)) != 0)
+	{
+		rx->len = 0;
+		return DARTT_ERROR_TIMEOUT;
+	}
+	return synctest_rx_blocking(rx, user_context, timeout);
+}
+
+static uint32_t delay_calls = 0;
+static uint32_t delay_total_ms = 0;
+void record_delay(uint32_t ms, void * user_context)
+{
+	delay_calls++;
+	delay_total_ms += ms;
+}
+
+void test_retry_policy(void)
+{
+	serial_message_type_t saved_msg = gl_msg_type;
+	gl_msg_type = TYPE_SERIAL_MESSAGE;
+	for(int i = 0; i < (int)periph_alias.size; i++)
+	{
+		periph_alias.buf[i] = (unsigned char)(i*7 + 1);
+	}
+	test_struct_t ctl_copy = {};
+	test_struct_t shadow_copy = {};
+	dartt_sync_t ds = {};
+	ds.address          = 0x3;
+	ds.ctl_base.buf     = (unsigned char *)&ctl_copy;
+	ds.ctl_base.size    = sizeof(test_struct_t);
+	ds.periph_base.buf  = (unsigned char *)&shadow_copy;
+	ds.periph_base.size = sizeof(test_struct_t);
+	ds.msg_type         = TYPE_SERIAL_MESSAGE;
+	dartt_init_buffer(&ds.tx_buf, tx_mem, sizeof(tx_mem));
+	dartt_init_buffer(&ds.rx_buf, rx_mem, sizeof(rx_mem));
+	ds.blocking_tx_callback = &synctest_tx_blocking;
+	ds.blocking_rx_callback = &lossy_rx_blocking;
+	ds.timeout_ms = 10;
+	p_sync_tx_buf = &ds.tx_buf;
+
+	dartt_mem_t ctl = {.buf = ds.ctl_base.buf, .size = ds.ctl_base.size};
+	size_t rsize = sizeof(rx_mem) - (NUM_BYTES_ADDRESS + NUM_BYTES_INDEX + NUM_BYTES_CHECKSUM);
+	rsize -= rsize % sizeof(uint32_t);
+	uint32_t num_chunks = (uint32_t)((ctl.size + rsize - 1)/rsize);
+	TEST_ASSERT_GREATER_THAN(4, num_chunks);
+
+	//no policy: the first loss aborts the operation
+	lossy_rx_count = 0;
+	lossy_drop_mask = (1ULL << 2);
+	int rc = dartt_read_multi(&ctl, &ds);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_TIMEOUT, rc);
+	TEST_ASSERT_EQUAL(0, ds.retry_stats.retries);
+
+	//with a policy, only the lost frames are requested again
+	ds.retry.max_attempts = 3;
+	ds.retry.backoff_ms = 1;
+	ds.retry.retry_mask = DARTT_RETRY_DEFAULT_MASK;
+	ds.retry.delay_callback = &record_delay;
+	memset(&shadow_copy, 0, sizeof(shadow_copy));
+	lossy_rx_count = 0;
+	lossy_drop_mask = (1ULL << 2) | (1ULL << 5) | (1ULL << 6);	//chunk 2 once, chunk 4 twice
+	delay_calls = 0;
+	delay_total_ms = 0;
+	rc = dartt_read_multi(&ctl, &ds);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(0, memcmp(&shadow_copy, periph_alias.buf, sizeof(shadow_copy)));
+	TEST_ASSERT_EQUAL(3, ds.retry_stats.retries);
+	TEST_ASSERT_EQUAL(2, ds.retry_stats.recovered);
+	TEST_ASSERT_EQUAL(0, ds.retry_stats.exhausted);
+	TEST_ASSERT_EQUAL(num_chunks + 3, lossy_rx_count);	//no chunk was read twice after succeeding
+	TEST_ASSERT_EQUAL(3, delay_calls);
+	TEST_ASSERT_EQUAL(1 + 1 + 2, delay_total_ms);	//exponential backoff per frame
+
+	//exhausted attempts return the last error
+	memset(&ds.retry_stats, 0, sizeof(ds.retry_stats));
+	lossy_rx_count = 0;
+	lossy_drop_mask = (1ULL << 0) | (1ULL << 1) | (1ULL << 2);
+	rc = dartt_read_multi(&ctl, &ds);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_TIMEOUT, rc);
+	TEST_ASSERT_EQUAL(2, ds.retry_stats.retries);
+	TEST_ASSERT_EQUAL(1, ds.retry_stats.exhausted);
+	TEST_ASSERT_EQUAL(3, lossy_rx_count);
+
+	//errors outside the mask are not retried
+	memset(&ds.retry_stats, 0, sizeof(ds.retry_stats));
+	ds.retry.retry_mask = DARTT_RETRY_BIT(DARTT_ERROR_CHECKSUM_MISMATCH);
+	lossy_rx_count = 0;
+	lossy_drop_mask = (1ULL << 0);
+	rc = dartt_read_multi(&ctl, &ds);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_TIMEOUT, rc);
+	TEST_ASSERT_EQUAL(0, ds.retry_stats.retries);
+	ds.retry.retry_mask = DARTT_RETRY_DEFAULT_MASK;
+
+	//dartt_sync resends only the span whose read-back was lost
+	memset(&ds.retry_stats, 0, sizeof(ds.retry_stats));
+	memcpy(&ctl_copy, &shadow_copy, sizeof(ctl_copy));
+	ctl_copy.m1_set += 1;
+	ctl_copy.mp[10].fds.module_number += 1;
+	ctl_copy.mp[20].pi_vq.x += 1;
+	uint32_t sends_before = gl_send_count;
+	lossy_rx_count = 0;
+	lossy_drop_mask = (1ULL << 1);	//read-back of the second span
+	rc = dartt_sync(&ctl, &ds);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(1, ds.retry_stats.retries);
+	TEST_ASSERT_EQUAL(1, ds.retry_stats.recovered);
+	TEST_ASSERT_EQUAL(2*(3 + 1), gl_send_count - sends_before);	//write + read request per span, plus one resent span
+	TEST_ASSERT_EQUAL(0, memcmp(&ctl_copy, &shadow_copy, sizeof(ctl_copy)));
+	TEST_ASSERT_EQUAL(0, memcmp(&ctl_copy, periph_alias.buf, sizeof(ctl_copy)));
+
+	lossy_drop_mask = 0;
+	gl_msg_type = saved_msg;
+	memset(&gl_periph, 0, sizeof(gl_periph));
+}
+
+/*
+	Slow link model - requests are answered in order, but the first delayed_hold receptions time out before their reply
+	arrives. The late replies stay queued, as they would in a serial or UDP receive buffer
+*/
+static unsigned char delayed_frames[REORDER_QUEUE_LEN][64];
+static size_t delayed_lens[REORDER_QUEUE_LEN];
+static int delayed_head = 0;
+static int delayed_count = 0;
+static int delayed_hold = 0;
+int delayed_tx_blocking(unsigned char addr, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	if(delayed_count >= REORDER_QUEUE_LEN || tx->len > sizeof(delayed_frames[0]))
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	int slot = (delayed_head + delayed_count) % REORDER_QUEUE_LEN;
+	memcpy(delayed_frames[slot], tx->buf, tx->len);
+	delayed_lens[slot] = tx->len;
+	delayed_count++;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+int delayed_rx_blocking(dartt_buffer_t * rx, void * user_context, uint32_t timeout)
+{
+	rx->len = 0;
+	if(delayed_hold > 0 || delayed_count == 0)
+	{
+		delayed_hold--;
+		return DARTT_ERROR_TIMEOUT;
+	}
+	dartt_buffer_t frame = {.buf = delayed_frames[delayed_head], .size = sizeof(delayed_frames[0]), .len = delayed_lens[delayed_head]};
+	delayed_head = (delayed_head + 1) % REORDER_QUEUE_LEN;
+	delayed_count--;
+	payload_layer_msg_t pld = {};
+	int rc = dartt_frame_to_payload(&frame, gl_msg_type, PAYLOAD_ALIAS, &pld);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	dartt_parse_general_message(&pld, gl_msg_type, &periph_alias, rx);
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+/*
+	A reply that arrives after its timeout answers the retransmitted request, and the reply to the retransmission is
+	then received while waiting for the next chunk. It must be discarded rather than taken as that chunk's reply
+*/
+void test_read_late_reply(void)
+{
+	serial_message_type_t saved_msg = gl_msg_type;
+	gl_msg_type = TYPE_SERIAL_MESSAGE;
+	int32_t periph_words[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+	int32_t ctl_words[8] = {};
+	int32_t shadow_words[8] = {};
+	dartt_mem_t saved_alias = periph_alias;
+	periph_alias.buf = (unsigned char *)periph_words;
+	periph_alias.size = sizeof(periph_words);
+	unsigned char small_rx[NUM_BYTES_ADDRESS + NUM_BYTES_INDEX + NUM_BYTES_CHECKSUM + 2*sizeof(int32_t)] = {};
+	dartt_sync_t ds = {};
+	ds.address          = 0x3;
+	ds.ctl_base.buf     = (unsigned char *)ctl_words;
+	ds.ctl_base.size    = sizeof(ctl_words);
+	ds.periph_base.buf  = (unsigned char *)shadow_words;
+	ds.periph_base.size = sizeof(shadow_words);
+	ds.msg_type         = TYPE_SERIAL_MESSAGE;
+	dartt_init_buffer(&ds.tx_buf, tx_mem, sizeof(tx_mem));
+	dartt_init_buffer(&ds.rx_buf, small_rx, sizeof(small_rx));	//8 byte chunks
+	ds.blocking_tx_callback = &delayed_tx_blocking;
+	ds.blocking_rx_callback = &delayed_rx_blocking;
+	ds.timeout_ms = 10;
+	ds.retry.max_attempts = 3;
+	ds.retry.retry_mask = DARTT_RETRY_DEFAULT_MASK;
+
+	delayed_head = 0;
+	delayed_count = 0;
+	delayed_hold = 1;
+	dartt_mem_t ctl = {.buf = ds.ctl_base.buf, .size = ds.ctl_base.size};
+	int rc = dartt_read_multi(&ctl, &ds);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(0, memcmp(periph_words, shadow_words, sizeof(shadow_words)));
+	TEST_ASSERT_EQUAL(1, ds.retry_stats.retries);
+	TEST_ASSERT_EQUAL(0, delayed_count);	//the late reply was consumed, not left for the next read
+
+	//stale replies landing in the wrong place would show up as changed shadow words
+	memset(shadow_words, 0, sizeof(shadow_words));
+	periph_words[6] = 70;
+	delayed_hold = 2;
+	rc = dartt_read_multi(&ctl, &ds);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(0, memcmp(periph_words, shadow_words, sizeof(shadow_words)));
+	TEST_ASSERT_EQUAL(0, delayed_count);
+
+	periph_alias = saved_alias;
+	gl_msg_type = saved_msg;
+}
+
+/*
+	Batching transport model - counts the flushes requested by dartt_sync
+*/
+static uint32_t flush_count = 0;
+int count_flush(void * user_context, uint32_t timeout)
+{
+	flush_count++;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+void test_read_multi_pipelined(void)
+{
+	serial_message_type_t saved_msg = gl_msg_type;
+	gl_msg_type = TYPE_ADDR_CRC_MESSAGE;
+	reorder_count = 0;
+	flush_count = 0;
+	unsigned char * p = (unsigned char *)&gl_periph;
+	for(size_t i = 0; i < sizeof(gl_periph); i++)
+	{
+		p[i] = (unsigned char)(i*7 + 1);
+	}
+	test_struct_t ctl_copy = {};
+	test_struct_t shadow_copy = {};
+	dartt_sync_t ds = {};
+	ds.address          = 0x3;
+	ds.ctl_base.buf     = (unsigned char *)&ctl_copy;
+	ds.ctl_base.size    = sizeof(test_struct_t);
+	ds.periph_base.buf  = (unsigned char *)&shadow_copy;
+	ds.periph_base.size = sizeof(test_struct_t);
+	ds.msg_type         = TYPE_ADDR_CRC_MESSAGE;
+	dartt_init_buffer(&ds.tx_buf, tx_mem, sizeof(tx_mem));
+	dartt_init_buffer(&ds.rx_buf, rx_mem, sizeof(rx_mem));
+	ds.blocking_tx_callback = &reorder_tx_blocking;
+	ds.blocking_rx_callback = &reorder_rx_blocking;
+	ds.flush_tx_callback = &count_flush;
+	ds.timeout_ms = 10;
+
+	//whole structure, many more chunks than tags. Replies come back out of order within each window
+	dartt_mem_t whole = {.buf = (unsigned char *)&ctl_copy, .size = sizeof(test_struct_t)};
+	int rc = dartt_read_multi_pipelined(&whole, &ds);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(0, memcmp(&gl_periph, &shadow_copy, sizeof(test_struct_t)));
+	TEST_ASSERT_EQUAL(0, ds.num_pending);
+	TEST_ASSERT_EQUAL(0, flush_count);	//read requests are left to the rx callback to send
+
+	//unaligned sub-region
+	memset(&shadow_copy, 0, sizeof(shadow_copy));
+	dartt_mem_t part = {.buf = (unsigned char *)&ctl_copy.mp[3], .size = 5*sizeof(motor_params_t) + 3};
+	rc = dartt_read_multi_pipelined(&part, &ds);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(0, memcmp(&gl_periph.mp[3], &shadow_copy.mp[3], part.size));
+	TEST_ASSERT_EQUAL(0, shadow_copy.mp[2].fds.align_offset);
+
+	//refuses to run alongside the caller's own tagged reads
+	uint8_t tag = 0;
+	dartt_mem_t one = {.buf = (unsigned char *)&ctl_copy.m1_set, .size = sizeof(int32_t)};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_read_post(&one, &ds, &tag));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, dartt_read_multi_pipelined(&whole, &ds));
+	dartt_read_flush(&ds);
+	reorder_count = 0;
+
+	//a failed chunk flushes the outstanding requests
+	dartt_mem_t saved_alias = periph_alias;
+	periph_alias.size = sizeof(int32_t)*8;
+	rc = dartt_read_multi_pipelined(&whole, &ds);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, rc);
+	TEST_ASSERT_EQUAL(0, ds.num_pending);
+	periph_alias = saved_alias;
+	reorder_count = 0;
+
+	//writes are flushed right away, since no reception follows them
+	rc = dartt_ctl_write(&one, &ds);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, rc);
+	TEST_ASSERT_EQUAL(1, flush_count);
+	reorder_count = 0;
+
+	gl_msg_type = saved_msg;
+	memset(&gl_periph, 0, sizeof(gl_periph));
+}
+
+/*
+	Frame lengths seen on the link, for the frame_len_callback chunking test
+*/
+#define LEN_LOG_SIZE 64
+static size_t tx_len_log[LEN_LOG_SIZE];
+static size_t rx_len_log[LEN_LOG_SIZE];
+static int tx_len_count = 0;
+static int rx_len_count = 0;
+int len_log_tx_blocking(unsigned char addr, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	if(tx_len_count < LEN_LOG_SIZE)
+	{
+		tx_len_log[tx_len_count++] = tx->len;
+	}
+	return synctest_tx_blocking_fdcan(addr, tx, user_context, timeout);
+}
+
+int len_log_rx_blocking(dartt_buffer_t * rx, void * user_context, uint32_t timeout)
+{
+	int rc = synctest_rx_blocking_fdcan(rx, user_context, timeout);
+	if(rx_len_count < LEN_LOG_SIZE)
+	{
+		rx_len_log[rx_len_count++] = rx->len;
+	}
+	return rc;
+}
+
+void test_frame_len_chunking(void)
+{
+	test_struct_t ctl_copy = {};
+	test_struct_t shadow_copy = {};
+	dartt_sync_t ds = {};
+	ds.address = 3;
+	init_struct_mem(&ctl_copy, &ds.ctl_base);
+	init_struct_mem(&shadow_copy, &ds.periph_base);
+	ds.msg_type = TYPE_ADDR_CRC_MESSAGE;
+	dartt_init_buffer(&ds.tx_buf, tx_mem, 40);
+	dartt_init_buffer(&ds.rx_buf, rx_mem, 40);
+	ds.blocking_tx_callback = &len_log_tx_blocking;
+	ds.blocking_rx_callback = &len_log_rx_blocking;
+	ds.timeout_ms = 10;
+	p_sync_tx_buf = &ds.tx_buf;
+	dartt_mem_t whole = {.buf = (unsigned char *)&ctl_copy, .size = sizeof(ctl_copy)};
+	for(size_t i = 0; i < sizeof(ctl_copy); i++)
+	{
+		whole.buf[i] = (unsigned char)(i*7 + 1);
+	}
+
+	//without a frame length callback, chunks fill the buffer: 36 byte payloads in 38 byte frames
+	tx_len_count = 0;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_write_multi(&whole, &ds));
+	TEST_ASSERT_GREATER_THAN(2, tx_len_count);
+	TEST_ASSERT_EQUAL(38, tx_len_log[0]);
+
+	//CAN-FD: 38 bytes would go out in a 48 byte frame. 28 byte payloads fill a 32 byte frame instead
+	ds.frame_len_callback = &dartt_canfd_len;
+	memset(&gl_periph, 0, sizeof(gl_periph));
+	tx_len_count = 0;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_write_multi(&whole, &ds));
+	TEST_ASSERT_EQUAL((sizeof(ctl_copy) + 27)/28, tx_len_count);
+	for(int i = 0; i < tx_len_count - 1; i++)
+	{
+		TEST_ASSERT_EQUAL(30, tx_len_log[i]);
+		TEST_ASSERT_EQUAL(32, dartt_canfd_len(tx_len_log[i]));
+	}
+	TEST_ASSERT_EQUAL(0, memcmp(&gl_periph, &ctl_copy, sizeof(ctl_copy)));
+
+	rx_len_count = 0;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_read_multi(&whole, &ds));
+	for(int i = 0; i < rx_len_count - 1; i++)
+	{
+		TEST_ASSERT_EQUAL(30, rx_len_log[i]);
+	}
+	TEST_ASSERT_EQUAL(0, memcmp(&gl_periph, &shadow_copy, sizeof(shadow_copy)));
+
+	//buffers too small for a single word
+	dartt_init_buffer(&ds.tx_buf, tx_mem, 5);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_write_multi(&whole, &ds));
+
+	memset(&gl_periph, 0, sizeof(gl_periph));
+}
+
+/*
+	Lossy write link - the tx callback drops the frames whose sequence number is flagged in lossy_tx_drop_mask
+*/
+static uint32_t lossy_tx_count = 0;
+static uint64_t lossy_tx_drop_mask = 0;
+int lossy_tx_blocking(unsigned char addr, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	uint32_t n = lossy_tx_count++;
+	if(n < 64 && (lossy_tx_drop_mask & (1ULL << n)) != 0)
+	{
+		return DARTT_PROTOCOL_SUCCESS;	//lost on the link
+	}
+	return synctest_tx_blocking(addr, tx, user_context, timeout);
+}
+
+void test_bulk_write(void)
+{
+	serial_message_type_t saved_msg = gl_msg_type;
+	gl_msg_type = TYPE_SERIAL_MESSAGE;
+	memset(&gl_periph, 0, sizeof(gl_periph));
+	test_struct_t ctl_copy = {};
+	test_struct_t shadow_copy = {};
+	dartt_sync_t ds = {};
+	ds.address = 3;
+	init_struct_mem(&ctl_copy, &ds.ctl_base);
+	init_struct_mem(&shadow_copy, &ds.periph_base);
+	ds.msg_type = TYPE_SERIAL_MESSAGE;
+	dartt_init_buffer(&ds.tx_buf, tx_mem, sizeof(tx_mem));
+	dartt_init_buffer(&ds.rx_buf, rx_mem, sizeof(rx_mem));
+	ds.blocking_tx_callback = &lossy_tx_blocking;
+	ds.blocking_rx_callback = &synctest_rx_blocking;
+	ds.timeout_ms = 10;
+	ds.bulk_window = 4;
+	p_sync_tx_buf = &ds.tx_buf;
+	dartt_mem_t whole = {.buf = (unsigned char *)&ctl_copy, .size = sizeof(ctl_copy)};
+	for(size_t i = 0; i < sizeof(ctl_copy); i++)
+	{
+		whole.buf[i] = (unsigned char)(i*13 + 5);
+	}
+	size_t wsize = sizeof(tx_mem) - (NUM_BYTES_ADDRESS + NUM_BYTES_INDEX + NUM_BYTES_CHECKSUM);
+	wsize -= wsize % sizeof(uint32_t);
+	uint32_t num_chunks = (uint32_t)((sizeof(ctl_copy) + wsize - 1)/wsize);
+	uint32_t num_windows = (num_chunks + 3)/4;
+
+	//clean link: every window costs one CRC32 query
+	lossy_tx_count = 0;
+	lossy_tx_drop_mask = 0;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_bulk_write(&whole, &ds));
+	TEST_ASSERT_EQUAL(0, memcmp(&gl_periph, &ctl_copy, sizeof(ctl_copy)));
+	TEST_ASSERT_EQUAL(0, memcmp(&shadow_copy, &ctl_copy, sizeof(ctl_copy)));
+	TEST_ASSERT_EQUAL(num_chunks + num_windows, lossy_tx_count);
+
+	uint32_t crc = 0;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_read_crc32(&whole, &ds, &crc));
+	TEST_ASSERT_EQUAL_HEX32(dartt_crc32(whole.buf, whole.size), crc);
+
+	//no policy: a lost frame fails its window
+	for(size_t i = 0; i < sizeof(ctl_copy); i++)
+	{
+		whole.buf[i] ^= 0x5A;
+	}
+	lossy_tx_count = 0;
+	lossy_tx_drop_mask = (1ULL << 1);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_SYNC_MISMATCH, dartt_bulk_write(&whole, &ds));
+	TEST_ASSERT_EQUAL(0, ds.retry_stats.retries);
+
+	//repairs are retries of DARTT_ERROR_SYNC_MISMATCH, so the mask must name it
+	ds.retry.max_attempts = 3;
+	ds.retry.backoff_ms = 2;
+	ds.retry.retry_mask = DARTT_RETRY_DEFAULT_MASK;
+	ds.retry.delay_callback = &record_delay;
+	delay_calls = 0;
+	lossy_tx_count = 0;
+	lossy_tx_drop_mask = (1ULL << 1);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_SYNC_MISMATCH, dartt_bulk_write(&whole, &ds));
+	TEST_ASSERT_EQUAL(0, ds.retry_stats.retries);
+	TEST_ASSERT_EQUAL(0, delay_calls);
+
+	//with it, only the chunk that did not land is sent again, after the backoff
+	ds.retry.retry_mask = DARTT_RETRY_DEFAULT_MASK | DARTT_RETRY_BIT(DARTT_ERROR_SYNC_MISMATCH);
+	delay_calls = 0;
+	delay_total_ms = 0;
+	lossy_tx_count = 0;
+	lossy_tx_drop_mask = (1ULL << 1) | (1ULL << 11);	//second chunk of the first window, first chunk of the second (after 6 repair frames)
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_bulk_write(&whole, &ds));
+	TEST_ASSERT_EQUAL(0, memcmp(&gl_periph, &ctl_copy, sizeof(ctl_copy)));
+	TEST_ASSERT_EQUAL(0, memcmp(&shadow_copy, &ctl_copy, sizeof(ctl_copy)));
+	TEST_ASSERT_EQUAL(2, ds.retry_stats.retries);
+	TEST_ASSERT_EQUAL(2, ds.retry_stats.recovered);
+	TEST_ASSERT_EQUAL(num_chunks + num_windows + 2*(4 + 1 + 1), lossy_tx_count);	//per window: a query per chunk, one resend, one more window query
+	TEST_ASSERT_EQUAL(2, delay_calls);	//one backoff per repair round
+	TEST_ASSERT_EQUAL(4, delay_total_ms);
+
+	//a write the peripheral never applies exhausts the policy
+	memset(&ds.retry_stats, 0, sizeof(ds.retry_stats));
+	dartt_mem_t saved_alias = periph_alias;
+	periph_alias.size = sizeof(int32_t)*8;
+	dartt_mem_t head = {.buf = whole.buf, .size = sizeof(int32_t)*16};
+	head.buf[40] ^= 0xFF;
+	lossy_tx_drop_mask = 0;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_bulk_write(&head, &ds));	//the query is rejected with an error reply
+	periph_alias = saved_alias;
+	ds.retry.max_attempts = 2;
+	lossy_tx_count = 0;
+	lossy_tx_drop_mask = (1ULL << 0) | (1ULL << 2);	//the chunk and its resend
+	dartt_mem_t word = {.buf = whole.buf, .size = sizeof(int32_t)};
+	whole.buf[0] ^= 0xFF;
+	delay_calls = 0;
+	delay_total_ms = 0;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_SYNC_MISMATCH, dartt_bulk_write(&word, &ds));
+	TEST_ASSERT_EQUAL(1, ds.retry_stats.retries);
+	TEST_ASSERT_EQUAL(1, ds.retry_stats.exhausted);
+	TEST_ASSERT_EQUAL(1, delay_calls);	//no backoff once the attempts are exhausted
+	TEST_ASSERT_EQUAL(2, delay_total_ms);
+
+	//unaligned regions are rejected
+	dartt_mem_t unaligned = {.buf = whole.buf + 2, .size = 8};
+	TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, dartt_bulk_write(&unaligned, &ds));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, dartt_read_crc32(&unaligned, &ds, &crc));
+
+	lossy_tx_drop_mask = 0;
+	gl_msg_type = saved_msg;
+	memset(&gl_periph, 0, sizeof(gl_periph));
+}
+
+/*
+	Reordering link that drops the requests flagged in reorder_drop_mask, and times out when no reply is left
+*/
+static uint32_t reorder_tx_count = 0;
+static uint64_t reorder_drop_mask = 0;
+static int mutate_on_crc32 = 0;
+int lossy_reorder_tx_blocking(unsigned char addr, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	uint32_t n = reorder_tx_count++;
+	if(n < 64 && (reorder_drop_mask & (1ULL << n)) != 0)
+	{
+		return DARTT_PROTOCOL_SUCCESS;
+	}
+	if(mutate_on_crc32 && tx->len >= NUM_BYTES_INDEX && tx->buf[0] == (DARTT_INDEX_CRC32 & 0xFF))
+	{
+		gl_periph.m1_set++;	//the peripheral changes its memory before the final check
+	}
+	return reorder_tx_blocking(addr, tx, user_context, timeout);
+}
+
+int quiet_reorder_rx_blocking(dartt_buffer_t * rx, void * user_context, uint32_t timeout)
+{
+	if(reorder_count == 0)
+	{
+		rx->len = 0;
+		return DARTT_ERROR_TIMEOUT;
+	}
+	return reorder_rx_blocking(rx, user_context, timeout);
+}
+
+void test_bulk_read(void)
+{
+	serial_message_type_t saved_msg = gl_msg_type;
+	gl_msg_type = TYPE_ADDR_CRC_MESSAGE;
+	reorder_count = 0;
+	unsigned char * p = (unsigned char *)&gl_periph;
+	for(size_t i = 0; i < sizeof(gl_periph); i++)
+	{
+		p[i] = (unsigned char)(i*11 + 3);
+	}
+	test_struct_t ctl_copy = {};
+	test_struct_t shadow_copy = {};
+	dartt_sync_t ds = {};
+	ds.address = 3;
+	init_struct_mem(&ctl_copy, &ds.ctl_base);
+	init_struct_mem(&shadow_copy, &ds.periph_base);
+	ds.msg_type = TYPE_ADDR_CRC_MESSAGE;
+	dartt_init_buffer(&ds.tx_buf, tx_mem, sizeof(tx_mem));
+	dartt_init_buffer(&ds.rx_buf, rx_mem, sizeof(rx_mem));
+	ds.blocking_tx_callback = &lossy_reorder_tx_blocking;
+	ds.blocking_rx_callback = &quiet_reorder_rx_blocking;
+	ds.timeout_ms = 10;
+	dartt_mem_t whole = {.buf = (unsigned char *)&ctl_copy, .size = sizeof(ctl_copy)};
+
+	//clean link, replies out of order
+	reorder_tx_count = 0;
+	reorder_drop_mask = 0;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_bulk_read(&whole, &ds));
+	TEST_ASSERT_EQUAL(0, memcmp(&gl_periph, &shadow_copy, sizeof(shadow_copy)));
+	TEST_ASSERT_EQUAL(0, ds.num_pending);
+
+	//no policy: a lost request fails the transfer
+	memset(&shadow_copy, 0, sizeof(shadow_copy));
+	reorder_tx_count = 0;
+	reorder_drop_mask = (1ULL << 1);
+	TEST_ASSERT_EQUAL(DARTT_ERROR_TIMEOUT, dartt_bulk_read(&whole, &ds));
+	TEST_ASSERT_EQUAL(0, ds.num_pending);
+	reorder_count = 0;
+
+	//with a policy, only the lost requests are posted again
+	ds.retry.max_attempts = 3;
+	ds.retry.retry_mask = DARTT_RETRY_DEFAULT_MASK;
+	reorder_tx_count = 0;
+	reorder_drop_mask = (1ULL << 1) | (1ULL << 5) | (1ULL << 12);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_bulk_read(&whole, &ds));
+	TEST_ASSERT_EQUAL(0, memcmp(&gl_periph, &shadow_copy, sizeof(shadow_copy)));
+	TEST_ASSERT_EQUAL(0, ds.num_pending);
+	TEST_ASSERT_GREATER_OR_EQUAL(1, ds.retry_stats.retries);
+	TEST_ASSERT_EQUAL(ds.retry_stats.retries, ds.retry_stats.recovered);
+	size_t rsize = sizeof(rx_mem) - (NUM_BYTES_INDEX + NUM_BYTES_TAG);
+	rsize -= rsize % sizeof(uint32_t);
+	uint32_t num_chunks = (uint32_t)((sizeof(ctl_copy) + rsize - 1)/rsize);
+	TEST_ASSERT_EQUAL(num_chunks + 3 + 1, reorder_tx_count);	//each chunk once, the lost ones again, and the CRC32 query
+
+	//memory that changes during the transfer fails the final check
+	reorder_drop_mask = 0;
+	mutate_on_crc32 = 1;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_SYNC_MISMATCH, dartt_bulk_read(&whole, &ds));
+	mutate_on_crc32 = 0;
+
+	//refuses to run alongside the caller's own tagged reads
+	uint8_t tag = 0;
+	dartt_mem_t one = {.buf = (unsigned char *)&ctl_copy.m1_set, .size = sizeof(int32_t)};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_read_post(&one, &ds, &tag));
+	TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, dartt_bulk_read(&whole, &ds));
+	dartt_read_flush(&ds);
+	reorder_count = 0;
+
+	gl_msg_type = saved_msg;
+	memset(&gl_periph, 0, sizeof(gl_periph));
+}
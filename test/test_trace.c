@@ -0,0 +1,200 @@
+#include "dartt.h"
+#include "dartt_sync.h"
+#include "dartt_trace.h"
+#include "unity.h"
+#include <string.h>
+
+typedef struct trace_regs_t
+{
+	int32_t setpoint[4];
+	int32_t status[4];
+}trace_regs_t;
+
+static trace_regs_t gl_periph;
+static uint32_t gl_now;
+static unsigned char gl_reply_mem[64];
+static dartt_buffer_t gl_reply = {.buf = gl_reply_mem, .size = sizeof(gl_reply_mem), .len = 0};
+static unsigned char gl_capture[2048];
+static size_t gl_capture_len;
+
+static uint32_t trace_test_clock(void * user_context)
+{
+	return gl_now;
+}
+
+static int trace_test_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	gl_now += 100;
+	payload_layer_msg_t pld = {};
+	int rc = dartt_frame_to_payload(tx, TYPE_SERIAL_MESSAGE, PAYLOAD_ALIAS, &pld);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	dartt_mem_t periph = {.buf = (unsigned char *)&gl_periph, .size = sizeof(gl_periph)};
+	gl_reply.len = 0;
+	return dartt_parse_general_message(&pld, TYPE_SERIAL_MESSAGE, &periph, &gl_reply);
+}
+
+static int trace_test_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout)
+{
+	gl_now += 50;
+	memcpy(rx->buf, gl_reply.buf, gl_reply.len);
+	rx->len = gl_reply.len;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+static int trace_test_write(const unsigned char * buf, size_t len, void * user_context)
+{
+	if(gl_capture_len + len > sizeof(gl_capture))
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	memcpy(&gl_capture[gl_capture_len], buf, len);
+	gl_capture_len += len;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+static uint32_t get_u32(const unsigned char * p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void test_trace_ring(void)
+{
+	static dartt_trace_record_t records[4];
+	dartt_trace_t trace = {};
+	TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, dartt_trace_init(&trace, records, 3));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_trace_init(&trace, records, 4));
+
+	unsigned char frame_mem[DARTT_TRACE_SNAPLEN + 16];
+	for(size_t i = 0; i < sizeof(frame_mem); i++)
+	{
+		frame_mem[i] = (unsigned char)i;
+	}
+	for(int i = 1; i <= 6; i++)
+	{
+		dartt_buffer_t frame = {.buf = frame_mem, .size = sizeof(frame_mem), .len = (size_t)i};
+		dartt_trace_frame(&trace, (i % 2) ? DARTT_TRACE_TX : DARTT_TRACE_RX, TYPE_ADDR_CRC_MESSAGE, 0x80 + i, &frame);
+	}
+	TEST_ASSERT_EQUAL(6, trace.head);
+
+	//the oldest slot is the next to be overwritten, so the last 3 frames are readable
+	dartt_trace_record_t out[8];
+	uint32_t cursor = 0;
+	uint32_t lost = 0;
+	TEST_ASSERT_EQUAL(3, dartt_trace_read(&trace, &cursor, out, 8, &lost));
+	TEST_ASSERT_EQUAL(3, lost);
+	TEST_ASSERT_EQUAL(6, cursor);
+	for(int i = 0; i < 3; i++)
+	{
+		TEST_ASSERT_EQUAL(i + 4, out[i].len);
+		TEST_ASSERT_EQUAL(0x84 + i, out[i].address);
+		TEST_ASSERT_EQUAL(TYPE_ADDR_CRC_MESSAGE, out[i].msg_type);
+		TEST_ASSERT_EQUAL_MEMORY(frame_mem, out[i].data, out[i].len);
+	}
+	TEST_ASSERT_EQUAL(DARTT_TRACE_RX, out[0].dir);
+	TEST_ASSERT_EQUAL(DARTT_TRACE_TX, out[1].dir);
+	TEST_ASSERT_EQUAL(0, dartt_trace_read(&trace, &cursor, out, 8, &lost));
+
+	//long frames keep their length but only DARTT_TRACE_SNAPLEN bytes
+	dartt_buffer_t frame = {.buf = frame_mem, .size = sizeof(frame_mem), .len = sizeof(frame_mem)};
+	dartt_trace_frame(&trace, DARTT_TRACE_TX, TYPE_SERIAL_MESSAGE, 0x81, &frame);
+	TEST_ASSERT_EQUAL(1, dartt_trace_read(&trace, &cursor, out, 1, NULL));
+	TEST_ASSERT_EQUAL(sizeof(frame_mem), out[0].len);
+	TEST_ASSERT_EQUAL_MEMORY(frame_mem, out[0].data, DARTT_TRACE_SNAPLEN);
+}
+
+void test_trace_sync_and_pcapng(void)
+{
+	static dartt_trace_record_t records[4];
+	static dartt_trace_t trace;
+	memset(&trace, 0, sizeof(trace));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_trace_init(&trace, records, 4));
+	trace.clock_callback = &trace_test_clock;
+	gl_now = 0xFFFFFFC0u;
+
+	trace_regs_t ctl = {};
+	trace_regs_t shadow = {};
+	unsigned char tx_mem[32];
+	unsigned char rx_mem[32];
+	dartt_sync_t ds = {};
+	ds.address = 3;
+	ds.ctl_base = (dartt_mem_t){.buf = (unsigned char *)&ctl, .size = sizeof(ctl)};
+	ds.periph_base = (dartt_mem_t){.buf = (unsigned char *)&shadow, .size = sizeof(shadow)};
+	ds.msg_type = TYPE_SERIAL_MESSAGE;
+	ds.tx_buf = (dartt_buffer_t){.buf = tx_mem, .size = sizeof(tx_mem), .len = 0};
+	ds.rx_buf = (dartt_buffer_t){.buf = rx_mem, .size = sizeof(rx_mem), .len = 0};
+	ds.blocking_tx_callback = &trace_test_tx;
+	ds.blocking_rx_callback = &trace_test_rx;
+	ds.timeout_ms = 10;
+	ds.trace = &trace;
+
+	//request [address][index][num_bytes][crc] = 7 bytes, captured as it is handed to the tx callback. Reply = 9 bytes
+	gl_periph.status[0] = 42;
+	dartt_mem_t status = {.buf = (unsigned char *)&ctl.status[0], .size = sizeof(int32_t)};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_ctl_read(&status, &ds));
+	TEST_ASSERT_EQUAL(2, trace.head);
+	TEST_ASSERT_EQUAL(DARTT_TRACE_TX, records[0].dir);
+	TEST_ASSERT_EQUAL(dartt_get_complementary_address(3), records[0].address);
+	TEST_ASSERT_EQUAL(7, records[0].len);
+	TEST_ASSERT_EQUAL_MEMORY(tx_mem, records[0].data, 7);
+	TEST_ASSERT_EQUAL(0xFFFFFFC0u, records[0].timestamp);
+	TEST_ASSERT_EQUAL(DARTT_TRACE_RX, records[1].dir);
+	TEST_ASSERT_EQUAL(9, records[1].len);
+	TEST_ASSERT_EQUAL(0x56, records[1].timestamp);	//150 ticks later, the clock wrapped
+
+	gl_capture_len = 0;
+	dartt_pcapng_writer_t writer = {.write_callback = &trace_test_write};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_trace_export_pcapng(&trace, &writer));
+	TEST_ASSERT_EQUAL(2, writer.cursor);
+
+	//section header, interface description with the link type and microsecond timestamps
+	TEST_ASSERT_EQUAL(0x0A0D0D0Au, get_u32(&gl_capture[0]));
+	TEST_ASSERT_EQUAL(0x1A2B3C4Du, get_u32(&gl_capture[8]));
+	const unsigned char * idb = &gl_capture[28];
+	TEST_ASSERT_EQUAL(1, get_u32(idb));
+	TEST_ASSERT_EQUAL(DARTT_TRACE_LINKTYPE, get_u32(idb + 8) & 0xFFFF);
+	TEST_ASSERT_EQUAL(9, get_u32(idb + 16) & 0xFFFF);	//if_tsresol
+	TEST_ASSERT_EQUAL(6, idb[20]);
+
+	//enhanced packet blocks: pseudo-header, frame, epb_flags with the direction
+	const unsigned char * epb = idb + get_u32(idb + 4);
+	TEST_ASSERT_EQUAL(6, get_u32(epb));
+	TEST_ASSERT_EQUAL(0, get_u32(epb + 12));
+	TEST_ASSERT_EQUAL(0xFFFFFFC0u, get_u32(epb + 16));
+	TEST_ASSERT_EQUAL(DARTT_TRACE_PSEUDO_HEADER_LEN + 7, get_u32(epb + 20));
+	TEST_ASSERT_EQUAL(DARTT_TRACE_TX, epb[28]);
+	TEST_ASSERT_EQUAL(TYPE_SERIAL_MESSAGE, epb[29]);
+	TEST_ASSERT_EQUAL(dartt_get_complementary_address(3), epb[30]);
+	TEST_ASSERT_EQUAL_MEMORY(tx_mem, &epb[32], 7);
+	TEST_ASSERT_EQUAL(2, get_u32(epb + 40) & 0xFFFF);	//epb_flags after the padded packet
+	TEST_ASSERT_EQUAL(2, get_u32(epb + 44));	//outbound
+	uint32_t epb_len = get_u32(epb + 4);
+	TEST_ASSERT_EQUAL(epb_len, get_u32(epb + epb_len - 4));
+	epb += epb_len;
+	TEST_ASSERT_EQUAL(1, get_u32(epb + 12));	//timestamps are unwrapped to 64 bits
+	TEST_ASSERT_EQUAL(0x56, get_u32(epb + 16));
+	TEST_ASSERT_EQUAL(DARTT_TRACE_RX, epb[28]);
+	TEST_ASSERT_EQUAL((size_t)(epb + get_u32(epb + 4) - gl_capture), gl_capture_len);
+
+	//later calls append: three reads overrun the 4 record ring, and the loss is reported on the next packet
+	size_t appended = gl_capture_len;
+	for(int i = 0; i < 3; i++)
+	{
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_ctl_read(&status, &ds));
+	}
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_trace_export_pcapng(&trace, &writer));
+	TEST_ASSERT_EQUAL(3, writer.lost);
+	epb = &gl_capture[appended];
+	TEST_ASSERT_EQUAL(6, get_u32(epb));
+	TEST_ASSERT_EQUAL(DARTT_TRACE_RX, epb[28]);	//the reply of the second read is the oldest readable frame
+	TEST_ASSERT_EQUAL(4, get_u32(epb + 52) & 0xFFFF);	//epb_dropcount follows epb_flags
+	TEST_ASSERT_EQUAL(3, get_u32(epb + 56));
+	size_t blocks = 0;
+	for(size_t off = appended; off < gl_capture_len; off += get_u32(&gl_capture[off + 4]))
+	{
+		blocks++;
+	}
+	TEST_ASSERT_EQUAL(3, blocks);
+}
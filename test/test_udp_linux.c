@@ -0,0 +1,150 @@
+#define _GNU_SOURCE
+#include "dartt.h"
+#include "dartt_sync.h"
+#include "dartt_periph.h"
+#include "dartt_udp_linux.h"
+#include "sim_periph.h"
+#include "unity.h"
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+/*
+	The controller runs dartt_sync_t through the UDP transport against a simulated peripheral on the loopback
+	interface, served from a thread with plain recvfrom/sendto (sim_dgram_t).
+*/
+
+static sim_dgram_t periph_sock;
+
+void setUp(void)
+{
+	periph_sock.fd = -1;
+}
+
+void tearDown(void)
+{
+	if(periph_sock.fd >= 0)
+	{
+		close(periph_sock.fd);
+	}
+}
+
+/*
+	Frames are queued by the tx callback, and only reach the socket on flush
+*/
+void test_udp_linux_batching(void)
+{
+	uint16_t port_num = sim_dgram_bind(&periph_sock);
+	if(port_num == 0)
+	{
+		TEST_IGNORE_MESSAGE("no loopback networking");
+	}
+	int periph_fd = periph_sock.fd;
+	static dartt_udp_linux_t port;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_udp_linux_open(&port, "127.0.0.1", port_num, 0));
+
+	unsigned char frame_mem[4][8];
+	for(int i = 0; i < 4; i++)
+	{
+		memset(frame_mem[i], 0x10 + i, sizeof(frame_mem[i]));
+		dartt_buffer_t frame = {.buf = frame_mem[i], .size = sizeof(frame_mem[i]), .len = (size_t)(i + 1)};
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_udp_linux_tx(0, &frame, &port, 10));
+	}
+	unsigned char buf[64];
+	TEST_ASSERT_EQUAL(-1, recv(periph_fd, buf, sizeof(buf), MSG_DONTWAIT));
+	TEST_ASSERT_EQUAL(EAGAIN, errno);
+
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_udp_linux_flush(&port, 10));
+	TEST_ASSERT_EQUAL(0, port.tx_count);
+	for(int i = 0; i < 4; i++)
+	{
+		ssize_t n = recv(periph_fd, buf, sizeof(buf), MSG_DONTWAIT);
+		TEST_ASSERT_EQUAL(i + 1, n);
+		TEST_ASSERT_EQUAL(0x10 + i, buf[0]);
+	}
+
+	//replies sent back to back are drained together, and handed out one per call in order
+	struct sockaddr_in ctl_addr;
+	socklen_t ctl_len = sizeof(ctl_addr);
+	TEST_ASSERT_EQUAL(0, getsockname(port.fd, (struct sockaddr *)&ctl_addr, &ctl_len));
+	for(int i = 0; i < 3; i++)
+	{
+		TEST_ASSERT_EQUAL(i + 2, sendto(periph_fd, frame_mem[i], i + 2, 0, (struct sockaddr *)&ctl_addr, ctl_len));
+	}
+	usleep(1000);
+	unsigned char rx_mem[16];
+	dartt_buffer_t rx = {.buf = rx_mem, .size = sizeof(rx_mem), .len = 0};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_udp_linux_rx(&rx, &port, 100));
+	TEST_ASSERT_EQUAL(2, rx.len);
+	TEST_ASSERT_EQUAL(3, port.rx_count);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_udp_linux_rx(&rx, &port, 100));
+	TEST_ASSERT_EQUAL(3, rx.len);
+	TEST_ASSERT_EQUAL(0x11, rx.buf[0]);
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_udp_linux_rx(&rx, &port, 100));
+	TEST_ASSERT_EQUAL(4, rx.len);
+
+	//too small for the next datagram
+	TEST_ASSERT_EQUAL(5, sendto(periph_fd, buf, 5, 0, (struct sockaddr *)&ctl_addr, ctl_len));
+	rx.size = 4;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_MEMORY_OVERRUN, dartt_udp_linux_rx(&rx, &port, 100));
+	rx.size = sizeof(rx_mem);
+
+	TEST_ASSERT_EQUAL(DARTT_ERROR_TIMEOUT, dartt_udp_linux_rx(&rx, &port, 5));
+	dartt_udp_linux_close(&port);
+}
+
+void test_udp_linux_loopback_sync(void)
+{
+	uint16_t port_num = sim_dgram_bind(&periph_sock);
+	if(port_num == 0)
+	{
+		TEST_IGNORE_MESSAGE("no loopback networking");
+	}
+	static sim_periph_t sim;
+	sim_link_t sim_link = {TYPE_ADDR_CRC_MESSAGE, &sim_dgram_tx, &sim_dgram_rx, &periph_sock, 0};
+	sim_periph_init(&sim, &sim_link);
+	TEST_ASSERT_EQUAL(0, sim_periph_start(&sim));
+
+	static dartt_udp_linux_t port;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_udp_linux_open(&port, "127.0.0.1", port_num, 0));
+	sim_regs_t ctl = {};
+	sim_regs_t shadow = {};
+	unsigned char tx_mem[64];
+	unsigned char rx_mem[64];
+	dartt_sync_t ds;
+	sim_link_t ctl_link = {TYPE_ADDR_CRC_MESSAGE, &dartt_udp_linux_tx, &dartt_udp_linux_rx, &port, 0};
+	sim_sync_init(&ds, &ctl_link, &ctl, &shadow, sizeof(ctl), tx_mem, rx_mem, sizeof(tx_mem));
+	ds.flush_tx_callback = &dartt_udp_linux_flush;
+	dartt_mem_t ctl_alias = {.buf = (unsigned char *)&ctl, .size = sizeof(ctl)};
+
+	ctl.setpoint[0] = 11;
+	ctl.setpoint[63] = -7;
+	ctl.flags = 0xA5A5;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_sync(&ctl_alias, &ds));
+	TEST_ASSERT_EQUAL(0, memcmp(&ctl, &shadow, sizeof(ctl)));
+	TEST_ASSERT_EQUAL(-7, sim.regs.setpoint[63]);
+
+	//plain writes are flushed without waiting for a reception
+	ctl.status = 99;
+	dartt_mem_t status = {.buf = (unsigned char *)&ctl.status, .size = sizeof(int32_t)};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_ctl_write(&status, &ds));
+	TEST_ASSERT_EQUAL(0, port.tx_count);
+
+	//pipelined read of the whole block, several chunks per window
+	for(int i = 0; i < 64; i++)
+	{
+		sim.regs.setpoint[i] = 1000 + i;
+	}
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_read_multi_pipelined(&ctl_alias, &ds));
+	for(int i = 0; i < 64; i++)
+	{
+		TEST_ASSERT_EQUAL(1000 + i, shadow.setpoint[i]);
+	}
+	TEST_ASSERT_EQUAL(0xA5A5, shadow.flags);
+
+	sim_periph_stop(&sim);
+	TEST_ASSERT_EQUAL(99, sim.regs.status);
+	dartt_udp_linux_close(&port);
+}
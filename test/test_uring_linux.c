@@ -0,0 +1,193 @@
+#define _GNU_SOURCE
+#include "dartt.h"
+#include "dartt_sync.h"
+#include "dartt_periph.h"
+#include "dartt_serial_linux.h"
+#include "dartt_uring_linux.h"
+#include "sim_periph.h"
+#include "unity.h"
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/*
+	A single thread drives several dartt_sync_t instances through one io_uring: UDP peripherals simulated on the
+	loopback interface, and a COBS stream peripheral on a pty pair served through the serial transport.
+*/
+
+#define NUM_UDP_PERIPHS	8
+
+static dartt_uring_linux_t ring;
+
+void setUp(void)
+{
+	memset(&ring, 0, sizeof(ring));
+	ring.ring_fd = -1;
+}
+
+void tearDown(void)
+{
+	dartt_uring_linux_exit(&ring);
+}
+
+static void init_sync(dartt_sync_t * ds, serial_message_type_t type, sim_regs_t * ctl, sim_regs_t * shadow, dartt_uring_linux_ep_t * ep, unsigned char * tx_mem, unsigned char * rx_mem, size_t mem_size)
+{
+	sim_link_t link = {type, &dartt_uring_linux_tx, &dartt_uring_linux_rx, ep, 0};
+	sim_sync_init(ds, &link, ctl, shadow, sizeof(sim_regs_t), tx_mem, rx_mem, mem_size);
+	ds->flush_tx_callback = &dartt_uring_linux_flush;
+	ds->timeout_ms = 0;		//never block. The loop waits on the ring instead
+}
+
+/*
+	Read every peripheral in full, posting all requests first and then handling replies as the ring reports them
+*/
+void test_uring_linux_udp_single_thread(void)
+{
+	if(dartt_uring_linux_init(&ring) != DARTT_PROTOCOL_SUCCESS)
+	{
+		TEST_IGNORE_MESSAGE("io_uring unavailable");
+	}
+	static sim_dgram_t socks[NUM_UDP_PERIPHS];
+	static sim_periph_t sims[NUM_UDP_PERIPHS];
+	static dartt_uring_linux_ep_t eps[NUM_UDP_PERIPHS];
+	int ctl_fd[NUM_UDP_PERIPHS];
+	for(int i = 0; i < NUM_UDP_PERIPHS; i++)
+	{
+		uint16_t port_num = sim_dgram_bind(&socks[i]);
+		TEST_ASSERT_NOT_EQUAL(0, port_num);
+		struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port_num), .sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)}};
+		ctl_fd[i] = socket(AF_INET, SOCK_DGRAM, 0);
+		TEST_ASSERT_EQUAL(0, connect(ctl_fd[i], (struct sockaddr *)&addr, sizeof(addr)));
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_uring_linux_add(&ring, &eps[i], ctl_fd[i], DARTT_URING_DGRAM));
+
+		sim_link_t sim_link = {TYPE_ADDR_CRC_MESSAGE, &sim_dgram_tx, &sim_dgram_rx, &socks[i], 0};
+		sim_periph_init(&sims[i], &sim_link);
+		for(int j = 0; j < 64; j++)
+		{
+			sims[i].regs.setpoint[j] = 100*i + j;
+		}
+		sims[i].regs.status = -i;
+		TEST_ASSERT_EQUAL(0, sim_periph_start(&sims[i]));
+	}
+
+	static sim_regs_t ctl[NUM_UDP_PERIPHS];
+	static sim_regs_t shadow[NUM_UDP_PERIPHS];
+	static unsigned char tx_mem[NUM_UDP_PERIPHS][512];
+	static unsigned char rx_mem[NUM_UDP_PERIPHS][512];
+	static dartt_sync_t ds[NUM_UDP_PERIPHS];
+	for(int i = 0; i < NUM_UDP_PERIPHS; i++)
+	{
+		memset(&shadow[i], 0, sizeof(sim_regs_t));
+		init_sync(&ds[i], TYPE_ADDR_CRC_MESSAGE, &ctl[i], &shadow[i], &eps[i], tx_mem[i], rx_mem[i], sizeof(tx_mem[i]));
+		dartt_mem_t whole = {.buf = (unsigned char *)&ctl[i], .size = sizeof(sim_regs_t)};
+		uint8_t tag = 0;
+		TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_read_post(&whole, &ds[i], &tag));
+	}
+	TEST_ASSERT_EQUAL(0, ring.enters);	//nothing sent yet: all requests go out with the first io_uring_enter
+
+	int done = 0;
+	int loops = 0;
+	while(done < NUM_UDP_PERIPHS && loops++ < 100)
+	{
+		TEST_ASSERT_GREATER_OR_EQUAL(0, dartt_uring_linux_run(&ring, 100));
+		for(int i = 0; i < NUM_UDP_PERIPHS; i++)
+		{
+			if(ds[i].num_pending != 0 && dartt_uring_linux_ready(&eps[i]))
+			{
+				uint8_t tag = 0;
+				TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_read_poll(&ds[i], &tag));
+				done++;
+			}
+		}
+	}
+	TEST_ASSERT_EQUAL(NUM_UDP_PERIPHS, done);
+	TEST_ASSERT_LESS_THAN(NUM_UDP_PERIPHS + 2, ring.enters);	//one submission for all requests, then at most one wait per reply
+	for(int i = 0; i < NUM_UDP_PERIPHS; i++)
+	{
+		TEST_ASSERT_EQUAL(0, memcmp(&sims[i].regs, &shadow[i], sizeof(sim_regs_t)));
+		TEST_ASSERT_EQUAL(0, eps[i].tx_failed);
+	}
+
+	//blocking use of a single endpoint through the same ring
+	ds[2].timeout_ms = 200;
+	ctl[2] = shadow[2];
+	ctl[2].flags = 0xF00D;
+	dartt_mem_t whole = {.buf = (unsigned char *)&ctl[2], .size = sizeof(sim_regs_t)};
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_sync(&whole, &ds[2]));
+	TEST_ASSERT_EQUAL(0xF00D, shadow[2].flags);
+
+	//no reply, no wait
+	ds[2].timeout_ms = 0;
+	uint8_t tag = 0;
+	TEST_ASSERT_EQUAL(DARTT_ERROR_TIMEOUT, dartt_read_poll(&ds[2], &tag));
+
+	for(int i = 0; i < NUM_UDP_PERIPHS; i++)
+	{
+		sim_periph_stop(&sims[i]);
+		close(socks[i].fd);
+		close(ctl_fd[i]);
+	}
+	TEST_ASSERT_EQUAL(0xF00D, sims[2].regs.flags);
+}
+
+void test_uring_linux_cobs_stream(void)
+{
+	if(dartt_uring_linux_init(&ring) != DARTT_PROTOCOL_SUCCESS)
+	{
+		TEST_IGNORE_MESSAGE("io_uring unavailable");
+	}
+	int master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if(master_fd < 0 || grantpt(master_fd) != 0 || unlockpt(master_fd) != 0)
+	{
+		TEST_IGNORE_MESSAGE("no pty support");
+	}
+	int slave_fd = open(ptsname(master_fd), O_RDWR | O_NOCTTY);
+	TEST_ASSERT_GREATER_OR_EQUAL(0, slave_fd);
+	static dartt_serial_linux_t sim_port;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_serial_linux_attach(&sim_port, master_fd, 0));
+	static sim_periph_t sim;
+	sim_link_t sim_link = {TYPE_SERIAL_MESSAGE, &dartt_serial_linux_tx, &dartt_serial_linux_rx, &sim_port, 0};
+	sim_periph_init(&sim, &sim_link);
+	TEST_ASSERT_EQUAL(0, sim_periph_start(&sim));
+
+	//the serial transport does the line setup, the ring does the I/O
+	static dartt_serial_linux_t line;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_serial_linux_attach(&line, slave_fd, 115200));
+	static dartt_uring_linux_ep_t ep;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_uring_linux_add(&ring, &ep, line.fd, DARTT_URING_COBS));
+	sim_regs_t ctl = {};
+	sim_regs_t shadow = {};
+	unsigned char tx_mem[64];
+	unsigned char rx_mem[64];
+	dartt_sync_t ds;
+	init_sync(&ds, TYPE_SERIAL_MESSAGE, &ctl, &shadow, &ep, tx_mem, rx_mem, sizeof(tx_mem));
+	ds.timeout_ms = 200;
+	dartt_mem_t whole = {.buf = (unsigned char *)&ctl, .size = sizeof(ctl)};
+
+	//values with embedded zero bytes exercise the COBS stuffing
+	ctl.setpoint[0] = 0x00110022;
+	ctl.setpoint[15] = -1;
+	ctl.flags = 0x80000000;
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_sync(&whole, &ds));
+	TEST_ASSERT_EQUAL(0, memcmp(&ctl, &shadow, sizeof(ctl)));
+
+	//replies arriving back to back in one read are split into frames
+	sim.regs.status = 0x12003400;
+	memset(&shadow, 0, sizeof(shadow));
+	TEST_ASSERT_EQUAL(DARTT_PROTOCOL_SUCCESS, dartt_read_multi_pipelined(&whole, &ds));
+	TEST_ASSERT_EQUAL(0, memcmp(&sim.regs, &shadow, sizeof(shadow)));
+
+	//the other end going away stops the endpoint
+	sim_periph_stop(&sim);
+	dartt_serial_linux_close(&sim_port);
+	close(master_fd);
+	dartt_mem_t status = {.buf = (unsigned char *)&ctl.status, .size = sizeof(int32_t)};
+	TEST_ASSERT_EQUAL(DARTT_ERROR_INVALID_ARGUMENT, dartt_ctl_read(&status, &ds));
+	TEST_ASSERT_NOT_EQUAL(0, ep.error);
+	dartt_serial_linux_close(&line);
+	close(slave_fd);
+}
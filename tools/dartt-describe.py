@@ -15,7 +15,9 @@ Requires: pyelftools (pip install pyelftools)
 
 import argparse
 import copy
+import fnmatch
 import json
+import re
 import sys
 from pathlib import Path
 
@@ -403,7 +405,7 @@ def compute_dartt_offsets(type_info, base_byte_offset=0, unaligned_fields=None):
     return unaligned_fields
 
 
-def flatten_fields(type_info, prefix="", base_offset=0):
+def flatten_fields(type_info, prefix="", base_offset=0, parent_const=False):
     """
     Flatten nested struct fields into a flat list with full paths.
     This makes it easier for the dashboard to address individual fields.
@@ -411,6 +413,7 @@ def flatten_fields(type_info, prefix="", base_offset=0):
     Output uses DARTT protocol conventions:
     - dartt_offset: 32-bit word index (byte_offset / 4)
     - nbytes: size in bytes
+    - const: present (True) if the field or any enclosing struct/array is const-qualified
     """
     fields = []
 
@@ -419,23 +422,25 @@ def flatten_fields(type_info, prefix="", base_offset=0):
             field_name = field.get("name", "")
             field_byte_offset = (field.get("byte_offset") or 0) + base_offset
             field_type = field.get("type_info", {})
+            is_const = parent_const or field_type.get("const", False)
 
             full_name = f"{prefix}.{field_name}" if prefix else field_name
 
             # If this field is itself a struct, recurse
             if field_type.get("type") in ("struct", "union"):
-                fields.extend(flatten_fields(field_type, full_name, field_byte_offset))
+                fields.extend(flatten_fields(field_type, full_name, field_byte_offset, is_const))
             elif field_type.get("type") == "array":
                 elem_type = field_type.get("element_type", {})
                 elem_size = elem_type.get("size", 0)
                 total = field_type.get("total_elements", 0)
+                is_const = is_const or elem_type.get("const", False)
 
                 # If array of structs, expand each element
                 if elem_type.get("type") in ("struct", "union"):
                     for i in range(total):
                         elem_name = f"{full_name}[{i}]"
                         elem_byte_offset = field_byte_offset + (i * elem_size)
-                        fields.extend(flatten_fields(elem_type, elem_name, elem_byte_offset))
+                        fields.extend(flatten_fields(elem_type, elem_name, elem_byte_offset, is_const))
                 else:
                     # Array of primitives - add as single field with array info
                     entry = {
@@ -446,6 +451,8 @@ def flatten_fields(type_info, prefix="", base_offset=0):
                         "array_size": total,
                         "element_nbytes": elem_size
                     }
+                    if is_const:
+                        entry["const"] = True
                     # Flag if not 32-bit aligned
                     if field_byte_offset % 4 != 0:
                         entry["unaligned"] = True
@@ -459,6 +466,8 @@ def flatten_fields(type_info, prefix="", base_offset=0):
                     "nbytes": field_type.get("size", 0),
                     "type": get_simple_type_name(field_type)
                 }
+                if is_const:
+                    entry["const"] = True
 
                 # Flag if not 32-bit aligned
                 if field_byte_offset % 4 != 0:
@@ -500,6 +509,183 @@ def get_simple_type_name(type_info):
         return type_info.get("type", "unknown")
 
 
+# Access modes, matching DARTT_ACCESS_RW/RO/WO/NA in src/dartt_periph.h.
+# Bit 0 denies writes, bit 1 denies reads.
+ACCESS_MODES = {"rw": 0x0, "ro": 0x1, "wo": 0x2, "na": 0x3}
+ACCESS_WORDS_PER_ENTRY = 16
+
+
+def parse_access_overrides(specs):
+    """Parse PATTERN=MODE strings (fnmatch patterns on flat field names) into (pattern, mode) pairs."""
+    overrides = []
+    for spec in specs:
+        pattern, sep, mode = spec.rpartition("=")
+        mode = mode.strip().lower()
+        if not sep or not pattern or mode not in ACCESS_MODES:
+            raise ValueError(f"Bad access override '{spec}', expected PATTERN=rw|ro|wo|na")
+        overrides.append((pattern, ACCESS_MODES[mode]))
+    return overrides
+
+
+def build_access_map(flat_fields, total_nbytes, overrides=None):
+    """
+    Build the peripheral access control map (see dartt_periph_t.access_map).
+
+    const-qualified fields are read-only, everything else is read/write unless an
+    override matches the field name (last matching override wins). Each field's mode is
+    ORed into every word it touches, so a word shared by several fields gets the most
+    restrictive mode of all of them.
+
+    Returns a list of uint32_t entries, 2 bits per word, 16 words per entry.
+    """
+    overrides = overrides or []
+    nwords = (total_nbytes + 3) // 4
+    modes = [0] * nwords
+    for field in flat_fields:
+        mode = ACCESS_MODES["ro"] if field.get("const") else ACCESS_MODES["rw"]
+        for pattern, override in overrides:
+            if fnmatch.fnmatchcase(field["name"], pattern):
+                mode = override
+        byte_offset = field.get("byte_offset", field["dartt_offset"] * 4)
+        nbytes = field.get("nbytes", 0)
+        if nbytes == 0:
+            continue
+        first_word = byte_offset // 4
+        last_word = (byte_offset + nbytes - 1) // 4
+        for w in range(first_word, min(last_word + 1, nwords)):
+            modes[w] |= mode
+
+    nentries = (nwords + ACCESS_WORDS_PER_ENTRY - 1) // ACCESS_WORDS_PER_ENTRY
+    access_map = [0] * nentries
+    for w, mode in enumerate(modes):
+        access_map[w // ACCESS_WORDS_PER_ENTRY] |= mode << (2 * (w % ACCESS_WORDS_PER_ENTRY))
+    return access_map
+
+
+def format_access_map_c(symbol, access_map):
+    """Format an access map as a C array definition for dartt_periph_t.access_map."""
+    lines = [f"/* Generated by dartt-describe.py from the layout of {symbol}. Do not edit. */",
+             f"static const uint32_t {symbol}_access_map[{max(len(access_map), 1)}] = {{"]
+    for i in range(0, len(access_map), 4):
+        row = ", ".join(f"0x{v:08X}" for v in access_map[i:i + 4])
+        lines.append(f"    {row},")
+    lines.append("};")
+    return "\n".join(lines) + "\n"
+
+
+# Element types that get a typed value pointer in generated write accessors. Anything else is passed as const void *
+C_VALUE_TYPES = {
+    "float", "double", "char", "signed char", "unsigned char", "short int", "short unsigned int", "int",
+    "unsigned int", "long int", "long unsigned int", "long long int", "long long unsigned int", "_Bool", "bool",
+    "int8_t", "uint8_t", "int16_t", "uint16_t", "int32_t", "uint32_t", "int64_t", "uint64_t",
+}
+C_DESIGNATOR = re.compile(r"^[A-Za-z_]\w*(\[\d+\])*(\.[A-Za-z_]\w*(\[\d+\])*)*$")
+
+
+def c_type_name(type_info):
+    """C name of a struct type, for offsetof/sizeof checks. None if the type has no name usable from C."""
+    if type_info.get("typedef"):
+        return type_info["typedef"]
+    t = type_info.get("type")
+    if t == "struct" and type_info.get("struct_name"):
+        return f"struct {type_info['struct_name']}"
+    if t == "union" and type_info.get("union_name"):
+        return f"union {type_info['union_name']}"
+    return None
+
+
+def format_layout_c(symbol, type_info, flat_fields, total_nbytes):
+    """
+    Format a C header with the word index and size of every flat field, and static inline functions that build
+    read and write frames for each field with a constant index.
+
+    Unaligned fields cannot be addressed by DARTT and are listed in a comment instead. When the top-level type has a
+    C name, _Static_assert checks compare the generated offsets with the compiler's, so a header that no longer
+    matches the firmware fails to build.
+    """
+    prefix = re.sub(r"\W", "_", symbol)
+    upper = prefix.upper()
+    guard = f"{upper}_LAYOUT_H"
+    type_name = c_type_name(type_info)
+    type_desc = f" ({type_name}, {total_nbytes} bytes)" if type_name else f" ({total_nbytes} bytes)"
+
+    lines = [f"/* Generated by dartt-describe.py from the layout of {symbol}{type_desc}. Do not edit. */",
+             f"#ifndef {guard}",
+             f"#define {guard}",
+             '#include "dartt.h"',
+             ""]
+    if type_name:
+        lines += [f"/* Include after the definition of {type_name}, or define {upper}_NO_LAYOUT_CHECK to skip the checks. */",
+                  "#include <stddef.h>",
+                  ""]
+    lines += [f"#define {upper}_NBYTES\t{total_nbytes}",
+              f"#define {upper}_NWORDS\t{(total_nbytes + 3) // 4}",
+              ""]
+
+    emitted = []
+    skipped = []
+    seen = {}
+    for field in flat_fields:
+        name = field["name"]
+        nbytes = field.get("nbytes", 0)
+        if field.get("unaligned") or nbytes == 0 or not C_DESIGNATOR.match(name):
+            skipped.append(name)
+            continue
+        ident = re.sub(r"_+", "_", re.sub(r"\W", "_", name)).strip("_")
+        if ident.upper() in seen:
+            raise ValueError(f"Fields '{seen[ident.upper()]}' and '{name}' both map to {upper}_{ident.upper()}")
+        seen[ident.upper()] = name
+        emitted.append((name, ident, field))
+
+        macro = f"{upper}_{ident.upper()}"
+        lines.append(f"#define {macro}_INDEX\t{field['dartt_offset']}")
+        lines.append(f"#define {macro}_NBYTES\t{nbytes}")
+        if "array_size" in field:
+            lines.append(f"#define {macro}_COUNT\t{field['array_size']}")
+    if skipped:
+        lines += ["", "/* Not addressable (unaligned, zero size or unnamed): " + ", ".join(skipped) + " */"]
+
+    if type_name:
+        lines += ["", f"#ifndef {upper}_NO_LAYOUT_CHECK",
+                  "#ifdef __cplusplus",
+                  f"#define {upper}_LAYOUT_ASSERT(c, m)\tstatic_assert(c, m)",
+                  "#else",
+                  f"#define {upper}_LAYOUT_ASSERT(c, m)\t_Static_assert(c, m)",
+                  "#endif",
+                  f'{upper}_LAYOUT_ASSERT(sizeof({type_name}) == {upper}_NBYTES, "{symbol}: layout changed, regenerate this header");']
+        for name, ident, field in emitted:
+            if "bit_size" in field:
+                continue    # offsetof does not apply to bitfields
+            macro = f"{upper}_{ident.upper()}"
+            lines.append(f"{upper}_LAYOUT_ASSERT(offsetof({type_name}, {name}) == {macro}_INDEX*4 && "
+                         f"sizeof((({type_name} *)0)->{name}) == {macro}_NBYTES, "
+                         f'"{symbol}.{name}: layout changed, regenerate this header");')
+        lines.append("#endif")
+
+    for name, ident, field in emitted:
+        macro = f"{upper}_{ident.upper()}"
+        value_type = field.get("type", "")
+        if "array_size" in field:
+            value_type = value_type.split("[", 1)[0]
+        value_type = value_type if value_type in C_VALUE_TYPES else "void"
+        lines += ["",
+                  f"/* {name}: {field.get('type', 'unknown')}, word {field['dartt_offset']}, {field['nbytes']} bytes */",
+                  f"static inline int {prefix}_write_{ident}_frame(unsigned char address, const {value_type} * value, serial_message_type_t type, dartt_buffer_t * output)",
+                  "{",
+                  f"\tmisc_write_message_t msg = {{address, DARTT_INDEX_OF_WORD({macro}_INDEX), {{(unsigned char *)value, {macro}_NBYTES, {macro}_NBYTES}}}};",
+                  "\treturn dartt_create_write_frame(&msg, type, output);",
+                  "}",
+                  "",
+                  f"static inline int {prefix}_read_{ident}_frame(unsigned char address, serial_message_type_t type, dartt_buffer_t * output)",
+                  "{",
+                  f"\tmisc_read_message_t msg = {{address, DARTT_INDEX_OF_WORD({macro}_INDEX), {macro}_NBYTES, DARTT_TAG_NONE}};",
+                  "\treturn dartt_create_read_frame(&msg, type, output);",
+                  "}"]
+
+    lines += ["", f"#endif /* {guard} */"]
+    return "\n".join(lines) + "\n"
+
+
 def main():
     parser = argparse.ArgumentParser(
         description="Extract struct layout from ELF DWARF debug info for DARTT dashboard",
@@ -509,6 +695,8 @@ Examples:
   python dartt-describe.py firmware.elf gl_dp
   python dartt-describe.py firmware.elf motor_config -o motor_config.json
   python dartt-describe.py firmware.elf gl_dp --flat
+  python dartt-describe.py firmware.elf gl_dp --access-map gl_dp_access.h --access "fault_*=na"
+  python dartt-describe.py firmware.elf gl_dp --emit-c gl_dp_layout.h
         """
     )
 
@@ -521,9 +709,24 @@ Examples:
                         help="Pretty-print JSON output (default: true)")
     parser.add_argument("--compact", action="store_true",
                         help="Compact JSON output (no indentation)")
+    parser.add_argument("--access-map", metavar="FILE",
+                        help="Write a C access control map for dartt_periph_t.access_map "
+                             "(const fields are read-only)")
+    parser.add_argument("--access", metavar="PATTERN=MODE", action="append", default=[],
+                        help="Override the access mode (rw, ro, wo, na) of flat fields matching "
+                             "PATTERN, e.g. 'stats.*=ro'. May be repeated")
+    parser.add_argument("--emit-c", metavar="FILE",
+                        help="Write a C header with the word index and size of every field, and "
+                             "inline read/write frame builders with constant indices")
 
     args = parser.parse_args()
 
+    try:
+        access_overrides = parse_access_overrides(args.access)
+    except ValueError as e:
+        print(f"Error: {e}", file=sys.stderr)
+        sys.exit(1)
+
     # Open and parse ELF file
     elf_path = Path(args.elf_file)
     if not elf_path.exists():
@@ -596,6 +799,22 @@ Examples:
         if args.flat:
             output["flat_fields"] = flatten_fields(type_info_cached)
 
+        if args.access_map:
+            access_map = build_access_map(flatten_fields(type_info_cached), total_nbytes, access_overrides)
+            with open(args.access_map, 'w') as f:
+                f.write(format_access_map_c(args.symbol, access_map))
+            print(f"Wrote {args.access_map}", file=sys.stderr)
+
+        if args.emit_c:
+            try:
+                layout = format_layout_c(args.symbol, type_info_cached, flatten_fields(type_info_cached), total_nbytes)
+            except ValueError as e:
+                print(f"Error: {e}", file=sys.stderr)
+                sys.exit(1)
+            with open(args.emit_c, 'w') as f:
+                f.write(layout)
+            print(f"Wrote {args.emit_c}", file=sys.stderr)
+
     # Output JSON
     indent = None if args.compact else 2
     json_output = json.dumps(output, indent=indent)
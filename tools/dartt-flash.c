@@ -0,0 +1,301 @@
+/*
+	dartt-flash - upload a firmware image into the flash staging region of a DARTT peripheral (dartt_flash.h)
+
+	The image goes through dartt_flash_upload over any dartt_sync_t transport: windows of write frames sent back to
+	back and acknowledged by CRC32 queries, sequenced program commands, and a commit checked against the CRC32 of
+	the whole image.
+
+	usage: dartt-flash [options] image.bin
+		--serial DEV		serial port, COBS framed TYPE_SERIAL_MESSAGE (dartt_serial_linux)
+		--baud N			serial baud rate. Default 921600
+		--udp HOST:PORT		UDP, TYPE_ADDR_CRC_MESSAGE (dartt_udp_linux)
+		--sim FILE			in-process simulated peripheral whose flash slot is FILE (dartt_flash_file)
+		--address A			peripheral address. Default 3
+		--word N			word index of the flash control block in the peripheral memory map. Default 0
+		--window N			largest window in bytes. Default 4096. The peripheral window_size also applies
+*/
+#define _GNU_SOURCE
+#include "dartt.h"
+#include "dartt_crc.h"
+#include "dartt_sync.h"
+#include "dartt_periph.h"
+#include "dartt_flash.h"
+#include "dartt_flash_file.h"
+#include "dartt_serial_linux.h"
+#include "dartt_udp_linux.h"
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_BAUD	921600
+#define DEFAULT_WINDOW	4096
+
+/*
+	Simulated peripheral, served from the tx callback: the reply is ready by the time the controller receives
+*/
+typedef struct sim_t
+{
+	unsigned char * map;
+	dartt_periph_t periph;
+	dartt_write_hook_t hook;
+	dartt_flash_t flash;
+	dartt_flash_file_t file;
+	unsigned char reply_mem[DARTT_UDP_LINUX_MAX_FRAME];
+	dartt_buffer_t reply;
+}sim_t;
+
+static int sim_tx(unsigned char address, dartt_buffer_t * tx, void * user_context, uint32_t timeout)
+{
+	(void)address;
+	(void)timeout;
+	sim_t * sim = (sim_t *)user_context;
+	payload_layer_msg_t pld = {0};
+	sim->reply.len = 0;
+	int rc = dartt_frame_to_payload(tx, TYPE_ADDR_CRC_MESSAGE, PAYLOAD_ALIAS, &pld);
+	if(rc != DARTT_PROTOCOL_SUCCESS)
+	{
+		return rc;
+	}
+	dartt_periph_parse(&sim->periph, &pld, TYPE_ADDR_CRC_MESSAGE, &sim->reply);
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+static int sim_rx(dartt_buffer_t * rx, void * user_context, uint32_t timeout)
+{
+	(void)timeout;
+	sim_t * sim = (sim_t *)user_context;
+	if(sim->reply.len == 0)
+	{
+		return DARTT_ERROR_TIMEOUT;
+	}
+	if(sim->reply.len > rx->size)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	memcpy(rx->buf, sim->reply.buf, sim->reply.len);
+	rx->len = sim->reply.len;
+	sim->reply.len = 0;
+	return DARTT_PROTOCOL_SUCCESS;
+}
+
+static int sim_open(sim_t * sim, const char * path, uint32_t word, size_t window, size_t capacity)
+{
+	size_t first = (size_t)word*sizeof(uint32_t);
+	sim->map = calloc(1, first + sizeof(dartt_flash_ctl_t) + window);
+	if(sim->map == NULL)
+	{
+		return DARTT_ERROR_MEMORY_OVERRUN;
+	}
+	int rc = dartt_flash_init((dartt_flash_ctl_t *)(sim->map + first), window);
+	if(rc == DARTT_PROTOCOL_SUCCESS)
+	{
+		rc = dartt_flash_file_open(&sim->file, path);
+	}
+	sim->flash.backend = &sim->file.backend;
+	sim->flash.capacity = capacity;
+	dartt_write_hook_t hook = DARTT_FLASH_HOOK(word, &sim->flash);
+	sim->hook = hook;
+	sim->periph.mem_base.buf = sim->map;
+	sim->periph.mem_base.size = first + sizeof(dartt_flash_ctl_t) + window;
+	sim->periph.hooks = &sim->hook;
+	sim->periph.num_hooks = 1;
+	sim->reply.buf = sim->reply_mem;
+	sim->reply.size = sizeof(sim->reply_mem);
+	return rc;
+}
+
+static unsigned char * load_image(const char * path, size_t * len)
+{
+	FILE * fp = fopen(path, "rb");
+	if(fp == NULL)
+	{
+		return NULL;
+	}
+	unsigned char * image = NULL;
+	if(fseek(fp, 0, SEEK_END) == 0)
+	{
+		long size = ftell(fp);
+		if(size > 0 && fseek(fp, 0, SEEK_SET) == 0)
+		{
+			image = malloc((size_t)size);
+			if(image != NULL && fread(image, 1, (size_t)size, fp) != (size_t)size)
+			{
+				free(image);
+				image = NULL;
+			}
+			*len = (size_t)size;
+		}
+	}
+	fclose(fp);
+	return image;
+}
+
+static double now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: dartt-flash (--serial DEV [--baud N] | --udp HOST:PORT | --sim FILE) [--address A] [--word N] [--window N] image.bin\n");
+}
+
+int main(int argc, char ** argv)
+{
+	static const struct option options[] = {
+		{"serial", required_argument, NULL, 's'},
+		{"baud", required_argument, NULL, 'b'},
+		{"udp", required_argument, NULL, 'u'},
+		{"sim", required_argument, NULL, 'S'},
+		{"address", required_argument, NULL, 'a'},
+		{"word", required_argument, NULL, 'w'},
+		{"window", required_argument, NULL, 'W'},
+		{NULL, 0, NULL, 0}
+	};
+	const char * serial_path = NULL;
+	const char * udp_target = NULL;
+	const char * sim_path = NULL;
+	uint32_t baud = DEFAULT_BAUD;
+	unsigned long address = 3;
+	unsigned long word = 0;
+	unsigned long window = DEFAULT_WINDOW;
+	int opt;
+	while((opt = getopt_long(argc, argv, "s:b:u:S:a:w:W:", options, NULL)) != -1)
+	{
+		switch(opt)
+		{
+			case 's': serial_path = optarg; break;
+			case 'b': baud = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'u': udp_target = optarg; break;
+			case 'S': sim_path = optarg; break;
+			case 'a': address = strtoul(optarg, NULL, 0); break;
+			case 'w': word = strtoul(optarg, NULL, 0); break;
+			case 'W': window = strtoul(optarg, NULL, 0); break;
+			default: usage(); return 2;
+		}
+	}
+	if(optind != argc - 1 || (serial_path != NULL) + (udp_target != NULL) + (sim_path != NULL) != 1
+		|| address > 0xFF || word > UINT32_MAX/2 || window == 0 || window % sizeof(uint32_t) != 0)
+	{
+		usage();
+		return 2;
+	}
+	size_t len = 0;
+	unsigned char * image = load_image(argv[optind], &len);
+	if(image == NULL)
+	{
+		fprintf(stderr, "dartt-flash: cannot read %s\n", argv[optind]);
+		return 1;
+	}
+
+	//the controller copies only cover the flash region, which base_offset places in the peripheral memory map
+	size_t region_size = sizeof(dartt_flash_ctl_t) + window;
+	unsigned char * ctl_mem = calloc(1, region_size);
+	unsigned char * shadow_mem = calloc(1, region_size);
+	static unsigned char tx_mem[DARTT_UDP_LINUX_MAX_FRAME];
+	static unsigned char rx_mem[DARTT_UDP_LINUX_MAX_FRAME];
+	static dartt_serial_linux_t serial;
+	static dartt_udp_linux_t udp;
+	static sim_t sim;
+	dartt_sync_t ds = {0};
+	ds.address = (unsigned char)address;
+	ds.ctl_base.buf = ctl_mem;
+	ds.ctl_base.size = region_size;
+	ds.periph_base.buf = shadow_mem;
+	ds.periph_base.size = region_size;
+	ds.base_offset = (uint32_t)word;
+	ds.tx_buf.buf = tx_mem;
+	ds.rx_buf.buf = rx_mem;
+	ds.timeout_ms = 100;
+	ds.retry.max_attempts = 3;
+	ds.retry.retry_mask = DARTT_RETRY_DEFAULT_MASK | DARTT_RETRY_BIT(DARTT_ERROR_SYNC_MISMATCH);	//repair lost frames of a window
+
+	int rc;
+	if(serial_path != NULL)
+	{
+		rc = dartt_serial_linux_open(&serial, serial_path, baud);
+		ds.msg_type = TYPE_SERIAL_MESSAGE;
+		ds.tx_buf.size = DARTT_SERIAL_LINUX_MAX_FRAME;
+		ds.rx_buf.size = DARTT_SERIAL_LINUX_MAX_FRAME;
+		ds.user_context_tx = &serial;
+		ds.user_context_rx = &serial;
+		ds.blocking_tx_callback = &dartt_serial_linux_tx;
+		ds.blocking_rx_callback = &dartt_serial_linux_rx;
+	}
+	else if(udp_target != NULL)
+	{
+		char host[256];
+		const char * colon = strrchr(udp_target, ':');
+		size_t host_len = (colon != NULL) ? (size_t)(colon - udp_target) : 0;
+		rc = DARTT_ERROR_INVALID_ARGUMENT;
+		if(host_len != 0 && host_len < sizeof(host))
+		{
+			memcpy(host, udp_target, host_len);
+			host[host_len] = '\0';
+			rc = dartt_udp_linux_open(&udp, host, (uint16_t)strtoul(colon + 1, NULL, 0), 0);
+		}
+		ds.msg_type = TYPE_ADDR_CRC_MESSAGE;
+		ds.tx_buf.size = DARTT_UDP_LINUX_MAX_FRAME;
+		ds.rx_buf.size = DARTT_UDP_LINUX_MAX_FRAME;
+		ds.user_context_tx = &udp;
+		ds.user_context_rx = &udp;
+		ds.blocking_tx_callback = &dartt_udp_linux_tx;
+		ds.blocking_rx_callback = &dartt_udp_linux_rx;
+		ds.flush_tx_callback = &dartt_udp_linux_flush;
+	}
+	else
+	{
+		rc = sim_open(&sim, sim_path, (uint32_t)word, window, len);
+		ds.msg_type = TYPE_ADDR_CRC_MESSAGE;
+		ds.tx_buf.size = DARTT_UDP_LINUX_MAX_FRAME;
+		ds.rx_buf.size = DARTT_UDP_LINUX_MAX_FRAME;
+		ds.user_context_tx = &sim;
+		ds.user_context_rx = &sim;
+		ds.blocking_tx_callback = &sim_tx;
+		ds.blocking_rx_callback = &sim_rx;
+	}
+	if(rc != DARTT_PROTOCOL_SUCCESS || ctl_mem == NULL || shadow_mem == NULL)
+	{
+		fprintf(stderr, "dartt-flash: cannot open the link (%d)\n", rc);
+		return 1;
+	}
+
+	double t0 = now_s();
+	rc = dartt_sync_prepare(&ds);
+	if(rc == DARTT_PROTOCOL_SUCCESS)
+	{
+		rc = dartt_flash_upload(&ds.ctl_base, &ds, image, len);
+	}
+	double dt = now_s() - t0;
+	if(rc == DARTT_PROTOCOL_SUCCESS)
+	{
+		printf("%zu bytes in %.3f s, %.1f kB/s, crc32 0x%08X, %u frames retried\n", len, dt, len/dt/1000.0,
+			(unsigned)dartt_crc32(image, len), (unsigned)ds.retry_stats.retries);
+	}
+	else
+	{
+		fprintf(stderr, "dartt-flash: upload failed (%d) after %.3f s\n", rc, dt);
+	}
+
+	if(serial_path != NULL)
+	{
+		dartt_serial_linux_close(&serial);
+	}
+	else if(udp_target != NULL)
+	{
+		dartt_udp_linux_close(&udp);
+	}
+	else
+	{
+		dartt_flash_file_close(&sim.file);
+		free(sim.map);
+	}
+	free(ctl_mem);
+	free(shadow_mem);
+	free(image);
+	return (rc == DARTT_PROTOCOL_SUCCESS) ? 0 : 1;
+}
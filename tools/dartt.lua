@@ -0,0 +1,207 @@
+--[[
+    dartt.lua - Wireshark dissector for DARTT frame captures
+
+    Captures are written by dartt_trace_export_pcapng() (src/dartt_trace.h) with link type LINKTYPE_USER0 (147).
+    Every packet starts with a 4 byte pseudo-header, followed by the frame as it was handed to the tx callback or
+    returned by the rx callback:
+
+        [direction][msg_type][address][flags] [frame...]
+
+        direction   0: controller to peripheral, 1: peripheral to controller
+        msg_type    serial_message_type_t of the frame, which sets its framing
+        address     misc address a controller frame was sent to. 0 for peripheral frames
+        flags       bit 0: the frame was truncated to DARTT_TRACE_SNAPLEN bytes
+
+    Install: copy to the Wireshark personal Lua plugins folder (Help > About Wireshark > Folders), or run
+        wireshark -X lua_script:tools/dartt.lua capture.pcapng
+]]
+
+local dartt = Proto("dartt", "Dual Address Real-Time Transport")
+
+local DIR_TX = 0
+local TYPE_SERIAL_MESSAGE = 0
+local TYPE_ADDR_MESSAGE = 1
+local INDEX_COMMIT = 0x7FFF
+local INDEX_EXTENDED = 0x7FFE
+local INDEX_CRC32 = 0x7FFD
+
+local directions = { [0] = "Controller to peripheral", [1] = "Peripheral to controller" }
+local msg_types = { [0] = "TYPE_SERIAL_MESSAGE", [1] = "TYPE_ADDR_MESSAGE", [2] = "TYPE_ADDR_CRC_MESSAGE" }
+local error_codes = {
+    [-1] = "ADDRESS_FILTERED", [-2] = "MALFORMED_MESSAGE", [-3] = "CHECKSUM_MISMATCH", [-4] = "INVALID_ARGUMENT",
+    [-5] = "MEMORY_OVERRUN", [-6] = "SYNC_MISMATCH", [-7] = "CTL_READ_LEN_MISMATCH", [-8] = "ACCESS_DENIED",
+    [-9] = "TAG_MISMATCH", [-10] = "TIMEOUT",
+}
+
+local f = dartt.fields
+f.direction = ProtoField.uint8("dartt.direction", "Direction", base.DEC, directions)
+f.msg_type = ProtoField.uint8("dartt.msg_type", "Message type", base.DEC, msg_types)
+f.sent_to = ProtoField.uint8("dartt.sent_to", "Sent to", base.HEX)
+f.truncated = ProtoField.bool("dartt.truncated", "Truncated", 8, nil, 0x01)
+f.address = ProtoField.uint8("dartt.address", "Address", base.HEX)
+f.index = ProtoField.uint16("dartt.index", "Index", base.HEX, nil, 0x7FFF)
+f.rw = ProtoField.bool("dartt.rw", "R/W bit", 16, nil, 0x8000)
+f.index_ext = ProtoField.uint32("dartt.index_ext", "Extended index", base.HEX)
+f.offset = ProtoField.uint32("dartt.offset", "Byte offset", base.DEC)
+f.num_bytes = ProtoField.uint16("dartt.num_bytes", "Num bytes", base.DEC)
+f.word = ProtoField.uint32("dartt.word", "Word", base.DEC)
+f.span = ProtoField.uint32("dartt.span", "Span bytes", base.DEC)
+f.crc32 = ProtoField.uint32("dartt.crc32", "CRC32", base.HEX)
+f.tag = ProtoField.uint8("dartt.tag", "Tag", base.DEC)
+f.payload = ProtoField.bytes("dartt.payload", "Payload")
+f.error = ProtoField.int8("dartt.error", "Error code", base.DEC, error_codes)
+f.crc = ProtoField.uint16("dartt.crc", "CRC", base.HEX)
+
+local ef_bad_crc = ProtoExpert.new("dartt.crc.bad", "Bad CRC", expert.group.CHECKSUM, expert.severity.ERROR)
+local ef_short = ProtoExpert.new("dartt.short", "Frame too short", expert.group.MALFORMED, expert.severity.ERROR)
+dartt.experts = { ef_bad_crc, ef_short }
+
+-- dartt_crc16: CRC-16 polynomial 0xA001 (reflected 0x8005), initial value 0xFFFF
+local function crc16(tvb, offset, len)
+    local crc = 0xFFFF
+    for i = offset, offset + len - 1 do
+        crc = bit.bxor(crc, tvb(i, 1):uint())
+        for _ = 1, 8 do
+            if bit.band(crc, 1) ~= 0 then
+                crc = bit.bxor(bit.rshift(crc, 1), 0xA001)
+            else
+                crc = bit.rshift(crc, 1)
+            end
+        end
+    end
+    return crc
+end
+
+function dartt.dissector(tvb, pinfo, tree)
+    if tvb:len() < 4 then
+        return 0
+    end
+    pinfo.cols.protocol = "DARTT"
+    local root = tree:add(dartt, tvb())
+    local dir = tvb(0, 1):uint()
+    local msg_type = tvb(1, 1):uint()
+    local truncated = bit.band(tvb(3, 1):uint(), 1) ~= 0
+    root:add(f.direction, tvb(0, 1))
+    root:add(f.msg_type, tvb(1, 1))
+    if dir == DIR_TX then
+        root:add(f.sent_to, tvb(2, 1))
+        pinfo.cols.src = "controller"
+        pinfo.cols.dst = string.format("0x%02X", tvb(2, 1):uint())
+    else
+        pinfo.cols.src = "peripheral"
+        pinfo.cols.dst = "controller"
+    end
+    root:add(f.truncated, tvb(3, 1))
+
+    local pos = 4
+    local stop = tvb:len()
+    if msg_type == TYPE_SERIAL_MESSAGE or msg_type == TYPE_ADDR_MESSAGE then
+        if not truncated and stop - pos >= 2 then
+            stop = stop - 2
+            local crc_item = root:add_le(f.crc, tvb(stop, 2))
+            if crc16(tvb, pos, stop - pos) ~= tvb(stop, 2):le_uint() then
+                crc_item:add_proxy_expert_info(ef_bad_crc)
+            end
+        end
+    end
+    if msg_type == TYPE_SERIAL_MESSAGE then
+        if stop - pos < 1 then
+            root:add_proxy_expert_info(ef_short)
+            return tvb:len()
+        end
+        root:add(f.address, tvb(pos, 1))
+        pos = pos + 1
+    end
+    if stop - pos < 2 then
+        root:add_proxy_expert_info(ef_short)
+        return tvb:len()
+    end
+    local index_word = tvb(pos, 2):le_uint()
+    local index = bit.band(index_word, 0x7FFF)
+    local rw = bit.band(index_word, 0x8000) ~= 0
+    root:add_le(f.rw, tvb(pos, 2))
+    root:add_le(f.index, tvb(pos, 2))
+    pos = pos + 2
+    if index == INDEX_EXTENDED then
+        -- extended frame: the 32 bit word index follows the index field
+        if stop - pos < 4 then
+            root:add_proxy_expert_info(ef_short)
+            return tvb:len()
+        end
+        index = tvb(pos, 4):le_uint()
+        root:add_le(f.index_ext, tvb(pos, 4))
+        root:add(f.offset, tvb(pos, 4), index * 4):set_generated()
+        pos = pos + 4
+    else
+        root:add(f.offset, tvb(pos - 2, 2), index * 4):set_generated()
+    end
+    local body = stop - pos
+    local info
+
+    if dir == DIR_TX and rw and index == INDEX_CRC32 then
+        -- CRC32 query: [word u32][num_bytes u32](tag)
+        if body < 8 then
+            root:add_proxy_expert_info(ef_short)
+            return tvb:len()
+        end
+        root:add_le(f.word, tvb(pos, 4))
+        root:add_le(f.span, tvb(pos + 4, 4))
+        info = string.format("CRC32 query word %d, %d bytes", tvb(pos, 4):le_uint(), tvb(pos + 4, 4):le_uint())
+        if body >= 9 then
+            root:add(f.tag, tvb(pos + 8, 1))
+            info = info .. string.format(", tag %d", tvb(pos + 8, 1):uint())
+        end
+    elseif dir == DIR_TX and rw then
+        if body < 2 then
+            root:add_proxy_expert_info(ef_short)
+            return tvb:len()
+        end
+        root:add_le(f.num_bytes, tvb(pos, 2))
+        info = string.format("Read request idx 0x%04X, %d bytes", index, tvb(pos, 2):le_uint())
+        if body >= 3 then
+            root:add(f.tag, tvb(pos + 2, 1))
+            info = info .. string.format(", tag %d", tvb(pos + 2, 1):uint())
+        end
+    elseif dir == DIR_TX then
+        if body > 0 then
+            root:add(f.payload, tvb(pos, body))
+        end
+        if index == INDEX_COMMIT then
+            info = "Commit"
+        else
+            info = string.format("Write idx 0x%04X, %d bytes", index, body)
+        end
+    elseif rw then
+        -- a read reply never sets the R/W bit: this is an error reply, [error code][tag]
+        if body < 1 then
+            root:add_proxy_expert_info(ef_short)
+            return tvb:len()
+        end
+        root:add(f.error, tvb(pos, 1))
+        local code = tvb(pos, 1):int()
+        info = string.format("Error reply idx 0x%04X: %s", index, error_codes[code] or tostring(code))
+        if body >= 2 then
+            root:add(f.tag, tvb(pos + 1, 1))
+        end
+    elseif index == INDEX_CRC32 and body >= 4 then
+        root:add_le(f.crc32, tvb(pos, 4))
+        info = string.format("CRC32 reply 0x%08X", tvb(pos, 4):le_uint())
+        if body >= 5 then
+            root:add(f.tag, tvb(pos + 4, 1))
+        end
+    else
+        -- the reply tag, if the request had one, is the last payload byte. It cannot be told apart from the data here
+        if body > 0 then
+            root:add(f.payload, tvb(pos, body))
+        end
+        info = string.format("Read reply idx 0x%04X, %d bytes", index, body)
+    end
+    if truncated then
+        info = info .. " [truncated]"
+    end
+    pinfo.cols.info = info
+    return tvb:len()
+end
+
+local encaps = wtap_encaps or wtap
+DissectorTable.get("wtap_encap"):add(encaps.USER0, dartt)